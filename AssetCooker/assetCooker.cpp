@@ -0,0 +1,416 @@
+#include "assetCooker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "cookedAssets.h"
+#include "cpuProfiler.h"
+#include "hash.h"
+#include "imageDecoder.h"
+#include "ktx2Texture.h"
+#include "mappedFile.h"
+#include "meshFile.h"
+#include "mipChainFile.h"
+#include "objImport.h"
+
+namespace {
+
+	const char* const manifestFileName = "cook.manifest";
+	const char* const manifestHeader = "AssetCooker manifest";
+	const uint32_t shaderBlobVersion = 1; // Raw SPIR-V words, as vkCreateShaderModule takes them.
+
+	std::string lowerExtension(const std::filesystem::path& path) {
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+		return extension;
+	}
+
+	bool classify(const std::string& extension, AssetKind& kind) {
+		if (extension == ".obj") {
+			kind = AssetKind::Mesh;
+		}
+		else if (extension == ".png" || extension == ".ktx2") {
+			kind = AssetKind::Texture;
+		}
+		else if (extension == ".vert" || extension == ".frag" || extension == ".comp") {
+			kind = AssetKind::Shader;
+		}
+		else {
+			return false; // Includes, glTF scenes and everything else are loaded as they are, or are inputs of other assets.
+		}
+		return true;
+	}
+
+	const char* kindName(AssetKind kind) {
+		switch (kind) {
+			case AssetKind::Mesh: return "mesh";
+			case AssetKind::Texture: return "texture";
+			default: return "shader";
+		}
+	}
+
+	bool readStamp(const std::string& path, uint64_t& size, int64_t& modified) {
+		std::error_code error;
+		size = std::filesystem::file_size(path, error);
+		if (error) {
+			return false;
+		}
+		modified = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+		return !error;
+	}
+
+	std::string keyName(uint64_t key) {
+		return toHex(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+	}
+
+	// Inverse of keyName.
+	bool parseKey(const std::string& hex, uint64_t& key) {
+		if (hex.size() != sizeof(key) * 2) {
+			return false;
+		}
+		uint8_t bytes[sizeof(key)];
+		for (size_t i = 0; i < sizeof(key); ++i) {
+			char* end = nullptr;
+			std::string pair = hex.substr(i * 2, 2);
+			bytes[i] = static_cast<uint8_t>(std::strtoul(pair.c_str(), &end, 16));
+			if (end != pair.c_str() + 2) {
+				return false;
+			}
+		}
+		memcpy(&key, bytes, sizeof(key));
+		return true;
+	}
+
+	// What follows the fixed fields of a manifest line: a path, which may contain spaces.
+	std::string readRest(std::istringstream& line) {
+		std::string rest;
+		std::getline(line, rest);
+		size_t start = rest.find_first_not_of(' ');
+		return start == std::string::npos ? std::string() : rest.substr(start);
+	}
+}
+
+AssetCooker::AssetCooker(CookOptions options) : options(std::move(options)) {
+	jobSystem = std::make_unique<JobSystem>(this->options.workerThreads);
+	// Its own include-aware cache makes recompiling an unchanged shader a hash and a file read.
+	shaderCompiler = std::make_unique<ShaderCompiler>(this->options.sourceDirectory, (std::filesystem::path(this->options.cacheDirectory) / "shaders").string());
+}
+
+bool AssetCooker::run() {
+	auto start = std::chrono::steady_clock::now();
+	std::filesystem::create_directories(options.cacheDirectory);
+	std::filesystem::create_directories(options.outputDirectory);
+	loadManifest();
+	scanSources();
+
+	// Largest first, so the longest cooks aren't the last ones started.
+	std::vector<uint32_t> order(assets.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return assets[a].size > assets[b].size; });
+	JobCounter jobs;
+	for (uint32_t index : order) {
+		jobSystem->submit([this, index]() { cookAsset(index); }, &jobs);
+	}
+	jobSystem->wait(jobs);
+
+	uint32_t removed = removeStaleOutputs();
+	saveManifest();
+
+	counts = CookCounts();
+	counts.removed = removed;
+	for (const Asset& asset : assets) {
+		switch (asset.result) {
+			case CookResult::UpToDate: ++counts.upToDate; break;
+			case CookResult::CacheHit: ++counts.fromCache; break;
+			case CookResult::Cooked: ++counts.cooked; break;
+			case CookResult::Failed: ++counts.failed; break;
+		}
+		if (asset.result == CookResult::Failed) {
+			std::cerr << "Asset Cooker: " << asset.source << " failed. " << asset.error << "\n";
+		}
+		else if (options.verbose && asset.result != CookResult::UpToDate) {
+			std::cout << "\t" << (asset.result == CookResult::Cooked ? "cooked " : "cached ") << kindName(asset.kind) << " " << asset.source
+				<< " -> " << asset.output << " (" << asset.milliseconds << " ms)\n";
+		}
+	}
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Asset Cooker: " << assets.size() << " assets in " << milliseconds << " ms on " << jobSystem->getThreadCount() << " threads. "
+		<< counts.upToDate << " up to date, " << counts.fromCache << " from cache, " << counts.cooked << " cooked, " << counts.failed << " failed, "
+		<< counts.removed << " stale outputs removed\n";
+	return counts.failed == 0;
+}
+
+void AssetCooker::scanSources() {
+	if (!std::filesystem::is_directory(options.sourceDirectory)) {
+		throw std::runtime_error("Source directory " + options.sourceDirectory + " does not exist.");
+	}
+
+	std::unordered_map<std::string, std::string> outputs;
+	for (const std::filesystem::directory_entry& file : std::filesystem::recursive_directory_iterator(options.sourceDirectory)) {
+		AssetKind kind;
+		if (!file.is_regular_file() || !classify(lowerExtension(file.path()), kind)) {
+			continue;
+		}
+		Asset asset{};
+		asset.kind = kind;
+		asset.source = std::filesystem::relative(file.path(), options.sourceDirectory).generic_string();
+		asset.output = getCookedAssetName(asset.source);
+		asset.size = static_cast<uint64_t>(file.file_size());
+
+		auto claimed = outputs.emplace(asset.output, asset.source);
+		if (!claimed.second) {
+			throw std::runtime_error("Both " + claimed.first->second + " and " + asset.source + " would cook to " + asset.output + ".");
+		}
+		assets.push_back(std::move(asset));
+	}
+	std::sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) { return a.source < b.source; });
+}
+
+// A manifest from another cooker version, or one that doesn't parse, is ignored: every asset is hashed again, and
+// only the ones whose key changed are cooked.
+void AssetCooker::loadManifest() {
+	std::ifstream file(std::filesystem::path(options.outputDirectory) / manifestFileName);
+	std::string line;
+	if (!file.is_open() || !std::getline(file, line) || line != manifestHeader + std::string(" ") + std::to_string(options.cookerVersion)) {
+		return;
+	}
+
+	ManifestEntry* entry = nullptr;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string tag;
+		fields >> tag;
+		if (tag == "asset") {
+			uint32_t kind = 0;
+			std::string key;
+			fields >> kind >> key;
+			ManifestEntry parsed;
+			parsed.kind = static_cast<AssetKind>(kind);
+			std::string source = readRest(fields);
+			if (fields.fail() || kind > static_cast<uint32_t>(AssetKind::Shader) || !parseKey(key, parsed.key) || source.empty()) {
+				entry = nullptr;
+				continue;
+			}
+			entry = &(manifest[source] = std::move(parsed));
+		}
+		else if (tag == "input" && entry) {
+			InputStamp stamp;
+			fields >> stamp.size >> stamp.modified;
+			stamp.path = readRest(fields);
+			entry->inputs.push_back(std::move(stamp));
+		}
+	}
+}
+
+void AssetCooker::saveManifest() const {
+	std::filesystem::path path = std::filesystem::path(options.outputDirectory) / manifestFileName;
+	std::string tempPath = path.string() + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open " + tempPath + " for writing.");
+		}
+		file << manifestHeader << " " << options.cookerVersion << "\n";
+		for (const Asset& asset : assets) {
+			if (asset.result == CookResult::Failed) {
+				continue;
+			}
+			file << "asset " << static_cast<uint32_t>(asset.kind) << " " << keyName(asset.entry.key) << " " << asset.source << "\n";
+			for (const InputStamp& input : asset.entry.inputs) {
+				file << "input " << input.size << " " << input.modified << " " << input.path << "\n";
+			}
+		}
+		if (!file.good()) {
+			throw std::runtime_error("Failed to write " + tempPath + ".");
+		}
+	}
+	std::filesystem::rename(tempPath, path);
+}
+
+uint32_t AssetCooker::removeStaleOutputs() const {
+	std::unordered_set<std::string> sources;
+	for (const Asset& asset : assets) {
+		sources.insert(asset.source);
+	}
+
+	uint32_t removed = 0;
+	for (const auto& entry : manifest) {
+		if (sources.count(entry.first) != 0) {
+			continue;
+		}
+		// Not a name any more when the cooker no longer cooks that kind of file; the output directory itself stays.
+		std::string output = getCookedAssetName(entry.first);
+		std::error_code error;
+		if (!output.empty() && std::filesystem::remove(std::filesystem::path(options.outputDirectory) / output, error)) {
+			++removed;
+		}
+	}
+	return removed;
+}
+
+void AssetCooker::cookAsset(uint32_t index) {
+	CPU_PROFILE_SCOPE("cookAsset");
+	auto start = std::chrono::steady_clock::now();
+	Asset& asset = assets[index];
+	try {
+		auto previous = manifest.find(asset.source);
+		if (previous != manifest.end() && isUpToDate(asset, previous->second)) {
+			asset.entry = previous->second;
+			asset.result = CookResult::UpToDate;
+		}
+		else {
+			std::string blobPath;
+			switch (asset.kind) {
+				case AssetKind::Mesh:
+					blobPath = cookMesh(index, asset);
+					break;
+				case AssetKind::Texture:
+					blobPath = cookTexture(index, asset);
+					break;
+				case AssetKind::Shader:
+					blobPath = cookShader(index, asset);
+					break;
+			}
+
+			std::filesystem::path outputPath = std::filesystem::path(options.outputDirectory) / asset.output;
+			std::filesystem::create_directories(outputPath.parent_path());
+			std::string stagingPath = getStagingPath(outputPath.string(), index);
+			std::filesystem::copy_file(blobPath, stagingPath, std::filesystem::copy_options::overwrite_existing);
+			std::filesystem::rename(stagingPath, outputPath);
+		}
+	}
+	catch (const std::exception& error) {
+		asset.result = CookResult::Failed;
+		asset.error = error.what();
+	}
+	asset.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool AssetCooker::isUpToDate(const Asset& asset, const ManifestEntry& previous) const {
+	if (previous.kind != asset.kind || previous.inputs.empty() || !std::filesystem::exists(std::filesystem::path(options.outputDirectory) / asset.output)) {
+		return false;
+	}
+	for (const InputStamp& input : previous.inputs) {
+		uint64_t size = 0;
+		int64_t modified = 0;
+		if (!readStamp(input.path, size, modified) || size != input.size || modified != input.modified) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void AssetCooker::hashInputs(Asset& asset, uint32_t formatVersion, const std::vector<std::string>& inputs) const {
+	CPU_PROFILE_SCOPE("hashCookInputs");
+	uint64_t key = hashValue(options.cookerVersion, hashValue(asset.kind, hashValue(formatVersion)));
+	asset.entry.kind = asset.kind;
+	asset.entry.inputs.clear();
+	for (const std::string& path : inputs) {
+		// Stamped before reading, so a file that changes while it is hashed gets hashed again next run.
+		InputStamp stamp;
+		stamp.path = path;
+		if (!readStamp(path, stamp.size, stamp.modified)) {
+			throw std::runtime_error("Failed to read " + path + ".");
+		}
+		key = hashValue(stamp.size, key);
+		if (stamp.size > 0) {
+			MappedFile file;
+			file.open(path);
+			key = fnv1a64(file.getData(), file.getSize(), key);
+		}
+		asset.entry.inputs.push_back(std::move(stamp));
+	}
+	asset.entry.key = key;
+}
+
+std::string AssetCooker::getBlobPath(uint64_t key, const std::string& extension) const {
+	return (std::filesystem::path(options.cacheDirectory) / (keyName(key) + extension)).string();
+}
+
+std::string AssetCooker::getStagingPath(const std::string& path, uint32_t index) const {
+	return path + "." + std::to_string(index) + ".cooking";
+}
+
+void AssetCooker::publishBlob(const std::string& stagingPath, const std::string& blobPath) const {
+	std::error_code error;
+	std::filesystem::rename(stagingPath, blobPath, error);
+	if (error) {
+		// Another job published the same key first and the blob is open. Its contents are the same as ours.
+		std::filesystem::remove(stagingPath, error);
+		if (!std::filesystem::exists(blobPath)) {
+			throw std::runtime_error("Failed to move " + stagingPath + " to " + blobPath + ".");
+		}
+	}
+}
+
+std::string AssetCooker::cookMesh(uint32_t index, Asset& asset) {
+	std::string path = (std::filesystem::path(options.sourceDirectory) / asset.source).string();
+	hashInputs(asset, meshFileVersion, { path });
+	std::string blobPath = getBlobPath(asset.entry.key, ".mesh");
+	asset.result = std::filesystem::exists(blobPath) ? CookResult::CacheHit : CookResult::Cooked;
+	if (asset.result == CookResult::Cooked) {
+		std::string stagingPath = getStagingPath(blobPath, index);
+		writeMeshFile(stagingPath, importObj(path));
+		publishBlob(stagingPath, blobPath);
+	}
+	return blobPath;
+}
+
+std::string AssetCooker::cookTexture(uint32_t index, Asset& asset) {
+	std::string path = (std::filesystem::path(options.sourceDirectory) / asset.source).string();
+	hashInputs(asset, mipChainFileVersion, { path });
+	std::string blobPath = getBlobPath(asset.entry.key, ".mips");
+	asset.result = std::filesystem::exists(blobPath) ? CookResult::CacheHit : CookResult::Cooked;
+	if (asset.result == CookResult::CacheHit) {
+		return blobPath;
+	}
+
+	MappedFile file;
+	file.open(path);
+	std::string stagingPath = getStagingPath(blobPath, index);
+	if (detectImageFormat(file.getData(), file.getSize()) == ImageFileFormat::Ktx2) {
+		// Blocks are kept as stored; choosing a format the device samples is the loader's job at runtime.
+		TextureLevels levels = loadKtx2(file.getData(), file.getSize(), allTextureFormats());
+		writeMipChainFile(stagingPath, levels.format, levels.width, levels.height, levels.levels);
+	}
+	else {
+		DecodedImage image = decodeImage(file.getData(), file.getSize());
+		writeMipChainFile(stagingPath, VK_FORMAT_R8G8B8A8_UNORM, image.width, image.height, buildMipChain(image));
+	}
+	publishBlob(stagingPath, blobPath);
+	return blobPath;
+}
+
+std::string AssetCooker::cookShader(uint32_t index, Asset& asset) {
+	// Includes aren't known until the shader is compiled, so compiling comes first; on an unchanged shader that is a
+	// hit in the compiler's own cache.
+	std::string extension = lowerExtension(asset.source);
+	ShaderRequest request;
+	request.path = asset.source;
+	request.stage = extension == ".vert" ? ShaderStage::Vertex : extension == ".frag" ? ShaderStage::Fragment : ShaderStage::Compute;
+	CompiledShader shader = shaderCompiler->compile(request);
+
+	hashInputs(asset, shaderBlobVersion, shader.dependencies);
+	std::string blobPath = getBlobPath(asset.entry.key, ".spv");
+	asset.result = std::filesystem::exists(blobPath) ? CookResult::CacheHit : CookResult::Cooked;
+	if (asset.result == CookResult::Cooked) {
+		std::string stagingPath = getStagingPath(blobPath, index);
+		{
+			std::ofstream file(stagingPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(shader.spirv.data()), static_cast<std::streamsize>(shader.spirv.size() * sizeof(uint32_t)));
+			if (!file.good()) {
+				throw std::runtime_error("Failed to write " + stagingPath + ".");
+			}
+		}
+		publishBlob(stagingPath, blobPath);
+	}
+	return blobPath;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "jobSystem.h"
+#include "shaderCompiler.h"
+
+// Bump whenever a cook step changes what it writes, so every blob an older cooker made is rebuilt.
+const uint32_t assetCookerVersion = 1;
+
+enum class AssetKind : uint32_t {
+	Mesh = 0, // .obj to .mesh (meshFile.h). glTF scenes are loaded as they are; only their images are cooked.
+	Texture, // .png, .ktx2 to .mips (mipChainFile.h)
+	Shader // .vert, .frag, .comp to .spv
+};
+
+struct CookOptions {
+	std::string sourceDirectory;
+	std::string outputDirectory;
+	std::string cacheDirectory = "cache/cooked";
+	uint32_t workerThreads = 0; // Zero: one per hardware thread.
+	bool verbose = false;
+	uint32_t cookerVersion = assetCookerVersion; // Tests raise it to check that a new cooker rebuilds everything.
+};
+
+// How the assets of one run were handled.
+struct CookCounts {
+	uint32_t upToDate = 0; // Manifest stamps matched; nothing was read.
+	uint32_t fromCache = 0; // Inputs changed or were unknown, but their key was already cooked.
+	uint32_t cooked = 0;
+	uint32_t failed = 0;
+	uint32_t removed = 0; // Outputs of sources that have disappeared.
+};
+
+/*
+	Asset Cooker
+	- Turns every mesh, texture and shader under the source directory into the blob the renderer loads, at the same
+	  relative path in the output directory.
+	- Blobs live in a content-addressed cache, named after a hash of the cooker version, the blob format's version and
+	  the bytes of every input, a shader's includes among them. Identical inputs anywhere, in any
+	  tree sharing the cache, are cooked once.
+	- The output directory's manifest records each asset's key and the size and modification time of its inputs.
+	  Assets whose inputs all still match are skipped without being read; the rest are hashed, and only those whose key
+	  isn't cached yet are cooked. Outputs of sources that have disappeared are removed.
+	- One job per asset on the job system, largest first. A failed asset is reported and left out of the manifest, so
+	  it is retried next run; the others still complete.
+*/
+class AssetCooker {
+
+	public:
+		explicit AssetCooker(CookOptions options);
+
+		bool run(); // False if any asset failed. Once per cooker.
+		const CookCounts& getCounts() const { return counts; } // Of run().
+
+	private:
+		struct InputStamp {
+			std::string path;
+			uint64_t size = 0;
+			int64_t modified = 0;
+		};
+
+		struct ManifestEntry {
+			AssetKind kind = AssetKind::Mesh;
+			uint64_t key = 0;
+			std::vector<InputStamp> inputs;
+		};
+
+		enum class CookResult {
+			UpToDate,
+			CacheHit,
+			Cooked,
+			Failed
+		};
+
+		struct Asset {
+			AssetKind kind;
+			std::string source; // Relative to the source directory, '/' separated. Also the manifest key.
+			std::string output; // Relative to the output directory.
+			uint64_t size; // Of the source alone, for scheduling.
+
+			// Written by the asset's job.
+			ManifestEntry entry;
+			CookResult result = CookResult::Failed;
+			std::string error;
+			double milliseconds = 0.0;
+		};
+
+		CookOptions options;
+		std::unique_ptr<JobSystem> jobSystem;
+		std::unique_ptr<ShaderCompiler> shaderCompiler;
+		std::vector<Asset> assets;
+		std::unordered_map<std::string, ManifestEntry> manifest; // From the previous run.
+		CookCounts counts;
+
+		void scanSources();
+		void loadManifest();
+		void saveManifest() const;
+		uint32_t removeStaleOutputs() const;
+
+		void cookAsset(uint32_t index);
+		bool isUpToDate(const Asset& asset, const ManifestEntry& previous) const;
+		// Hashes every input into the entry's key and records their stamps.
+		void hashInputs(Asset& asset, uint32_t formatVersion, const std::vector<std::string>& inputs) const;
+		std::string getBlobPath(uint64_t key, const std::string& extension) const;
+		// Writers produce a blob here, named after the asset, and publishBlob renames it into place. Two assets with the
+		// same key may be cooked at once; they never share a temporary file and either result is correct.
+		std::string getStagingPath(const std::string& path, uint32_t index) const;
+		void publishBlob(const std::string& stagingPath, const std::string& blobPath) const;
+
+		// Each hashes the asset's inputs, cooks on a cache miss and returns the blob's path.
+		std::string cookMesh(uint32_t index, Asset& asset);
+		std::string cookTexture(uint32_t index, Asset& asset);
+		std::string cookShader(uint32_t index, Asset& asset);
+};
@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "assetCooker.h"
+#include "cpuProfiler.h"
+
+struct CookerArguments {
+	CookOptions cook;
+	std::string tracePath; // Write a Chrome trace of CPU scopes here at exit. Profiling is off when empty.
+};
+
+CookerArguments parseArguments(int argc, char** argv) {
+	const char* usage = "\nUsage: AssetCooker SOURCE_DIR OUTPUT_DIR [--cache DIR] [--worker-threads N] [--trace FILE] [--verbose]";
+	CookerArguments arguments;
+	std::vector<std::string> positional;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (argument == "--cache" && hasValue) {
+			arguments.cook.cacheDirectory = argv[++i];
+		}
+		else if (argument == "--worker-threads" && hasValue) {
+			arguments.cook.workerThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--trace" && hasValue) {
+			arguments.tracePath = argv[++i];
+		}
+		else if (argument == "--verbose") {
+			arguments.cook.verbose = true;
+		}
+		else if (argument.compare(0, 2, "--") != 0) {
+			positional.push_back(argument);
+		}
+		else {
+			throw std::runtime_error("Unknown or incomplete argument: " + argument + usage);
+		}
+	}
+
+	if (positional.size() != 2) {
+		throw std::runtime_error(std::string("Expected a source and an output directory.") + usage);
+	}
+	arguments.cook.sourceDirectory = positional[0];
+	arguments.cook.outputDirectory = positional[1];
+	return arguments;
+}
+
+int main(int argc, char** argv) {
+	try {
+		CookerArguments arguments = parseArguments(argc, argv);
+		if (!arguments.tracePath.empty()) {
+			CpuProfiler::enable();
+		}
+		CpuProfiler::setThreadName("Main");
+
+		AssetCooker cooker(arguments.cook);
+		bool succeeded = cooker.run();
+
+		if (!arguments.tracePath.empty()) {
+			CpuProfiler::disable();
+			if (CpuProfiler::writeChromeTrace(arguments.tracePath)) {
+				std::cout << "CPU trace written to " << arguments.tracePath << "\n";
+			}
+			else {
+				std::cerr << "Failed to write CPU trace to " << arguments.tracePath << std::endl;
+			}
+		}
+		return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
@@ -0,0 +1,205 @@
+#include "bindlessDescriptors.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	// Upper bounds before device limits. Enough for a scene's worth of materials and meshes without a huge pool.
+	const uint32_t maxBindlessTextures = 16384;
+	const uint32_t maxBindlessBuffers = 16384;
+}
+
+uint32_t DescriptorSlotAllocator::allocate() {
+	if (!freeSlots.empty()) {
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		allocated[slot] = true;
+		return slot;
+	}
+	if (next == capacity) {
+		throw std::runtime_error("Descriptor array is full (" + std::to_string(capacity) + " slots).");
+	}
+	allocated.push_back(true);
+	return next++;
+}
+
+void DescriptorSlotAllocator::free(uint32_t slot) {
+	if (slot >= next) {
+		throw std::runtime_error("Freeing descriptor slot " + std::to_string(slot) + " that was never allocated.");
+	}
+	if (!allocated[slot]) {
+		throw std::runtime_error("Freeing descriptor slot " + std::to_string(slot) + " twice.");
+	}
+	allocated[slot] = false;
+	freeSlots.push_back(slot);
+}
+
+bool BindlessDescriptors::isSupported(VkPhysicalDevice physicalDevice) {
+	VkPhysicalDeviceVulkan12Features supported{};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &supported;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return supported.descriptorIndexing
+		&& supported.runtimeDescriptorArray
+		&& supported.descriptorBindingPartiallyBound
+		&& supported.descriptorBindingUpdateUnusedWhilePending
+		&& supported.descriptorBindingSampledImageUpdateAfterBind
+		&& supported.descriptorBindingStorageBufferUpdateAfterBind
+		&& supported.shaderSampledImageArrayNonUniformIndexing
+		&& supported.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+void BindlessDescriptors::enableFeatures(VkPhysicalDeviceVulkan12Features& features) {
+	features.descriptorIndexing = VK_TRUE;
+	features.runtimeDescriptorArray = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+	features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+}
+
+void BindlessDescriptors::init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->callbacks = callbacks;
+
+	// Update-after-bind arrays have their own, usually much higher, limits than ordinary descriptors.
+	VkPhysicalDeviceVulkan12Properties limits{};
+	limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &limits;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	uint32_t perStageResources = limits.maxPerStageUpdateAfterBindResources;
+	uint32_t textureCount = std::min({ maxBindlessTextures, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+		limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		limits.maxPerStageDescriptorUpdateAfterBindSamplers, perStageResources / 2 });
+	uint32_t bufferCount = std::min({ maxBindlessBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers, perStageResources - textureCount });
+	textureSlots = DescriptorSlotAllocator(textureCount);
+	bufferSlots = DescriptorSlotAllocator(bufferCount);
+
+	VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings = {
+		{ textureBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount, stages, nullptr },
+		{ bufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCount, stages, nullptr }
+	};
+
+	VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::vector<VkDescriptorBindingFlags> flags(bindings.size(), bindingFlags);
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flagsInfo.bindingCount = static_cast<uint32_t>(flags.size());
+	flagsInfo.pBindingFlags = flags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, callbacks, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create bindless descriptor set layout.");
+	}
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCount }
+	};
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	if (vkCreateDescriptorPool(device, &poolInfo, callbacks, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create bindless descriptor pool.");
+	}
+
+	VkDescriptorSetAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = pool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &setLayout;
+	if (vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate the bindless descriptor set.");
+	}
+
+	std::cout << "Bindless Descriptors: " << textureCount << " textures, " << bufferCount << " storage buffers\n";
+}
+
+void BindlessDescriptors::destroy() {
+	// The set goes with its pool.
+	vkDestroyDescriptorPool(device, pool, callbacks);
+	vkDestroyDescriptorSetLayout(device, setLayout, callbacks);
+	pool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	descriptorSet = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessDescriptors::addTexture(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t index = textureSlots.allocate();
+
+	VkDescriptorImageInfo imageInfo{ sampler, view, layout };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = descriptorSet;
+	write.dstBinding = textureBinding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return index;
+}
+
+uint32_t BindlessDescriptors::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t index = bufferSlots.allocate();
+
+	VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = descriptorSet;
+	write.dstBinding = bufferBinding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return index;
+}
+
+void BindlessDescriptors::releaseTexture(uint32_t index) {
+	// The stale descriptor stays in the array; partially bound arrays allow that as long as no shader reads it.
+	std::lock_guard<std::mutex> lock(mutex);
+	textureSlots.free(index);
+}
+
+void BindlessDescriptors::releaseBuffer(uint32_t index) {
+	std::lock_guard<std::mutex> lock(mutex);
+	bufferSlots.free(index);
+}
+
+void BindlessDescriptors::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout) const {
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+}
+
+void BindlessDescriptors::printStats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cout << "Bindless Descriptors: " << textureSlots.getUsedCount() << "/" << textureSlots.getCapacity() << " textures, "
+		<< bufferSlots.getUsedCount() << "/" << bufferSlots.getCapacity() << " storage buffers in use\n";
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Hands out indices into a fixed-size descriptor array. Freed indices are reused most recent first; freeing one twice
+// throws, since the second free would otherwise hand the same slot to two resources.
+class DescriptorSlotAllocator {
+
+	public:
+		explicit DescriptorSlotAllocator(uint32_t capacity = 0) : capacity(capacity) {}
+
+		uint32_t allocate(); // Throws when the array is full.
+		void free(uint32_t slot);
+		uint32_t getCapacity() const { return capacity; }
+		uint32_t getUsedCount() const { return next - static_cast<uint32_t>(freeSlots.size()); }
+
+	private:
+		uint32_t capacity;
+		uint32_t next = 0; // Slots at or past this have never been handed out.
+		std::vector<uint32_t> freeSlots;
+		std::vector<bool> allocated; // One per slot below next.
+};
+
+/*
+	Bindless Descriptors
+	- One descriptor set, bound once per command buffer, holding every texture and storage buffer in large arrays.
+	  Draws pick their resources by index (normally through a push constant) instead of binding sets.
+	- Arrays are update-after-bind and partially bound: slots can be written while the set is bound in command buffers
+	  that are still pending, as long as those command buffers don't read the slots being written.
+	- A released slot can be handed out again straight away, so release only once the GPU is done with it
+	  (FrameScheduler::deferUntilComplete).
+	- Shaders see the set through shaders/bindless.glsl. LayoutCache puts this layout at set 0 of every pipeline.
+*/
+class BindlessDescriptors {
+
+	public:
+		static const uint32_t set = 0;
+		static const uint32_t textureBinding = 0; // COMBINED_IMAGE_SAMPLER array.
+		static const uint32_t bufferBinding = 1; // STORAGE_BUFFER array.
+
+		// Descriptor indexing is optional in the API, so device creation checks for it before enabling it.
+		static bool isSupported(VkPhysicalDevice physicalDevice);
+		static void enableFeatures(VkPhysicalDeviceVulkan12Features& features);
+
+		void init(VkDevice device, VkPhysicalDevice physicalDevice, const VkAllocationCallbacks* callbacks);
+		void destroy();
+
+		uint32_t addTexture(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+		void releaseTexture(uint32_t index);
+		void releaseBuffer(uint32_t index);
+
+		void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout) const;
+
+		uint32_t getTextureCapacity() const { return textureSlots.getCapacity(); }
+		VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+		const std::vector<VkDescriptorSetLayoutBinding>& getBindings() const { return bindings; }
+		void printStats() const;
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		// Descriptor writes to one set must be externally synchronized, even with update-after-bind.
+		mutable std::mutex mutex;
+		DescriptorSlotAllocator textureSlots;
+		DescriptorSlotAllocator bufferSlots;
+};
@@ -0,0 +1,92 @@
+#include "buddyAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+BuddyAllocator::BuddyAllocator(uint64_t totalSize, uint64_t minBlockSize)
+	: totalSize(totalSize), minBlockSize(minBlockSize) {
+
+	if (totalSize == 0 || minBlockSize == 0 || nextPowerOfTwo(totalSize) != totalSize || nextPowerOfTwo(minBlockSize) != minBlockSize || minBlockSize > totalSize) {
+		throw std::runtime_error("Buddy allocator sizes must be powers of two with minBlockSize <= totalSize.");
+	}
+
+	levelCount = 1;
+	while ((totalSize >> (levelCount - 1)) > minBlockSize) {
+		levelCount++;
+	}
+	freeBlocks.resize(levelCount);
+	freeBlocks[0].insert(0);
+}
+
+uint32_t BuddyAllocator::levelFor(uint64_t blockSize) const {
+	uint32_t level = 0;
+	while (levelSize(level) > blockSize) {
+		level++;
+	}
+	return level;
+}
+
+uint64_t BuddyAllocator::blockSizeFor(uint64_t size, uint64_t alignment) const {
+	// Blocks are aligned to their own size, so rounding up to the alignment satisfies it for free.
+	return nextPowerOfTwo(std::max({ size, alignment, minBlockSize }));
+}
+
+std::optional<uint64_t> BuddyAllocator::allocate(uint64_t size, uint64_t alignment) {
+	uint64_t blockSize = blockSizeFor(size, alignment);
+	if (blockSize > totalSize) {
+		return std::nullopt;
+	}
+
+	uint32_t targetLevel = levelFor(blockSize);
+
+	// Find the smallest free block that fits, then split it down to the target size.
+	int32_t level = static_cast<int32_t>(targetLevel);
+	while (level >= 0 && freeBlocks[level].empty()) {
+		level--;
+	}
+	if (level < 0) {
+		return std::nullopt;
+	}
+
+	uint64_t offset = *freeBlocks[level].begin();
+	freeBlocks[level].erase(freeBlocks[level].begin());
+
+	while (static_cast<uint32_t>(level) < targetLevel) {
+		level++;
+		// Keep the lower half, hand the upper half back as a free buddy.
+		freeBlocks[level].insert(offset + levelSize(level));
+	}
+
+	allocatedLevels[offset] = targetLevel;
+	usedSize += blockSize;
+	return offset;
+}
+
+void BuddyAllocator::free(uint64_t offset) {
+	auto it = allocatedLevels.find(offset);
+	if (it == allocatedLevels.end()) {
+		throw std::runtime_error("Buddy allocator free of an offset that was never allocated.");
+	}
+
+	uint32_t level = it->second;
+	allocatedLevels.erase(it);
+	usedSize -= levelSize(level);
+
+	// Merge upwards for as long as the buddy is also free.
+	while (level > 0) {
+		uint64_t buddy = offset ^ levelSize(level);
+		auto buddyIt = freeBlocks[level].find(buddy);
+		if (buddyIt == freeBlocks[level].end()) {
+			break;
+		}
+		freeBlocks[level].erase(buddyIt);
+		offset = std::min(offset, buddy);
+		level--;
+	}
+	freeBlocks[level].insert(offset);
+}
+
+uint64_t BuddyAllocator::allocationSize(uint64_t offset) const {
+	auto it = allocatedLevels.find(offset);
+	return it == allocatedLevels.end() ? 0 : levelSize(it->second);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Buddy Allocator
+	- Pure offset bookkeeping with no Vulkan calls, so placement can be exercised without a GPU.
+	- The range is a power of two split into halves down to minBlockSize; every block is aligned to its own size.
+	- Freed blocks merge back with their buddy, which keeps external fragmentation bounded.
+*/
+class BuddyAllocator {
+
+	public:
+		BuddyAllocator(uint64_t totalSize, uint64_t minBlockSize);
+
+		std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment);
+		void free(uint64_t offset);
+
+		uint64_t blockSizeFor(uint64_t size, uint64_t alignment) const;
+		uint64_t allocationSize(uint64_t offset) const;
+		uint64_t getTotalSize() const { return totalSize; }
+		uint64_t getUsedSize() const { return usedSize; }
+		size_t getAllocationCount() const { return allocatedLevels.size(); }
+		bool isEmpty() const { return allocatedLevels.empty(); }
+
+	private:
+		uint64_t totalSize;
+		uint64_t minBlockSize;
+		uint32_t levelCount;
+		uint64_t usedSize = 0;
+		std::vector<std::set<uint64_t>> freeBlocks; // Level 0 is the whole range, the last level is minBlockSize.
+		std::unordered_map<uint64_t, uint32_t> allocatedLevels;
+
+		uint64_t levelSize(uint32_t level) const { return totalSize >> level; }
+		uint32_t levelFor(uint64_t blockSize) const;
+};
+
+inline uint64_t nextPowerOfTwo(uint64_t value) {
+	uint64_t result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
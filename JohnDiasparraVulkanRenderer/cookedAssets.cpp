@@ -0,0 +1,41 @@
+#include "cookedAssets.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+std::string getCookedAssetName(const std::string& source) {
+	std::filesystem::path path(source);
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+	if (extension == ".obj") {
+		path.replace_extension(".mesh");
+	}
+	else if (extension == ".png" || extension == ".ktx2") {
+		path.replace_extension(".mips");
+	}
+	else if (extension == ".vert" || extension == ".frag" || extension == ".comp") {
+		path += ".spv";
+	}
+	else {
+		return "";
+	}
+	return path.generic_string();
+}
+
+std::string findCookedAsset(const std::string& cookedDirectory, const std::string& sourcePath) {
+	// Lexical, so the source itself needn't exist: a cooked tree can ship without the files it was cooked from.
+	std::error_code error;
+	std::filesystem::path source(sourcePath);
+	std::filesystem::path relative = source.is_absolute() ? source.lexically_relative(std::filesystem::current_path(error)) : source.lexically_normal();
+	if (error || relative.empty() || *relative.begin() == "..") {
+		return "";
+	}
+	std::string name = getCookedAssetName(relative.generic_string());
+	if (name.empty()) {
+		return "";
+	}
+	std::filesystem::path path = std::filesystem::path(cookedDirectory) / name;
+	return std::filesystem::is_regular_file(path, error) ? path.string() : "";
+}
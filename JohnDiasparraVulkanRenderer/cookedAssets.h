@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+/*
+	Cooked Assets
+	- AssetCooker's output mirrors its source tree: OBJ meshes become .mesh files, textures .mips files, and shaders
+	  keep their stage extension with .spv appended, so mesh.vert and mesh.frag don't collide. glTF scenes aren't
+	  cooked, since a mesh file keeps neither their node transforms nor their materials; their images are.
+	- The renderer reads a tree cooked from its working directory, so the cooked copy of a file it would open by a
+	  relative path sits at that same path inside the cooked directory.
+*/
+std::string getCookedAssetName(const std::string& source); // Empty when the extension is not one the cooker cooks.
+// Empty when the file can't be cooked, lies outside the working directory, or has not been cooked yet.
+std::string findCookedAsset(const std::string& cookedDirectory, const std::string& sourcePath);
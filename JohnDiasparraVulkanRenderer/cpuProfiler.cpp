@@ -0,0 +1,162 @@
+#include "cpuProfiler.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+	struct TraceEvent {
+		const char* name;
+		int64_t startNs;
+		int64_t durationNs;
+	};
+
+	// Fixed-size chunks in a singly linked list: the writer only ever appends, so a reader walking the list never
+	// sees memory move underneath it.
+	struct EventChunk {
+		static const uint32_t capacity = 4096;
+		TraceEvent events[capacity];
+		std::atomic<uint32_t> count{ 0 };
+		std::atomic<EventChunk*> next{ nullptr };
+	};
+
+	struct ThreadBuffer {
+		uint32_t threadId;
+		std::string threadName;
+		std::unique_ptr<EventChunk> head = std::make_unique<EventChunk>();
+		EventChunk* tail = head.get();
+
+		~ThreadBuffer() {
+			EventChunk* chunk = head->next.load();
+			while (chunk) {
+				EventChunk* next = chunk->next.load();
+				delete chunk;
+				chunk = next;
+			}
+		}
+	};
+
+	// Buffers outlive their threads so a trace can still be written after worker threads have exited.
+	struct Registry {
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		CpuProfiler::Clock::time_point epoch = CpuProfiler::Clock::now();
+	};
+
+	Registry& registry() {
+		static Registry instance;
+		return instance;
+	}
+
+	thread_local ThreadBuffer* threadBuffer = nullptr;
+
+	ThreadBuffer& currentThreadBuffer() {
+		if (!threadBuffer) {
+			// Once per thread; every later event goes straight to the thread's own buffer.
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			auto buffer = std::make_unique<ThreadBuffer>();
+			buffer->threadId = static_cast<uint32_t>(reg.buffers.size());
+			threadBuffer = buffer.get();
+			reg.buffers.push_back(std::move(buffer));
+		}
+		return *threadBuffer;
+	}
+
+	void writeJsonString(std::ofstream& file, const std::string& text) {
+		file << '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				file << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				file << escaped;
+			}
+			else {
+				file << c;
+			}
+		}
+		file << '"';
+	}
+}
+
+void CpuProfiler::enable() {
+	registry();
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::disable() {
+	enabled.store(false, std::memory_order_relaxed);
+}
+
+void CpuProfiler::setThreadName(const std::string& name) {
+	ThreadBuffer& buffer = currentThreadBuffer();
+	std::lock_guard<std::mutex> lock(registry().mutex);
+	buffer.threadName = name;
+}
+
+void CpuProfiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+	ThreadBuffer& buffer = currentThreadBuffer();
+	EventChunk* chunk = buffer.tail;
+
+	uint32_t index = chunk->count.load(std::memory_order_relaxed);
+	if (index == EventChunk::capacity) {
+		EventChunk* next = new EventChunk();
+		chunk->next.store(next, std::memory_order_release);
+		buffer.tail = chunk = next;
+		index = 0;
+	}
+
+	Clock::time_point epoch = registry().epoch;
+	chunk->events[index] = {
+		name,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(),
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()
+	};
+	chunk->count.store(index + 1, std::memory_order_release);
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& path) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	char timing[96];
+
+	for (const auto& buffer : reg.buffers) {
+		if (!buffer->threadName.empty()) {
+			file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+			writeJsonString(file, buffer->threadName);
+			file << "}}";
+			first = false;
+		}
+
+		for (EventChunk* chunk = buffer->head.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+			uint32_t count = chunk->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; ++i) {
+				const TraceEvent& event = chunk->events[i];
+				// Trace timestamps are microseconds; keep the nanoseconds as decimals.
+				snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f", event.startNs / 1000.0, event.durationNs / 1000.0);
+
+				file << (first ? "" : ",\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId << "," << timing << ",\"name\":";
+				writeJsonString(file, event.name);
+				file << "}";
+				first = false;
+			}
+		}
+	}
+
+	file << "\n]}\n";
+	return file.good();
+}
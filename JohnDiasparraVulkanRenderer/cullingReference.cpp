@@ -0,0 +1,233 @@
+#include "cullingReference.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	glm::vec4 matrixRow(const glm::mat4& matrix, int row) {
+		return glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+	}
+
+	uint32_t levelWidth(uint32_t width, uint32_t level) {
+		return std::max(1u, width >> level);
+	}
+
+	float hiZDepth(const CullView& view, const float* hiZ, uint32_t level, uint32_t x, uint32_t y) {
+		size_t offset = hiZLevelOffset(view.hiZWidth, view.hiZHeight, level);
+		return hiZ[offset + static_cast<size_t>(y) * levelWidth(view.hiZWidth, level) + x];
+	}
+
+	bool isInsideFrustum(const CullView& view, const glm::vec4& sphere) {
+		for (const glm::vec4& plane : view.frustumPlanes) {
+			if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Texels are found through the level 0 pixel, since an odd level's last texel also covers the leftover row or
+	// column (see hiZ.comp).
+	uint32_t basePixel(float uv, uint32_t size) {
+		return std::min(static_cast<uint32_t>(uv * static_cast<float>(size)), size - 1);
+	}
+
+	// Same steps, in the same order, as isUnoccluded in cull.comp.
+	bool isUnoccluded(const CullView& view, const glm::vec4& sphere, const float* hiZ) {
+		if (view.hiZLevels == 0 || hiZ == nullptr) {
+			return true;
+		}
+
+		glm::vec3 minNdc(3.0e38f);
+		glm::vec3 maxNdc(-3.0e38f);
+		for (int corner = 0; corner < 8; ++corner) {
+			glm::vec3 direction((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+			glm::vec4 clip = view.viewProjection * glm::vec4(glm::vec3(sphere) + direction * sphere.w, 1.0f);
+			if (clip.w <= 0.0f) {
+				return true;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			minNdc = glm::min(minNdc, ndc);
+			maxNdc = glm::max(maxNdc, ndc);
+		}
+
+		glm::vec2 uvMin = glm::clamp(glm::vec2(minNdc) * 0.5f + 0.5f, 0.0f, 1.0f);
+		glm::vec2 uvMax = glm::clamp(glm::vec2(maxNdc) * 0.5f + 0.5f, 0.0f, 1.0f);
+		glm::vec2 extent = (uvMax - uvMin) * glm::vec2(static_cast<float>(view.hiZWidth), static_cast<float>(view.hiZHeight));
+
+		uint32_t level = std::min(static_cast<uint32_t>(std::ceil(std::log2(std::max(std::max(extent.x, extent.y), 1.0f)))), view.hiZLevels - 1);
+		uint32_t width = levelWidth(view.hiZWidth, level);
+		uint32_t height = levelWidth(view.hiZHeight, level);
+		uint32_t minX = std::min(basePixel(uvMin.x, view.hiZWidth) >> level, width - 1);
+		uint32_t minY = std::min(basePixel(uvMin.y, view.hiZHeight) >> level, height - 1);
+		uint32_t maxX = std::min(basePixel(uvMax.x, view.hiZWidth) >> level, width - 1);
+		uint32_t maxY = std::min(basePixel(uvMax.y, view.hiZHeight) >> level, height - 1);
+
+		float farthest = std::max(std::max(hiZDepth(view, hiZ, level, minX, minY), hiZDepth(view, hiZ, level, maxX, minY)),
+			std::max(hiZDepth(view, hiZ, level, minX, maxY), hiZDepth(view, hiZ, level, maxX, maxY)));
+		return minNdc.z <= farthest;
+	}
+}
+
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+	glm::vec4 x = matrixRow(viewProjection, 0);
+	glm::vec4 y = matrixRow(viewProjection, 1);
+	glm::vec4 z = matrixRow(viewProjection, 2);
+	glm::vec4 w = matrixRow(viewProjection, 3);
+
+	planes[0] = w + x; // Left.
+	planes[1] = w - x; // Right.
+	planes[2] = w + y; // Top (Vulkan's y points down).
+	planes[3] = w - y; // Bottom.
+	planes[4] = z; // Near: Vulkan clip space starts at z = 0, not -w.
+	planes[5] = w - z; // Far.
+	for (int i = 0; i < 6; ++i) {
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+CullView makeCullView(const glm::mat4& viewProjection, uint32_t instanceCount, uint32_t bucketCount) {
+	CullView view{};
+	view.viewProjection = viewProjection;
+	extractFrustumPlanes(viewProjection, view.frustumPlanes);
+	view.instanceCount = instanceCount;
+	view.bucketCount = bucketCount;
+	return view;
+}
+
+std::vector<CullBucket> makeCullBuckets(const std::vector<CullInstance>& instances, uint32_t bucketCount) {
+	std::vector<CullBucket> buckets(bucketCount, CullBucket{ 0, 0 });
+	for (const CullInstance& instance : instances) {
+		if (instance.bucket >= bucketCount) {
+			throw std::runtime_error("Cull instance is in bucket " + std::to_string(instance.bucket) + " of " + std::to_string(bucketCount) + ".");
+		}
+		buckets[instance.bucket].capacity++;
+	}
+
+	uint32_t firstCommand = 0;
+	for (CullBucket& bucket : buckets) {
+		bucket.firstCommand = firstCommand;
+		firstCommand += bucket.capacity;
+	}
+	return buckets;
+}
+
+uint32_t getCullCommandCount(const std::vector<CullBucket>& buckets) {
+	return buckets.empty() ? 0 : buckets.back().firstCommand + buckets.back().capacity;
+}
+
+uint32_t hiZLevelCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	while ((std::max(width, height) >> levels) > 0) {
+		levels++;
+	}
+	return levels;
+}
+
+size_t hiZLevelOffset(uint32_t width, uint32_t height, uint32_t level) {
+	size_t offset = 0;
+	for (uint32_t i = 0; i < level; ++i) {
+		offset += static_cast<size_t>(levelWidth(width, i)) * levelWidth(height, i);
+	}
+	return offset;
+}
+
+std::vector<float> buildHiZPyramid(const std::vector<float>& depth, uint32_t width, uint32_t height) {
+	uint32_t levels = hiZLevelCount(width, height);
+	std::vector<float> pyramid(hiZLevelOffset(width, height, levels));
+	std::copy(depth.begin(), depth.begin() + static_cast<size_t>(width) * height, pyramid.begin());
+
+	for (uint32_t level = 1; level < levels; ++level) {
+		const float* source = pyramid.data() + hiZLevelOffset(width, height, level - 1);
+		float* destination = pyramid.data() + hiZLevelOffset(width, height, level);
+		uint32_t sourceWidth = levelWidth(width, level - 1);
+		uint32_t sourceHeight = levelWidth(height, level - 1);
+		uint32_t destinationWidth = levelWidth(width, level);
+		uint32_t destinationHeight = levelWidth(height, level);
+
+		for (uint32_t y = 0; y < destinationHeight; ++y) {
+			// An odd source size leaves one row or column over; the last texel takes it so nothing goes unreduced.
+			uint32_t endY = (y + 1 == destinationHeight) ? sourceHeight : std::min(2 * y + 2, sourceHeight);
+			for (uint32_t x = 0; x < destinationWidth; ++x) {
+				uint32_t endX = (x + 1 == destinationWidth) ? sourceWidth : std::min(2 * x + 2, sourceWidth);
+				float farthest = 0.0f;
+				for (uint32_t sy = 2 * y; sy < endY; ++sy) {
+					for (uint32_t sx = 2 * x; sx < endX; ++sx) {
+						farthest = std::max(farthest, source[static_cast<size_t>(sy) * sourceWidth + sx]);
+					}
+				}
+				destination[static_cast<size_t>(y) * destinationWidth + x] = farthest;
+			}
+		}
+	}
+	return pyramid;
+}
+
+bool isInstanceVisible(const CullView& view, const glm::vec4& boundingSphere, const float* hiZ) {
+	return isInsideFrustum(view, boundingSphere) && isUnoccluded(view, boundingSphere, hiZ);
+}
+
+CullResult cullInstancesReference(const CullView& view, const std::vector<CullInstance>& instances, const std::vector<CullMesh>& meshes,
+	const std::vector<CullBucket>& buckets, const float* hiZ) {
+	CPU_PROFILE_SCOPE("cullInstancesReference");
+	CullResult result;
+	result.counts.assign(view.bucketCount, 0);
+	result.commands.assign(getCullCommandCount(buckets), VkDrawIndexedIndirectCommand{});
+
+	for (uint32_t index = 0; index < view.instanceCount; ++index) {
+		const CullInstance& instance = instances[index];
+		if (!isInstanceVisible(view, instance.boundingSphere, hiZ)) {
+			continue;
+		}
+		const CullBucket& bucket = buckets[instance.bucket];
+		uint32_t slot = result.counts[instance.bucket]++;
+		if (slot >= bucket.capacity) {
+			continue;
+		}
+		const CullMesh& mesh = meshes[instance.mesh];
+		result.commands[bucket.firstCommand + slot] = { mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, index };
+	}
+	return result;
+}
+
+std::string compareCullResults(const CullResult& expected, const CullResult& actual, const std::vector<CullBucket>& buckets) {
+	if (expected.counts.size() != actual.counts.size()) {
+		return "bucket counts differ in size";
+	}
+
+	auto byInstance = [](const VkDrawIndexedIndirectCommand& a, const VkDrawIndexedIndirectCommand& b) { return a.firstInstance < b.firstInstance; };
+	for (size_t bucket = 0; bucket < expected.counts.size(); ++bucket) {
+		if (expected.counts[bucket] != actual.counts[bucket]) {
+			return "bucket " + std::to_string(bucket) + " has " + std::to_string(actual.counts[bucket]) + " draws, expected " + std::to_string(expected.counts[bucket]);
+		}
+		// Which instances win the slots of an overflowing bucket depends on scheduling, so only the count is comparable.
+		if (expected.counts[bucket] > buckets[bucket].capacity) {
+			continue;
+		}
+
+		auto first = static_cast<std::ptrdiff_t>(buckets[bucket].firstCommand);
+		auto last = first + expected.counts[bucket];
+		std::vector<VkDrawIndexedIndirectCommand> expectedDraws(expected.commands.begin() + first, expected.commands.begin() + last);
+		std::vector<VkDrawIndexedIndirectCommand> actualDraws(actual.commands.begin() + first, actual.commands.begin() + last);
+		std::sort(expectedDraws.begin(), expectedDraws.end(), byInstance);
+		std::sort(actualDraws.begin(), actualDraws.end(), byInstance);
+
+		for (size_t i = 0; i < expectedDraws.size(); ++i) {
+			const VkDrawIndexedIndirectCommand& a = expectedDraws[i];
+			const VkDrawIndexedIndirectCommand& b = actualDraws[i];
+			if (std::tie(a.indexCount, a.instanceCount, a.firstIndex, a.vertexOffset, a.firstInstance)
+				!= std::tie(b.indexCount, b.instanceCount, b.firstIndex, b.vertexOffset, b.firstInstance)) {
+				return "bucket " + std::to_string(bucket) + " draws instance " + std::to_string(b.firstInstance) + " where instance "
+					+ std::to_string(a.firstInstance) + " was expected";
+			}
+		}
+	}
+	return "";
+}
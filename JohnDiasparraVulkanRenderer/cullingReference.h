@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// std430 mirrors of the structs in shaders/culling.glsl.
+struct CullInstance {
+	glm::mat4 transform;
+	glm::vec4 boundingSphere; // World space centre and radius.
+	uint32_t mesh;
+	uint32_t bucket; // Material bucket: one indirect draw call per bucket.
+	uint32_t padding[2];
+};
+
+struct CullMesh {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t texture; // Bindless index of the base colour texture. The cull kernel ignores it.
+};
+
+// Where a bucket's commands start in the command buffer, and how many it has room for.
+struct CullBucket {
+	uint32_t firstCommand;
+	uint32_t capacity;
+};
+
+struct CullView {
+	glm::mat4 viewProjection;
+	glm::vec4 frustumPlanes[6]; // Normals point inwards; xyz normalized.
+	uint32_t instanceCount;
+	uint32_t bucketCount;
+	uint32_t hiZLevels; // Zero disables occlusion culling.
+	uint32_t hiZWidth;
+	uint32_t hiZHeight;
+	uint32_t padding[3];
+};
+
+static_assert(sizeof(CullInstance) == 96, "CullInstance must match Instance in culling.glsl.");
+static_assert(sizeof(CullMesh) == 16, "CullMesh must match Mesh in culling.glsl.");
+static_assert(sizeof(CullBucket) == 8, "CullBucket must match Bucket in culling.glsl.");
+static_assert(sizeof(CullView) == 192, "CullView must match CullView in culling.glsl.");
+
+// What the cull kernel leaves behind: a count per bucket, then each bucket's commands in its own range.
+struct CullResult {
+	std::vector<uint32_t> counts; // Every visible instance, even past capacity.
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+};
+
+// Gribb/Hartmann planes for Vulkan clip space (0 <= z <= w).
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+CullView makeCullView(const glm::mat4& viewProjection, uint32_t instanceCount, uint32_t bucketCount);
+
+// One range per bucket, as large as the number of instances in it, so no bucket can overflow and the command buffer
+// holds one command per instance however many buckets there are.
+std::vector<CullBucket> makeCullBuckets(const std::vector<CullInstance>& instances, uint32_t bucketCount);
+uint32_t getCullCommandCount(const std::vector<CullBucket>& buckets);
+
+// Hi-Z pyramid: every mip level of a max-depth reduction packed into one float array, level 0 first.
+uint32_t hiZLevelCount(uint32_t width, uint32_t height);
+size_t hiZLevelOffset(uint32_t width, uint32_t height, uint32_t level);
+std::vector<float> buildHiZPyramid(const std::vector<float>& depth, uint32_t width, uint32_t height);
+
+// CPU version of cull.comp, for checking the GPU path and for running the culling where there is no GPU. Commands
+// within a bucket come out in instance order; the GPU's order depends on thread scheduling.
+bool isInstanceVisible(const CullView& view, const glm::vec4& boundingSphere, const float* hiZ);
+CullResult cullInstancesReference(const CullView& view, const std::vector<CullInstance>& instances, const std::vector<CullMesh>& meshes,
+	const std::vector<CullBucket>& buckets, const float* hiZ);
+// Empty when the two agree, ignoring command order within a bucket. Otherwise describes the first difference.
+std::string compareCullResults(const CullResult& expected, const CullResult& actual, const std::vector<CullBucket>& buckets);
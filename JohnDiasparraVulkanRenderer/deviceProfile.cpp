@@ -0,0 +1,234 @@
+#include "deviceProfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "hash.h"
+
+namespace {
+
+	const uint32_t profileFileMagic = 0x5044544D; // "MTDP"
+	const uint32_t profileFileVersion = 1;
+
+	struct ProfileFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vkHeaderVersion; // Struct layouts can change between header versions, so a mismatch invalidates the file.
+		uint32_t queueFamilyCount;
+		uint32_t extensionCount;
+	};
+
+	template <typename T>
+	bool readPod(std::ifstream& file, T* data, size_t count = 1) {
+		file.read(reinterpret_cast<char*>(data), sizeof(T) * count);
+		return file.good();
+	}
+
+	template <typename T>
+	void writePod(std::ofstream& file, const T* data, size_t count = 1) {
+		file.write(reinterpret_cast<const char*>(data), sizeof(T) * count);
+	}
+
+	VkPhysicalDeviceIDProperties queryDeviceIDs(VkPhysicalDevice device, VkPhysicalDeviceProperties& properties) {
+		VkPhysicalDeviceIDProperties idProperties{};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &idProperties;
+		vkGetPhysicalDeviceProperties2(device, &properties2);
+
+		properties = properties2.properties;
+		return idProperties;
+	}
+}
+
+bool DeviceCapabilityProfile::supportsExtension(const char* extensionName) const {
+	for (const auto& extension : extensions) {
+		if (strcmp(extension.extensionName, extensionName) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+VkDeviceSize DeviceCapabilityProfile::deviceLocalHeapSize() const {
+	VkDeviceSize size = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+		if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			size += memoryProperties.memoryHeaps[i].size;
+		}
+	}
+	return size;
+}
+
+DeviceCapabilityProfile queryDeviceProfile(VkPhysicalDevice device) {
+	DeviceCapabilityProfile profile;
+
+	VkPhysicalDeviceIDProperties idProperties = queryDeviceIDs(device, profile.properties);
+	memcpy(profile.deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+	memcpy(profile.driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
+
+	vkGetPhysicalDeviceFeatures(device, &profile.features);
+	vkGetPhysicalDeviceMemoryProperties(device, &profile.memoryProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	profile.queueFamilies.resize(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, profile.queueFamilies.data());
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	profile.extensions.resize(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, profile.extensions.data());
+
+	return profile;
+}
+
+uint64_t scoreDeviceProfile(const DeviceCapabilityProfile& profile) {
+	const VkPhysicalDeviceProperties& properties = profile.properties;
+	const VkPhysicalDeviceLimits& limits = properties.limits;
+
+	// Hard requirements: the instance targets 1.3 and everything is rendered through a graphics queue.
+	if (properties.apiVersion < VK_API_VERSION_1_3) {
+		return 0;
+	}
+
+	bool hasGraphicsQueue = false;
+	bool hasDedicatedTransferQueue = false;
+	bool hasDedicatedComputeQueue = false;
+	uint32_t queueCount = 0;
+	for (const auto& queueFamily : profile.queueFamilies) {
+		VkQueueFlags flags = queueFamily.queueFlags;
+		hasGraphicsQueue |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		hasDedicatedTransferQueue |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+		hasDedicatedComputeQueue |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+		queueCount += queueFamily.queueCount;
+	}
+	if (!hasGraphicsQueue) {
+		return 0;
+	}
+
+	uint64_t score = 1;
+
+	// Device type dominates: any discrete GPU beats any integrated one, which beats software rasterizers.
+	switch (properties.deviceType) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 4000000; break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 2000000; break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 1000000; break;
+		default: break;
+	}
+
+	// Between devices of the same type, one point per MiB of device local memory.
+	score += profile.deviceLocalHeapSize() / (1024 * 1024);
+
+	// Limits that track how much work the device accepts per draw or dispatch.
+	score += limits.maxImageDimension2D / 64;
+	score += limits.maxComputeSharedMemorySize / 256;
+	score += limits.maxComputeWorkGroupInvocations / 8;
+	score += std::min<uint32_t>(limits.maxPerStageDescriptorSampledImages, 65536) / 256;
+
+	// Queue topology: separate transfer and compute families let uploads and compute overlap graphics.
+	if (hasDedicatedTransferQueue) score += 2000;
+	if (hasDedicatedComputeQueue) score += 2000;
+	score += 100 * std::min<uint32_t>(queueCount, 32);
+
+	// Optional features and extensions the renderer takes advantage of.
+	if (profile.supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) score += 500;
+	if (profile.features.samplerAnisotropy) score += 250;
+	if (profile.features.geometryShader) score += 250;
+
+	return score;
+}
+
+DeviceProfileCache::DeviceProfileCache(std::string directory) : directory(std::move(directory)) {}
+
+DeviceCapabilityProfile DeviceProfileCache::getProfile(VkPhysicalDevice device) {
+	VkPhysicalDeviceProperties liveProperties;
+	VkPhysicalDeviceIDProperties idProperties = queryDeviceIDs(device, liveProperties);
+	std::string path = profilePath(idProperties.driverUUID, idProperties.deviceUUID);
+
+	DeviceCapabilityProfile profile;
+	if (loadProfile(path, profile)
+		&& profile.properties.vendorID == liveProperties.vendorID
+		&& profile.properties.deviceID == liveProperties.deviceID
+		&& profile.properties.driverVersion == liveProperties.driverVersion) {
+		// Properties come back from the UUID query anyway, so keep the live copy.
+		profile.properties = liveProperties;
+		return profile;
+	}
+
+	profile = queryDeviceProfile(device);
+	saveProfile(path, profile);
+	return profile;
+}
+
+std::string DeviceProfileCache::profilePath(const uint8_t driverUUID[VK_UUID_SIZE], const uint8_t deviceUUID[VK_UUID_SIZE]) const {
+	return (std::filesystem::path(directory) / (toHex(driverUUID, VK_UUID_SIZE) + "-" + toHex(deviceUUID, VK_UUID_SIZE) + ".profile")).string();
+}
+
+bool DeviceProfileCache::loadProfile(const std::string& path, DeviceCapabilityProfile& profile) const {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	ProfileFileHeader header{};
+	if (!readPod(file, &header)
+		|| header.magic != profileFileMagic
+		|| header.version != profileFileVersion
+		|| header.vkHeaderVersion != VK_HEADER_VERSION
+		|| header.queueFamilyCount > 64
+		|| header.extensionCount > 4096) {
+		return false;
+	}
+
+	profile.queueFamilies.resize(header.queueFamilyCount);
+	profile.extensions.resize(header.extensionCount);
+
+	return readPod(file, &profile.properties)
+		&& readPod(file, &profile.features)
+		&& readPod(file, &profile.memoryProperties)
+		&& readPod(file, profile.deviceUUID, VK_UUID_SIZE)
+		&& readPod(file, profile.driverUUID, VK_UUID_SIZE)
+		&& readPod(file, profile.queueFamilies.data(), profile.queueFamilies.size())
+		&& readPod(file, profile.extensions.data(), profile.extensions.size());
+}
+
+void DeviceProfileCache::saveProfile(const std::string& path, const DeviceCapabilityProfile& profile) const {
+	// The cache is an optimisation only, so failing to write it is not an error.
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+
+		ProfileFileHeader header{};
+		header.magic = profileFileMagic;
+		header.version = profileFileVersion;
+		header.vkHeaderVersion = VK_HEADER_VERSION;
+		header.queueFamilyCount = static_cast<uint32_t>(profile.queueFamilies.size());
+		header.extensionCount = static_cast<uint32_t>(profile.extensions.size());
+
+		writePod(file, &header);
+		writePod(file, &profile.properties);
+		writePod(file, &profile.features);
+		writePod(file, &profile.memoryProperties);
+		writePod(file, profile.deviceUUID, VK_UUID_SIZE);
+		writePod(file, profile.driverUUID, VK_UUID_SIZE);
+		writePod(file, profile.queueFamilies.data(), profile.queueFamilies.size());
+		writePod(file, profile.extensions.data(), profile.extensions.size());
+		if (!file.good()) {
+			return;
+		}
+	}
+
+	// Write-then-rename so a crash mid-write never leaves a truncated profile behind.
+	std::filesystem::rename(tempPath, path, error);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Snapshot of everything device selection ranks a physical device on.
+// Kept as plain Vulkan structs so the whole thing can be written to disk and read back without asking the driver again.
+struct DeviceCapabilityProfile {
+	VkPhysicalDeviceProperties properties{};
+	VkPhysicalDeviceFeatures features{};
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	std::vector<VkQueueFamilyProperties> queueFamilies;
+	std::vector<VkExtensionProperties> extensions;
+	uint8_t deviceUUID[VK_UUID_SIZE]{};
+	uint8_t driverUUID[VK_UUID_SIZE]{};
+
+	bool supportsExtension(const char* extensionName) const;
+	VkDeviceSize deviceLocalHeapSize() const;
+};
+
+/*
+	Device Profile Cache
+	- Profiles are stored one file per device, named after the driver and device UUIDs.
+	- Only vkGetPhysicalDeviceProperties2 runs on a hit; features, memory, queue and extension queries are skipped.
+	- A driver update changes the driver UUID, so stale profiles are never picked up.
+*/
+class DeviceProfileCache {
+
+	public:
+		explicit DeviceProfileCache(std::string directory);
+
+		DeviceCapabilityProfile getProfile(VkPhysicalDevice device);
+
+	private:
+		std::string directory;
+
+		std::string profilePath(const uint8_t driverUUID[VK_UUID_SIZE], const uint8_t deviceUUID[VK_UUID_SIZE]) const;
+		bool loadProfile(const std::string& path, DeviceCapabilityProfile& profile) const;
+		void saveProfile(const std::string& path, const DeviceCapabilityProfile& profile) const;
+};
+
+// Queries every capability of the device straight from the driver.
+DeviceCapabilityProfile queryDeviceProfile(VkPhysicalDevice device);
+
+// Ranks a device for rendering. Zero means the device cannot run the renderer at all.
+uint64_t scoreDeviceProfile(const DeviceCapabilityProfile& profile);
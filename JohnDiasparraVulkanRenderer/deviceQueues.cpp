@@ -0,0 +1,153 @@
+#include "deviceQueues.h"
+
+#include <map>
+#include <stdexcept>
+
+uint32_t QueueFamilyIndicies::familyFor(QueueType type) const {
+	switch (type) {
+		case QueueType::Compute: return computeFamily.value();
+		case QueueType::Transfer: return transferFamily.value();
+		default: return graphicsFamily.value();
+	}
+}
+
+QueueFamilyIndicies findQueueFamilies(const std::vector<VkQueueFamilyProperties>& queueFamilies) {
+	QueueFamilyIndicies indicies;
+
+	// Dedicated families are matched on what they lack: a compute family without graphics, a transfer family without either.
+	for (uint32_t i = 0; i < queueFamilies.size(); ++i) {
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (queueFamilies[i].queueCount == 0) {
+			continue;
+		}
+		if ((flags & VK_QUEUE_GRAPHICS_BIT) && !indicies.graphicsFamily.has_value()) {
+			indicies.graphicsFamily = i;
+		}
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !indicies.computeFamily.has_value()) {
+			indicies.computeFamily = i;
+		}
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && !indicies.transferFamily.has_value()) {
+			indicies.transferFamily = i;
+		}
+	}
+
+	// Graphics and compute families implicitly support transfer, so the fallbacks are always valid.
+	if (!indicies.computeFamily.has_value()) {
+		if (indicies.graphicsFamily.has_value() && (queueFamilies[indicies.graphicsFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+			indicies.computeFamily = indicies.graphicsFamily;
+		}
+		else {
+			for (uint32_t i = 0; i < queueFamilies.size(); ++i) {
+				if ((queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && queueFamilies[i].queueCount > 0) {
+					indicies.computeFamily = i;
+					break;
+				}
+			}
+		}
+	}
+	if (!indicies.transferFamily.has_value()) {
+		indicies.transferFamily = indicies.computeFamily.has_value() ? indicies.computeFamily : indicies.graphicsFamily;
+	}
+	return indicies;
+}
+
+const std::vector<VkDeviceQueueCreateInfo>& DeviceQueues::buildCreateInfos(const QueueFamilyIndicies& familyIndicies, const std::vector<VkQueueFamilyProperties>& queueFamilies) {
+	indicies = familyIndicies;
+	slots.clear();
+	createInfos.clear();
+	priorities.clear();
+
+	std::map<uint32_t, std::vector<QueueSlot*>> familySlots;
+	std::map<uint32_t, std::vector<float>> familyPriorities;
+
+	for (uint32_t type = 0; type < static_cast<uint32_t>(QueueType::Count); ++type) {
+		QueueType queueType = static_cast<QueueType>(type);
+		uint32_t familyIndex = indicies.familyFor(queueType);
+		uint32_t wanted = queueType == QueueType::Graphics ? 1 : maxQueuesPerType;
+		std::vector<QueueSlot*>& existing = familySlots[familyIndex];
+
+		typeQueues[type].clear();
+		for (uint32_t i = 0; i < wanted; ++i) {
+			if (existing.size() < queueFamilies[familyIndex].queueCount) {
+				auto slot = std::make_unique<QueueSlot>();
+				slot->familyIndex = familyIndex;
+				slot->queueIndex = static_cast<uint32_t>(existing.size());
+				existing.push_back(slot.get());
+				typeQueues[type].push_back(slot.get());
+				// Graphics drives the frame, so it is the one queue that gets full priority.
+				familyPriorities[familyIndex].push_back(queueType == QueueType::Graphics ? 1.0f : 0.5f);
+				slots.push_back(std::move(slot));
+			}
+			else if (typeQueues[type].empty()) {
+				// The family is out of queues: share one with whichever type claimed it first.
+				typeQueues[type].push_back(existing[i % existing.size()]);
+			}
+		}
+	}
+
+	for (auto& [familyIndex, familyQueues] : familySlots) {
+		priorities.push_back(familyPriorities[familyIndex]);
+
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = familyIndex;
+		queueCreateInfo.queueCount = static_cast<uint32_t>(familyQueues.size());
+		createInfos.push_back(queueCreateInfo);
+	}
+	// Priorities are only pointed at once the outer vector has stopped reallocating.
+	for (size_t i = 0; i < createInfos.size(); ++i) {
+		createInfos[i].pQueuePriorities = priorities[i].data();
+	}
+	return createInfos;
+}
+
+void DeviceQueues::fetchQueues(VkDevice device) {
+	for (auto& slot : slots) {
+		vkGetDeviceQueue(device, slot->familyIndex, slot->queueIndex, &slot->queue);
+	}
+}
+
+DeviceQueues::QueueSlot& DeviceQueues::slotFor(QueueType type, uint32_t index) const {
+	const std::vector<QueueSlot*>& queues = typeQueues[static_cast<uint32_t>(type)];
+	if (queues.empty()) {
+		throw std::runtime_error("Requested a queue type that was never created.");
+	}
+	return *queues[index % queues.size()];
+}
+
+VkQueue DeviceQueues::getQueue(QueueType type, uint32_t index) const {
+	return slotFor(type, index).queue;
+}
+
+uint32_t DeviceQueues::getQueueCount(QueueType type) const {
+	return static_cast<uint32_t>(typeQueues[static_cast<uint32_t>(type)].size());
+}
+
+uint32_t DeviceQueues::getFamilyIndex(QueueType type) const {
+	return indicies.familyFor(type);
+}
+
+void DeviceQueues::submit(QueueType type, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence, uint32_t queueIndex) {
+	QueueSlot& slot = slotFor(type, queueIndex);
+	std::lock_guard<std::mutex> lock(slot.submitMutex);
+
+	if (vkQueueSubmit(slot.queue, submitCount, submits, fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit to device queue.");
+	}
+}
+
+void DeviceQueues::submit2(QueueType type, uint32_t submitCount, const VkSubmitInfo2* submits, VkFence fence, uint32_t queueIndex) {
+	QueueSlot& slot = slotFor(type, queueIndex);
+	std::lock_guard<std::mutex> lock(slot.submitMutex);
+
+	if (vkQueueSubmit2(slot.queue, submitCount, submits, fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit to device queue.");
+	}
+}
+
+void DeviceQueues::waitIdle() {
+	for (auto& slot : slots) {
+		std::lock_guard<std::mutex> lock(slot->submitMutex);
+		vkQueueWaitIdle(slot->queue);
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+enum class QueueType : uint32_t {
+	Graphics = 0,
+	Compute,
+	Transfer,
+	Count
+};
+
+struct QueueFamilyIndicies {
+	std::optional<uint32_t> graphicsFamily;
+	std::optional<uint32_t> computeFamily; // Compute-only family when the device has one, otherwise falls back to graphics.
+	std::optional<uint32_t> transferFamily; // Transfer-only family when the device has one, otherwise falls back to compute.
+
+	bool isComplete() const {
+		return graphicsFamily.has_value() && computeFamily.has_value() && transferFamily.has_value();
+	}
+
+	bool hasDedicatedCompute() const {
+		return computeFamily != graphicsFamily;
+	}
+
+	bool hasDedicatedTransfer() const {
+		return transferFamily != graphicsFamily && transferFamily != computeFamily;
+	}
+
+	uint32_t familyFor(QueueType type) const;
+};
+
+QueueFamilyIndicies findQueueFamilies(const std::vector<VkQueueFamilyProperties>& queueFamilies);
+
+/*
+	Device Queues
+	- Works out how many queues to create in each family (buildCreateInfos), then fetches them once the device exists.
+	- Each queue type gets its own VkQueue when the family has enough of them, and shares one otherwise.
+	- VkQueue access must be externally synchronized, so every queue carries its own mutex and all submits go through here.
+*/
+class DeviceQueues {
+
+	public:
+		// Queues requested per type. Extra compute and transfer queues let independent streams of work overlap.
+		static const uint32_t maxQueuesPerType = 2;
+
+		// The returned create infos point into this object, so it must outlive vkCreateDevice.
+		const std::vector<VkDeviceQueueCreateInfo>& buildCreateInfos(const QueueFamilyIndicies& indicies, const std::vector<VkQueueFamilyProperties>& queueFamilies);
+		void fetchQueues(VkDevice device);
+
+		VkQueue getQueue(QueueType type, uint32_t index = 0) const;
+		uint32_t getQueueCount(QueueType type) const;
+		uint32_t getFamilyIndex(QueueType type) const;
+
+		void submit(QueueType type, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence, uint32_t queueIndex = 0);
+		void submit2(QueueType type, uint32_t submitCount, const VkSubmitInfo2* submits, VkFence fence, uint32_t queueIndex = 0);
+		void waitIdle();
+
+	private:
+		struct QueueSlot {
+			uint32_t familyIndex;
+			uint32_t queueIndex;
+			VkQueue queue = VK_NULL_HANDLE;
+			std::mutex submitMutex;
+		};
+
+		QueueFamilyIndicies indicies;
+		std::vector<std::unique_ptr<QueueSlot>> slots; // One per distinct VkQueue.
+		std::vector<QueueSlot*> typeQueues[static_cast<uint32_t>(QueueType::Count)];
+		std::vector<VkDeviceQueueCreateInfo> createInfos;
+		std::vector<std::vector<float>> priorities;
+
+		QueueSlot& slotFor(QueueType type, uint32_t index) const;
+};
@@ -0,0 +1,301 @@
+#include "frameScheduler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	double millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+void FrameScheduler::init(VkDevice device, DeviceQueues& queues, uint32_t framesInFlight, uint32_t recordingThreads, const VkAllocationCallbacks* frameCallbacks, const VkAllocationCallbacks* deviceCallbacks) {
+	if (framesInFlight == 0) {
+		throw std::runtime_error("Frame scheduler needs at least one frame in flight.");
+	}
+	if (recordingThreads == 0) {
+		throw std::runtime_error("Frame scheduler needs at least one recording thread.");
+	}
+
+	this->device = device;
+	this->queues = &queues;
+	this->framesInFlight = framesInFlight;
+	this->frameCallbacks = frameCallbacks;
+	this->deviceCallbacks = deviceCallbacks;
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, deviceCallbacks, &timeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create frame timeline semaphore.");
+	}
+
+	slots.resize(framesInFlight);
+	for (FrameSlot& slot : slots) {
+		slot.commandPool = createCommandPool();
+		slot.threadPools.resize(recordingThreads);
+		for (ThreadCommandPool& threadPool : slot.threadPools) {
+			threadPool.commandPool = createCommandPool();
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = slot.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate per-frame command buffer.");
+		}
+	}
+}
+
+VkCommandPool FrameScheduler::createCommandPool() {
+	// Transient: everything in the pool is re-recorded every frame, so the driver can skip keeping it around.
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queues->getFamilyIndex(QueueType::Graphics);
+
+	VkCommandPool commandPool;
+	if (vkCreateCommandPool(device, &poolInfo, frameCallbacks, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create per-frame command pool.");
+	}
+	return commandPool;
+}
+
+void FrameScheduler::destroy() {
+	waitIdle();
+	while (!deferredReleases.empty()) {
+		deferredReleases.front().release();
+		deferredReleases.pop_front();
+	}
+
+	for (FrameSlot& slot : slots) {
+		for (ThreadCommandPool& threadPool : slot.threadPools) {
+			vkDestroyCommandPool(device, threadPool.commandPool, frameCallbacks);
+		}
+		vkDestroyCommandPool(device, slot.commandPool, frameCallbacks);
+	}
+	slots.clear();
+	vkDestroySemaphore(device, timeline, deviceCallbacks);
+	timeline = VK_NULL_HANDLE;
+}
+
+FrameContext& FrameScheduler::beginFrame() {
+	current.frameIndex = nextFrameIndex++;
+	current.slot = static_cast<uint32_t>(current.frameIndex % framesInFlight);
+
+	// The slot was last used by frame F - N. Waiting for it is the only CPU/GPU sync point in the loop.
+	if (current.frameIndex >= framesInFlight) {
+		waitForFrame(current.frameIndex - framesInFlight);
+	}
+	collectCompleted();
+	beginTime = Clock::now();
+
+	FrameSlot& slot = slots[current.slot];
+	vkResetCommandPool(device, slot.commandPool, 0);
+	for (ThreadCommandPool& threadPool : slot.threadPools) {
+		vkResetCommandPool(device, threadPool.commandPool, 0);
+		threadPool.usedSecondaries = 0;
+	}
+	current.commandBuffer = slot.commandBuffer;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(current.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording command buffer.");
+	}
+	return current;
+}
+
+void FrameScheduler::endFrame(const std::vector<VkSemaphoreSubmitInfo>& waitSemaphores) {
+	CPU_PROFILE_SCOPE("endFrame");
+	if (vkEndCommandBuffer(current.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record command buffer.");
+	}
+
+	VkCommandBufferSubmitInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+	commandBufferInfo.commandBuffer = current.commandBuffer;
+
+	VkSemaphoreSubmitInfo signalInfo{};
+	signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	signalInfo.semaphore = timeline;
+	signalInfo.value = current.frameIndex + 1;
+	signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo2 submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.waitSemaphoreInfoCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphoreInfos = waitSemaphores.data();
+	submitInfo.commandBufferInfoCount = 1;
+	submitInfo.pCommandBufferInfos = &commandBufferInfo;
+	submitInfo.signalSemaphoreInfoCount = 1;
+	submitInfo.pSignalSemaphoreInfos = &signalInfo;
+	queues->submit2(QueueType::Graphics, 1, &submitInfo, VK_NULL_HANDLE);
+
+	Clock::time_point submitTime = Clock::now();
+	double interval = current.frameIndex == 0 ? 0.0 : millisecondsBetween(lastSubmitTime, submitTime);
+	if (current.frameIndex == 0) {
+		firstSubmitTime = submitTime;
+	}
+	lastSubmitTime = submitTime;
+	inFlight.push_back({ current.frameIndex, beginTime, submitTime, interval });
+}
+
+VkCommandBuffer FrameScheduler::acquireSecondary(uint32_t threadIndex) {
+	if (threadIndex >= slots[current.slot].threadPools.size()) {
+		throw std::runtime_error("Recording thread index exceeds the frame scheduler's thread pools.");
+	}
+
+	ThreadCommandPool& threadPool = slots[current.slot].threadPools[threadIndex];
+	if (threadPool.usedSecondaries == threadPool.secondaries.size()) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = threadPool.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate secondary command buffer.");
+		}
+		threadPool.secondaries.push_back(commandBuffer);
+	}
+	return threadPool.secondaries[threadPool.usedSecondaries++];
+}
+
+void FrameScheduler::recordParallel(JobSystem& jobSystem, const std::vector<RecordPass>& passes, const VkCommandBufferInheritanceInfo* inheritance, VkCommandBufferUsageFlags usage) {
+	if (passes.empty()) {
+		return;
+	}
+
+	VkCommandBufferInheritanceInfo emptyInheritance{};
+	emptyInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | usage;
+	beginInfo.pInheritanceInfo = inheritance ? inheritance : &emptyInheritance;
+
+	// Each job writes only its own element, so the order of execution below is the order of the passes,
+	// whichever thread recorded them.
+	std::vector<VkCommandBuffer> secondaries(passes.size(), VK_NULL_HANDLE);
+	jobSystem.parallelFor(static_cast<uint32_t>(passes.size()), 1, [&](uint32_t begin, uint32_t end) {
+		CPU_PROFILE_SCOPE("recordSecondary");
+		for (uint32_t i = begin; i < end; ++i) {
+			VkCommandBuffer commandBuffer = acquireSecondary(JobSystem::currentThreadIndex());
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to begin recording secondary command buffer.");
+			}
+			passes[i](commandBuffer);
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to record secondary command buffer.");
+			}
+			secondaries[i] = commandBuffer;
+		}
+	});
+
+	vkCmdExecuteCommands(current.commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+}
+
+void FrameScheduler::deferUntilComplete(std::function<void()> release) {
+	if (nextFrameIndex == 0) {
+		release();
+		return;
+	}
+	deferredReleases.push_back({ nextFrameIndex - 1, std::move(release) });
+}
+
+uint64_t FrameScheduler::getCompletedValue() {
+	uint64_t value = 0;
+	vkGetSemaphoreCounterValue(device, timeline, &value);
+	return value;
+}
+
+bool FrameScheduler::isFrameComplete(uint64_t frameIndex) {
+	return getCompletedValue() >= frameIndex + 1;
+}
+
+void FrameScheduler::waitForFrame(uint64_t frameIndex) {
+	CPU_PROFILE_SCOPE("waitForFrame");
+	uint64_t value = frameIndex + 1;
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &timeline;
+	waitInfo.pValues = &value;
+	if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("Failed waiting on the frame timeline.");
+	}
+}
+
+void FrameScheduler::waitIdle() {
+	if (nextFrameIndex > 0 && !inFlight.empty()) {
+		waitForFrame(nextFrameIndex - 1);
+	}
+	collectCompleted();
+}
+
+void FrameScheduler::collectCompleted() {
+	if (inFlight.empty() && deferredReleases.empty()) {
+		return;
+	}
+
+	uint64_t completed = getCompletedValue();
+	Clock::time_point now = Clock::now();
+
+	while (!deferredReleases.empty() && deferredReleases.front().frameIndex + 1 <= completed) {
+		std::function<void()> release = std::move(deferredReleases.front().release);
+		deferredReleases.pop_front();
+		release();
+	}
+
+	while (!inFlight.empty() && inFlight.front().frameIndex + 1 <= completed) {
+		const InFlightFrame& frame = inFlight.front();
+
+		FrameTiming timing{};
+		timing.frameIndex = frame.frameIndex;
+		timing.cpuFrameMs = millisecondsBetween(frame.beginTime, frame.submitTime);
+		timing.gpuLatencyMs = millisecondsBetween(frame.submitTime, now);
+		timing.frameIntervalMs = frame.frameIntervalMs;
+		completedTimings.push_back(timing);
+
+		totalFrames++;
+		totalCpuMs += timing.cpuFrameMs;
+		totalLatencyMs += timing.gpuLatencyMs;
+		maxLatencyMs = std::max(maxLatencyMs, timing.gpuLatencyMs);
+		inFlight.pop_front();
+	}
+}
+
+std::vector<FrameTiming> FrameScheduler::takeCompletedTimings() {
+	std::vector<FrameTiming> timings;
+	timings.swap(completedTimings);
+	return timings;
+}
+
+void FrameScheduler::printSummary() const {
+	if (totalFrames == 0) {
+		return;
+	}
+
+	double elapsedMs = millisecondsBetween(firstSubmitTime, lastSubmitTime);
+	std::cout << "Frame Summary: " << totalFrames << " frames, " << framesInFlight << " in flight\n";
+	std::cout << "\t" << "Avg CPU frame: " << totalCpuMs / totalFrames << " ms\n";
+	std::cout << "\t" << "Avg submit-to-complete latency: " << totalLatencyMs / totalFrames << " ms (max " << maxLatencyMs << " ms)\n";
+	if (elapsedMs > 0.0 && totalFrames > 1) {
+		std::cout << "\t" << "Throughput: " << (totalFrames - 1) * 1000.0 / elapsedMs << " frames/s\n";
+	}
+}
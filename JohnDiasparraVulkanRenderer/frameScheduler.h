@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "deviceQueues.h"
+#include "jobSystem.h"
+
+struct FrameTiming {
+	uint64_t frameIndex;
+	double cpuFrameMs; // beginFrame to submit: CPU time spent building the frame.
+	double gpuLatencyMs; // Submit to the CPU observing completion on the timeline.
+	double frameIntervalMs; // Submit to submit, the inverse of throughput.
+};
+
+struct FrameContext {
+	uint64_t frameIndex = 0;
+	uint32_t slot = 0; // Which per-frame resources this frame owns, in [0, framesInFlight).
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+};
+
+/*
+	Frame Scheduler
+	- N frames in flight, each with its own command pool that is reset wholesale instead of per command buffer.
+	- A single timeline semaphore replaces per-frame fences and binary semaphores: frame F signals F + 1 on completion.
+	- beginFrame for frame F only waits for F - N, so the CPU never waits for the frame it has just submitted.
+	- Each slot also owns one command pool per recording thread. Pools are never shared between threads, so
+	  recordParallel can fill secondary command buffers on every core without locking.
+*/
+class FrameScheduler {
+
+	public:
+		using RecordPass = std::function<void(VkCommandBuffer)>;
+
+		// recordingThreads should match JobSystem::getThreadCount() of the job system passed to recordParallel.
+		void init(VkDevice device, DeviceQueues& queues, uint32_t framesInFlight, uint32_t recordingThreads, const VkAllocationCallbacks* frameCallbacks, const VkAllocationCallbacks* deviceCallbacks);
+		void destroy();
+
+		FrameContext& beginFrame();
+		// Extra semaphores let other queues (uploads, async compute) gate this frame without the CPU waiting on them.
+		void endFrame(const std::vector<VkSemaphoreSubmitInfo>& waitSemaphores = {});
+
+		// Records each pass into its own secondary command buffer on the job system, then executes them in order on the
+		// frame's primary. Passes inside a render pass or dynamic rendering need the inheritance info and CONTINUE usage flag.
+		void recordParallel(JobSystem& jobSystem, const std::vector<RecordPass>& passes, const VkCommandBufferInheritanceInfo* inheritance = nullptr, VkCommandBufferUsageFlags usage = 0);
+
+		// Runs release once every frame submitted so far (including the one being recorded) has completed. For
+		// destroying objects that in-flight command buffers may still reference.
+		void deferUntilComplete(std::function<void()> release);
+
+		bool isFrameComplete(uint64_t frameIndex);
+		void waitForFrame(uint64_t frameIndex);
+		void waitIdle();
+		uint64_t getCompletedValue();
+		VkSemaphore getTimeline() const { return timeline; }
+		uint32_t getFramesInFlight() const { return framesInFlight; }
+		uint64_t getFrameIndex() const { return current.frameIndex; }
+
+		// Timings of frames whose completion was observed since the last call, oldest first.
+		std::vector<FrameTiming> takeCompletedTimings();
+		void printSummary() const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct ThreadCommandPool {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> secondaries; // Grown on demand and kept, since resetting the pool recycles them.
+			uint32_t usedSecondaries = 0;
+		};
+
+		struct FrameSlot {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			std::vector<ThreadCommandPool> threadPools;
+		};
+
+		struct DeferredRelease {
+			uint64_t frameIndex;
+			std::function<void()> release;
+		};
+
+		struct InFlightFrame {
+			uint64_t frameIndex;
+			Clock::time_point beginTime;
+			Clock::time_point submitTime;
+			double frameIntervalMs;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		DeviceQueues* queues = nullptr;
+		const VkAllocationCallbacks* frameCallbacks = nullptr;
+		const VkAllocationCallbacks* deviceCallbacks = nullptr;
+		uint32_t framesInFlight = 0;
+
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		std::vector<FrameSlot> slots;
+		FrameContext current;
+		uint64_t nextFrameIndex = 0;
+		Clock::time_point beginTime;
+		Clock::time_point lastSubmitTime;
+
+		std::deque<InFlightFrame> inFlight;
+		std::deque<DeferredRelease> deferredReleases;
+		std::vector<FrameTiming> completedTimings;
+
+		uint64_t totalFrames = 0;
+		double totalCpuMs = 0.0;
+		double totalLatencyMs = 0.0;
+		double maxLatencyMs = 0.0;
+		Clock::time_point firstSubmitTime;
+
+		VkCommandPool createCommandPool();
+		VkCommandBuffer acquireSecondary(uint32_t threadIndex);
+		void collectCompleted();
+};
@@ -0,0 +1,235 @@
+#include "frustumCulling.h"
+
+// Only the intrinsics headers and GLM_ARCH; the project defines GLM_FORCE_INTRINSICS so GLM_ARCH follows the
+// compiler's target. Without it GLM_ARCH has no SIMD bits and the scalar loop is used.
+#include <glm/simd/platform.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	// Sits behind every plane however the frustum is oriented, so padding never comes out visible.
+	const float paddingRadius = -FLT_MAX;
+
+	// Spheres per parallel job. Big enough that a job outlasts its scheduling cost by a wide margin.
+	const uint32_t spheresPerJob = 16384;
+
+	void checkRange(const BoundingSpheres& spheres, uint32_t begin, uint32_t end) {
+		if (begin % BoundingSpheres::batchSize != 0 || (end % BoundingSpheres::batchSize != 0 && end != spheres.paddedSize()) || end > spheres.paddedSize()) {
+			throw std::runtime_error("Frustum culling range must be whole batches of bounding spheres.");
+		}
+	}
+
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	uint32_t cullSpheresAvx2(const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int i = 0; i < 6; ++i) {
+			planeX[i] = _mm256_set1_ps(planes[i].x);
+			planeY[i] = _mm256_set1_ps(planes[i].y);
+			planeZ[i] = _mm256_set1_ps(planes[i].z);
+			planeW[i] = _mm256_set1_ps(planes[i].w);
+		}
+		const __m256 negate = _mm256_set1_ps(-0.0f);
+
+		uint32_t count = 0;
+		for (uint32_t base = begin; base < end; base += 8) {
+			__m256 x = _mm256_loadu_ps(spheres.getCentreX() + base);
+			__m256 y = _mm256_loadu_ps(spheres.getCentreY() + base);
+			__m256 z = _mm256_loadu_ps(spheres.getCentreZ() + base);
+			__m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(spheres.getRadius() + base), negate);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int i = 0; i < 6; ++i) {
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[i], x), _mm256_mul_ps(planeY[i], y)),
+					_mm256_add_ps(_mm256_mul_ps(planeZ[i], z), planeW[i]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 8; ++lane) {
+				visible[count] = base + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+		return count;
+	}
+#endif
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	uint32_t cullSpheresSse2(const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible) {
+		glm_f32vec4 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int i = 0; i < 6; ++i) {
+			planeX[i] = _mm_set1_ps(planes[i].x);
+			planeY[i] = _mm_set1_ps(planes[i].y);
+			planeZ[i] = _mm_set1_ps(planes[i].z);
+			planeW[i] = _mm_set1_ps(planes[i].w);
+		}
+		const glm_f32vec4 negate = _mm_set1_ps(-0.0f);
+
+		uint32_t count = 0;
+		for (uint32_t base = begin; base < end; base += 4) {
+			glm_f32vec4 x = _mm_loadu_ps(spheres.getCentreX() + base);
+			glm_f32vec4 y = _mm_loadu_ps(spheres.getCentreY() + base);
+			glm_f32vec4 z = _mm_loadu_ps(spheres.getCentreZ() + base);
+			glm_f32vec4 negativeRadius = _mm_xor_ps(_mm_loadu_ps(spheres.getRadius() + base), negate);
+
+			glm_f32vec4 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int i = 0; i < 6; ++i) {
+				glm_f32vec4 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[i], x), _mm_mul_ps(planeY[i], y)),
+					_mm_add_ps(_mm_mul_ps(planeZ[i], z), planeW[i]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+				visible[count] = base + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+		return count;
+	}
+#endif
+}
+
+FrustumCullingPath getFrustumCullingPath() {
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	return FrustumCullingPath::Avx2;
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+	return FrustumCullingPath::Sse2;
+#else
+	return FrustumCullingPath::Scalar;
+#endif
+}
+
+const char* getFrustumCullingPathName(FrustumCullingPath path) {
+	switch (path) {
+		case FrustumCullingPath::Scalar: return "scalar";
+		case FrustumCullingPath::Sse2: return "SSE2";
+		case FrustumCullingPath::Avx2: return "AVX2";
+	}
+	return "unknown";
+}
+
+bool isFrustumCullingPathAvailable(FrustumCullingPath path) {
+	switch (path) {
+		case FrustumCullingPath::Scalar: return true;
+		case FrustumCullingPath::Sse2: return (GLM_ARCH & GLM_ARCH_SSE2_BIT) != 0;
+		case FrustumCullingPath::Avx2: return (GLM_ARCH & GLM_ARCH_AVX2_BIT) != 0;
+	}
+	return false;
+}
+
+uint32_t BoundingSpheres::add(const glm::vec4& sphere) {
+	uint32_t index = count++;
+	if (index == radius.size()) {
+		// Grow by a whole batch of padding, then overwrite the first entry.
+		size_t padded = radius.size() + batchSize;
+		centreX.resize(padded, 0.0f);
+		centreY.resize(padded, 0.0f);
+		centreZ.resize(padded, 0.0f);
+		radius.resize(padded, paddingRadius);
+	}
+	set(index, sphere);
+	return index;
+}
+
+void BoundingSpheres::set(uint32_t index, const glm::vec4& sphere) {
+	centreX[index] = sphere.x;
+	centreY[index] = sphere.y;
+	centreZ[index] = sphere.z;
+	radius[index] = sphere.w;
+}
+
+void BoundingSpheres::clear() {
+	centreX.clear();
+	centreY.clear();
+	centreZ.clear();
+	radius.clear();
+	count = 0;
+}
+
+void BoundingSpheres::reserve(uint32_t count) {
+	size_t padded = (static_cast<size_t>(count) + batchSize - 1) / batchSize * batchSize;
+	centreX.reserve(padded);
+	centreY.reserve(padded);
+	centreZ.reserve(padded);
+	radius.reserve(padded);
+}
+
+uint32_t cullSpheresScalar(const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible) {
+	checkRange(spheres, begin, end);
+	uint32_t count = 0;
+	for (uint32_t index = begin; index < end; ++index) {
+		float x = spheres.getCentreX()[index];
+		float y = spheres.getCentreY()[index];
+		float z = spheres.getCentreZ()[index];
+		float negativeRadius = -spheres.getRadius()[index];
+
+		bool inside = true;
+		for (int i = 0; i < 6; ++i) {
+			// Same operation order as the SIMD paths.
+			float distance = (planes[i].x * x + planes[i].y * y) + (planes[i].z * z + planes[i].w);
+			inside = inside && distance >= negativeRadius;
+		}
+		visible[count] = index;
+		count += inside ? 1 : 0;
+	}
+	return count;
+}
+
+uint32_t cullSpheres(const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible) {
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	checkRange(spheres, begin, end);
+	return cullSpheresAvx2(planes, spheres, begin, end, visible);
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+	checkRange(spheres, begin, end);
+	return cullSpheresSse2(planes, spheres, begin, end, visible);
+#else
+	return cullSpheresScalar(planes, spheres, begin, end, visible);
+#endif
+}
+
+uint32_t cullSpheresWithPath(FrustumCullingPath path, const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible) {
+	switch (path) {
+		case FrustumCullingPath::Scalar:
+			return cullSpheresScalar(planes, spheres, begin, end, visible);
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+		case FrustumCullingPath::Sse2:
+			checkRange(spheres, begin, end);
+			return cullSpheresSse2(planes, spheres, begin, end, visible);
+#endif
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+		case FrustumCullingPath::Avx2:
+			checkRange(spheres, begin, end);
+			return cullSpheresAvx2(planes, spheres, begin, end, visible);
+#endif
+		default:
+			throw std::runtime_error(std::string("This build has no ") + getFrustumCullingPathName(path) + " frustum culling path.");
+	}
+}
+
+void cullSpheresParallel(JobSystem& jobSystem, const glm::vec4 planes[6], const BoundingSpheres& spheres, std::vector<uint32_t>& visible) {
+	CPU_PROFILE_SCOPE("cullSpheresParallel");
+	uint32_t total = spheres.paddedSize();
+	visible.resize(total);
+
+	// Each job writes into its own part of visible, then the parts are packed together in order.
+	uint32_t jobCount = (total + spheresPerJob - 1) / spheresPerJob;
+	std::vector<uint32_t> jobVisible(jobCount);
+	jobSystem.parallelFor(total, spheresPerJob, [&](uint32_t begin, uint32_t end) {
+		jobVisible[begin / spheresPerJob] = cullSpheres(planes, spheres, begin, end, visible.data() + begin);
+	});
+
+	uint32_t packed = 0;
+	for (uint32_t job = 0; job < jobCount; ++job) {
+		memmove(visible.data() + packed, visible.data() + static_cast<size_t>(job) * spheresPerJob, jobVisible[job] * sizeof(uint32_t));
+		packed += jobVisible[job];
+	}
+	visible.resize(packed);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "jobSystem.h"
+
+// Which loop cullSpheres runs, fixed at compile time by what glm/simd/platform.h detects (GLM_ARCH).
+enum class FrustumCullingPath {
+	Scalar,
+	Sse2, // 4 spheres per iteration.
+	Avx2 // 8 spheres per iteration. Needs an AVX2 build (/arch:AVX2 or -mavx2).
+};
+
+FrustumCullingPath getFrustumCullingPath();
+const char* getFrustumCullingPathName(FrustumCullingPath path);
+// An AVX2 build has all three paths, an SSE2 build the first two.
+bool isFrustumCullingPathAvailable(FrustumCullingPath path);
+
+/*
+	Bounding Spheres (SoA)
+	- Centres and radii in four separate arrays so a SIMD load picks up the same component of consecutive spheres.
+	- Always padded to a whole number of batches with spheres that every plane rejects, so the loops never need a
+	  scalar tail.
+*/
+class BoundingSpheres {
+
+	public:
+		static const uint32_t batchSize = 8; // The widest path; narrower ones divide it evenly.
+
+		uint32_t add(const glm::vec4& sphere); // Centre in xyz, radius in w. Returns the sphere's index.
+		void set(uint32_t index, const glm::vec4& sphere);
+		void clear();
+		void reserve(uint32_t count);
+
+		uint32_t size() const { return count; }
+		uint32_t paddedSize() const { return static_cast<uint32_t>(radius.size()); }
+		const float* getCentreX() const { return centreX.data(); }
+		const float* getCentreY() const { return centreY.data(); }
+		const float* getCentreZ() const { return centreZ.data(); }
+		const float* getRadius() const { return radius.data(); }
+
+	private:
+		std::vector<float> centreX;
+		std::vector<float> centreY;
+		std::vector<float> centreZ;
+		std::vector<float> radius;
+		uint32_t count = 0;
+};
+
+/*
+	Frustum Culling
+	- planes are inward-facing and normalized, as extractFrustumPlanes produces; a sphere is culled when it lies wholly
+	  behind any of them, the same test cull.comp uses.
+	- Visible indices are written in ascending order and the count returned. Writes are branchless, so visible needs
+	  room for a whole range (end - begin entries) even when few spheres survive.
+	- begin and end are multiples of BoundingSpheres::batchSize, or end is paddedSize().
+*/
+uint32_t cullSpheres(const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible);
+// The plain loop every path must agree with.
+uint32_t cullSpheresScalar(const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible);
+// A particular path rather than the widest one, for comparing them. Throws when the build doesn't have it.
+uint32_t cullSpheresWithPath(FrustumCullingPath path, const glm::vec4 planes[6], const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible);
+// Splits the spheres across the job system. visible is resized to hold every index and trimmed to the result.
+void cullSpheresParallel(JobSystem& jobSystem, const glm::vec4 planes[6], const BoundingSpheres& spheres, std::vector<uint32_t>& visible);
@@ -0,0 +1,769 @@
+#include "gltfLoader.h"
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include "cookedAssets.h"
+#include "cpuProfiler.h"
+#include "mipChainFile.h"
+
+namespace {
+
+	const uint32_t glbMagic = 0x46546C67; // "glTF"
+	const uint32_t glbJsonChunk = 0x4E4F534A; // "JSON"
+	const uint32_t glbBinChunk = 0x004E4942; // "BIN\0"
+	const uint32_t triangleListMode = 4;
+	const uint32_t maxNodeDepth = 256; // Also what stops a cyclic hierarchy.
+	const char* const basisuExtension = "KHR_texture_basisu";
+
+	[[noreturn]] void fail(const std::string& message) {
+		throw std::runtime_error("glTF: " + message + ".");
+	}
+
+	uint32_t componentSize(uint32_t componentType) {
+		switch (componentType) {
+			case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+			case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+			case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+			default: fail("Unknown accessor component type " + std::to_string(componentType));
+		}
+	}
+
+	uint32_t componentCount(const std::string& type) {
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		if (type == "MAT2") return 4;
+		if (type == "MAT3") return 9;
+		if (type == "MAT4") return 16;
+		fail("Unknown accessor type " + type);
+	}
+
+	bool isDataUri(const std::string& uri) {
+		return uri.compare(0, 5, "data:") == 0;
+	}
+
+	// Only base64 payloads; glTF doesn't allow any other data URI encoding.
+	std::vector<uint8_t> decodeDataUri(const std::string& uri) {
+		size_t comma = uri.find(',');
+		if (comma == std::string::npos || comma < 7 || uri.compare(comma - 7, 7, ";base64") != 0) {
+			fail("Data URI is not base64");
+		}
+
+		std::vector<uint8_t> out;
+		out.reserve((uri.size() - comma) / 4 * 3);
+		uint32_t accumulator = 0;
+		uint32_t bits = 0;
+		for (size_t i = comma + 1; i < uri.size(); ++i) {
+			char c = uri[i];
+			uint32_t value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else if (c == '=') break;
+			else fail("Invalid base64 in data URI");
+
+			accumulator = accumulator << 6 | value;
+			bits += 6;
+			if (bits >= 8) {
+				bits -= 8;
+				out.push_back(static_cast<uint8_t>(accumulator >> bits));
+			}
+		}
+		return out;
+	}
+
+	// Relative URIs may percent-encode spaces and other characters that file names allow.
+	std::string decodeUriPath(const std::string& uri) {
+		std::string out;
+		for (size_t i = 0; i < uri.size(); ++i) {
+			if (uri[i] == '%' && i + 2 < uri.size()) {
+				out.push_back(static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+				i += 2;
+			}
+			else {
+				out.push_back(uri[i]);
+			}
+		}
+		return out;
+	}
+
+	uint32_t readUint32(const uint8_t* bytes) {
+		uint32_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	glm::mat4 readNodeTransform(const JsonValue& node) {
+		const JsonValue& matrix = node["matrix"];
+		if (matrix.size() == 16) {
+			glm::mat4 transform;
+			for (int i = 0; i < 16; ++i) {
+				transform[i / 4][i % 4] = static_cast<float>(matrix.at(i).asNumber()); // Column major, like glm.
+			}
+			return transform;
+		}
+
+		const JsonValue& translation = node["translation"];
+		const JsonValue& rotation = node["rotation"];
+		const JsonValue& scale = node["scale"];
+		glm::mat4 transform(1.0f);
+		if (translation.size() == 3) {
+			transform = glm::translate(transform, glm::vec3(translation.at(0).asNumber(), translation.at(1).asNumber(), translation.at(2).asNumber()));
+		}
+		if (rotation.size() == 4) {
+			// glTF stores x, y, z, w; glm's constructor takes w first.
+			glm::quat orientation(static_cast<float>(rotation.at(3).asNumber()), static_cast<float>(rotation.at(0).asNumber()),
+				static_cast<float>(rotation.at(1).asNumber()), static_cast<float>(rotation.at(2).asNumber()));
+			transform = transform * glm::mat4_cast(orientation);
+		}
+		if (scale.size() == 3) {
+			transform = glm::scale(transform, glm::vec3(scale.at(0).asNumber(1.0), scale.at(1).asNumber(1.0), scale.at(2).asNumber(1.0)));
+		}
+		return transform;
+	}
+
+	// The largest axis scale bounds how much the transform can grow a sphere.
+	glm::vec4 transformSphere(const glm::mat4& transform, const glm::vec4& sphere) {
+		glm::vec3 centre = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+		float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		return glm::vec4(centre, sphere.w * scale);
+	}
+}
+
+void GltfLoader::open(const std::string& path) {
+	CPU_PROFILE_SCOPE("openGltf");
+	this->path = path;
+	directory = std::filesystem::path(path).parent_path().string();
+	file.open(path);
+
+	const uint8_t* data = file.getData();
+	size_t size = file.getSize();
+	const char* json = reinterpret_cast<const char*>(data);
+	size_t jsonSize = size;
+	const uint8_t* binChunk = nullptr;
+	size_t binSize = 0;
+
+	try {
+		// GLB: a 12 byte header, then a JSON chunk and an optional BIN chunk, each 4 byte aligned.
+		if (size >= 12 && readUint32(data) == glbMagic) {
+			if (readUint32(data + 4) != 2) {
+				fail("Only GLB version 2 is supported");
+			}
+			json = nullptr;
+			size_t offset = 12;
+			size_t end = std::min<size_t>(size, readUint32(data + 8));
+			while (offset + 8 <= end) {
+				uint32_t chunkSize = readUint32(data + offset);
+				uint32_t chunkType = readUint32(data + offset + 4);
+				if (chunkSize > end - offset - 8) {
+					fail("GLB chunk runs past the end of the file");
+				}
+				if (chunkType == glbJsonChunk && !json) {
+					json = reinterpret_cast<const char*>(data + offset + 8);
+					jsonSize = chunkSize;
+				}
+				else if (chunkType == glbBinChunk && !binChunk) {
+					binChunk = data + offset + 8;
+					binSize = chunkSize;
+				}
+				offset += 8 + ((static_cast<size_t>(chunkSize) + 3) & ~static_cast<size_t>(3));
+			}
+			if (!json) {
+				fail("GLB has no JSON chunk");
+			}
+		}
+
+		JsonValue document = parseJson(json, jsonSize);
+		if (document["asset"]["version"].asString().compare(0, 2, "2.") != 0) {
+			fail("Only glTF 2.x is supported");
+		}
+		// Required extensions change what the data means, so a file that needs one can't be loaded partially.
+		for (const JsonValue& extension : document["extensionsRequired"].getElements()) {
+			if (extension.asString() == basisuExtension) {
+				continue; // Only means there is no PNG fallback; textures that can't be transcoded keep their placeholder.
+			}
+			fail("Required extension " + extension.asString() + " is not supported");
+		}
+
+		loadBuffers(document, binChunk, binSize);
+		loadAccessors(document);
+		std::vector<std::vector<uint32_t>> meshPrimitives;
+		loadMeshes(document, meshPrimitives);
+		loadMaterials(document);
+		loadNodes(document, meshPrimitives);
+	}
+	catch (const std::exception& e) {
+		throw std::runtime_error(path + ": " + e.what());
+	}
+}
+
+void GltfLoader::loadBuffers(const JsonValue& document, const uint8_t* binChunk, size_t binSize) {
+	const JsonValue& bufferList = document["buffers"];
+	externalBuffers.reserve(bufferList.size());
+	embeddedBuffers.reserve(bufferList.size());
+	for (size_t i = 0; i < bufferList.size(); ++i) {
+		const JsonValue& buffer = bufferList.at(i);
+		size_t byteLength = static_cast<size_t>(buffer["byteLength"].asNumber());
+		const std::string& uri = buffer["uri"].asString();
+
+		const uint8_t* bytes = nullptr;
+		size_t available = 0;
+		if (uri.empty()) {
+			if (i != 0 || !binChunk) {
+				fail("Buffer " + std::to_string(i) + " has no URI and there is no GLB binary chunk");
+			}
+			bytes = binChunk;
+			available = binSize;
+		}
+		else if (isDataUri(uri)) {
+			embeddedBuffers.push_back(decodeDataUri(uri));
+			bytes = embeddedBuffers.back().data();
+			available = embeddedBuffers.back().size();
+		}
+		else {
+			// Mapped, not read: decode jobs fault in only the pages their accessors cover.
+			MappedFile external;
+			external.open((std::filesystem::path(directory) / decodeUriPath(uri)).string());
+			external.prefetch(0, external.getSize());
+			bytes = external.getData();
+			available = external.getSize();
+			externalBuffers.push_back(std::move(external));
+		}
+		if (byteLength > available) {
+			fail("Buffer " + std::to_string(i) + " is shorter than its byteLength");
+		}
+		buffers.emplace_back(bytes, byteLength);
+	}
+
+	const JsonValue& viewList = document["bufferViews"];
+	for (size_t i = 0; i < viewList.size(); ++i) {
+		const JsonValue& view = viewList.at(i);
+		BufferView bufferView{};
+		bufferView.buffer = view["buffer"].asUint(gltfNone);
+		bufferView.offset = static_cast<size_t>(view["byteOffset"].asNumber());
+		bufferView.length = static_cast<size_t>(view["byteLength"].asNumber());
+		bufferView.stride = view["byteStride"].asUint(0);
+		if (bufferView.buffer >= buffers.size() || bufferView.offset > buffers[bufferView.buffer].second
+			|| bufferView.length > buffers[bufferView.buffer].second - bufferView.offset) {
+			fail("Buffer view " + std::to_string(i) + " is out of bounds");
+		}
+		bufferViews.push_back(bufferView);
+	}
+}
+
+void GltfLoader::loadAccessors(const JsonValue& document) {
+	const JsonValue& accessorList = document["accessors"];
+	for (size_t i = 0; i < accessorList.size(); ++i) {
+		const JsonValue& source = accessorList.at(i);
+		if (source.has("sparse")) {
+			fail("Sparse accessors are not supported");
+		}
+
+		Accessor accessor{};
+		accessor.bufferView = source["bufferView"].asUint(gltfNone);
+		accessor.offset = static_cast<size_t>(source["byteOffset"].asNumber());
+		accessor.componentType = source["componentType"].asUint();
+		accessor.componentCount = componentCount(source["type"].asString());
+		accessor.count = source["count"].asUint();
+		accessor.normalized = source["normalized"].asBool();
+
+		const JsonValue& min = source["min"];
+		const JsonValue& max = source["max"];
+		accessor.hasBounds = min.size() >= 3 && max.size() >= 3;
+		for (uint32_t c = 0; c < 3 && accessor.hasBounds; ++c) {
+			accessor.min[c] = static_cast<float>(min.at(c).asNumber());
+			accessor.max[c] = static_cast<float>(max.at(c).asNumber());
+		}
+
+		// Checked once here, so decoding never needs to.
+		if (accessor.bufferView != gltfNone && accessor.count > 0) {
+			if (accessor.bufferView >= bufferViews.size()) {
+				fail("Accessor " + std::to_string(i) + " has an invalid buffer view");
+			}
+			const BufferView& view = bufferViews[accessor.bufferView];
+			size_t elementSize = static_cast<size_t>(componentSize(accessor.componentType)) * accessor.componentCount;
+			size_t stride = view.stride ? view.stride : elementSize;
+			if (accessor.offset + stride * (accessor.count - 1) + elementSize > view.length) {
+				fail("Accessor " + std::to_string(i) + " runs past its buffer view");
+			}
+		}
+		accessors.push_back(accessor);
+	}
+}
+
+void GltfLoader::loadMeshes(const JsonValue& document, std::vector<std::vector<uint32_t>>& meshPrimitives) {
+	auto findAccessor = [this](const JsonValue& index, uint32_t minComponents) {
+		uint32_t accessor = index.asUint(gltfNone);
+		if (accessor == gltfNone) {
+			return gltfNone;
+		}
+		if (accessor >= accessors.size() || accessors[accessor].componentCount < minComponents || accessors[accessor].componentCount > 4) {
+			fail("Attribute accessor " + std::to_string(accessor) + " is missing or has the wrong type");
+		}
+		return accessor;
+	};
+
+	uint64_t vertexTotal = 0;
+	uint64_t indexTotal = 0;
+	const JsonValue& meshList = document["meshes"];
+	meshPrimitives.resize(meshList.size());
+	for (size_t m = 0; m < meshList.size(); ++m) {
+		for (const JsonValue& source : meshList.at(m)["primitives"].getElements()) {
+			if (source["mode"].asUint(triangleListMode) != triangleListMode) {
+				std::cout << path << ": skipping a primitive of mesh " << m << " that isn't a triangle list.\n";
+				continue;
+			}
+
+			const JsonValue& attributes = source["attributes"];
+			PrimitiveSource sources{};
+			sources.position = findAccessor(attributes["POSITION"], 3);
+			sources.normal = findAccessor(attributes["NORMAL"], 3);
+			sources.uv = findAccessor(attributes["TEXCOORD_0"], 2);
+			sources.indices = findAccessor(source["indices"], 1);
+			if (sources.position == gltfNone) {
+				fail("Primitive of mesh " + std::to_string(m) + " has no POSITION");
+			}
+
+			uint32_t vertexCount = accessors[sources.position].count;
+			for (uint32_t attribute : { sources.normal, sources.uv }) {
+				if (attribute != gltfNone && accessors[attribute].count != vertexCount) {
+					fail("Attributes of a primitive of mesh " + std::to_string(m) + " have different counts");
+				}
+			}
+			uint32_t indexCount = sources.indices != gltfNone ? accessors[sources.indices].count : vertexCount;
+
+			GltfPrimitive primitive{};
+			primitive.firstVertex = static_cast<uint32_t>(vertexTotal);
+			primitive.vertexCount = vertexCount;
+			primitive.firstIndex = static_cast<uint32_t>(indexTotal);
+			primitive.indexCount = indexCount - indexCount % 3;
+			primitive.material = source["material"].asUint(gltfNone);
+			primitive.boundingSphere = computeBoundingSphere(accessors[sources.position]);
+			vertexTotal += primitive.vertexCount;
+			indexTotal += primitive.indexCount;
+			if (vertexTotal > UINT32_MAX || indexTotal > UINT32_MAX) {
+				fail("Scene has more than 2^32 vertices or indices");
+			}
+
+			meshPrimitives[m].push_back(static_cast<uint32_t>(primitives.size()));
+			primitives.push_back(primitive);
+			primitiveSources.push_back(sources);
+		}
+	}
+
+	vertices.resize(static_cast<size_t>(vertexTotal));
+	indices.resize(static_cast<size_t>(indexTotal));
+}
+
+void GltfLoader::loadMaterials(const JsonValue& document) {
+	for (const JsonValue& source : document["images"].getElements()) {
+		Image image;
+		image.uri = source["uri"].asString();
+		image.bufferView = source["bufferView"].asUint(gltfNone);
+		if (image.uri.empty() && image.bufferView >= bufferViews.size()) {
+			fail("Image " + std::to_string(images.size()) + " has neither a URI nor a valid buffer view");
+		}
+		images.push_back(std::move(image));
+	}
+
+	const JsonValue& textures = document["textures"];
+	for (const JsonValue& source : document["materials"].getElements()) {
+		GltfMaterial material;
+		const JsonValue& pbr = source["pbrMetallicRoughness"];
+		const JsonValue& factor = pbr["baseColorFactor"];
+		if (factor.size() == 4) {
+			material.baseColorFactor = glm::vec4(factor.at(0).asNumber(1.0), factor.at(1).asNumber(1.0), factor.at(2).asNumber(1.0), factor.at(3).asNumber(1.0));
+		}
+		uint32_t texture = pbr["baseColorTexture"]["index"].asUint(gltfNone);
+		if (texture != gltfNone) {
+			uint32_t image = textures.at(texture)["source"].asUint(gltfNone);
+			if (image == gltfNone) {
+				image = textures.at(texture)["extensions"][basisuExtension]["source"].asUint(gltfNone);
+			}
+			material.baseColorImage = image < images.size() ? image : gltfNone;
+		}
+		materials.push_back(material);
+	}
+
+	for (GltfPrimitive& primitive : primitives) {
+		if (primitive.material != gltfNone && primitive.material >= materials.size()) {
+			primitive.material = gltfNone;
+		}
+	}
+}
+
+void GltfLoader::loadNodes(const JsonValue& document, const std::vector<std::vector<uint32_t>>& meshPrimitives) {
+	const JsonValue& nodes = document["nodes"];
+	std::vector<uint32_t> roots;
+	const JsonValue& scenes = document["scenes"];
+	if (scenes.size() > 0) {
+		const JsonValue& scene = scenes.at(document["scene"].asUint(0));
+		for (const JsonValue& node : scene["nodes"].getElements()) {
+			roots.push_back(node.asUint(gltfNone));
+		}
+	}
+	else {
+		// No scene: every node nobody claims as a child is a root.
+		std::vector<bool> isChild(nodes.size(), false);
+		for (const JsonValue& node : nodes.getElements()) {
+			for (const JsonValue& child : node["children"].getElements()) {
+				if (child.asUint(gltfNone) < nodes.size()) {
+					isChild[child.asUint()] = true;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < nodes.size(); ++i) {
+			if (!isChild[i]) {
+				roots.push_back(i);
+			}
+		}
+	}
+
+	struct PendingNode {
+		uint32_t node;
+		glm::mat4 parent;
+		uint32_t depth;
+	};
+	std::vector<PendingNode> stack;
+	for (uint32_t root : roots) {
+		stack.push_back({ root, glm::mat4(1.0f), 0 });
+	}
+
+	bool anyInstance = false;
+	while (!stack.empty()) {
+		PendingNode pending = stack.back();
+		stack.pop_back();
+		if (pending.node >= nodes.size()) {
+			fail("Node index " + std::to_string(pending.node) + " is out of range");
+		}
+		if (pending.depth > maxNodeDepth) {
+			fail("Node hierarchy is too deep or cyclic");
+		}
+
+		const JsonValue& node = nodes.at(pending.node);
+		glm::mat4 world = pending.parent * readNodeTransform(node);
+		uint32_t mesh = node["mesh"].asUint(gltfNone);
+		if (mesh < meshPrimitives.size()) {
+			for (uint32_t primitive : meshPrimitives[mesh]) {
+				GltfInstance instance;
+				instance.transform = world;
+				instance.boundingSphere = transformSphere(world, primitives[primitive].boundingSphere);
+				instance.primitive = primitive;
+				instances.push_back(instance);
+
+				glm::vec3 centre(instance.boundingSphere);
+				glm::vec3 extent(instance.boundingSphere.w);
+				boundsMin = anyInstance ? glm::min(boundsMin, centre - extent) : centre - extent;
+				boundsMax = anyInstance ? glm::max(boundsMax, centre + extent) : centre + extent;
+				anyInstance = true;
+			}
+		}
+		for (const JsonValue& child : node["children"].getElements()) {
+			stack.push_back({ child.asUint(gltfNone), world, pending.depth + 1 });
+		}
+	}
+}
+
+const uint8_t* GltfLoader::getBufferViewData(uint32_t view, size_t& size) const {
+	const BufferView& bufferView = bufferViews[view];
+	size = bufferView.length;
+	return buffers[bufferView.buffer].first + bufferView.offset;
+}
+
+void GltfLoader::readElement(const Accessor& accessor, uint32_t index, float* out) const {
+	uint32_t components = std::min(accessor.componentCount, 4u);
+	if (accessor.bufferView == gltfNone) {
+		std::fill(out, out + components, 0.0f);
+		return;
+	}
+
+	const BufferView& view = bufferViews[accessor.bufferView];
+	uint32_t size = componentSize(accessor.componentType);
+	size_t stride = view.stride ? view.stride : static_cast<size_t>(size) * accessor.componentCount;
+	const uint8_t* element = buffers[view.buffer].first + view.offset + accessor.offset + stride * index;
+
+	if (accessor.componentType == 5126) {
+		memcpy(out, element, sizeof(float) * components);
+		return;
+	}
+	for (uint32_t c = 0; c < components; ++c) {
+		const uint8_t* bytes = element + c * size;
+		float value = 0.0f;
+		switch (accessor.componentType) {
+			case 5120: {
+				int8_t v = static_cast<int8_t>(bytes[0]);
+				value = accessor.normalized ? std::max(v / 127.0f, -1.0f) : v;
+				break;
+			}
+			case 5121:
+				value = accessor.normalized ? bytes[0] / 255.0f : bytes[0];
+				break;
+			case 5122: {
+				int16_t v;
+				memcpy(&v, bytes, sizeof(v));
+				value = accessor.normalized ? std::max(v / 32767.0f, -1.0f) : v;
+				break;
+			}
+			case 5123: {
+				uint16_t v;
+				memcpy(&v, bytes, sizeof(v));
+				value = accessor.normalized ? v / 65535.0f : v;
+				break;
+			}
+			case 5125: {
+				uint32_t v;
+				memcpy(&v, bytes, sizeof(v));
+				value = static_cast<float>(v);
+				break;
+			}
+		}
+		out[c] = value;
+	}
+}
+
+uint32_t GltfLoader::readIndex(const Accessor& accessor, uint32_t index) const {
+	const BufferView& view = bufferViews[accessor.bufferView];
+	uint32_t size = componentSize(accessor.componentType);
+	const uint8_t* element = buffers[view.buffer].first + view.offset + accessor.offset + static_cast<size_t>(view.stride ? view.stride : size) * index;
+	switch (accessor.componentType) {
+		case 5121:
+			return element[0];
+		case 5123: {
+			uint16_t value;
+			memcpy(&value, element, sizeof(value));
+			return value;
+		}
+		case 5125:
+			return readUint32(element);
+		default:
+			fail("Index accessors must be unsigned integers");
+	}
+}
+
+// The spec requires POSITION bounds, but exporters do leave them out; those files pay for one pass over the positions.
+glm::vec4 GltfLoader::computeBoundingSphere(const Accessor& positions) const {
+	glm::vec3 min(0.0f);
+	glm::vec3 max(0.0f);
+	if (positions.hasBounds) {
+		min = glm::vec3(positions.min[0], positions.min[1], positions.min[2]);
+		max = glm::vec3(positions.max[0], positions.max[1], positions.max[2]);
+	}
+	else {
+		for (uint32_t i = 0; i < positions.count; ++i) {
+			float position[4];
+			readElement(positions, i, position);
+			glm::vec3 point(position[0], position[1], position[2]);
+			min = i == 0 ? point : glm::min(min, point);
+			max = i == 0 ? point : glm::max(max, point);
+		}
+	}
+	return glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+}
+
+void GltfLoader::setCookedDirectory(const std::string& cookedDirectory) {
+	for (Image& image : images) {
+		if (image.bufferView == gltfNone && !isDataUri(image.uri)) {
+			image.cookedPath = findCookedAsset(cookedDirectory, (std::filesystem::path(directory) / decodeUriPath(image.uri)).string());
+		}
+	}
+}
+
+void GltfLoader::decode(JobSystem& jobSystem, JobCounter& counter, bool includeImages) {
+	uint32_t imageCount = includeImages ? static_cast<uint32_t>(images.size()) : 0;
+	totalJobs = static_cast<uint32_t>(primitives.size()) + imageCount;
+	// Images first: they are the slowest to decode, and the background queue is first in, first out.
+	for (uint32_t i = 0; i < imageCount; ++i) {
+		jobSystem.submitBackground([this, i]() { decodeImageData(i); }, &counter);
+	}
+	for (uint32_t i = 0; i < primitives.size(); ++i) {
+		jobSystem.submitBackground([this, i]() { decodePrimitiveData(i); }, &counter);
+	}
+}
+
+std::vector<std::string> GltfLoader::getExternalBufferPaths() const {
+	std::vector<std::string> paths;
+	for (const MappedFile& buffer : externalBuffers) {
+		paths.push_back(buffer.getPath());
+	}
+	return paths;
+}
+
+std::vector<GltfReadyItem> GltfLoader::takeReady() {
+	std::lock_guard<std::mutex> lock(readyMutex);
+	std::vector<GltfReadyItem> taken;
+	taken.swap(ready);
+	return taken;
+}
+
+void GltfLoader::releaseImage(uint32_t image) {
+	images[image].decoded = DecodedImage{};
+	images[image].levels = TextureLevels{};
+}
+
+DecodedImage GltfLoader::takeImage(uint32_t image) {
+	DecodedImage taken = std::move(images[image].decoded);
+	images[image].decoded = DecodedImage{};
+	return taken;
+}
+
+TextureLevels GltfLoader::takeTextureLevels(uint32_t image) {
+	TextureLevels taken = std::move(images[image].levels);
+	images[image].levels = TextureLevels{};
+	return taken;
+}
+
+void GltfLoader::markReady(GltfReadyItem item) {
+	{
+		std::lock_guard<std::mutex> lock(readyMutex);
+		ready.push_back(item);
+	}
+	finishedJobs.fetch_add(1, std::memory_order_release);
+}
+
+void GltfLoader::decodePrimitiveData(uint32_t index) {
+	CPU_PROFILE_SCOPE("decodeGltfPrimitive");
+	const GltfPrimitive& primitive = primitives[index];
+	const PrimitiveSource& sources = primitiveSources[index];
+	MeshVertex* out = vertices.data() + primitive.firstVertex;
+	uint32_t* outIndices = indices.data() + primitive.firstIndex;
+
+	// A job must not throw, so a broken primitive is reported and left as degenerate triangles that draw nothing.
+	try {
+		float element[4];
+		for (uint32_t i = 0; i < primitive.vertexCount; ++i) {
+			readElement(accessors[sources.position], i, element);
+			memcpy(out[i].position, element, sizeof(out[i].position));
+			if (sources.normal != gltfNone) {
+				readElement(accessors[sources.normal], i, element);
+				memcpy(out[i].normal, element, sizeof(out[i].normal));
+			}
+			if (sources.uv != gltfNone) {
+				readElement(accessors[sources.uv], i, element);
+				memcpy(out[i].uv, element, sizeof(out[i].uv));
+			}
+			else {
+				out[i].uv[0] = out[i].uv[1] = 0.0f;
+			}
+		}
+
+		for (uint32_t i = 0; i < primitive.indexCount; ++i) {
+			uint32_t vertex = sources.indices != gltfNone ? readIndex(accessors[sources.indices], i) : i;
+			if (vertex >= primitive.vertexCount) {
+				fail("Index " + std::to_string(vertex) + " is out of range");
+			}
+			outIndices[i] = vertex;
+		}
+
+		// Area-weighted face normals, as importObj generates them.
+		if (sources.normal == gltfNone) {
+			std::vector<glm::vec3> generated(primitive.vertexCount, glm::vec3(0.0f));
+			for (uint32_t i = 0; i < primitive.indexCount; i += 3) {
+				glm::vec3 a = glm::vec3(out[outIndices[i]].position[0], out[outIndices[i]].position[1], out[outIndices[i]].position[2]);
+				glm::vec3 b = glm::vec3(out[outIndices[i + 1]].position[0], out[outIndices[i + 1]].position[1], out[outIndices[i + 1]].position[2]);
+				glm::vec3 c = glm::vec3(out[outIndices[i + 2]].position[0], out[outIndices[i + 2]].position[1], out[outIndices[i + 2]].position[2]);
+				glm::vec3 faceNormal = glm::cross(b - a, c - a);
+				for (uint32_t corner = 0; corner < 3; ++corner) {
+					generated[outIndices[i + corner]] += faceNormal;
+				}
+			}
+			for (uint32_t i = 0; i < primitive.vertexCount; ++i) {
+				float length = glm::length(generated[i]);
+				glm::vec3 normal = length > 0.0f ? generated[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+				out[i].normal[0] = normal.x;
+				out[i].normal[1] = normal.y;
+				out[i].normal[2] = normal.z;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << path << ": primitive " << index << " failed to decode. " << e.what() << std::endl;
+		std::fill(outIndices, outIndices + primitive.indexCount, 0u);
+	}
+	markReady({ GltfReadyItem::Kind::Primitive, index });
+}
+
+void GltfLoader::decodeImageData(uint32_t index) {
+	CPU_PROFILE_SCOPE("decodeGltfImage");
+	Image& image = images[index];
+	try {
+		if (!image.cookedPath.empty() && !canSampleCookedChain(image.cookedPath)) {
+			std::cerr << path << ": image " << index << " decoded from its source, as the device can't sample " << image.cookedPath << std::endl;
+			image.cookedPath.clear();
+		}
+		if (!image.cookedPath.empty()) {
+			// Already mipmapped on disk: residency opens the chain itself.
+		}
+		else if (image.bufferView != gltfNone) {
+			size_t size = 0;
+			const uint8_t* data = getBufferViewData(image.bufferView, size);
+			decodeImageBytes(image, data, size);
+		}
+		else if (isDataUri(image.uri)) {
+			std::vector<uint8_t> data = decodeDataUri(image.uri);
+			decodeImageBytes(image, data.data(), data.size());
+		}
+		else {
+			MappedFile imageFile;
+			imageFile.open((std::filesystem::path(directory) / decodeUriPath(image.uri)).string());
+			decodeImageBytes(image, imageFile.getData(), imageFile.getSize());
+		}
+	}
+	catch (const std::exception& e) {
+		// Not fatal: whatever uses the image keeps its placeholder.
+		std::cerr << path << ": image " << index << " not loaded. " << e.what() << std::endl;
+		finishedJobs.fetch_add(1, std::memory_order_release);
+		return;
+	}
+	markReady({ GltfReadyItem::Kind::Image, index });
+}
+
+bool GltfLoader::canSampleCookedChain(const std::string& chainPath) const {
+	try {
+		MipChainFile chain;
+		chain.open(chainPath);
+		return chain.getFormat() == VK_FORMAT_R8G8B8A8_UNORM || textureFormats.supports(chain.getFormat());
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+}
+
+void GltfLoader::decodeImageBytes(Image& image, const uint8_t* data, size_t size) const {
+	if (detectImageFormat(data, size) == ImageFileFormat::Ktx2) {
+		image.levels = loadKtx2(data, size, textureFormats);
+	}
+	else {
+		image.decoded = ::decodeImage(data, size);
+	}
+}
+
+MeshData GltfLoader::toMeshData() const {
+	MeshData mesh;
+	mesh.vertices = vertices;
+	mesh.indices.reserve(indices.size());
+	for (const GltfPrimitive& primitive : primitives) {
+		if (primitive.indexCount == 0) {
+			continue;
+		}
+		MeshSubmesh submesh{};
+		submesh.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+		submesh.indexCount = primitive.indexCount;
+		for (uint32_t i = 0; i < primitive.indexCount; ++i) {
+			mesh.indices.push_back(indices[primitive.firstIndex + i] + primitive.firstVertex);
+		}
+		mesh.submeshes.push_back(submesh);
+	}
+	return mesh;
+}
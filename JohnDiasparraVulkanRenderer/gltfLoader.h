@@ -0,0 +1,199 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "imageDecoder.h"
+#include "jobSystem.h"
+#include "json.h"
+#include "ktx2Texture.h"
+#include "mappedFile.h"
+#include "meshFile.h"
+
+const uint32_t gltfNone = ~0u;
+
+// One triangle primitive, as a slice of the loader's shared vertex and index arrays. Indices are relative to
+// firstVertex, which is what an indexed draw's vertexOffset expects.
+struct GltfPrimitive {
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t material; // gltfNone uses the default material.
+	glm::vec4 boundingSphere; // Mesh space, from the POSITION accessor's bounds.
+};
+
+struct GltfMaterial {
+	glm::vec4 baseColorFactor{ 1.0f };
+	uint32_t baseColorImage = gltfNone;
+};
+
+// A primitive placed by a node. Nodes with a mesh of several primitives give one instance per primitive.
+struct GltfInstance {
+	glm::mat4 transform;
+	glm::vec4 boundingSphere; // World space.
+	uint32_t primitive;
+};
+
+// Decode jobs report each finished primitive and image through the ready queue, in completion order.
+struct GltfReadyItem {
+	enum class Kind {
+		Primitive,
+		Image
+	};
+
+	Kind kind;
+	uint32_t index;
+};
+
+/*
+	glTF Loader
+	- open() parses the JSON once and resolves everything the scene's layout depends on: buffers (GLB chunk, external
+	  files mapped rather than read, base64 data URIs), primitive sizes from accessor counts, materials and the node
+	  hierarchy. It touches no vertex data, so even a large scene's structure is known in milliseconds.
+	- Every primitive owns a pre-sized slice of one vertex and one index array, so decode() can hand each primitive and
+	  each image to its own job with no locking beyond the ready queue.
+	- Accessors of any component type, normalization and byte stride are converted to MeshVertex. Missing normals are
+	  generated; missing UVs are zero. Only triangle lists are loaded; other modes are skipped with a warning.
+	- Images are PNG (imageDecoder.h) or KTX2 (ktx2Texture.h), told apart by content. KTX2 images keep their blocks in
+	  whichever format setTextureFormats() says the device samples, transcoding in the decode job when it can't. Any
+	  image that fails to decode is reported and left out, so its users keep whatever placeholder the renderer gave them.
+	- KHR_texture_basisu is accepted. A texture's plain source is preferred, since Basis payloads can't be transcoded
+	  by this build; the KTX2 source is used when it is the only one.
+*/
+class GltfLoader {
+
+	public:
+		GltfLoader() = default;
+		GltfLoader(const GltfLoader&) = delete;
+		GltfLoader& operator=(const GltfLoader&) = delete;
+
+		void open(const std::string& path); // Throws on malformed files and on anything out of bounds.
+		// What KTX2 images may stay compressed as. Before decode(); without it every KTX2 image needs a fallback.
+		void setTextureFormats(const TextureFormatSupport& formats) { textureFormats = formats; }
+		// Image files with a copy in this cooked tree (cookedAssets.h) skip decoding, unless the copy is in a format
+		// setTextureFormats doesn't allow. Before decode().
+		void setCookedDirectory(const std::string& directory);
+		// Submits every decode job as background work, so a frame's waits on the main thread never pick one up. The
+		// loader must outlive them; wait on counter before destroying it. Tools that only want the geometry skip the
+		// images, which are usually most of the work.
+		void decode(JobSystem& jobSystem, JobCounter& counter, bool includeImages = true);
+		// Items finished since the last call.
+		std::vector<GltfReadyItem> takeReady();
+		bool isDecodeComplete() const { return finishedJobs.load(std::memory_order_acquire) == totalJobs; }
+
+		const std::string& getPath() const { return path; }
+		const std::vector<GltfPrimitive>& getPrimitives() const { return primitives; }
+		const std::vector<GltfMaterial>& getMaterials() const { return materials; }
+		const std::vector<GltfInstance>& getInstances() const { return instances; }
+		uint32_t getImageCount() const { return static_cast<uint32_t>(images.size()); }
+		// Buffer files the geometry reads besides the glTF itself, for tools that track what a mesh depends on.
+		std::vector<std::string> getExternalBufferPaths() const;
+		glm::vec3 getBoundsMin() const { return boundsMin; }
+		glm::vec3 getBoundsMax() const { return boundsMax; }
+
+		// Valid once the primitive or image has come out of takeReady().
+		const MeshVertex* getVertices(uint32_t primitive) const { return vertices.data() + primitives[primitive].firstVertex; }
+		const uint32_t* getIndices(uint32_t primitive) const { return indices.data() + primitives[primitive].firstIndex; }
+		const DecodedImage& getImage(uint32_t image) const { return images[image].decoded; }
+		// Frees the decoded pixels once they have been uploaded.
+		void releaseImage(uint32_t image);
+		// Hands the decoded pixels over, leaving the image empty.
+		DecodedImage takeImage(uint32_t image);
+		// KTX2 images decode to levels rather than pixels.
+		bool hasTextureLevels(uint32_t image) const { return !images[image].levels.levels.empty(); }
+		TextureLevels takeTextureLevels(uint32_t image);
+		// The cooked mip chain standing in for the image, or empty when it was decoded.
+		const std::string& getCookedChainPath(uint32_t image) const { return images[image].cookedPath; }
+
+		// Every primitive as a submesh of one mesh, in mesh space, for --convert-mesh. Only after decoding completes.
+		MeshData toMeshData() const;
+
+	private:
+		struct BufferView {
+			uint32_t buffer;
+			size_t offset;
+			size_t length;
+			uint32_t stride; // Zero: tightly packed.
+		};
+
+		struct Accessor {
+			uint32_t bufferView; // gltfNone: every element is zero.
+			size_t offset;
+			uint32_t componentType;
+			uint32_t componentCount;
+			uint32_t count;
+			bool normalized;
+			bool hasBounds;
+			float min[3];
+			float max[3];
+		};
+
+		// Where a primitive's vertex data comes from, kept until its decode job runs.
+		struct PrimitiveSource {
+			uint32_t position;
+			uint32_t normal;
+			uint32_t uv;
+			uint32_t indices;
+		};
+
+		struct Image {
+			std::string uri; // External file relative to the glTF, or a data URI.
+			uint32_t bufferView = gltfNone;
+			DecodedImage decoded;
+			TextureLevels levels;
+			std::string cookedPath;
+		};
+
+		std::string path;
+		std::string directory;
+		MappedFile file;
+		std::vector<MappedFile> externalBuffers;
+		std::vector<std::vector<uint8_t>> embeddedBuffers; // Decoded data URIs.
+		std::vector<std::pair<const uint8_t*, size_t>> buffers;
+		std::vector<BufferView> bufferViews;
+		std::vector<Accessor> accessors;
+
+		std::vector<GltfPrimitive> primitives;
+		std::vector<PrimitiveSource> primitiveSources;
+		std::vector<GltfMaterial> materials;
+		std::vector<GltfInstance> instances;
+		std::vector<Image> images;
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;
+		TextureFormatSupport textureFormats;
+		glm::vec3 boundsMin{ 0.0f };
+		glm::vec3 boundsMax{ 0.0f };
+
+		std::mutex readyMutex;
+		std::vector<GltfReadyItem> ready;
+		std::atomic<uint32_t> finishedJobs{ 0 };
+		uint32_t totalJobs = 0;
+
+		void loadBuffers(const JsonValue& document, const uint8_t* binChunk, size_t binSize);
+		void loadAccessors(const JsonValue& document);
+		void loadMeshes(const JsonValue& document, std::vector<std::vector<uint32_t>>& meshPrimitives);
+		void loadMaterials(const JsonValue& document);
+		void loadNodes(const JsonValue& document, const std::vector<std::vector<uint32_t>>& meshPrimitives);
+
+		const uint8_t* getBufferViewData(uint32_t view, size_t& size) const;
+		// Reads up to four components of element index, converted to float as the accessor's normalization says.
+		void readElement(const Accessor& accessor, uint32_t index, float* out) const;
+		uint32_t readIndex(const Accessor& accessor, uint32_t index) const;
+		glm::vec4 computeBoundingSphere(const Accessor& positions) const;
+
+		void decodePrimitiveData(uint32_t primitive);
+		void decodeImageData(uint32_t image);
+		void decodeImageBytes(Image& image, const uint8_t* data, size_t size) const;
+		// Cooked chains keep KTX2 blocks as stored, which this device may not sample.
+		bool canSampleCookedChain(const std::string& chainPath) const;
+		void markReady(GltfReadyItem item);
+};
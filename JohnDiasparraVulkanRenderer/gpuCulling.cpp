@@ -0,0 +1,381 @@
+#include "gpuCulling.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	// Push constants of cull.comp: bindless indices of everything the kernel touches.
+	struct CullConstants {
+		uint32_t view;
+		uint32_t instances;
+		uint32_t meshes;
+		uint32_t buckets;
+		uint32_t commands;
+		uint32_t counts;
+		uint32_t hiZ;
+	};
+
+	// Push constants of hiZ.comp: one level of the pyramid from the level above it.
+	struct HiZConstants {
+		uint32_t pyramid;
+		uint32_t sourceOffset;
+		uint32_t destinationOffset;
+		uint32_t sourceWidth;
+		uint32_t sourceHeight;
+		uint32_t destinationWidth;
+		uint32_t destinationHeight;
+	};
+
+	// The cull and Hi-Z kernels are both single-stage compute pipelines.
+	VkPipeline createComputePipeline(VkDevice device, VkPipelineCache pipelineCache, VkPipelineLayout layout, const CompiledShader& shader,
+		const VkAllocationCallbacks* callbacks) {
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = shader.spirv.size() * sizeof(uint32_t);
+		moduleInfo.pCode = shader.spirv.data();
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(device, &moduleInfo, callbacks, &shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shader module for " + shader.path + ".");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = shader.entryPoint.c_str();
+		pipelineInfo.layout = layout;
+
+		VkPipeline pipeline;
+		VkResult result = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, callbacks, &pipeline);
+		vkDestroyShaderModule(device, shaderModule, callbacks);
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline for " + shader.path + ".");
+		}
+		return pipeline;
+	}
+}
+
+bool GpuCuller::isSupported(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& features) {
+	VkPhysicalDeviceVulkan12Features supported{};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features2{};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features2.pNext = &supported;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+	return supported.drawIndirectCount && features.multiDrawIndirect && features.drawIndirectFirstInstance;
+}
+
+void GpuCuller::enableFeatures(VkPhysicalDeviceFeatures& features, VkPhysicalDeviceVulkan12Features& vulkan12Features) {
+	features.multiDrawIndirect = VK_TRUE;
+	features.drawIndirectFirstInstance = VK_TRUE; // firstInstance carries the instance index to the vertex shader.
+	vulkan12Features.drawIndirectCount = VK_TRUE;
+}
+
+void GpuCuller::init(VkDevice device, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless, uint32_t framesInFlight, bool validate, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->bindless = &bindless;
+	this->validate = validate;
+	this->callbacks = callbacks;
+
+	frames.resize(framesInFlight);
+	for (FrameBuffers& frame : frames) {
+		frame.view = createBuffer(sizeof(CullView), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::CpuToGpu, frame.viewAllocation);
+		frame.viewIndex = bindless.addBuffer(frame.view);
+	}
+}
+
+void GpuCuller::destroy() {
+	releaseFrameOutputs();
+	releaseScene();
+	clearHiZ();
+	for (FrameBuffers& frame : frames) {
+		bindless->releaseBuffer(frame.viewIndex);
+		destroyBuffer(frame.view, frame.viewAllocation);
+	}
+	frames.clear();
+	vkDestroyPipeline(device, pipeline, callbacks);
+	pipeline = VK_NULL_HANDLE;
+}
+
+void GpuCuller::createPipeline(LayoutCache& layoutCache, VkPipelineCache pipelineCache, const CompiledShader& shader) {
+	CPU_PROFILE_SCOPE("createCullPipeline");
+	pipelineLayout = layoutCache.getPipelineLayout(std::vector<ShaderReflection>{ reflectShader(shader) });
+
+	pipeline = createComputePipeline(device, pipelineCache, pipelineLayout, shader, callbacks);
+}
+
+void GpuCuller::setScene(const std::vector<CullInstance>& instances, const std::vector<CullMesh>& meshes, uint32_t bucketCount) {
+	if (instances.empty() || meshes.empty() || bucketCount == 0) {
+		throw std::runtime_error("GPU culler needs at least one instance, mesh and bucket.");
+	}
+	releaseFrameOutputs();
+	releaseScene();
+
+	this->instances = instances;
+	this->meshes = meshes;
+	meshVersion = 1;
+	this->bucketCount = bucketCount;
+	buckets = makeCullBuckets(instances, bucketCount);
+
+	// Written once, so the GPU reads them straight out of host-visible memory rather than via a staging copy.
+	VkDeviceSize instanceBytes = sizeof(CullInstance) * instances.size();
+	instanceBuffer = createBuffer(instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::CpuToGpu, instanceAllocation);
+	memcpy(instanceAllocation->mappedData, instances.data(), instanceBytes);
+	instanceIndex = bindless->addBuffer(instanceBuffer);
+
+	VkDeviceSize bucketBytes = sizeof(CullBucket) * buckets.size();
+	bucketBuffer = createBuffer(bucketBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::CpuToGpu, bucketAllocation);
+	memcpy(bucketAllocation->mappedData, buckets.data(), bucketBytes);
+	bucketIndex = bindless->addBuffer(bucketBuffer);
+
+	MemoryUsage outputUsage = validate ? MemoryUsage::GpuToCpu : MemoryUsage::GpuOnly;
+	VkDeviceSize commandBytes = sizeof(VkDrawIndexedIndirectCommand) * getCullCommandCount(buckets);
+	for (FrameBuffers& frame : frames) {
+		frame.commands = createBuffer(commandBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, outputUsage, frame.commandAllocation);
+		frame.counts = createBuffer(sizeof(uint32_t) * bucketCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			outputUsage, frame.countAllocation);
+		frame.commandIndex = bindless->addBuffer(frame.commands);
+		frame.countIndex = bindless->addBuffer(frame.counts);
+		frame.culled = false;
+
+		// Filled in by the slot's first beginFrame.
+		frame.meshes = createBuffer(sizeof(CullMesh) * meshes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::CpuToGpu, frame.meshAllocation);
+		frame.meshIndex = bindless->addBuffer(frame.meshes);
+		frame.meshVersion = 0;
+	}
+}
+
+void GpuCuller::updateMesh(uint32_t index, const CullMesh& mesh) {
+	meshes[index] = mesh;
+	++meshVersion;
+}
+
+void GpuCuller::setHiZ(uint32_t pyramidIndex, uint32_t width, uint32_t height, const float* hostPyramid) {
+	hiZIndex = pyramidIndex;
+	hiZWidth = width;
+	hiZHeight = height;
+	hostHiZ = hostPyramid;
+	hasHiZ = true;
+}
+
+void GpuCuller::clearHiZ() {
+	hostHiZ = nullptr;
+	hasHiZ = false;
+}
+
+void GpuCuller::beginFrame(uint32_t slot, const glm::mat4& viewProjection) {
+	FrameBuffers& frame = frames[slot];
+	CullView view = makeCullView(viewProjection, static_cast<uint32_t>(instances.size()), bucketCount);
+	if (hasHiZ) {
+		view.hiZLevels = hiZLevelCount(hiZWidth, hiZHeight);
+		view.hiZWidth = hiZWidth;
+		view.hiZHeight = hiZHeight;
+	}
+	memcpy(frame.viewAllocation->mappedData, &view, sizeof(view));
+	frame.lastView = view;
+	frame.hiZIndex = hasHiZ ? hiZIndex : 0;
+	frame.lastHiZ = hasHiZ ? hostHiZ : nullptr;
+
+	if (frame.meshVersion != meshVersion) {
+		memcpy(frame.meshAllocation->mappedData, meshes.data(), sizeof(CullMesh) * meshes.size());
+		frame.meshVersion = meshVersion;
+		if (validate) {
+			frame.lastMeshes = meshes;
+		}
+	}
+	frame.culled = true;
+}
+
+void GpuCuller::recordResetCounts(VkCommandBuffer commandBuffer, uint32_t slot) const {
+	vkCmdFillBuffer(commandBuffer, frames[slot].counts, 0, VK_WHOLE_SIZE, 0);
+}
+
+void GpuCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t slot) const {
+	const FrameBuffers& frame = frames[slot];
+	CullConstants constants{ frame.viewIndex, instanceIndex, frame.meshIndex, bucketIndex, frame.commandIndex, frame.countIndex, frame.hiZIndex };
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, (static_cast<uint32_t>(instances.size()) + groupSize - 1) / groupSize, 1, 1);
+}
+
+void GpuCuller::recordDraws(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t bucket) const {
+	const FrameBuffers& frame = frames[slot];
+	const CullBucket& range = buckets[bucket];
+	if (range.capacity == 0) {
+		return;
+	}
+	VkDeviceSize commandOffset = sizeof(VkDrawIndexedIndirectCommand) * range.firstCommand;
+	vkCmdDrawIndexedIndirectCount(commandBuffer, frame.commands, commandOffset, frame.counts, sizeof(uint32_t) * bucket,
+		range.capacity, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuCuller::validateFrame(uint32_t slot) const {
+	CPU_PROFILE_SCOPE("validateCulling");
+	const FrameBuffers& frame = frames[slot];
+	if (!validate || !frame.culled) {
+		return;
+	}
+
+	CullResult actual;
+	const uint32_t* counts = static_cast<const uint32_t*>(frame.countAllocation->mappedData);
+	const VkDrawIndexedIndirectCommand* commands = static_cast<const VkDrawIndexedIndirectCommand*>(frame.commandAllocation->mappedData);
+	actual.counts.assign(counts, counts + bucketCount);
+	actual.commands.assign(commands, commands + getCullCommandCount(buckets));
+
+	CullResult expected = cullInstancesReference(frame.lastView, instances, frame.lastMeshes, buckets, frame.lastHiZ);
+	std::string difference = compareCullResults(expected, actual, buckets);
+	if (!difference.empty()) {
+		throw std::runtime_error("GPU culling disagrees with the CPU reference: " + difference + ".");
+	}
+}
+
+VkBuffer GpuCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, GpuAllocation*& allocation) const {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(device, &bufferInfo, callbacks, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create GPU culling buffer.");
+	}
+	allocation = allocator->allocateForBuffer(buffer, memoryUsage);
+	return buffer;
+}
+
+void GpuCuller::destroyBuffer(VkBuffer& buffer, GpuAllocation*& allocation) const {
+	if (buffer == VK_NULL_HANDLE) {
+		return;
+	}
+	vkDestroyBuffer(device, buffer, callbacks);
+	allocator->free(allocation);
+	buffer = VK_NULL_HANDLE;
+	allocation = nullptr;
+}
+
+void GpuCuller::releaseScene() {
+	if (instanceBuffer == VK_NULL_HANDLE) {
+		return;
+	}
+	bindless->releaseBuffer(instanceIndex);
+	bindless->releaseBuffer(bucketIndex);
+	destroyBuffer(instanceBuffer, instanceAllocation);
+	destroyBuffer(bucketBuffer, bucketAllocation);
+}
+
+void GpuCuller::releaseFrameOutputs() {
+	for (FrameBuffers& frame : frames) {
+		if (frame.commands == VK_NULL_HANDLE) {
+			continue;
+		}
+		bindless->releaseBuffer(frame.commandIndex);
+		bindless->releaseBuffer(frame.countIndex);
+		bindless->releaseBuffer(frame.meshIndex);
+		destroyBuffer(frame.commands, frame.commandAllocation);
+		destroyBuffer(frame.counts, frame.countAllocation);
+		destroyBuffer(frame.meshes, frame.meshAllocation);
+	}
+}
+
+void HiZBuilder::init(VkDevice device, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless, VkExtent2D extent, uint32_t framesInFlight, bool hostVisible,
+	const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->bindless = &bindless;
+	this->extent = extent;
+	this->hostVisible = hostVisible;
+	this->callbacks = callbacks;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = sizeof(float) * hiZLevelOffset(extent.width, extent.height, hiZLevelCount(extent.width, extent.height));
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	pyramids.resize(framesInFlight + 1);
+	for (Pyramid& pyramid : pyramids) {
+		if (vkCreateBuffer(device, &bufferInfo, callbacks, &pyramid.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create Hi-Z pyramid buffer.");
+		}
+		pyramid.allocation = allocator.allocateForBuffer(pyramid.buffer, hostVisible ? MemoryUsage::GpuToCpu : MemoryUsage::GpuOnly);
+		pyramid.index = bindless.addBuffer(pyramid.buffer);
+	}
+}
+
+void HiZBuilder::destroy() {
+	for (Pyramid& pyramid : pyramids) {
+		bindless->releaseBuffer(pyramid.index);
+		vkDestroyBuffer(device, pyramid.buffer, callbacks);
+		allocator->free(pyramid.allocation);
+	}
+	pyramids.clear();
+	vkDestroyPipeline(device, pipeline, callbacks);
+	pipeline = VK_NULL_HANDLE;
+}
+
+void HiZBuilder::createPipeline(LayoutCache& layoutCache, VkPipelineCache pipelineCache, const CompiledShader& shader) {
+	CPU_PROFILE_SCOPE("createHiZPipeline");
+	pipelineLayout = layoutCache.getPipelineLayout(std::vector<ShaderReflection>{ reflectShader(shader) });
+	pipeline = createComputePipeline(device, pipelineCache, pipelineLayout, shader, callbacks);
+}
+
+const float* HiZBuilder::getHostData(uint32_t pyramid) const {
+	return hostVisible ? static_cast<const float*>(pyramids[pyramid].allocation->mappedData) : nullptr;
+}
+
+void HiZBuilder::recordBuild(VkCommandBuffer commandBuffer, VkImage depth, uint32_t pyramid) const {
+	const Pyramid& target = pyramids[pyramid];
+
+	// D32_SFLOAT copies out as tightly packed floats, which is exactly level 0.
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, depth, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.buffer, 1, &region);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout);
+
+	// Each level reads the one before it, so every dispatch waits for the write in front of it.
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+	VkDependencyInfo dependency{};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency.memoryBarrierCount = 1;
+	dependency.pMemoryBarriers = &barrier;
+
+	uint32_t levels = hiZLevelCount(extent.width, extent.height);
+	for (uint32_t level = 1; level < levels; ++level) {
+		vkCmdPipelineBarrier2(commandBuffer, &dependency);
+
+		HiZConstants constants{};
+		constants.pyramid = target.index;
+		constants.sourceOffset = static_cast<uint32_t>(hiZLevelOffset(extent.width, extent.height, level - 1));
+		constants.destinationOffset = static_cast<uint32_t>(hiZLevelOffset(extent.width, extent.height, level));
+		constants.sourceWidth = std::max(1u, extent.width >> (level - 1));
+		constants.sourceHeight = std::max(1u, extent.height >> (level - 1));
+		constants.destinationWidth = std::max(1u, extent.width >> level);
+		constants.destinationHeight = std::max(1u, extent.height >> level);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, (constants.destinationWidth + groupSize - 1) / groupSize, (constants.destinationHeight + groupSize - 1) / groupSize, 1);
+
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	}
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "bindlessDescriptors.h"
+#include "cullingReference.h"
+#include "gpuMemoryAllocator.h"
+#include "shaderCompiler.h"
+#include "shaderReflection.h"
+
+/*
+	GPU Culler
+	- GPU-driven submission: instance and mesh tables live in storage buffers, cull.comp tests every instance and
+	  appends a draw command for each survivor, and each material bucket is one vkCmdDrawIndexedIndirectCount.
+	  CPU cost per frame no longer depends on how many objects there are.
+	- Every buffer is reached through the bindless set, so the kernel and vertex shaders only take indices.
+	- Each bucket's commands get their own range, sized to the instances in that bucket (makeCullBuckets), so the
+	  command buffers hold one command per instance however many buckets there are.
+	- Command and count buffers are per frame slot. Validation mode makes them host visible and checks each completed
+	  frame against cullInstancesReference.
+	- Occlusion needs a Hi-Z pyramid from the previous frame's depth (HiZBuilder, then setHiZ before beginFrame).
+	  Without one only frustum culling runs.
+	- The mesh table is per frame slot, so streamed meshes can be swapped in (updateMesh) while earlier frames still
+	  read the old entries. A slot's copy is refreshed in beginFrame only when the table has changed since.
+*/
+class GpuCuller {
+
+	public:
+		static const uint32_t groupSize = 64; // local_size_x in cull.comp.
+
+		// drawIndirectCount is optional in 1.2; firstInstance and multi-draw are optional 1.0 features.
+		static bool isSupported(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& features);
+		static void enableFeatures(VkPhysicalDeviceFeatures& features, VkPhysicalDeviceVulkan12Features& vulkan12Features);
+
+		void init(VkDevice device, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless, uint32_t framesInFlight, bool validate, const VkAllocationCallbacks* callbacks);
+		void destroy();
+
+		// Through the shared layout cache, so the layout has the bindless set at set 0 like every other pipeline.
+		void createPipeline(LayoutCache& layoutCache, VkPipelineCache pipelineCache, const CompiledShader& shader);
+
+		// Uploads the tables. Only while no frame that culls is in flight.
+		void setScene(const std::vector<CullInstance>& instances, const std::vector<CullMesh>& meshes, uint32_t bucketCount);
+		// Takes effect from the next beginFrame of each slot.
+		void updateMesh(uint32_t index, const CullMesh& mesh);
+		// The pyramid stays the caller's; pyramidIndex is its bindless index. Both take effect from the next beginFrame.
+		// hostPyramid is the mapped pyramid when it is host visible. Validation needs it; culling itself doesn't.
+		void setHiZ(uint32_t pyramidIndex, uint32_t width, uint32_t height, const float* hostPyramid = nullptr);
+		void clearHiZ();
+
+		// Per frame, after the slot's previous frame has completed.
+		void beginFrame(uint32_t slot, const glm::mat4& viewProjection);
+		void recordResetCounts(VkCommandBuffer commandBuffer, uint32_t slot) const;
+		void recordCull(VkCommandBuffer commandBuffer, uint32_t slot) const;
+		void recordDraws(VkCommandBuffer commandBuffer, uint32_t slot, uint32_t bucket) const;
+
+		VkBuffer getCommandBuffer(uint32_t slot) const { return frames[slot].commands; }
+		VkBuffer getCountBuffer(uint32_t slot) const { return frames[slot].counts; }
+		uint32_t getInstanceBufferIndex() const { return instanceIndex; }
+		uint32_t getMeshBufferIndex(uint32_t slot) const { return frames[slot].meshIndex; }
+		uint32_t getBucketCount() const { return bucketCount; }
+		bool isValidating() const { return validate; }
+
+		// Validation mode only. Compares the slot's last completed frame with the CPU reference and throws on a mismatch.
+		void validateFrame(uint32_t slot) const;
+
+	private:
+		struct FrameBuffers {
+			VkBuffer view = VK_NULL_HANDLE;
+			GpuAllocation* viewAllocation = nullptr;
+			VkBuffer commands = VK_NULL_HANDLE;
+			GpuAllocation* commandAllocation = nullptr;
+			VkBuffer counts = VK_NULL_HANDLE;
+			GpuAllocation* countAllocation = nullptr;
+			VkBuffer meshes = VK_NULL_HANDLE;
+			GpuAllocation* meshAllocation = nullptr;
+			uint32_t viewIndex = 0;
+			uint32_t commandIndex = 0;
+			uint32_t countIndex = 0;
+			uint32_t meshIndex = 0;
+			uint64_t meshVersion = 0; // meshVersion of the table when it was last copied in.
+			CullView lastView{}; // What the slot's last frame culled with, for validation.
+			uint32_t hiZIndex = 0; // Pyramid the slot's last frame culled against, when lastView has Hi-Z levels.
+			const float* lastHiZ = nullptr;
+			std::vector<CullMesh> lastMeshes; // Validation only.
+			bool culled = false;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		GpuMemoryAllocator* allocator = nullptr;
+		BindlessDescriptors* bindless = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		bool validate = false;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE; // Owned by the layout cache.
+
+		std::vector<CullInstance> instances; // CPU copies, for the reference in validation mode. Meshes also feed the slot tables.
+		std::vector<CullMesh> meshes;
+		uint64_t meshVersion = 0;
+		uint32_t bucketCount = 0;
+		std::vector<CullBucket> buckets;
+		VkBuffer instanceBuffer = VK_NULL_HANDLE;
+		GpuAllocation* instanceAllocation = nullptr;
+		uint32_t instanceIndex = 0;
+		VkBuffer bucketBuffer = VK_NULL_HANDLE;
+		GpuAllocation* bucketAllocation = nullptr;
+		uint32_t bucketIndex = 0;
+
+		uint32_t hiZIndex = 0;
+		uint32_t hiZWidth = 0;
+		uint32_t hiZHeight = 0;
+		bool hasHiZ = false;
+		const float* hostHiZ = nullptr;
+
+		std::vector<FrameBuffers> frames;
+
+		VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, GpuAllocation*& allocation) const;
+		void destroyBuffer(VkBuffer& buffer, GpuAllocation*& allocation) const;
+		void releaseScene();
+		void releaseFrameOutputs();
+};
+
+/*
+	Hi-Z Builder
+	- Builds the pyramids GpuCuller::setHiZ takes from a frame's depth buffer: a copy of the depth into level 0, then
+	  one hiZ.comp dispatch per level, laid out as hiZLevelOffset describes.
+	- Culling reads the pyramid the previous frame built, so there is one more pyramid than frames in flight. Frame F
+	  builds pyramid F % count and frame F + 1 culls against it; the next frame to build it is F + count, which starts
+	  after F + 1 has completed and been validated.
+	- Validation mode keeps the pyramids host visible so the CPU reference can cull against the same depths.
+*/
+class HiZBuilder {
+
+	public:
+		static const uint32_t groupSize = 8; // local_size_x and local_size_y in hiZ.comp.
+
+		void init(VkDevice device, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless, VkExtent2D extent, uint32_t framesInFlight, bool hostVisible,
+			const VkAllocationCallbacks* callbacks);
+		void destroy();
+		void createPipeline(LayoutCache& layoutCache, VkPipelineCache pipelineCache, const CompiledShader& shader);
+
+		// The pyramid frame frameIndex builds.
+		uint32_t getPyramid(uint64_t frameIndex) const { return static_cast<uint32_t>(frameIndex % pyramids.size()); }
+		VkBuffer getBuffer(uint32_t pyramid) const { return pyramids[pyramid].buffer; }
+		uint32_t getBufferIndex(uint32_t pyramid) const { return pyramids[pyramid].index; }
+		// Null unless the pyramids are host visible.
+		const float* getHostData(uint32_t pyramid) const;
+		uint32_t getWidth() const { return extent.width; }
+		uint32_t getHeight() const { return extent.height; }
+
+		// depth is a D32_SFLOAT image of the builder's extent in TRANSFER_SRC_OPTIMAL. Barriers between the levels are
+		// recorded here; the ones around the build are the caller's.
+		void recordBuild(VkCommandBuffer commandBuffer, VkImage depth, uint32_t pyramid) const;
+
+	private:
+		struct Pyramid {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			GpuAllocation* allocation = nullptr;
+			uint32_t index = 0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		GpuMemoryAllocator* allocator = nullptr;
+		BindlessDescriptors* bindless = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		VkExtent2D extent{};
+		bool hostVisible = false;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE; // Owned by the layout cache.
+		std::vector<Pyramid> pyramids;
+};
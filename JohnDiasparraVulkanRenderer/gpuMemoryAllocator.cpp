@@ -0,0 +1,431 @@
+#include "gpuMemoryAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	// Smallest placement granule. Matches the largest minUniformBufferOffsetAlignment in the wild.
+	const VkDeviceSize minPlacementSize = 256;
+	const VkDeviceSize largeHeapBlockSize = 256ull * 1024 * 1024;
+	const VkDeviceSize smallHeapThreshold = 1024ull * 1024 * 1024;
+
+	uint32_t popCount(uint32_t value) {
+		uint32_t count = 0;
+		for (; value; value &= value - 1) {
+			count++;
+		}
+		return count;
+	}
+}
+
+void GpuMemoryAllocator::init(VkDevice device, const DeviceCapabilityProfile& profile, VkPhysicalDevice physicalDevice, bool memoryBudgetEnabled, const VkAllocationCallbacks* allocationCallbacks) {
+	this->device = device;
+	this->physicalDevice = physicalDevice;
+	this->memoryBudgetEnabled = memoryBudgetEnabled;
+	this->allocationCallbacks = allocationCallbacks;
+	memoryProperties = profile.memoryProperties;
+	maxMemoryAllocationCount = profile.properties.limits.maxMemoryAllocationCount;
+	heapAllocatedBytes.assign(memoryProperties.memoryHeapCount, 0);
+}
+
+void GpuMemoryAllocator::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!allocations.empty()) {
+		std::cerr << "GPU memory allocator destroyed with " << allocations.size() << " live allocations.\n";
+	}
+	for (auto& [pointer, allocation] : allocations) {
+		if (!allocation->block) {
+			freeDeviceMemory(allocation->memoryTypeIndex, allocation->size, allocation->memory);
+		}
+	}
+	for (auto& [key, pool] : pools) {
+		for (auto& block : pool) {
+			freeDeviceMemory(block->memoryTypeIndex, block->placement.getTotalSize(), block->memory);
+		}
+	}
+	allocations.clear();
+	pools.clear();
+}
+
+GpuAllocation* GpuMemoryAllocator::allocateForBuffer(VkBuffer buffer, MemoryUsage usage) {
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+	vkGetBufferMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	GpuAllocation* allocation = allocate(requirements.memoryRequirements, usage, true, dedicated, buffer, VK_NULL_HANDLE, false);
+
+	if (vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset) != VK_SUCCESS) {
+		free(allocation);
+		throw std::runtime_error("Failed to bind buffer memory.");
+	}
+	return allocation;
+}
+
+GpuAllocation* GpuMemoryAllocator::allocateForAliasing(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear) {
+	// Marked under the allocator's lock, so no defragmentation plan ever sees it unmarked.
+	return allocate(requirements, usage, linear, false, VK_NULL_HANDLE, VK_NULL_HANDLE, true);
+}
+
+GpuAllocation* GpuMemoryAllocator::allocateForImage(VkImage image, MemoryUsage usage) {
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+
+	VkImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+	vkGetImageMemoryRequirements2(device, &requirementsInfo, &requirements);
+
+	// Large render targets are where drivers ask for dedicated memory, usually to enable compression.
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	GpuAllocation* allocation = allocate(requirements.memoryRequirements, usage, false, dedicated, VK_NULL_HANDLE, image, false);
+
+	if (vkBindImageMemory(device, image, allocation->memory, allocation->offset) != VK_SUCCESS) {
+		free(allocation);
+		throw std::runtime_error("Failed to bind image memory.");
+	}
+	return allocation;
+}
+
+GpuAllocation* GpuMemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear, bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage, bool aliased) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, usage);
+	VkDeviceSize blockSize = preferredBlockSize(memoryTypeIndex);
+
+	auto allocation = std::make_unique<GpuAllocation>();
+	allocation->memoryTypeIndex = memoryTypeIndex;
+	allocation->size = requirements.size;
+	allocation->aliased = aliased;
+
+	if (dedicated || requirements.size > blockSize / 2) {
+		VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+		dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedInfo.buffer = dedicatedBuffer;
+		dedicatedInfo.image = dedicatedImage;
+
+		allocation->memory = allocateDeviceMemory(memoryTypeIndex, requirements.size, &dedicatedInfo, &allocation->mappedData);
+		return track(std::move(allocation));
+	}
+
+	std::vector<std::unique_ptr<MemoryBlock>>& pool = pools[{ memoryTypeIndex, linear }];
+
+	MemoryBlock* block = nullptr;
+	std::optional<uint64_t> offset;
+	for (auto& candidate : pool) {
+		offset = candidate->placement.allocate(requirements.size, requirements.alignment);
+		if (offset.has_value()) {
+			block = candidate.get();
+			break;
+		}
+	}
+
+	if (!block) {
+		auto newBlock = std::make_unique<MemoryBlock>(blockSize, minPlacementSize);
+		newBlock->memoryTypeIndex = memoryTypeIndex;
+		newBlock->linear = linear;
+		newBlock->memory = allocateDeviceMemory(memoryTypeIndex, blockSize, nullptr, &newBlock->mappedData);
+		offset = newBlock->placement.allocate(requirements.size, requirements.alignment);
+		if (!offset.has_value()) {
+			freeDeviceMemory(memoryTypeIndex, blockSize, newBlock->memory);
+			throw std::runtime_error("Allocation alignment exceeds the memory block size.");
+		}
+		block = newBlock.get();
+		pool.push_back(std::move(newBlock));
+	}
+
+	allocation->memory = block->memory;
+	allocation->offset = offset.value();
+	allocation->block = block;
+	if (block->mappedData) {
+		allocation->mappedData = static_cast<char*>(block->mappedData) + allocation->offset;
+	}
+	block->allocations.insert(allocation.get());
+	return track(std::move(allocation));
+}
+
+GpuAllocation* GpuMemoryAllocator::track(std::unique_ptr<GpuAllocation> allocation) {
+	GpuAllocation* pointer = allocation.get();
+	allocations[pointer] = std::move(allocation);
+	return pointer;
+}
+
+void GpuMemoryAllocator::free(GpuAllocation* allocation) {
+	if (!allocation) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = allocations.find(allocation);
+	if (it == allocations.end()) {
+		throw std::runtime_error("Freeing a GPU allocation this allocator does not own.");
+	}
+
+	if (MemoryBlock* block = allocation->block) {
+		block->placement.free(allocation->offset);
+		block->allocations.erase(allocation);
+		releaseEmptyBlocks(pools[{ block->memoryTypeIndex, block->linear }]);
+	}
+	else {
+		freeDeviceMemory(allocation->memoryTypeIndex, allocation->size, allocation->memory);
+	}
+	allocations.erase(it);
+}
+
+void GpuMemoryAllocator::releaseEmptyBlocks(std::vector<std::unique_ptr<MemoryBlock>>& pool) {
+	// Keep one empty block around so a free/allocate pattern at a block boundary doesn't thrash vkAllocateMemory.
+	bool keptOne = false;
+	for (auto it = pool.begin(); it != pool.end();) {
+		MemoryBlock& block = **it;
+		if (!block.placement.isEmpty()) {
+			++it;
+		}
+		else if (!keptOne) {
+			keptOne = true;
+			++it;
+		}
+		else {
+			freeDeviceMemory(block.memoryTypeIndex, block.placement.getTotalSize(), block.memory);
+			it = pool.erase(it);
+		}
+	}
+}
+
+uint32_t GpuMemoryAllocator::findMemoryType(uint32_t typeBits, MemoryUsage usage) const {
+	VkMemoryPropertyFlags required = 0;
+	VkMemoryPropertyFlags preferred = 0;
+	switch (usage) {
+		case MemoryUsage::GpuOnly:
+			preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			break;
+		case MemoryUsage::CpuToGpu:
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			break;
+		case MemoryUsage::GpuToCpu:
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+	}
+
+	// Among types that have every required flag, take the one matching the most preferred flags.
+	int32_t bestType = -1;
+	uint32_t bestScore = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if (!(typeBits & (1u << i)) || (flags & required) != required) {
+			continue;
+		}
+		uint32_t score = popCount(flags & preferred) + 1;
+		if (score > bestScore) {
+			bestScore = score;
+			bestType = static_cast<int32_t>(i);
+		}
+	}
+	if (bestType < 0) {
+		throw std::runtime_error("Failed to find a suitable memory type.");
+	}
+	return static_cast<uint32_t>(bestType);
+}
+
+VkDeviceSize GpuMemoryAllocator::preferredBlockSize(uint32_t memoryTypeIndex) const {
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	if (heapSize >= smallHeapThreshold) {
+		return largeHeapBlockSize;
+	}
+	// Small heaps (e.g. the 256 MiB host visible device local window) get an eighth each, rounded down to a power of two.
+	VkDeviceSize blockSize = nextPowerOfTwo(std::max<VkDeviceSize>(heapSize / 8, minPlacementSize));
+	return blockSize > heapSize / 8 ? blockSize / 2 : blockSize;
+}
+
+VkDeviceMemory GpuMemoryAllocator::allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, const void* pNext, void** mappedData) {
+	if (deviceMemoryCount >= maxMemoryAllocationCount) {
+		throw std::runtime_error("Reached maxMemoryAllocationCount.");
+	}
+
+	uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	HeapBudget heapBudget = queryHeapBudget(heapIndex);
+	if (heapBudget.usage + size > heapBudget.budget) {
+		throw std::runtime_error("GPU memory budget exceeded for heap " + std::to_string(heapIndex) + ".");
+	}
+
+	VkMemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.pNext = pNext;
+	allocateInfo.allocationSize = size;
+	allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocateInfo, allocationCallbacks, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate device memory.");
+	}
+
+	*mappedData = nullptr;
+	if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		// Host visible memory stays mapped for its whole lifetime; mapping is not free and is never needed twice.
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS) {
+			vkFreeMemory(device, memory, allocationCallbacks);
+			throw std::runtime_error("Failed to map device memory.");
+		}
+	}
+
+	heapAllocatedBytes[heapIndex] += size;
+	deviceMemoryCount++;
+	return memory;
+}
+
+void GpuMemoryAllocator::freeDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory) {
+	vkFreeMemory(device, memory, allocationCallbacks);
+	heapAllocatedBytes[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] -= size;
+	deviceMemoryCount--;
+}
+
+HeapBudget GpuMemoryAllocator::queryHeapBudget(uint32_t heapIndex) {
+	HeapBudget heapBudget{};
+	heapBudget.allocatedBlockBytes = heapAllocatedBytes[heapIndex];
+
+	if (memoryBudgetEnabled) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+
+		heapBudget.budget = budgetProperties.heapBudget[heapIndex];
+		heapBudget.usage = budgetProperties.heapUsage[heapIndex];
+	}
+	else {
+		// Without the extension, assume 80% of the heap is ours to use.
+		heapBudget.budget = memoryProperties.memoryHeaps[heapIndex].size * 8 / 10;
+		heapBudget.usage = heapAllocatedBytes[heapIndex];
+	}
+	return heapBudget;
+}
+
+std::vector<HeapBudget> GpuMemoryAllocator::getHeapBudgets() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<HeapBudget> budgets;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+		budgets.push_back(queryHeapBudget(i));
+	}
+	return budgets;
+}
+
+void GpuMemoryAllocator::printStats() {
+	std::vector<HeapBudget> budgets = getHeapBudgets();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cout << "GPU Memory: " << allocations.size() << " allocations in " << deviceMemoryCount << " VkDeviceMemory objects\n";
+	for (size_t i = 0; i < budgets.size(); ++i) {
+		std::cout << "\t" << "Heap " << i << ": " << budgets[i].allocatedBlockBytes / (1024 * 1024) << " MiB allocated, "
+			<< budgets[i].usage / (1024 * 1024) << " / " << budgets[i].budget / (1024 * 1024) << " MiB budget\n";
+	}
+}
+
+std::vector<DefragmentationMove> GpuMemoryAllocator::planDefragmentation(VkDeviceSize maxBytesToMove) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::vector<DefragmentationMove> moves;
+	VkDeviceSize bytesMoved = 0;
+
+	for (auto& [key, pool] : pools) {
+		if (pool.size() < 2) {
+			continue;
+		}
+
+		// Empty the least used blocks into the most used ones, so whole blocks become free.
+		std::vector<MemoryBlock*> blocks;
+		for (auto& block : pool) {
+			blocks.push_back(block.get());
+		}
+		std::sort(blocks.begin(), blocks.end(), [](MemoryBlock* a, MemoryBlock* b) {
+			return a->placement.getUsedSize() < b->placement.getUsedSize();
+		});
+
+		std::set<MemoryBlock*> destinations;
+		for (size_t source = 0; source + 1 < blocks.size(); ++source) {
+			MemoryBlock* sourceBlock = blocks[source];
+			if (destinations.count(sourceBlock)) {
+				continue;
+			}
+			// A block holding aliased memory can't be emptied, so moving its other allocations would free nothing.
+			bool pinned = std::any_of(sourceBlock->allocations.begin(), sourceBlock->allocations.end(), [](const GpuAllocation* allocation) {
+				return allocation->aliased;
+			});
+			if (pinned) {
+				continue;
+			}
+
+			for (GpuAllocation* allocation : sourceBlock->allocations) {
+				// The buddy block size is a power of two at least as large as the original alignment, so it is safe to reuse.
+				VkDeviceSize placedSize = sourceBlock->placement.allocationSize(allocation->offset);
+				if (bytesMoved + placedSize > maxBytesToMove) {
+					return moves;
+				}
+
+				for (size_t destination = blocks.size() - 1; destination > source; --destination) {
+					MemoryBlock* destinationBlock = blocks[destination];
+					std::optional<uint64_t> offset = destinationBlock->placement.allocate(placedSize, 1);
+					if (offset.has_value()) {
+						moves.push_back({ allocation, destinationBlock->memory, offset.value(), destinationBlock });
+						destinations.insert(destinationBlock);
+						bytesMoved += placedSize;
+						break;
+					}
+				}
+			}
+		}
+	}
+	return moves;
+}
+
+void GpuMemoryAllocator::completeDefragmentation(const std::vector<DefragmentationMove>& moves) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (const DefragmentationMove& move : moves) {
+		GpuAllocation* allocation = move.allocation;
+		allocation->block->placement.free(allocation->offset);
+		allocation->block->allocations.erase(allocation);
+
+		// The destination range was already reserved when the move was planned.
+		allocation->memory = move.dstMemory;
+		allocation->offset = move.dstOffset;
+		allocation->block = move.dstBlock;
+		allocation->mappedData = move.dstBlock->mappedData ? static_cast<char*>(move.dstBlock->mappedData) + move.dstOffset : nullptr;
+		move.dstBlock->allocations.insert(allocation);
+	}
+
+	for (auto& [key, pool] : pools) {
+		releaseEmptyBlocks(pool);
+	}
+}
+
+void GpuMemoryAllocator::cancelDefragmentation(const std::vector<DefragmentationMove>& moves) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (const DefragmentationMove& move : moves) {
+		move.dstBlock->placement.free(move.dstOffset);
+	}
+
+	for (auto& [key, pool] : pools) {
+		releaseEmptyBlocks(pool);
+	}
+}
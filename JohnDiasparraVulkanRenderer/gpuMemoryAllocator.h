@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "buddyAllocator.h"
+#include "deviceProfile.h"
+
+enum class MemoryUsage {
+	GpuOnly, // Device local, never touched by the CPU.
+	CpuToGpu, // Host visible and coherent, for uploads and per-frame constants.
+	GpuToCpu // Host visible, cached where possible, for readback.
+};
+
+struct GpuAllocation;
+
+// One VkDeviceMemory that many allocations are placed in.
+struct MemoryBlock {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	uint32_t memoryTypeIndex = 0;
+	bool linear = true;
+	void* mappedData = nullptr;
+	BuddyAllocator placement;
+	std::set<GpuAllocation*> allocations;
+
+	MemoryBlock(VkDeviceSize size, VkDeviceSize minPlacementSize) : placement(size, minPlacementSize) {}
+};
+
+// Owned by the allocator. Pointers stay valid until free(), and defragmentation updates memory/offset in place.
+struct GpuAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t memoryTypeIndex = 0;
+	void* mappedData = nullptr; // Already offset to this allocation. Null unless the memory is host visible.
+	MemoryBlock* block = nullptr; // Null for dedicated allocations.
+	bool aliased = false; // From allocateForAliasing. Several resources are bound into it, so defragmentation never moves it.
+};
+
+struct HeapBudget {
+	VkDeviceSize budget; // How much this process may use before the OS starts evicting or failing.
+	VkDeviceSize usage; // Driver-reported usage when VK_EXT_memory_budget is on, otherwise what we allocated ourselves.
+	VkDeviceSize allocatedBlockBytes; // What this allocator holds from vkAllocateMemory.
+};
+
+struct DefragmentationMove {
+	GpuAllocation* allocation;
+	VkDeviceMemory dstMemory;
+	VkDeviceSize dstOffset;
+	MemoryBlock* dstBlock;
+};
+
+/*
+	GPU Memory Allocator
+	- Sub-allocates from large VkDeviceMemory blocks per memory type with buddy placement, so a scene costs a handful of
+	  vkAllocateMemory calls instead of one per resource and stays well under maxMemoryAllocationCount.
+	- Linear (buffer) and optimal (image) resources live in separate pools, so bufferImageGranularity never needs padding.
+	- Resources the driver wants dedicated, or that would take more than half a block, get their own VkDeviceMemory.
+	- Defragmentation is a two step plan/complete: the caller recreates, binds and copies each moved resource between the two.
+	  A plan reserves its destinations, so one that is abandoned must be cancelled to give them back.
+*/
+class GpuMemoryAllocator {
+
+	public:
+		void init(VkDevice device, const DeviceCapabilityProfile& profile, VkPhysicalDevice physicalDevice, bool memoryBudgetEnabled, const VkAllocationCallbacks* allocationCallbacks = nullptr);
+		void destroy();
+
+		// Allocate and bind in one step.
+		GpuAllocation* allocateForBuffer(VkBuffer buffer, MemoryUsage usage);
+		GpuAllocation* allocateForImage(VkImage image, MemoryUsage usage);
+		// Unbound memory for resources that alias each other; the caller binds them at offsets of its choosing.
+		// Moving it would mean rebinding every one of them, so defragmentation leaves it and its block where they are.
+		GpuAllocation* allocateForAliasing(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear);
+		void free(GpuAllocation* allocation);
+
+		std::vector<HeapBudget> getHeapBudgets();
+		void printStats();
+
+		// Moves allocations out of the emptiest blocks into fuller ones, up to maxBytesToMove.
+		std::vector<DefragmentationMove> planDefragmentation(VkDeviceSize maxBytesToMove);
+		// Call once every move's resource has been rebound and copied and the GPU has finished with the old ones.
+		void completeDefragmentation(const std::vector<DefragmentationMove>& moves);
+		// Releases the destinations of a plan that won't be completed. Its allocations stay where they are.
+		void cancelDefragmentation(const std::vector<DefragmentationMove>& moves);
+
+	private:
+		struct PoolKey {
+			uint32_t memoryTypeIndex;
+			bool linear;
+			bool operator<(const PoolKey& other) const {
+				return memoryTypeIndex != other.memoryTypeIndex ? memoryTypeIndex < other.memoryTypeIndex : linear < other.linear;
+			}
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* allocationCallbacks = nullptr;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		uint32_t maxMemoryAllocationCount = 0;
+		bool memoryBudgetEnabled = false;
+
+		std::mutex mutex;
+		std::map<PoolKey, std::vector<std::unique_ptr<MemoryBlock>>> pools;
+		std::unordered_map<GpuAllocation*, std::unique_ptr<GpuAllocation>> allocations;
+		std::vector<VkDeviceSize> heapAllocatedBytes;
+		uint32_t deviceMemoryCount = 0;
+
+		GpuAllocation* allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear, bool dedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage, bool aliased);
+		uint32_t findMemoryType(uint32_t typeBits, MemoryUsage usage) const;
+		VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const;
+		VkDeviceMemory allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, const void* pNext, void** mappedData);
+		void freeDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory);
+		void releaseEmptyBlocks(std::vector<std::unique_ptr<MemoryBlock>>& pool);
+		HeapBudget queryHeapBudget(uint32_t heapIndex);
+		GpuAllocation* track(std::unique_ptr<GpuAllocation> allocation);
+};
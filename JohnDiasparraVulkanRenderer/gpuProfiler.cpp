@@ -0,0 +1,194 @@
+#include "gpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+void GpuProfiler::init(VkDevice device, const DeviceCapabilityProfile& profile, uint32_t queueFamilyIndex, uint32_t framesInFlight, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->callbacks = callbacks;
+
+	uint32_t validBits = profile.queueFamilies[queueFamilyIndex].timestampValidBits;
+	enabled = validBits != 0 && profile.properties.limits.timestampPeriod > 0.0f;
+	if (!enabled) {
+		std::cout << "GPU Profiler: graphics queue has no timestamp support, disabled.\n";
+		return;
+	}
+
+	timestampPeriodNs = profile.properties.limits.timestampPeriod;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	for (uint32_t i = 0; i < framesInFlight; ++i) {
+		auto frame = std::make_unique<FrameQueries>();
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = maxScopesPerFrame * 2;
+		if (vkCreateQueryPool(device, &poolInfo, callbacks, &frame->pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool.");
+		}
+		frames.push_back(std::move(frame));
+	}
+}
+
+void GpuProfiler::destroy() {
+	for (auto& frame : frames) {
+		vkDestroyQueryPool(device, frame->pool, callbacks);
+	}
+	frames.clear();
+	enabled = false;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+	if (!enabled) {
+		return;
+	}
+
+	currentSlot = slot;
+	FrameQueries& frame = *frames[slot];
+	collect(frame);
+
+	// Recorded first in the primary, so it lands before any scope in this frame's secondaries.
+	vkCmdResetQueryPool(commandBuffer, frame.pool, 0, maxScopesPerFrame * 2);
+	frame.scopeCount.store(0, std::memory_order_relaxed);
+	frame.pending = true;
+}
+
+void GpuProfiler::collectAll() {
+	for (auto& frame : frames) {
+		collect(*frame);
+	}
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name) {
+	if (!enabled) {
+		return;
+	}
+
+	FrameQueries& frame = *frames[currentSlot];
+	uint32_t scope = frame.scopeCount.fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t depth;
+	{
+		std::lock_guard<std::mutex> lock(scopeMutex);
+		std::vector<uint32_t>& stack = openScopes[commandBuffer];
+		depth = static_cast<uint32_t>(stack.size());
+		stack.push_back(scope);
+	}
+
+	// Past the limit the scope still balances its endScope, it just isn't measured.
+	if (scope < maxScopesPerFrame) {
+		frame.scopes[scope] = { name, depth };
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.pool, scope * 2);
+	}
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer) {
+	if (!enabled) {
+		return;
+	}
+
+	uint32_t scope;
+	{
+		std::lock_guard<std::mutex> lock(scopeMutex);
+		std::vector<uint32_t>& stack = openScopes[commandBuffer];
+		if (stack.empty()) {
+			throw std::runtime_error("GPU profiler endScope without a matching beginScope.");
+		}
+		scope = stack.back();
+		stack.pop_back();
+		if (stack.empty()) {
+			openScopes.erase(commandBuffer);
+		}
+	}
+
+	if (scope < maxScopesPerFrame) {
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frames[currentSlot]->pool, scope * 2 + 1);
+	}
+}
+
+void GpuProfiler::collect(FrameQueries& frame) {
+	if (!frame.pending) {
+		return;
+	}
+	frame.pending = false;
+
+	uint32_t scopeCount = std::min(frame.scopeCount.load(std::memory_order_relaxed), maxScopesPerFrame);
+	if (scopeCount == 0) {
+		return;
+	}
+
+	// Value/availability pairs. A scope in a pass that was skipped this frame is simply unavailable.
+	std::vector<uint64_t> results(scopeCount * 2 * 2);
+	vkGetQueryPoolResults(device, frame.pool, 0, scopeCount * 2, results.size() * sizeof(uint64_t), results.data(),
+		2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	for (uint32_t scope = 0; scope < scopeCount; ++scope) {
+		const uint64_t* begin = &results[scope * 4];
+		const uint64_t* end = &results[scope * 4 + 2];
+		if (begin[1] == 0 || end[1] == 0) {
+			continue;
+		}
+
+		uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+		double milliseconds = static_cast<double>(ticks) * timestampPeriodNs / 1000000.0;
+
+		const ScopeRecord& record = frame.scopes[scope];
+		auto inserted = history.emplace(record.name, PassHistory{});
+		PassHistory& pass = inserted.first->second;
+		if (inserted.second) {
+			pass.depth = record.depth;
+			pass.samples.reserve(historySize);
+			passOrder.push_back(record.name);
+		}
+
+		if (pass.samples.size() < historySize) {
+			pass.samples.push_back(milliseconds);
+		}
+		else {
+			pass.samples[pass.next] = milliseconds;
+		}
+		pass.next = (pass.next + 1) % historySize;
+		pass.lastMs = milliseconds;
+	}
+}
+
+std::vector<GpuPassStats> GpuProfiler::getPassStats() const {
+	std::vector<GpuPassStats> stats;
+	for (const std::string& name : passOrder) {
+		const PassHistory& pass = history.at(name);
+
+		std::vector<double> sorted = pass.samples;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double sample : sorted) {
+			total += sample;
+		}
+		size_t p99Index = static_cast<size_t>(std::ceil(0.99 * sorted.size())) - 1;
+
+		GpuPassStats passStats{};
+		passStats.name = name;
+		passStats.depth = pass.depth;
+		passStats.samples = static_cast<uint32_t>(sorted.size());
+		passStats.lastMs = pass.lastMs;
+		passStats.minMs = sorted.front();
+		passStats.avgMs = total / sorted.size();
+		passStats.p99Ms = sorted[p99Index];
+		stats.push_back(passStats);
+	}
+	return stats;
+}
+
+void GpuProfiler::printSummary() const {
+	if (!enabled || passOrder.empty()) {
+		return;
+	}
+
+	std::cout << "GPU Pass Times (last " << historySize << " frames):\n";
+	for (const GpuPassStats& pass : getPassStats()) {
+		std::cout << "\t" << std::string(pass.depth * 2, ' ') << pass.name << ": min " << pass.minMs << " ms, avg " << pass.avgMs
+			<< " ms, p99 " << pass.p99Ms << " ms (" << pass.samples << " samples)\n";
+	}
+}
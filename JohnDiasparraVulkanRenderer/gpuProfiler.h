@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "deviceProfile.h"
+
+struct GpuPassStats {
+	std::string name;
+	uint32_t depth; // Nesting within the command buffer the scope was recorded in.
+	uint32_t samples;
+	double lastMs;
+	double minMs;
+	double avgMs;
+	double p99Ms;
+};
+
+/*
+	GPU Profiler
+	- Timestamp queries around named scopes. Each frame-in-flight slot has its own query pool, so results are read
+	  when the slot comes round again, by which point the frame scheduler has already waited for it: no stalls.
+	- Scopes nest per command buffer and can be opened from any recording thread at once.
+	- Every pass keeps a rolling window of samples for min/avg/p99.
+	- Disabled (every call a no-op) when the graphics queue has no timestamp support.
+*/
+class GpuProfiler {
+
+	public:
+		static const uint32_t maxScopesPerFrame = 128;
+		static const uint32_t historySize = 256;
+
+		void init(VkDevice device, const DeviceCapabilityProfile& profile, uint32_t queueFamilyIndex, uint32_t framesInFlight, const VkAllocationCallbacks* callbacks);
+		void destroy();
+		bool isEnabled() const { return enabled; }
+
+		// Call on the slot's primary command buffer right after FrameScheduler::beginFrame. Collects the results of the
+		// frame that last used this slot, then resets its queries.
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+		// Collects every slot with outstanding results. Only valid once the GPU is idle.
+		void collectAll();
+
+		void beginScope(VkCommandBuffer commandBuffer, const char* name); // name must outlive the profiler (a literal).
+		void endScope(VkCommandBuffer commandBuffer);
+
+		std::vector<GpuPassStats> getPassStats() const;
+		void printSummary() const;
+
+	private:
+		struct ScopeRecord {
+			const char* name;
+			uint32_t depth;
+		};
+
+		struct FrameQueries {
+			VkQueryPool pool = VK_NULL_HANDLE;
+			ScopeRecord scopes[maxScopesPerFrame];
+			std::atomic<uint32_t> scopeCount{ 0 };
+			bool pending = false;
+		};
+
+		struct PassHistory {
+			uint32_t depth = 0;
+			std::vector<double> samples; // Ring buffer of the last historySize samples.
+			size_t next = 0;
+			double lastMs = 0.0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		bool enabled = false;
+		double timestampPeriodNs = 1.0;
+		uint64_t timestampMask = ~0ull;
+
+		std::vector<std::unique_ptr<FrameQueries>> frames;
+		uint32_t currentSlot = 0;
+
+		std::mutex scopeMutex; // Guards openScopes.
+		std::unordered_map<VkCommandBuffer, std::vector<uint32_t>> openScopes;
+
+		std::map<std::string, PassHistory> history;
+		std::vector<std::string> passOrder; // First-seen order, which is recording order.
+
+		void collect(FrameQueries& frame);
+};
+
+// Opens a GPU scope for the lifetime of the object.
+class GpuScope {
+
+	public:
+		GpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name) : profiler(profiler), commandBuffer(commandBuffer) {
+			profiler.beginScope(commandBuffer, name);
+		}
+		~GpuScope() { profiler.endScope(commandBuffer); }
+		GpuScope(const GpuScope&) = delete;
+		GpuScope& operator=(const GpuScope&) = delete;
+
+	private:
+		GpuProfiler& profiler;
+		VkCommandBuffer commandBuffer;
+};
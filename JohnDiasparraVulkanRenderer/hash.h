@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. Not cryptographic, but stable across runs and platforms, which is what on-disk cache keys and
+// checksums need (std::hash gives no such guarantee).
+const uint64_t fnv1aOffsetBasis = 0xcbf29ce484222325ull;
+
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = fnv1aOffsetBasis) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& text, uint64_t hash = fnv1aOffsetBasis) {
+	return fnv1a64(text.data(), text.size(), hash);
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t hash = fnv1aOffsetBasis) {
+	return fnv1a64(&value, sizeof(T), hash);
+}
+
+inline std::string toHex(const uint8_t* bytes, size_t count) {
+	static const char digits[] = "0123456789abcdef";
+	std::string hex;
+	hex.reserve(count * 2);
+	for (size_t i = 0; i < count; ++i) {
+		hex.push_back(digits[bytes[i] >> 4]);
+		hex.push_back(digits[bytes[i] & 0xF]);
+	}
+	return hex;
+}
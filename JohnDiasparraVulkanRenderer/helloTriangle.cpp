@@ -5,14 +5,60 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstdio>
 
 #include <vector>
 #include <map>
 #include <optional>
+#include <cstring>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <chrono>
+#include <cctype>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "deviceProfile.h"
+#include "deviceQueues.h"
+#include "gpuMemoryAllocator.h"
+#include "hostAllocator.h"
+#include "offscreenTarget.h"
+#include "frameScheduler.h"
+#include "renderGraph.h"
+#include "jobSystem.h"
+#include "pipelineCache.h"
+#include "shaderCompiler.h"
+#include "shaderReflection.h"
+#include "bindlessDescriptors.h"
+#include "gpuCulling.h"
+#include "meshFile.h"
+#include "objImport.h"
+#include "gltfLoader.h"
+#include "sceneStreamer.h"
+#include "textureResidency.h"
+#include "uploadManager.h"
+#include "shaderHotReload.h"
+#include "gpuProfiler.h"
+#include "cookedAssets.h"
+#include "cpuProfiler.h"
+#include "startupTimeline.h"
 
 const uint32_t winResX = 800;
 const uint32_t winResY = 600;
 
+
+// Capability snapshots of every physical device seen, so selection doesn't re-query the driver each launch.
+const char* deviceProfileCacheDir = "cache/deviceProfiles";
+const char* pipelineCacheDir = "cache/pipelines";
+const char* shaderDir = "shaders";
+const char* shaderCacheDir = "cache/shaders";
+const char* textureCacheDir = "cache/textures";
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -23,6 +69,52 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// Must match the vertex inputs of triangle.vert; buildGraphicsPipeline checks the reflected stride against it.
+struct Vertex {
+	float position[2];
+	float color[3];
+};
+
+const std::vector<ShaderRequest> triangleShaders = {
+	{ "triangle.vert", ShaderStage::Vertex },
+	{ "triangle.frag", ShaderStage::Fragment }
+};
+
+const std::vector<ShaderRequest> meshShaderRequests = {
+	{ "mesh.vert", ShaderStage::Vertex },
+	{ "mesh.frag", ShaderStage::Fragment }
+};
+
+const std::vector<ShaderRequest> cullShaderRequests = {
+	{ "cull.comp", ShaderStage::Compute },
+	{ "hiZ.comp", ShaderStage::Compute }
+};
+
+const std::vector<Vertex> triangleVertices = {
+	{ { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } }
+};
+
+const std::vector<uint16_t> triangleIndices = { 0, 1, 2 };
+
+// Must match FrameConstants in common.glsl.
+struct TriangleConstants {
+	float phase;
+	uint32_t instances; // Bindless index of the culler's instance buffer.
+};
+
+// Must match SceneConstants in scene.glsl.
+struct SceneConstants {
+	glm::mat4 viewProjection;
+	uint32_t instances;
+	uint32_t meshes; // Bindless index of the frame slot's mesh table.
+	uint32_t textureFeedback; // Bindless index of the frame slot's texture feedback buffer.
+};
+
+// No single depth format is required everywhere; this is the one every desktop driver supports.
+const VkFormat sceneDepthFormat = VK_FORMAT_D32_SFLOAT;
+
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
 	const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
 
@@ -45,66 +137,409 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 	}
 }
 
+// Command line switches. Defaults give the interactive windowed renderer.
+struct RendererOptions {
+	bool headless = false; // No GLFW, no surface: frames go to an offscreen image and are read back.
+	uint32_t frameCount = 0; // Stop after this many frames. Zero runs until the window closes (headless defaults to 1).
+	std::string outputDirectory; // Headless only. Read back frames are written here as PPM when set.
+	uint32_t framesInFlight = 2; // How far the CPU may run ahead of the GPU.
+	bool printFrameStats = false; // Print CPU time, latency and interval of every frame as it completes.
+	uint32_t workerThreads = 0; // Job system workers on top of the main thread. Zero uses every hardware thread.
+	bool hotReload = false; // Watch shader sources and rebuild pipelines when they change.
+	std::string tracePath; // Write a Chrome trace of CPU scopes here at exit. Profiling is off when empty.
+	bool verbose = false; // List instance extensions and queue family choices during startup.
+	uint32_t instanceGrid = 1; // Draw an N x N grid of triangles through the GPU culling path. One fills the screen as before.
+	bool validateCulling = false; // Check every frame's GPU culling output against the CPU reference.
+	std::string convertMeshInput; // Offline mode: convert this OBJ or glTF to a mesh file and exit without starting Vulkan.
+	std::string convertMeshOutput;
+	std::string scenePath; // Stream this glTF scene or converted mesh file in and draw it instead of the triangle grid.
+	uint32_t textureBudgetMB = 256; // Device memory the scene's streamed texture levels may occupy.
+	std::optional<glm::uvec2> pickPixel; // With --scene, report the instance under this pixel on the first frame. Windowed, clicks pick too.
+	std::string cookedDirectory; // AssetCooker's output for the working directory: shaders, OBJ scenes and glTF images load from it.
+};
+
+RendererOptions parseOptions(int argc, char** argv) {
+	RendererOptions options;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (argument == "--headless") {
+			options.headless = true;
+		}
+		else if (argument == "--frames" && hasValue) {
+			options.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--output" && hasValue) {
+			options.outputDirectory = argv[++i];
+		}
+		else if (argument == "--frames-in-flight" && hasValue) {
+			options.framesInFlight = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (argument == "--frame-stats") {
+			options.printFrameStats = true;
+		}
+		else if (argument == "--worker-threads" && hasValue) {
+			options.workerThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--hot-reload") {
+			options.hotReload = true;
+		}
+		else if (argument == "--trace" && hasValue) {
+			options.tracePath = argv[++i];
+		}
+		else if (argument == "--verbose") {
+			options.verbose = true;
+		}
+		else if (argument == "--instance-grid" && hasValue) {
+			options.instanceGrid = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (argument == "--validate-culling") {
+			options.validateCulling = true;
+		}
+		else if (argument == "--scene" && hasValue) {
+			options.scenePath = argv[++i];
+		}
+		else if (argument == "--texture-budget" && hasValue) {
+			options.textureBudgetMB = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (argument == "--pick" && i + 2 < argc) {
+			uint32_t x = static_cast<uint32_t>(std::stoul(argv[++i]));
+			options.pickPixel = glm::uvec2(x, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (argument == "--cooked" && hasValue) {
+			options.cookedDirectory = argv[++i];
+		}
+		else if (argument == "--convert-mesh" && i + 2 < argc) {
+			options.convertMeshInput = argv[++i];
+			options.convertMeshOutput = argv[++i];
+		}
+		else {
+			throw std::runtime_error("Unknown or incomplete argument: " + argument
+				+ "\nUsage: JohnDiasparraVulkanRenderer [--headless] [--frames N] [--output DIR] [--frames-in-flight N] [--frame-stats] [--worker-threads N] [--hot-reload] [--trace FILE] [--verbose] [--instance-grid N] [--validate-culling] [--scene FILE.gltf|FILE.glb|FILE.mesh|FILE.obj] [--texture-budget MB] [--pick X Y] [--cooked DIR] [--convert-mesh IN.obj|IN.gltf|IN.glb OUT.mesh]");
+		}
+	}
+
+	if (options.headless && options.frameCount == 0) {
+		options.frameCount = 1;
+	}
+	if (!options.cookedDirectory.empty() && options.hotReload) {
+		throw std::runtime_error("--hot-reload compiles shader sources, so it can't be combined with --cooked.");
+	}
+	// Only the cooker reads OBJ, so an OBJ scene is drawn from its cooked mesh. glTF scenes are still streamed from
+	// the glTF, since a mesh file keeps neither node transforms nor materials; their images come from the cooked tree.
+	if (!options.cookedDirectory.empty() && std::filesystem::path(options.scenePath).extension() == ".obj") {
+		std::string cookedPath = findCookedAsset(options.cookedDirectory, options.scenePath);
+		if (cookedPath.empty()) {
+			throw std::runtime_error("No cooked mesh for " + options.scenePath + " in " + options.cookedDirectory + ".");
+		}
+		options.scenePath = cookedPath;
+	}
+	return options;
+}
+
+// Everything a draw needs from one build of a shader program. Hot reload replaces it as a unit.
+struct GraphicsPipeline {
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout layout = VK_NULL_HANDLE; // Owned by the layout cache.
+	VkShaderStageFlags pushConstantStages = 0;
+};
+
 class HelloTriangleApplication {
 
 	public:
+		explicit HelloTriangleApplication(const RendererOptions& options) : options(options) {}
+
 		// Application Life-Cycle
 		void run() {
-			initWindow();
-			initVulkan();
+			if (!options.tracePath.empty()) {
+				CpuProfiler::enable();
+			}
+			CpuProfiler::setThreadName("Main");
+
+			initVulkan(); // Also creates the window, alongside the instance.
 			mainLoop();
 			cleanup();
+
+			if (!options.tracePath.empty()) {
+				CpuProfiler::disable();
+				if (CpuProfiler::writeChromeTrace(options.tracePath)) {
+					std::cout << "CPU trace written to " << options.tracePath << "\n";
+				}
+				else {
+					std::cerr << "Failed to write CPU trace to " << options.tracePath << std::endl;
+				}
+			}
 		}
 
 	private:
-		GLFWwindow* window;
+		StartupTimeline startup; // First member, so its clock starts as close to launch as the application can see.
+		RendererOptions options;
+		TrackingHostAllocator hostAllocator; // Passed as pAllocator to every vkCreate*/vkDestroy* so driver host memory is accounted for.
+		GLFWwindow* window = nullptr;
 		VkInstance instance; // Vulkan Instance is the connection between an application and the vulkan library.
 		VkDebugUtilsMessengerEXT debugMessenger;
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE; // Implicitly destroyed in cleanup. No manual cleanup needed.
+		DeviceCapabilityProfile physicalDeviceProfile;
+		TextureFormatSupport textureFormats;
 		VkDevice device;
-		VkQueue graphicsQueue;
-
-		struct QueueFamilyIndicies {
-			std::optional<uint32_t> graphicsFamily;
-
-			bool isComplete() {
-				return graphicsFamily.has_value();
-			}
-		};
+		DeviceQueues queues; // Graphics, compute and transfer queues. All submission goes through this.
+		GpuMemoryAllocator gpuAllocator; // Every buffer and image gets its memory from here, never from vkAllocateMemory directly.
+		bool memoryBudgetEnabled = false;
+		UploadManager uploads; // Staged, batched copies into device local memory on the transfer queue.
+		PipelineCache pipelineCache; // Every pipeline is created through this so compiles carry over between launches.
+		ShaderCompiler shaderCompiler{ shaderDir, shaderCacheDir, !enableValidationLayers }; // Debug builds keep debug info in the SPIR-V.
+		std::vector<CompiledShader> shaders;
+		LayoutCache layoutCache; // Descriptor set and pipeline layouts, generated from shader reflection and shared between pipelines.
+		BindlessDescriptors bindless; // Set 0 of every pipeline layout: all textures and storage buffers, addressed by index.
+		std::vector<CompiledShader> cullShaders;
+		GpuCuller culler; // Turns the instance table into indirect draws on the GPU each frame.
+		HiZBuilder hiZBuilder; // Only with --scene: each frame's depth, reduced for the next frame's occlusion culling.
+		GraphicsPipeline triangle;
+		std::vector<CompiledShader> meshShaders;
+		GraphicsPipeline scenePipeline; // Only with --scene.
+		std::unique_ptr<GltfLoader> sceneLoader;
+		std::unique_ptr<MeshFile> sceneMesh; // Instead of sceneLoader when --scene names a mesh file. Mapped until cleanup.
+		SceneStreamer sceneStreamer; // Uploads the scene on the transfer queue while frames render with placeholders.
+		TextureResidency textureResidency; // The scene's texture levels, streamed in and out by what frames sample.
+		JobCounter sceneDecodeJobs;
+		std::optional<glm::uvec2> pendingPick; // Window pixel, set by --pick and by clicks.
+		std::unique_ptr<ShaderHotReloader> shaderHotReloader;
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		GpuAllocation* vertexAllocation = nullptr;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		GpuAllocation* indexAllocation = nullptr;
+
+		// Until a swapchain exists every frame is rendered offscreen. Headless mode also copies each one out.
+		OffscreenImage colorTarget;
+		ReadbackRing readbackRing;
+		FrameScheduler frameScheduler;
+		std::vector<RenderGraphTransients> graphTransients; // One per frame slot, so transient images never cross frames in flight.
+		GpuProfiler gpuProfiler; // Per-pass GPU times from timestamp queries, summarised at exit.
+		std::unique_ptr<JobSystem> jobSystem; // Created before the instance so any init stage can fan out work.
+		std::vector<VkExtensionProperties> availableInstanceExtensions;
+		std::vector<VkLayerProperties> availableInstanceLayers;
 
 		void initWindow() {
+			CPU_PROFILE_SCOPE("initWindow");
 			glfwInit();
 			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Tells GLFW not to create in the OpenGL context.
 			glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Disables resizable window.
 
 			window = glfwCreateWindow(winResX, winResY, "Vulkan Render Window", nullptr, nullptr);
+			glfwSetWindowUserPointer(window, this);
+			glfwSetMouseButtonCallback(window, [](GLFWwindow* window, int button, int action, int) {
+				if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+					double x, y;
+					glfwGetCursorPos(window, &x, &y);
+					// Picked in drawFrame, against the camera of the frame the click lands in.
+					static_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window))->pendingPick = glm::uvec2(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+				}
+			});
 		}
 
 		void initVulkan() {
-			createInstance();
-			setupDebugMessenger();
-			pickPhysicalDevice();
-			createLogicalDevice();
+			CPU_PROFILE_SCOPE("initVulkan");
+			jobSystem = std::make_unique<JobSystem>(options.workerThreads);
+
+			// Shader compiles only need the source files, so they run behind everything up to pipeline creation.
+			JobCounter shaderJobs;
+			submitStartupJob(shaderJobs, "Compile shaders", [this]() { compileShaders(); });
+			if (!options.scenePath.empty() && std::filesystem::path(options.scenePath).extension() == ".mesh") {
+				// Only the header is read; the streams are copied out of the mapping once frames are running.
+				submitStartupJob(shaderJobs, "Map mesh file", [this]() {
+					sceneMesh = std::make_unique<MeshFile>();
+					sceneMesh->open(options.scenePath);
+				});
+			}
+			else if (!options.scenePath.empty()) {
+				// Parsing only lays the scene out; the vertex and image data is decoded once frames are running.
+				submitStartupJob(shaderJobs, "Parse scene", [this]() {
+					sceneLoader = std::make_unique<GltfLoader>();
+					sceneLoader->open(options.scenePath);
+				});
+			}
+			runAlongside(shaderJobs, [this]() { createDeviceObjects(); });
+			std::vector<CompiledShader> allShaders = shaders;
+			allShaders.insert(allShaders.end(), meshShaders.begin(), meshShaders.end());
+			allShaders.insert(allShaders.end(), cullShaders.begin(), cullShaders.end());
+			ShaderCompiler::printReport(allShaders);
+
+			layoutCache.init(device, hostAllocator.callbacks(HostAllocationArena::Device));
+			layoutCache.reserveSet(BindlessDescriptors::set, bindless.getSetLayout(), bindless.getBindings());
+
+			// Pipeline creation is the slow part of a cold start and needs none of the buffers or frame resources.
+			JobCounter pipelineJobs;
+			submitStartupJob(pipelineJobs, "Build pipelines", [this]() {
+				triangle = buildGraphicsPipeline(shaders, sizeof(Vertex), VK_FORMAT_UNDEFINED);
+				if (hasScene()) {
+					scenePipeline = buildGraphicsPipeline(meshShaders, sizeof(MeshVertex), sceneDepthFormat);
+				}
+				culler.createPipeline(layoutCache, pipelineCache.getCache(), cullShaders[0]);
+				if (hasScene()) {
+					hiZBuilder.createPipeline(layoutCache, pipelineCache.getCache(), cullShaders[1]);
+				}
+			});
+			runAlongside(pipelineJobs, [this]() {
+				timeStartupStage("Create frame resources", [this]() {
+					createVertexBuffer();
+					createIndexBuffer();
+					createScene();
+					createFrameResources();
+				});
+			});
+			if (options.hotReload) {
+				startShaderHotReload();
+			}
+			// Last, so the decode jobs don't compete with anything the first frame is waiting for.
+			if (sceneLoader) {
+				sceneLoader->setTextureFormats(textureFormats);
+				if (!options.cookedDirectory.empty()) {
+					sceneLoader->setCookedDirectory(options.cookedDirectory);
+				}
+				sceneLoader->decode(*jobSystem, sceneDecodeJobs);
+			}
+		}
+
+		// Instance through logical device, with the window and file reads overlapped wherever the dependencies allow.
+		void createDeviceObjects() {
+			// The first loader call pays for loading the drivers, so enumeration overlaps the window. GLFW windows can
+			// only be created on the main thread, which is why that is the half that stays here.
+			JobCounter instanceJobs;
+			submitStartupJob(instanceJobs, "Enumerate instance support", [this]() { enumerateInstanceSupport(); });
+			runAlongside(instanceJobs, [this]() {
+				if (!options.headless) {
+					timeStartupStage("Create window", [this]() { initWindow(); });
+				}
+			});
+
+			timeStartupStage("Create instance", [this]() {
+				createInstance();
+				setupDebugMessenger();
+			});
+			timeStartupStage("Pick physical device", [this]() { pickPhysicalDevice(); });
+
+			// The cache file is named after the device, so it can be read as soon as one is picked.
+			JobCounter cacheJobs;
+			submitStartupJob(cacheJobs, "Load pipeline cache", [this]() { pipelineCache.load(physicalDeviceProfile, pipelineCacheDir); });
+			runAlongside(cacheJobs, [this]() {
+				timeStartupStage("Create logical device", [this]() { createLogicalDevice(); });
+			});
+
+			gpuAllocator.init(device, physicalDeviceProfile, physicalDevice, memoryBudgetEnabled, hostAllocator.callbacks(HostAllocationArena::Device));
+			uploads.init(device, queues, gpuAllocator, UploadManager::defaultRingSize, hostAllocator.callbacks(HostAllocationArena::Device));
+			pipelineCache.init(device, hostAllocator.callbacks(HostAllocationArena::Device));
+			bindless.init(device, physicalDevice, hostAllocator.callbacks(HostAllocationArena::Device));
+			culler.init(device, gpuAllocator, bindless, options.framesInFlight, options.validateCulling, hostAllocator.callbacks(HostAllocationArena::Device));
+			// The scene is still being parsed alongside this, so the option says whether there will be one.
+			if (!options.scenePath.empty()) {
+				hiZBuilder.init(device, gpuAllocator, bindless, { winResX, winResY }, options.framesInFlight, options.validateCulling,
+					hostAllocator.callbacks(HostAllocationArena::Device));
+			}
+		}
+
+		void timeStartupStage(const char* name, const std::function<void()>& stage) {
+			StartupStage timing(startup, name);
+			stage();
+		}
+
+		// In the background, so a wait on this thread can't pick a stage up and serialise it behind the main thread's own.
+		void submitStartupJob(JobCounter& jobs, const char* name, std::function<void()> job) {
+			jobSystem->submitBackground([this, name, job = std::move(job)]() { timeStartupStage(name, job); }, &jobs);
+		}
+
+		// Runs work on this thread while the jobs run on the workers, then rethrows the first failure from either side.
+		// The jobs still reference the counter, so they are waited for even when work throws.
+		void runAlongside(JobCounter& jobs, const std::function<void()>& work) {
+			try {
+				work();
+			}
+			catch (...) {
+				try {
+					jobSystem->wait(jobs);
+				}
+				catch (...) {
+					// Work's own failure is the one reported.
+				}
+				throw;
+			}
+			jobSystem->wait(jobs);
 		}
 
 		void mainLoop() {
-			// Loops and checks for the window being closed. Main app life-cycle will then run cleanup once the loop is terminated.
-			while (!glfwWindowShouldClose(window)) {
-				glfwPollEvents();
+			if (options.headless) {
+				// Batch mode: a fixed number of frames, nothing to poll.
+				for (uint32_t i = 0; i < options.frameCount; ++i) {
+					drawFrame();
+				}
 			}
+			else {
+				// Loops and checks for the window being closed. Main app life-cycle will then run cleanup once the loop is terminated.
+				while (!glfwWindowShouldClose(window)) {
+					glfwPollEvents();
+					drawFrame();
+
+					if (options.frameCount != 0 && frameScheduler.getFrameIndex() + 1 >= options.frameCount) {
+						break;
+					}
+				}
+			}
+			drainFrames();
+			frameScheduler.printSummary();
+			gpuProfiler.printSummary();
 		}
 
 		void cleanup() {
+			CPU_PROFILE_SCOPE("cleanup");
+			if (shaderHotReloader) {
+				// A rebuild that finished after the last frame still owns its pipeline; swapping it in hands it to cleanup.
+				shaderHotReloader->stop();
+				shaderHotReloader->applyPendingSwaps();
+			}
+			// Decode jobs write into the loader, so they have to finish before anything they touch goes away.
+			jobSystem->wait(sceneDecodeJobs);
+			destroyFrameResources();
+			sceneStreamer.destroy();
+			if (hasScene()) {
+				textureResidency.printStats();
+			}
+			textureResidency.destroy();
+			sceneLoader.reset();
+			sceneMesh.reset();
+			vkDestroyBuffer(device, vertexBuffer, hostAllocator.callbacks(HostAllocationArena::Device));
+			gpuAllocator.free(vertexAllocation);
+			vkDestroyBuffer(device, indexBuffer, hostAllocator.callbacks(HostAllocationArena::Device));
+			gpuAllocator.free(indexAllocation);
+			culler.destroy();
+			if (!options.scenePath.empty()) {
+				hiZBuilder.destroy();
+			}
+			vkDestroyPipeline(device, triangle.pipeline, hostAllocator.callbacks(HostAllocationArena::Device));
+			vkDestroyPipeline(device, scenePipeline.pipeline, hostAllocator.callbacks(HostAllocationArena::Device));
+			layoutCache.destroy();
+			bindless.destroy();
+			pipelineCache.destroy();
+			uploads.printStats();
+			uploads.destroy();
+			gpuAllocator.destroy();
+			vkDestroyDevice(device, hostAllocator.callbacks(HostAllocationArena::Device));
+
 			if (enableValidationLayers) {
-				DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
-				vkDestroyDevice(device, nullptr);
+				DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator.callbacks(HostAllocationArena::Instance));
+			}
+
+			vkDestroyInstance(instance, hostAllocator.callbacks(HostAllocationArena::Instance));
+			if (window) {
+				glfwDestroyWindow(window);
+				glfwTerminate();
 			}
+			jobSystem.reset();
 
-			vkDestroyInstance(instance, nullptr);
-			glfwDestroyWindow(window);
-			glfwTerminate();
+			hostAllocator.printReport();
 		}
 		void createInstance() {
+			CPU_PROFILE_SCOPE("createInstance");
 
 			if (enableValidationLayers && !checkValidationLayerSupport()) {
 				throw std::runtime_error("Validation layers requested, but not available.");
@@ -140,7 +575,9 @@ class HelloTriangleApplication {
 				createInfo.pNext = nullptr;
 			}
 
-			validateVulkanExtensions();
+			if (options.verbose) {
+				printInstanceExtensions();
+			}
 
 			/*
 				Common patterin in vk object creation :
@@ -149,7 +586,7 @@ class HelloTriangleApplication {
 				- Pointer to variable that stores the handle of new objects.
 			*/
 
-			if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+			if (vkCreateInstance(&createInfo, hostAllocator.callbacks(HostAllocationArena::Instance), &instance) != VK_SUCCESS) {
 				throw std::runtime_error("Failed to create vkInstance!\n");
 			}
 
@@ -157,17 +594,19 @@ class HelloTriangleApplication {
 		}
 
 		void setupDebugMessenger() {
+			CPU_PROFILE_SCOPE("setupDebugMessenger");
 			if (!enableValidationLayers) return;
 
 			VkDebugUtilsMessengerCreateInfoEXT createInfo{};
 			populateDebugMessengerCreateInfo(createInfo);
 
-			if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+			if (CreateDebugUtilsMessengerEXT(instance, &createInfo, hostAllocator.callbacks(HostAllocationArena::Instance), &debugMessenger) != VK_SUCCESS) {
 				throw std::runtime_error("Failed to setup Debug Messenger.");
 			}
 		}
 
 		void pickPhysicalDevice() {
+			CPU_PROFILE_SCOPE("pickPhysicalDevice");
 			uint32_t deviceCount = 0;
 			vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -178,82 +617,114 @@ class HelloTriangleApplication {
 			std::vector<VkPhysicalDevice> devices(deviceCount);
 			vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
+			// Rank every device instead of taking the first acceptable one, so mixed-GPU nodes get the fastest.
+			DeviceProfileCache profileCache(deviceProfileCacheDir);
+			uint64_t bestScore = 0;
 			for (const auto& device : devices) {
-				if (isPhysicalDeviceValid(device)) {
+				DeviceCapabilityProfile profile = profileCache.getProfile(device);
+				// The score only ranks; a device missing a feature createLogicalDevice requires must never win.
+				const char* missing = findMissingRequirement(device, profile);
+				uint64_t score = missing ? 0 : scoreDeviceProfile(profile);
+				std::cout << "Device Found: " << profile.properties.deviceName << " (score " << score << ")"
+					<< (missing ? std::string(", skipped: no ") + missing : std::string()) << "\n";
+
+				if (score > bestScore) {
+					bestScore = score;
 					physicalDevice = device;
-					debugPhysicalDevice(physicalDevice);
-					break;
+					physicalDeviceProfile = std::move(profile);
 				}
 			}
 			if (physicalDevice == VK_NULL_HANDLE) {
 				throw std::runtime_error("Failed to find a suitable GPU.");
 			}
+			// Decides which KTX2 textures upload as blocks and which are transcoded first.
+			textureFormats = queryTextureFormatSupport(physicalDevice);
+			debugPhysicalDevice();
 		}
 
-		bool isPhysicalDeviceValid(VkPhysicalDevice device) {
-			VkPhysicalDeviceProperties deviceProperties;
-			VkPhysicalDeviceFeatures deviceFeatures;
-			vkGetPhysicalDeviceProperties(device, &deviceProperties);
-			vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
-			std::cout << "Device Found: " << deviceProperties.deviceName << "\n";
-			isDeviceSuitable(device);
-			return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && deviceFeatures.geometryShader;
+		// The first feature createLogicalDevice would throw without, or null when the device has them all. Queue
+		// families and the API version are already hard requirements of the score.
+		const char* findMissingRequirement(VkPhysicalDevice device, const DeviceCapabilityProfile& profile) const {
+			if (!BindlessDescriptors::isSupported(device)) {
+				return "descriptor indexing for bindless descriptors";
+			}
+			if (!GpuCuller::isSupported(device, profile.features)) {
+				return "indirect draw features for GPU culling";
+			}
+			if (!options.scenePath.empty() && !TextureResidency::isSupported(profile.features)) {
+				return "fragment shader stores for texture streaming";
+			}
+			return nullptr;
 		}
 
-		void debugPhysicalDevice(VkPhysicalDevice device) {
-			VkPhysicalDeviceProperties deviceProperties;
-			vkGetPhysicalDeviceProperties(device, &deviceProperties);
+		void debugPhysicalDevice() {
+			const VkPhysicalDeviceProperties& deviceProperties = physicalDeviceProfile.properties;
 			std::cout << "Physial Device Debug: " << "\n";
 			std::cout << "\t" << "Allocated Physical Device: " << deviceProperties.deviceName << "\n";
-
+			std::cout << "\t" << "Device Local Memory: " << physicalDeviceProfile.deviceLocalHeapSize() / (1024 * 1024) << " MiB\n";
+			std::cout << "\t" << "Compressed Textures: " << textureFormats.describe() << "\n";
 		}
 
-		bool isDeviceSuitable(VkPhysicalDevice device) {
-			QueueFamilyIndicies indices = findQueueFamilies(device);
-			return indices.isComplete();
-		}
+		void createLogicalDevice() {
+			CPU_PROFILE_SCOPE("createLogicalDevice");
+			QueueFamilyIndicies indicies = findQueueFamilies(physicalDeviceProfile.queueFamilies);
+			if (!indicies.isComplete()) {
+				throw std::runtime_error("Selected device is missing a graphics queue family.");
+			}
+			if (options.verbose) {
+				std::cout << "Device Queue Families: graphics " << indicies.graphicsFamily.value()
+					<< ", compute " << indicies.computeFamily.value() << (indicies.hasDedicatedCompute() ? " (dedicated)" : "")
+					<< ", transfer " << indicies.transferFamily.value() << (indicies.hasDedicatedTransfer() ? " (dedicated)" : "") << "\n";
+			}
 
-		QueueFamilyIndicies findQueueFamilies(VkPhysicalDevice device) {
-			QueueFamilyIndicies indicies;
-			uint32_t queueFamilyCount = 0;
+			const std::vector<VkDeviceQueueCreateInfo>& queueCreateInfos = queues.buildCreateInfos(indicies, physicalDeviceProfile.queueFamilies);
 
-			vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-			std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-			vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-			std::cout << "Device Queue Family Indicies: " << queueFamilies.size() << "\n";
-			int i = 0;
-			for (const auto& queueFamily : queueFamilies) {
-				if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-					indicies.graphicsFamily = i;
-				}
-				if (indicies.isComplete()) {
-					
-					break;
-				}
-				i++;
-			}
-			return indicies;
-		}
+			// Core 1.2/1.3 features the frame loop is built on. Both are mandatory on 1.3 devices, which device selection requires.
+			VkPhysicalDeviceVulkan13Features vulkan13Features{};
+			vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+			vulkan13Features.synchronization2 = VK_TRUE;
+			vulkan13Features.dynamicRendering = VK_TRUE;
 
-		void createLogicalDevice() {
-			float queuePriority = 1.0f;
-			QueueFamilyIndicies indicies = findQueueFamilies(physicalDevice);
+			VkPhysicalDeviceVulkan12Features vulkan12Features{};
+			vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			vulkan12Features.pNext = &vulkan13Features;
+			vulkan12Features.timelineSemaphore = VK_TRUE;
 
-			VkDeviceQueueCreateInfo queueCreateInfo{};
-			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-			queueCreateInfo.queueFamilyIndex = indicies.graphicsFamily.value();
-			queueCreateInfo.queueCount = 1;
-			queueCreateInfo.pQueuePriorities = &queuePriority;
+			// Descriptor indexing is optional even on 1.3, and the cached profile only records 1.0 features, so ask the device.
+			if (!BindlessDescriptors::isSupported(physicalDevice)) {
+				throw std::runtime_error("Selected device doesn't support the descriptor indexing features bindless descriptors need.");
+			}
+			BindlessDescriptors::enableFeatures(vulkan12Features);
 
 			VkPhysicalDeviceFeatures deviceFeatures{};
+			if (!GpuCuller::isSupported(physicalDevice, physicalDeviceProfile.features)) {
+				throw std::runtime_error("Selected device doesn't support the indirect draw features GPU culling needs.");
+			}
+			GpuCuller::enableFeatures(deviceFeatures, vulkan12Features);
+			if (!options.scenePath.empty()) {
+				if (!TextureResidency::isSupported(physicalDeviceProfile.features)) {
+					throw std::runtime_error("Selected device doesn't support the fragment shader stores texture streaming needs.");
+				}
+				TextureResidency::enableFeatures(deviceFeatures);
+				textureFormats.enableFeatures(deviceFeatures);
+			}
+
 			VkDeviceCreateInfo createInfo{};
 			createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-			createInfo.pQueueCreateInfos = &queueCreateInfo;
-			createInfo.queueCreateInfoCount = 1;
+			createInfo.pNext = &vulkan12Features;
+			createInfo.pQueueCreateInfos = queueCreateInfos.data();
+			createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 			createInfo.pEnabledFeatures = &deviceFeatures;
 
-			createInfo.enabledExtensionCount = 0;
+			// Optional device extensions are enabled only when the selected device reports them.
+			std::vector<const char*> deviceExtensions;
+			memoryBudgetEnabled = physicalDeviceProfile.supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			if (memoryBudgetEnabled) {
+				deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			}
+			createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+			createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
 			if (enableValidationLayers) {
 				createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
 				createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -262,18 +733,644 @@ class HelloTriangleApplication {
 				createInfo.enabledLayerCount = 0;
 			}
 		
-			if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+			if (vkCreateDevice(physicalDevice, &createInfo, hostAllocator.callbacks(HostAllocationArena::Device), &device) != VK_SUCCESS) {
 				throw std::runtime_error("Failed to create logical device.");
 			}
-			vkGetDeviceQueue(device, indicies.graphicsFamily.value(), 0, &graphicsQueue);
+			queues.fetchQueues(device);
+		}
+
+		void compileShaders() {
+			CPU_PROFILE_SCOPE("compileShaders");
+			// Unchanged shaders come straight out of the on-disk cache, so this is only slow the first time.
+			shaders = loadShaders(triangleShaders);
+			cullShaders = loadShaders(cullShaderRequests);
+			if (!options.scenePath.empty()) {
+				meshShaders = loadShaders(meshShaderRequests);
+			}
+		}
+
+		// With --cooked, the SPIR-V AssetCooker compiled is used as it is and shaderc never runs.
+		std::vector<CompiledShader> loadShaders(const std::vector<ShaderRequest>& requests) {
+			if (options.cookedDirectory.empty()) {
+				return shaderCompiler.compileAll(*jobSystem, requests);
+			}
+			std::vector<CompiledShader> loaded;
+			for (const ShaderRequest& request : requests) {
+				std::string sourcePath = (std::filesystem::path(shaderDir) / request.path).string();
+				std::string cookedPath = findCookedAsset(options.cookedDirectory, sourcePath);
+				if (cookedPath.empty()) {
+					throw std::runtime_error("No cooked shader for " + sourcePath + " in " + options.cookedDirectory + ".");
+				}
+				loaded.push_back(ShaderCompiler::loadSpirv(request, cookedPath));
+			}
+			return loaded;
+		}
+
+		VkShaderModule createShaderModule(const CompiledShader& shader) {
+			VkShaderModuleCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			createInfo.codeSize = shader.spirv.size() * sizeof(uint32_t);
+			createInfo.pCode = shader.spirv.data();
+
+			VkShaderModule shaderModule;
+			if (vkCreateShaderModule(device, &createInfo, hostAllocator.callbacks(HostAllocationArena::Device), &shaderModule) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create shader module for " + shader.path + ".");
+			}
+			return shaderModule;
+		}
+
+		// Also runs on the hot reload thread, so it may only create objects, never touch the current pipeline.
+		// vertexStride is the size of the C++ vertex struct the shader's inputs must match. No depth format: no depth test.
+		GraphicsPipeline buildGraphicsPipeline(const std::vector<CompiledShader>& stages, uint32_t vertexStride, VkFormat depthFormat) {
+			CPU_PROFILE_SCOPE("buildGraphicsPipeline");
+			const VkAllocationCallbacks* deviceCallbacks = hostAllocator.callbacks(HostAllocationArena::Device);
+
+			// Layouts and vertex input come from the SPIR-V, so they cannot drift from the shaders.
+			std::vector<ShaderReflection> reflections;
+			for (const CompiledShader& shader : stages) {
+				reflections.push_back(reflectShader(shader));
+			}
+
+			auto vertexStage = std::find_if(reflections.begin(), reflections.end(),
+				[](const ShaderReflection& reflection) { return reflection.stage == VK_SHADER_STAGE_VERTEX_BIT; });
+			if (vertexStage == reflections.end()) {
+				throw std::runtime_error("Graphics pipeline for " + stages.front().path + " has no vertex shader.");
+			}
+			VertexInputLayout vertexLayout = buildVertexInputLayout(*vertexStage);
+			if (vertexLayout.binding.stride != vertexStride) {
+				throw std::runtime_error(stages[vertexStage - reflections.begin()].path + " inputs no longer match its vertex struct.");
+			}
+
+			GraphicsPipeline built;
+			built.layout = layoutCache.getPipelineLayout(reflections);
+			for (const ShaderReflection& reflection : reflections) {
+				for (const VkPushConstantRange& range : reflection.pushConstants) {
+					built.pushConstantStages |= range.stageFlags;
+				}
+			}
+
+			std::vector<VkShaderModule> shaderModules;
+			std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+			for (size_t i = 0; i < stages.size(); ++i) {
+				shaderModules.push_back(createShaderModule(stages[i]));
+
+				VkPipelineShaderStageCreateInfo stageInfo{};
+				stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+				stageInfo.stage = reflections[i].stage;
+				stageInfo.module = shaderModules.back();
+				stageInfo.pName = stages[i].entryPoint.c_str();
+				shaderStages.push_back(stageInfo);
+			}
+
+			VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputInfo.vertexBindingDescriptionCount = 1;
+			vertexInputInfo.pVertexBindingDescriptions = &vertexLayout.binding;
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexLayout.attributes.size());
+			vertexInputInfo.pVertexAttributeDescriptions = vertexLayout.attributes.data();
+
+			VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+			inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+			// Viewport and scissor are dynamic so the pipeline survives a resize.
+			VkPipelineViewportStateCreateInfo viewportState{};
+			viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewportState.viewportCount = 1;
+			viewportState.scissorCount = 1;
+
+			VkPipelineRasterizationStateCreateInfo rasterizer{};
+			rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+			rasterizer.cullMode = VK_CULL_MODE_NONE;
+			rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+			rasterizer.lineWidth = 1.0f;
+
+			VkPipelineMultisampleStateCreateInfo multisampling{};
+			multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+			VkPipelineDepthStencilStateCreateInfo depthStencil{};
+			depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+			depthStencil.depthTestEnable = depthFormat != VK_FORMAT_UNDEFINED;
+			depthStencil.depthWriteEnable = depthFormat != VK_FORMAT_UNDEFINED;
+			depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+			VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+			colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+			VkPipelineColorBlendStateCreateInfo colorBlending{};
+			colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlending.attachmentCount = 1;
+			colorBlending.pAttachments = &colorBlendAttachment;
+
+			VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+			VkPipelineDynamicStateCreateInfo dynamicState{};
+			dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+			dynamicState.dynamicStateCount = 2;
+			dynamicState.pDynamicStates = dynamicStates;
+
+			// Dynamic rendering: the pipeline only needs the attachment formats, not a VkRenderPass.
+			VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+			VkPipelineRenderingCreateInfo renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+			renderingInfo.colorAttachmentCount = 1;
+			renderingInfo.pColorAttachmentFormats = &colorFormat;
+			renderingInfo.depthAttachmentFormat = depthFormat;
+
+			VkGraphicsPipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.pNext = &renderingInfo;
+			pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+			pipelineInfo.pStages = shaderStages.data();
+			pipelineInfo.pVertexInputState = &vertexInputInfo;
+			pipelineInfo.pInputAssemblyState = &inputAssembly;
+			pipelineInfo.pViewportState = &viewportState;
+			pipelineInfo.pRasterizationState = &rasterizer;
+			pipelineInfo.pMultisampleState = &multisampling;
+			pipelineInfo.pDepthStencilState = &depthStencil;
+			pipelineInfo.pColorBlendState = &colorBlending;
+			pipelineInfo.pDynamicState = &dynamicState;
+			pipelineInfo.layout = built.layout;
+
+			VkResult result = vkCreateGraphicsPipelines(device, pipelineCache.getCache(), 1, &pipelineInfo, deviceCallbacks, &built.pipeline);
+			for (VkShaderModule shaderModule : shaderModules) {
+				vkDestroyShaderModule(device, shaderModule, deviceCallbacks);
+			}
+			if (result != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create graphics pipeline for " + stages.front().path + ".");
+			}
+			layoutCache.printStats();
+			return built;
+		}
+
+		void startShaderHotReload() {
+			shaderHotReloader = std::make_unique<ShaderHotReloader>(shaderCompiler);
+			addHotReloadProgram(triangleShaders, shaders, triangle, sizeof(Vertex), VK_FORMAT_UNDEFINED);
+			if (hasScene()) {
+				addHotReloadProgram(meshShaderRequests, meshShaders, scenePipeline, sizeof(MeshVertex), sceneDepthFormat);
+			}
+			shaderHotReloader->start();
+		}
+
+		void addHotReloadProgram(const std::vector<ShaderRequest>& requests, const std::vector<CompiledShader>& compiled, GraphicsPipeline& target, uint32_t vertexStride, VkFormat depthFormat) {
+			shaderHotReloader->addProgram(requests, compiled, [this, &target, vertexStride, depthFormat](const std::vector<CompiledShader>& rebuiltShaders) {
+				GraphicsPipeline rebuilt = buildGraphicsPipeline(rebuiltShaders, vertexStride, depthFormat);
+				return [this, &target, rebuilt]() {
+					// Frames already submitted still reference the old pipeline, so it goes once they have completed.
+					VkPipeline retired = target.pipeline;
+					target = rebuilt;
+					frameScheduler.deferUntilComplete([this, retired]() {
+						vkDestroyPipeline(device, retired, hostAllocator.callbacks(HostAllocationArena::Device));
+					});
+				};
+			});
+		}
+
+		void createVertexBuffer() {
+			CPU_PROFILE_SCOPE("createVertexBuffer");
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = sizeof(Vertex) * triangleVertices.size();
+			bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateBuffer(device, &bufferInfo, hostAllocator.callbacks(HostAllocationArena::Device), &vertexBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create vertex buffer.");
+			}
+
+			// Three vertices: not worth a staging copy, the GPU reads them straight out of host-visible memory.
+			vertexAllocation = gpuAllocator.allocateForBuffer(vertexBuffer, MemoryUsage::CpuToGpu);
+			memcpy(vertexAllocation->mappedData, triangleVertices.data(), bufferInfo.size);
+		}
+
+		void createIndexBuffer() {
+			CPU_PROFILE_SCOPE("createIndexBuffer");
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = sizeof(uint16_t) * triangleIndices.size();
+			bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateBuffer(device, &bufferInfo, hostAllocator.callbacks(HostAllocationArena::Device), &indexBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create index buffer.");
+			}
+
+			indexAllocation = gpuAllocator.allocateForBuffer(indexBuffer, MemoryUsage::CpuToGpu);
+			memcpy(indexAllocation->mappedData, triangleIndices.data(), bufferInfo.size);
+		}
+
+		// An N x N grid of the triangle filling clip space. With N = 1 its transform is the identity. With --scene, the
+		// scene's instances instead, every mesh empty until the streamer has uploaded it.
+		void createScene() {
+			CPU_PROFILE_SCOPE("createScene");
+			if (hasScene()) {
+				textureResidency.init(device, queues, uploads, gpuAllocator, bindless, frameScheduler, *jobSystem, options.framesInFlight, textureCacheDir,
+					static_cast<VkDeviceSize>(options.textureBudgetMB) << 20, hostAllocator.callbacks(HostAllocationArena::Device));
+				sceneStreamer.init(device, queues, uploads, gpuAllocator, bindless, textureResidency, hostAllocator.callbacks(HostAllocationArena::Device));
+				if (sceneMesh) {
+					sceneStreamer.beginMeshFile(*jobSystem, *sceneMesh, culler);
+				}
+				else {
+					sceneStreamer.begin(*jobSystem, *sceneLoader, culler);
+				}
+				pendingPick = options.pickPixel;
+				return;
+			}
+
+			uint32_t grid = options.instanceGrid;
+			float cell = 2.0f / static_cast<float>(grid);
+			float scale = 1.0f / static_cast<float>(grid);
+			float radius = 0.7072f * scale; // Every triangle vertex is within sqrt(0.5) of the origin.
+
+			std::vector<CullInstance> instances;
+			instances.reserve(static_cast<size_t>(grid) * grid);
+			for (uint32_t y = 0; y < grid; ++y) {
+				for (uint32_t x = 0; x < grid; ++x) {
+					glm::vec3 centre(-1.0f + cell * (static_cast<float>(x) + 0.5f), -1.0f + cell * (static_cast<float>(y) + 0.5f), 0.0f);
+					CullInstance instance{};
+					instance.transform = glm::mat4(scale);
+					instance.transform[2][2] = 1.0f;
+					instance.transform[3] = glm::vec4(centre, 1.0f);
+					instance.boundingSphere = glm::vec4(centre, radius);
+					instance.mesh = 0;
+					instance.bucket = 0;
+					instances.push_back(instance);
+				}
+			}
+
+			std::vector<CullMesh> meshes = { { static_cast<uint32_t>(triangleIndices.size()), 0, 0, 0 } };
+			culler.setScene(instances, meshes, 1);
+		}
+
+		void createFrameResources() {
+			CPU_PROFILE_SCOPE("createFrameResources");
+			const VkAllocationCallbacks* deviceCallbacks = hostAllocator.callbacks(HostAllocationArena::Device);
+			VkExtent2D extent = { winResX, winResY };
+
+			colorTarget = createOffscreenImage(device, gpuAllocator, extent, VK_FORMAT_R8G8B8A8_UNORM,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, deviceCallbacks);
+			if (options.headless) {
+				readbackRing.init(device, gpuAllocator, options.framesInFlight, static_cast<VkDeviceSize>(extent.width) * extent.height * 4, deviceCallbacks);
+				if (!options.outputDirectory.empty()) {
+					std::filesystem::create_directories(options.outputDirectory);
+				}
+			}
+
+			frameScheduler.init(device, queues, options.framesInFlight, jobSystem->getThreadCount(), hostAllocator.callbacks(HostAllocationArena::Frame), deviceCallbacks);
+			graphTransients.resize(options.framesInFlight);
+			for (RenderGraphTransients& transients : graphTransients) {
+				transients.init(device, gpuAllocator, deviceCallbacks);
+			}
+			gpuProfiler.init(device, physicalDeviceProfile, queues.getFamilyIndex(QueueType::Graphics), options.framesInFlight, deviceCallbacks);
+		}
+
+		void destroyFrameResources() {
+			const VkAllocationCallbacks* deviceCallbacks = hostAllocator.callbacks(HostAllocationArena::Device);
+
+			frameScheduler.destroy();
+			for (RenderGraphTransients& transients : graphTransients) {
+				transients.destroy();
+			}
+			graphTransients.clear();
+			gpuProfiler.destroy();
+			readbackRing.destroy(device, gpuAllocator, deviceCallbacks);
+			destroyOffscreenImage(device, gpuAllocator, colorTarget, deviceCallbacks);
+		}
+
+		void drawFrame() {
+			CPU_PROFILE_SCOPE("drawFrame");
+			// Frame boundary: nothing is being recorded, so rebuilt pipelines can be swapped in.
+			if (shaderHotReloader) {
+				shaderHotReloader->applyPendingSwaps();
+			}
+
+			// Returns once the slot's previous frame is done, so its readback buffer is safe to read.
+			FrameContext& frame = frameScheduler.beginFrame();
+			consumeReadback(frame.slot);
+			culler.validateFrame(frame.slot);
+			gpuProfiler.beginFrame(frame.commandBuffer, frame.slot);
+			if (hasScene()) {
+				textureResidency.readFeedback(frame.slot, frame.frameIndex);
+				textureResidency.update();
+			}
+			// The triangle grid is authored in clip space; a loaded scene gets a camera.
+			glm::mat4 viewProjection = hasScene() ? computeSceneViewProjection(colorTarget.extent, frame.frameIndex) : glm::mat4(1.0f);
+			if (hasScene() && pendingPick) {
+				pickInstance(*pendingPick, viewProjection);
+			}
+			pendingPick.reset();
+			// Publishes finished uploads into the culler's tables and queues the next ones, what the camera sees first.
+			if (hasScene()) {
+				sceneStreamer.update(viewProjection);
+			}
+			uploads.flush(); // Everything queued this frame goes out as one transfer submission.
+
+			recordFrame(frame, viewProjection);
+			// Everything published so far completed at or before this value, so the wait never stalls. It is what makes
+			// the transfer queue's writes visible to the frame.
+			std::vector<VkSemaphoreSubmitInfo> uploadWaits;
+			uint64_t uploadsCompleted = uploads.getCompletedValue();
+			if (uploadsCompleted > 0) {
+				uploadWaits.push_back(uploads.getWaitInfo(uploadsCompleted));
+			}
+			frameScheduler.endFrame(uploadWaits);
+			startup.finish(); // Reports once, on the first frame.
+
+			if (options.headless) {
+				readbackRing.markPending(frame.slot, frame.frameIndex);
+			}
+			if (options.printFrameStats) {
+				for (const FrameTiming& timing : frameScheduler.takeCompletedTimings()) {
+					std::cout << "Frame " << timing.frameIndex << ": cpu " << timing.cpuFrameMs << " ms, latency " << timing.gpuLatencyMs
+						<< " ms, interval " << timing.frameIntervalMs << " ms\n";
+				}
+			}
+		}
+
+		void recordFrame(const FrameContext& frame, const glm::mat4& viewProjection) {
+			CPU_PROFILE_SCOPE("recordFrame");
+			RenderGraph graph;
+
+			// The previous frame may still be drawing into or copying out of the image; its contents are not kept.
+			RenderGraphImageDesc colorDesc{ colorTarget.format, colorTarget.extent };
+			RenderGraphResourceState previousColorUse{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT };
+			RenderGraphResource color = graph.importImage("Color", colorTarget.image, colorTarget.view, colorDesc, previousColorUse);
+			graph.markOutput(color); // Nothing presents it yet, but the windowed renderer should still draw.
+
+			// The draw list is built on the GPU. Like the readback buffer, the slot's previous use finished in beginFrame.
+
+			// Occlusion culls against the pyramid the previous frame built from its depth. The camera moves a little
+			// between frames, so something that motion uncovers can be missing for one frame.
+			bool cullsAgainstHiZ = hasScene() && frame.frameIndex > 0;
+			uint32_t previousHiZ = cullsAgainstHiZ ? hiZBuilder.getPyramid(frame.frameIndex - 1) : 0;
+			if (cullsAgainstHiZ) {
+				culler.setHiZ(hiZBuilder.getBufferIndex(previousHiZ), hiZBuilder.getWidth(), hiZBuilder.getHeight(), hiZBuilder.getHostData(previousHiZ));
+			}
+			culler.beginFrame(frame.slot, viewProjection);
+			RenderGraphResource drawCounts = graph.importBuffer("Draw Counts", culler.getCountBuffer(frame.slot), {});
+			RenderGraphResource drawCommands = graph.importBuffer("Draw Commands", culler.getCommandBuffer(frame.slot), {});
+			if (culler.isValidating()) {
+				graph.setFinalState(drawCounts, RenderGraphAccess::HostRead);
+				graph.setFinalState(drawCommands, RenderGraphAccess::HostRead);
+			}
+
+			graph.addPass("Reset Draw Counts", [this, &frame](VkCommandBuffer commandBuffer) {
+				culler.recordResetCounts(commandBuffer, frame.slot);
+			}).write(drawCounts, RenderGraphAccess::TransferWrite);
+
+			RenderGraphPassBuilder cull = graph.addPass("Cull", [this, &frame](VkCommandBuffer commandBuffer) {
+				CPU_PROFILE_SCOPE("recordCullPass");
+				GpuScope scope(gpuProfiler, commandBuffer, "Cull");
+				culler.recordCull(commandBuffer, frame.slot);
+			}).write(drawCounts, RenderGraphAccess::StorageWrite).write(drawCommands, RenderGraphAccess::StorageWrite);
+			if (cullsAgainstHiZ) {
+				// Written by the previous frame's Hi-Z pass, which may still be running.
+				RenderGraphResourceState previousBuild{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT };
+				cull.read(graph.importBuffer("Previous Hi-Z", hiZBuilder.getBuffer(previousHiZ), previousBuild), RenderGraphAccess::StorageRead);
+			}
+
+			if (hasScene()) {
+				// Transient: only the scene and Hi-Z passes use it, so the graph can alias its memory with other transients.
+				RenderGraphResource depth = graph.createImage("Depth", { sceneDepthFormat, colorTarget.extent, VK_IMAGE_ASPECT_DEPTH_BIT });
+				// Reset by the host when it was last read, in beginFrame, so the shader's atomics start from scratch.
+				RenderGraphResource feedback = graph.importBuffer("Texture Feedback", textureResidency.getFeedbackBuffer(frame.slot), {});
+				graph.setFinalState(feedback, RenderGraphAccess::HostRead);
+				graph.addPass("Scene", [this, &graph, color, depth, &frame, viewProjection](VkCommandBuffer commandBuffer) {
+					recordScenePass(commandBuffer, graph.getImageView(color), graph.getImageView(depth), graph.getImageDesc(color).extent, viewProjection, frame.slot);
+				}).write(color, RenderGraphAccess::ColorAttachmentWrite).write(depth, RenderGraphAccess::DepthAttachmentWrite)
+					.write(feedback, RenderGraphAccess::StorageWrite)
+					.read(drawCounts, RenderGraphAccess::IndirectRead).read(drawCommands, RenderGraphAccess::IndirectRead);
+
+				// The next frame culls against this. Its last builder and reader were frames F - count and F - count + 1,
+				// and the later of those is this slot's previous frame, so there is nothing to wait for.
+				uint32_t buildHiZ = hiZBuilder.getPyramid(frame.frameIndex);
+				RenderGraphResource hiZ = graph.importBuffer("Hi-Z", hiZBuilder.getBuffer(buildHiZ), {});
+				if (culler.isValidating()) {
+					graph.setFinalState(hiZ, RenderGraphAccess::HostRead);
+				}
+				else {
+					graph.markOutput(hiZ);
+				}
+				graph.addPass("Hi-Z", [this, &graph, depth, buildHiZ](VkCommandBuffer commandBuffer) {
+					CPU_PROFILE_SCOPE("recordHiZPass");
+					GpuScope scope(gpuProfiler, commandBuffer, "Hi-Z");
+					hiZBuilder.recordBuild(commandBuffer, graph.getImage(depth), buildHiZ);
+				}).read(depth, RenderGraphAccess::TransferRead)
+					.write(hiZ, RenderGraphAccess::TransferWrite).write(hiZ, RenderGraphAccess::StorageWrite);
+			}
+			else {
+				graph.addPass("Triangle", [this, &graph, color, &frame](VkCommandBuffer commandBuffer) {
+					recordTrianglePass(commandBuffer, graph.getImageView(color), graph.getImageDesc(color).extent, frame.frameIndex, frame.slot);
+				}).write(color, RenderGraphAccess::ColorAttachmentWrite)
+					.read(drawCounts, RenderGraphAccess::IndirectRead).read(drawCommands, RenderGraphAccess::IndirectRead);
+			}
+
+			if (options.headless) {
+				// Host reads of the slot's buffer finished before beginFrame returned, so there is nothing to wait for.
+				RenderGraphResource readback = graph.importBuffer("Readback", readbackRing.getBuffer(frame.slot), {});
+				graph.setFinalState(readback, RenderGraphAccess::HostRead);
+
+				graph.addPass("Readback", [this, &graph, color, readback](VkCommandBuffer commandBuffer) {
+					recordReadbackPass(commandBuffer, graph.getImage(color), graph.getImageDesc(color).extent, graph.getBuffer(readback));
+				}).read(color, RenderGraphAccess::TransferRead).write(readback, RenderGraphAccess::TransferWrite);
+			}
+
+			RenderGraphTransients& transients = graphTransients[frame.slot];
+			graph.compile([&transients](const VkImageCreateInfo& createInfo) { return transients.getMemoryRequirements(createInfo); });
+			transients.bind(graph);
+
+			// Every pass gets its own secondary command buffer recorded on the job system. They execute in graph order.
+			GpuScope frameScope(gpuProfiler, frame.commandBuffer, "Frame");
+			graph.execute(frameScheduler, *jobSystem);
+		}
+
+		void recordTrianglePass(VkCommandBuffer commandBuffer, VkImageView target, VkExtent2D extent, uint64_t frameIndex, uint32_t slot) {
+			CPU_PROFILE_SCOPE("recordTrianglePass");
+			GpuScope scope(gpuProfiler, commandBuffer, "Triangle");
+
+			VkRenderingAttachmentInfo colorAttachment{};
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachment.imageView = target;
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.clearValue.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+			VkRenderingInfo renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+			renderingInfo.renderArea = { { 0, 0 }, extent };
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = 1;
+			renderingInfo.pColorAttachments = &colorAttachment;
+			vkCmdBeginRendering(commandBuffer, &renderingInfo);
+
+			VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+			VkRect2D scissor = { { 0, 0 }, extent };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle.pipeline);
+			// Every pipeline layout shares set 0, so this stays bound across pipeline changes within the pass.
+			bindless.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle.layout);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			// Colours cycle over 120 frames, which is enough to tell frames apart on readback.
+			TriangleConstants constants{ static_cast<float>(frameIndex % 120) / 120.0f, culler.getInstanceBufferIndex() };
+			vkCmdPushConstants(commandBuffer, triangle.layout, triangle.pushConstantStages, 0, sizeof(constants), &constants);
+
+			VkDeviceSize vertexOffset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+			// One indirect draw per material bucket, however many instances survived culling. The triangle pipeline is
+			// the only material so far, so every bucket draws with it.
+			for (uint32_t bucket = 0; bucket < culler.getBucketCount(); ++bucket) {
+				culler.recordDraws(commandBuffer, slot, bucket);
+			}
+			vkCmdEndRendering(commandBuffer);
+		}
+
+		// Orbits the scene's bounds, one revolution every 720 frames, so headless runs render the same views every time.
+		glm::mat4 computeSceneViewProjection(VkExtent2D extent, uint64_t frameIndex) const {
+			glm::vec3 boundsMin = sceneStreamer.getBoundsMin();
+			glm::vec3 boundsMax = sceneStreamer.getBoundsMax();
+			glm::vec3 centre = (boundsMin + boundsMax) * 0.5f;
+			float radius = std::max(glm::length(boundsMax - boundsMin) * 0.5f, 0.001f);
+
+			const float fieldOfView = glm::radians(60.0f);
+			float distance = radius / std::sin(fieldOfView * 0.5f); // Far enough that the bounding sphere fills the view.
+			float angle = static_cast<float>(frameIndex % 720) / 720.0f * glm::two_pi<float>();
+			const float elevation = 0.35f;
+			glm::vec3 eye = centre + distance * glm::vec3(std::cos(elevation) * std::sin(angle), std::sin(elevation), std::cos(elevation) * std::cos(angle));
+
+			glm::mat4 view = glm::lookAt(eye, centre, glm::vec3(0.0f, 1.0f, 0.0f));
+			float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+			glm::mat4 projection = glm::perspectiveRH_ZO(fieldOfView, aspect, distance * 0.01f, distance + radius * 2.0f);
+			projection[1][1] *= -1.0f; // Vulkan's clip space has Y pointing down.
+			return projection * view;
+		}
+
+		bool hasScene() const { return sceneLoader || sceneMesh; }
+
+		// Casts from the near plane through the pixel's centre to the far plane and reports the closest instance hit.
+		void pickInstance(glm::uvec2 pixel, const glm::mat4& viewProjection) const {
+			CPU_PROFILE_SCOPE("pickInstance");
+			glm::vec2 ndc = (glm::vec2(pixel) + 0.5f) / glm::vec2(colorTarget.extent.width, colorTarget.extent.height) * 2.0f - 1.0f;
+			glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+			glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, 0.0f, 1.0f);
+			glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+			glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+			glm::vec3 ray = glm::vec3(farPoint) / farPoint.w - origin;
+
+			BvhRayHit hit;
+			if (sceneStreamer.pick(origin, glm::normalize(ray), glm::length(ray), hit)) {
+				std::cout << "Picked instance " << hit.primitive << " (mesh " << sceneStreamer.getInstanceMesh(hit.primitive)
+					<< ") at (" << pixel.x << ", " << pixel.y << "), distance " << hit.distance << "\n";
+			}
+			else {
+				std::cout << "Nothing to pick at (" << pixel.x << ", " << pixel.y << ")\n";
+			}
+		}
+
+		void recordScenePass(VkCommandBuffer commandBuffer, VkImageView target, VkImageView depth, VkExtent2D extent, const glm::mat4& viewProjection, uint32_t slot) {
+			CPU_PROFILE_SCOPE("recordScenePass");
+			GpuScope scope(gpuProfiler, commandBuffer, "Scene");
+
+			VkRenderingAttachmentInfo colorAttachment{};
+			colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			colorAttachment.imageView = target;
+			colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			colorAttachment.clearValue.color = { { 0.1f, 0.1f, 0.12f, 1.0f } };
+
+			VkRenderingAttachmentInfo depthAttachment{};
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+			depthAttachment.imageView = depth;
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // The Hi-Z pass reads it.
+			depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+			VkRenderingInfo renderingInfo{};
+			renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+			renderingInfo.renderArea = { { 0, 0 }, extent };
+			renderingInfo.layerCount = 1;
+			renderingInfo.colorAttachmentCount = 1;
+			renderingInfo.pColorAttachments = &colorAttachment;
+			renderingInfo.pDepthAttachment = &depthAttachment;
+			vkCmdBeginRendering(commandBuffer, &renderingInfo);
+
+			VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+			VkRect2D scissor = { { 0, 0 }, extent };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipeline.pipeline);
+			bindless.bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scenePipeline.layout);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			SceneConstants constants{ viewProjection, culler.getInstanceBufferIndex(), culler.getMeshBufferIndex(slot), textureResidency.getFeedbackBufferIndex(slot) };
+			vkCmdPushConstants(commandBuffer, scenePipeline.layout, scenePipeline.pushConstantStages, 0, sizeof(constants), &constants);
+
+			// Meshes that haven't streamed in yet have no indices, so their commands draw nothing.
+			VkBuffer sceneVertexBuffer = sceneStreamer.getVertexBuffer();
+			VkDeviceSize vertexOffset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &sceneVertexBuffer, &vertexOffset);
+			vkCmdBindIndexBuffer(commandBuffer, sceneStreamer.getIndexBuffer(), 0, sceneStreamer.getIndexType());
+			for (uint32_t bucket = 0; bucket < culler.getBucketCount(); ++bucket) {
+				culler.recordDraws(commandBuffer, slot, bucket);
+			}
+			vkCmdEndRendering(commandBuffer);
+		}
+
+		// The graph's final HostRead state makes the copy visible once the frame's timeline value has been waited on.
+		void recordReadbackPass(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D extent, VkBuffer destination) {
+			CPU_PROFILE_SCOPE("recordReadbackPass");
+			GpuScope scope(gpuProfiler, commandBuffer, "Readback");
+			VkBufferImageCopy region{};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageExtent = { extent.width, extent.height, 1 };
+			vkCmdCopyImageToBuffer(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination, 1, &region);
+		}
+
+		void consumeReadback(uint32_t slot) {
+			CPU_PROFILE_SCOPE("consumeReadback");
+			if (!options.headless || !readbackRing.isPending(slot)) {
+				return;
+			}
+
+			if (!options.outputDirectory.empty()) {
+				char fileName[32];
+				snprintf(fileName, sizeof(fileName), "frame_%05llu.ppm", static_cast<unsigned long long>(readbackRing.getPendingFrame(slot)));
+				writeFramePPM((std::filesystem::path(options.outputDirectory) / fileName).string(), readbackRing.getData(slot), colorTarget.extent);
+			}
+			readbackRing.clearPending(slot);
+		}
+
+		void drainFrames() {
+			CPU_PROFILE_SCOPE("drainFrames");
+			frameScheduler.waitIdle();
+			gpuProfiler.collectAll();
+
+			// Consume the outstanding readbacks oldest first so frames come out in order.
+			uint32_t framesInFlight = frameScheduler.getFramesInFlight();
+			uint64_t nextFrame = frameScheduler.getFrameIndex() + 1;
+			for (uint64_t i = 0; i < framesInFlight; ++i) {
+				consumeReadback(static_cast<uint32_t>((nextFrame + i) % framesInFlight));
+				culler.validateFrame(static_cast<uint32_t>((nextFrame + i) % framesInFlight));
+			}
+			vkDeviceWaitIdle(device);
 		}
 
 		std::vector<const char*> getRequiredExtensions() {
-			uint32_t glfwExtensionCount = 0;
-			const char** glfwExtensions;
-			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			std::vector<const char*> extensions;
+
+			// Surface extensions are only needed to present; headless nodes may not even have a display to load them from.
+			if (!options.headless) {
+				uint32_t glfwExtensionCount = 0;
+				const char** glfwExtensions;
+				glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-			std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+				extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			}
 
 			if (enableValidationLayers) {
 				extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -281,17 +1378,25 @@ class HelloTriangleApplication {
 			return extensions;
 		}
 
-		bool checkValidationLayerSupport() {
-			uint32_t layerCount;
-			vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+		// Runs on a worker while the window is created; createInstance reads the results.
+		void enumerateInstanceSupport() {
+			CPU_PROFILE_SCOPE("enumerateInstanceSupport");
+			uint32_t extensionCount = 0;
+			vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+			availableInstanceExtensions.resize(extensionCount);
+			vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableInstanceExtensions.data());
 
-			std::vector<VkLayerProperties> availableLayers(layerCount);
-			vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+			uint32_t layerCount = 0;
+			vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+			availableInstanceLayers.resize(layerCount);
+			vkEnumerateInstanceLayerProperties(&layerCount, availableInstanceLayers.data());
+		}
 
+		bool checkValidationLayerSupport() {
 			for (const char* layerName : validationLayers) {
 				bool layerFound = false;
 
-				for (const auto& layerProperties : availableLayers) {
+				for (const auto& layerProperties : availableInstanceLayers) {
 					if (strcmp(layerName, layerProperties.layerName) == 0) {
 						layerFound = true;
 						break;
@@ -301,6 +1406,7 @@ class HelloTriangleApplication {
 					return false;
 				}
 			}
+			return true;
 		}
 
 		/*
@@ -324,14 +1430,10 @@ class HelloTriangleApplication {
 			return VK_FALSE;
 		}
 
-		void validateVulkanExtensions() {
-			uint32_t extensionCount = 0;
-			vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
-			std::vector<VkExtensionProperties> extensions(extensionCount);
-			vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+		void printInstanceExtensions() {
 			std::cout << "Vulkan Extensions Available:\n";
 
-			for (const auto& extension : extensions) {
+			for (const auto& extension : availableInstanceExtensions) {
 				std::cout << "\t" << extension.extensionName << "\n";
 			}
 		}
@@ -358,10 +1460,47 @@ class HelloTriangleApplication {
 		}
 };
 
-int main() {
-	HelloTriangleApplication app;
+// glTF primitives become submeshes in mesh space; node transforms aren't baked in.
+MeshData importMesh(const std::string& path) {
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+	if (extension != ".gltf" && extension != ".glb") {
+		return importObj(path);
+	}
+
+	GltfLoader loader;
+	loader.open(path);
+	JobSystem jobSystem;
+	JobCounter decodeJobs;
+	loader.decode(jobSystem, decodeJobs, false);
+	jobSystem.wait(decodeJobs);
+	return loader.toMeshData();
+}
 
+// Imports, writes, then opens the result with the checks --scene applies to mesh files, so a conversion that wouldn't
+// load fails here instead.
+void convertMesh(const RendererOptions& options) {
+	auto start = std::chrono::steady_clock::now();
+	writeMeshFile(options.convertMeshOutput, importMesh(options.convertMeshInput));
+
+	MeshFile meshFile;
+	meshFile.open(options.convertMeshOutput);
+	const MeshFileHeader& header = meshFile.getHeader();
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Converted " << options.convertMeshInput << " to " << options.convertMeshOutput << " in " << milliseconds << " ms\n"
+		<< "\t" << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles (" << header.indexSize * 8 << "-bit indices), "
+		<< header.submeshCount << " submeshes, " << header.meshletCount << " meshlets, " << header.fileSize << " bytes\n";
+}
+
+int main(int argc, char** argv) {
 	try {
+		RendererOptions options = parseOptions(argc, argv);
+		if (!options.convertMeshInput.empty()) {
+			convertMesh(options);
+			return EXIT_SUCCESS;
+		}
+
+		HelloTriangleApplication app(options);
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -0,0 +1,190 @@
+#include "hostAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+	// Sits directly in front of every pointer handed to the driver, so free and realloc know what they are releasing.
+	struct AllocationHeader {
+		void* base; // What the backend returned, before alignment.
+		uint64_t size;
+		uint32_t scope;
+	};
+
+	class MallocBackend : public HostMemoryBackend {
+
+		public:
+			void* allocate(size_t size) override { return std::malloc(size); }
+			void release(void* memory) override { std::free(memory); }
+	};
+
+	MallocBackend defaultBackend;
+
+	const char* arenaNames[] = { "Instance", "Device", "Frame" };
+	const char* scopeNames[] = { "Command", "Object", "Cache", "Device", "Instance" };
+
+	AllocationHeader* headerOf(void* memory) {
+		return reinterpret_cast<AllocationHeader*>(static_cast<char*>(memory) - sizeof(AllocationHeader));
+	}
+}
+
+TrackingHostAllocator::TrackingHostAllocator(HostMemoryBackend* backend) : backend(backend ? backend : &defaultBackend) {
+	for (uint32_t i = 0; i < static_cast<uint32_t>(HostAllocationArena::Count); ++i) {
+		Arena& arena = arenas[i];
+		arena.owner = this;
+		arena.id = static_cast<HostAllocationArena>(i);
+		arena.callbacks.pUserData = &arena;
+		arena.callbacks.pfnAllocation = allocationCallback;
+		arena.callbacks.pfnReallocation = reallocationCallback;
+		arena.callbacks.pfnFree = freeCallback;
+		arena.callbacks.pfnInternalAllocation = internalAllocationCallback;
+		arena.callbacks.pfnInternalFree = internalFreeCallback;
+	}
+}
+
+const VkAllocationCallbacks* TrackingHostAllocator::callbacks(HostAllocationArena arena) const {
+	return &arenas[static_cast<uint32_t>(arena)].callbacks;
+}
+
+void TrackingHostAllocator::setArenaLimit(HostAllocationArena arena, uint64_t maxBytes) {
+	arenas[static_cast<uint32_t>(arena)].limitBytes.store(maxBytes, std::memory_order_relaxed);
+}
+
+uint64_t TrackingHostAllocator::getCurrentBytes(HostAllocationArena arena) const {
+	return arenas[static_cast<uint32_t>(arena)].total.currentBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t TrackingHostAllocator::getPeakBytes(HostAllocationArena arena) const {
+	return arenas[static_cast<uint32_t>(arena)].total.peakBytes.load(std::memory_order_relaxed);
+}
+
+void TrackingHostAllocator::recordAllocation(Counters& counters, uint64_t size) {
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	uint64_t current = counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+	uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+	while (current > peak && !counters.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+	}
+}
+
+void TrackingHostAllocator::recordFree(Counters& counters, uint64_t size) {
+	counters.frees.fetch_add(1, std::memory_order_relaxed);
+	counters.currentBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* TrackingHostAllocator::allocate(Arena& arena, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	if (size == 0) {
+		return nullptr;
+	}
+
+	uint64_t limit = arena.limitBytes.load(std::memory_order_relaxed);
+	if (limit != 0 && arena.total.currentBytes.load(std::memory_order_relaxed) + size > limit) {
+		arena.failedAllocations.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	// Over-allocate so the header fits in front of the aligned pointer whatever the backend returns.
+	alignment = std::max(alignment, alignof(AllocationHeader));
+	void* base = backend->allocate(size + alignment + sizeof(AllocationHeader));
+	if (!base) {
+		arena.failedAllocations.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	uintptr_t address = reinterpret_cast<uintptr_t>(base) + sizeof(AllocationHeader);
+	address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	void* memory = reinterpret_cast<void*>(address);
+
+	AllocationHeader* header = headerOf(memory);
+	header->base = base;
+	header->size = size;
+	header->scope = static_cast<uint32_t>(scope);
+
+	recordAllocation(arena.total, size);
+	recordAllocation(arena.scopes[std::min<uint32_t>(header->scope, scopeCount - 1)], size);
+	return memory;
+}
+
+void TrackingHostAllocator::release(Arena& arena, void* memory) {
+	if (!memory) {
+		return;
+	}
+
+	AllocationHeader* header = headerOf(memory);
+	recordFree(arena.total, header->size);
+	recordFree(arena.scopes[std::min<uint32_t>(header->scope, scopeCount - 1)], header->size);
+	backend->release(header->base);
+}
+
+VKAPI_ATTR void* VKAPI_CALL TrackingHostAllocator::allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	Arena& arena = *static_cast<Arena*>(userData);
+	return arena.owner->allocate(arena, size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL TrackingHostAllocator::reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	Arena& arena = *static_cast<Arena*>(userData);
+
+	// Vulkan realloc semantics: null original allocates, zero size frees, and failure leaves the original untouched.
+	if (!original) {
+		return arena.owner->allocate(arena, size, alignment, scope);
+	}
+	if (size == 0) {
+		arena.owner->release(arena, original);
+		return nullptr;
+	}
+
+	void* memory = arena.owner->allocate(arena, size, alignment, scope);
+	if (!memory) {
+		return nullptr;
+	}
+	memcpy(memory, original, std::min<uint64_t>(size, headerOf(original)->size));
+	arena.owner->release(arena, original);
+
+	arena.total.reallocations.fetch_add(1, std::memory_order_relaxed);
+	arena.scopes[std::min<uint32_t>(static_cast<uint32_t>(scope), scopeCount - 1)].reallocations.fetch_add(1, std::memory_order_relaxed);
+	return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL TrackingHostAllocator::freeCallback(void* userData, void* memory) {
+	Arena& arena = *static_cast<Arena*>(userData);
+	arena.owner->release(arena, memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL TrackingHostAllocator::internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType /*type*/, VkSystemAllocationScope /*scope*/) {
+	Arena& arena = *static_cast<Arena*>(userData);
+	recordAllocation(arena.internal, size);
+}
+
+VKAPI_ATTR void VKAPI_CALL TrackingHostAllocator::internalFreeCallback(void* userData, size_t size, VkInternalAllocationType /*type*/, VkSystemAllocationScope /*scope*/) {
+	Arena& arena = *static_cast<Arena*>(userData);
+	recordFree(arena.internal, size);
+}
+
+void TrackingHostAllocator::printReport() const {
+	std::cout << "Host Allocation Report (current / high-water KiB, allocs, reallocs, frees):\n";
+
+	auto printCounters = [](const char* name, const Counters& counters) {
+		if (counters.allocations.load() == 0) {
+			return;
+		}
+		std::cout << "\t\t" << name << ": " << counters.currentBytes.load() / 1024 << " / " << counters.peakBytes.load() / 1024 << " KiB, "
+			<< counters.allocations.load() << ", " << counters.reallocations.load() << ", " << counters.frees.load() << "\n";
+	};
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(HostAllocationArena::Count); ++i) {
+		const Arena& arena = arenas[i];
+		std::cout << "\t" << arenaNames[i] << " arena: " << arena.total.currentBytes.load() / 1024 << " / " << arena.total.peakBytes.load() / 1024 << " KiB";
+		if (arena.limitBytes.load() != 0) {
+			std::cout << " (cap " << arena.limitBytes.load() / 1024 << " KiB, " << arena.failedAllocations.load() << " refused)";
+		}
+		std::cout << "\n";
+
+		for (uint32_t scope = 0; scope < scopeCount; ++scope) {
+			printCounters(scopeNames[scope], arena.scopes[scope]);
+		}
+		printCounters("Internal", arena.internal);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Which part of the renderer's lifetime a Vulkan object belongs to. Objects must be destroyed with the arena they were created with.
+enum class HostAllocationArena : uint32_t {
+	Instance = 0,
+	Device,
+	Frame, // Objects recreated per frame in flight, e.g. command pools.
+	Count
+};
+
+// Where the tracked bytes actually come from. Swap in a different backend to plug in another heap.
+class HostMemoryBackend {
+
+	public:
+		virtual ~HostMemoryBackend() = default;
+		virtual void* allocate(size_t size) = 0;
+		virtual void release(void* memory) = 0;
+};
+
+/*
+	Tracking Host Allocator
+	- Implements VkAllocationCallbacks so driver-side host allocations show up in our accounting instead of vanishing into malloc.
+	- Every arena keeps counters per VkSystemAllocationScope, plus a high-water mark and an optional byte cap.
+	- Once an arena is capped, allocations past the cap return null and the driver reports VK_ERROR_OUT_OF_HOST_MEMORY.
+*/
+class TrackingHostAllocator {
+
+	public:
+		explicit TrackingHostAllocator(HostMemoryBackend* backend = nullptr);
+		TrackingHostAllocator(const TrackingHostAllocator&) = delete;
+		TrackingHostAllocator& operator=(const TrackingHostAllocator&) = delete;
+
+		const VkAllocationCallbacks* callbacks(HostAllocationArena arena) const;
+
+		void setArenaLimit(HostAllocationArena arena, uint64_t maxBytes); // 0 removes the cap.
+		uint64_t getCurrentBytes(HostAllocationArena arena) const;
+		uint64_t getPeakBytes(HostAllocationArena arena) const;
+		void printReport() const;
+
+	private:
+		static const uint32_t scopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+		struct Counters {
+			std::atomic<uint64_t> currentBytes{ 0 };
+			std::atomic<uint64_t> peakBytes{ 0 };
+			std::atomic<uint64_t> allocations{ 0 };
+			std::atomic<uint64_t> reallocations{ 0 };
+			std::atomic<uint64_t> frees{ 0 };
+		};
+
+		struct Arena {
+			TrackingHostAllocator* owner = nullptr;
+			HostAllocationArena id = HostAllocationArena::Instance;
+			VkAllocationCallbacks callbacks{};
+			Counters total;
+			Counters scopes[scopeCount];
+			Counters internal; // Driver allocations it only tells us about (pfnInternalAllocation).
+			std::atomic<uint64_t> limitBytes{ 0 };
+			std::atomic<uint64_t> failedAllocations{ 0 };
+		};
+
+		HostMemoryBackend* backend;
+		Arena arenas[static_cast<uint32_t>(HostAllocationArena::Count)];
+
+		void* allocate(Arena& arena, size_t size, size_t alignment, VkSystemAllocationScope scope);
+		void release(Arena& arena, void* memory);
+		static void recordAllocation(Counters& counters, uint64_t size);
+		static void recordFree(Counters& counters, uint64_t size);
+
+		static VKAPI_ATTR void* VKAPI_CALL allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void* VKAPI_CALL reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void VKAPI_CALL freeCallback(void* userData, void* memory);
+		static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+		static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+};
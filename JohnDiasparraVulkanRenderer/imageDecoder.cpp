@@ -0,0 +1,483 @@
+#include "imageDecoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+	const uint8_t pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	const uint8_t ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const uint32_t maxImageDimension = 16384; // The largest 2D image any Vulkan device has to support.
+
+	const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+		4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	[[noreturn]] void fail(const char* message) {
+		throw std::runtime_error(std::string("Image decode: ") + message + ".");
+	}
+
+	// LSB-first bit reader over the deflate stream. Reading past the end yields zeros and sets overrun.
+	class BitReader {
+
+		public:
+			BitReader(const uint8_t* data, size_t size) : cursor(data), end(data + size) {}
+
+			uint32_t peek(uint32_t count) {
+				refill(count);
+				return static_cast<uint32_t>(buffer & ((1ull << count) - 1));
+			}
+
+			void skip(uint32_t count) {
+				buffer >>= count;
+				bitCount -= count;
+			}
+
+			uint32_t read(uint32_t count) {
+				if (count == 0) {
+					return 0;
+				}
+				uint32_t value = peek(count);
+				skip(count);
+				return value;
+			}
+
+			void alignToByte() {
+				skip(bitCount % 8);
+			}
+
+			// Stored blocks are byte aligned and copied straight through.
+			void readBytes(uint8_t* out, size_t count) {
+				while (count > 0 && bitCount >= 8) {
+					*out++ = static_cast<uint8_t>(read(8));
+					--count;
+				}
+				if (static_cast<size_t>(end - cursor) < count) {
+					fail("Truncated stored block");
+				}
+				memcpy(out, cursor, count);
+				cursor += count;
+			}
+
+			bool overran() const { return overrun; }
+
+		private:
+			const uint8_t* cursor;
+			const uint8_t* end;
+			uint64_t buffer = 0;
+			uint32_t bitCount = 0;
+			bool overrun = false;
+
+			void refill(uint32_t count) {
+				while (bitCount < count) {
+					uint64_t byte = 0;
+					if (cursor < end) {
+						byte = *cursor++;
+					}
+					else {
+						overrun = true;
+					}
+					buffer |= byte << bitCount;
+					bitCount += 8;
+				}
+			}
+	};
+
+	// Canonical Huffman code decoded through one table indexed by the next maxLength bits (bit-reversed codes, as
+	// deflate stores them LSB first). Entries pack symbol << 4 | length.
+	class HuffmanTable {
+
+		public:
+			void build(const uint8_t* lengths, uint32_t count) {
+				uint32_t lengthCounts[16] = {};
+				maxLength = 0;
+				for (uint32_t i = 0; i < count; ++i) {
+					lengthCounts[lengths[i]]++;
+					maxLength = std::max<uint32_t>(maxLength, lengths[i]);
+				}
+				lengthCounts[0] = 0;
+
+				uint32_t nextCode[16] = {};
+				uint32_t code = 0;
+				for (uint32_t bits = 1; bits < 16; ++bits) {
+					code = (code + lengthCounts[bits - 1]) << 1;
+					nextCode[bits] = code;
+				}
+
+				table.assign(static_cast<size_t>(1) << std::max(maxLength, 1u), 0);
+				for (uint32_t symbol = 0; symbol < count; ++symbol) {
+					uint32_t length = lengths[symbol];
+					if (length == 0) {
+						continue;
+					}
+					uint32_t reversed = 0;
+					uint32_t assigned = nextCode[length]++;
+					for (uint32_t bit = 0; bit < length; ++bit) {
+						reversed |= ((assigned >> bit) & 1) << (length - 1 - bit);
+					}
+					// Every table index whose low bits are this code decodes to the symbol.
+					for (uint32_t index = reversed; index < table.size(); index += 1u << length) {
+						table[index] = static_cast<uint16_t>(symbol << 4 | length);
+					}
+				}
+			}
+
+			uint32_t decode(BitReader& reader) const {
+				uint16_t entry = table[reader.peek(std::max(maxLength, 1u))];
+				uint32_t length = entry & 0xF;
+				if (length == 0) {
+					fail("Invalid Huffman code");
+				}
+				reader.skip(length);
+				return entry >> 4;
+			}
+
+		private:
+			std::vector<uint16_t> table;
+			uint32_t maxLength = 0;
+	};
+
+	void buildFixedTables(HuffmanTable& literals, HuffmanTable& distances) {
+		uint8_t lengths[288];
+		std::fill(lengths, lengths + 144, 8);
+		std::fill(lengths + 144, lengths + 256, 9);
+		std::fill(lengths + 256, lengths + 280, 7);
+		std::fill(lengths + 280, lengths + 288, 8);
+		literals.build(lengths, 288);
+		std::fill(lengths, lengths + 30, 5);
+		distances.build(lengths, 30);
+	}
+
+	void readDynamicTables(BitReader& reader, HuffmanTable& literals, HuffmanTable& distances) {
+		uint32_t literalCount = reader.read(5) + 257;
+		uint32_t distanceCount = reader.read(5) + 1;
+		uint32_t codeLengthCount = reader.read(4) + 4;
+
+		uint8_t codeLengthLengths[19] = {};
+		for (uint32_t i = 0; i < codeLengthCount; ++i) {
+			codeLengthLengths[codeLengthOrder[i]] = static_cast<uint8_t>(reader.read(3));
+		}
+		HuffmanTable codeLengths;
+		codeLengths.build(codeLengthLengths, 19);
+
+		uint8_t lengths[288 + 32] = {};
+		uint32_t total = literalCount + distanceCount;
+		for (uint32_t i = 0; i < total;) {
+			uint32_t symbol = codeLengths.decode(reader);
+			if (symbol < 16) {
+				lengths[i++] = static_cast<uint8_t>(symbol);
+				continue;
+			}
+
+			uint8_t repeated = 0;
+			uint32_t repeat = 0;
+			if (symbol == 16) {
+				if (i == 0) {
+					fail("Length repeat with nothing to repeat");
+				}
+				repeated = lengths[i - 1];
+				repeat = 3 + reader.read(2);
+			}
+			else if (symbol == 17) {
+				repeat = 3 + reader.read(3);
+			}
+			else {
+				repeat = 11 + reader.read(7);
+			}
+			if (i + repeat > total) {
+				fail("Code lengths overflow");
+			}
+			std::fill(lengths + i, lengths + i + repeat, repeated);
+			i += repeat;
+		}
+
+		literals.build(lengths, literalCount);
+		distances.build(lengths + literalCount, distanceCount);
+	}
+
+	uint32_t readBigEndian(const uint8_t* bytes) {
+		return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16 | static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+	}
+
+	uint8_t paeth(uint8_t left, uint8_t up, uint8_t upLeft) {
+		int estimate = static_cast<int>(left) + up - upLeft;
+		int distanceLeft = std::abs(estimate - left);
+		int distanceUp = std::abs(estimate - up);
+		int distanceUpLeft = std::abs(estimate - upLeft);
+		if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) {
+			return left;
+		}
+		return distanceUp <= distanceUpLeft ? up : upLeft;
+	}
+}
+
+void inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+	if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+		fail("Not a zlib stream");
+	}
+	BitReader reader(data + 2, size - 2);
+
+	HuffmanTable literals;
+	HuffmanTable distances;
+	bool finalBlock = false;
+	while (!finalBlock) {
+		finalBlock = reader.read(1) != 0;
+		uint32_t blockType = reader.read(2);
+
+		if (blockType == 0) {
+			reader.alignToByte();
+			uint32_t length = reader.read(16);
+			uint32_t inverse = reader.read(16);
+			if ((length ^ 0xFFFF) != inverse) {
+				fail("Corrupt stored block");
+			}
+			size_t start = out.size();
+			out.resize(start + length);
+			reader.readBytes(out.data() + start, length);
+			continue;
+		}
+		if (blockType == 1) {
+			buildFixedTables(literals, distances);
+		}
+		else if (blockType == 2) {
+			readDynamicTables(reader, literals, distances);
+		}
+		else {
+			fail("Invalid block type");
+		}
+
+		while (true) {
+			// Past the end the reader yields zeros, which can decode forever; a valid stream never gets there, since
+			// the Adler-32 trailer follows the last block.
+			if (reader.overran()) {
+				fail("Truncated deflate stream");
+			}
+			uint32_t symbol = literals.decode(reader);
+			if (symbol < 256) {
+				out.push_back(static_cast<uint8_t>(symbol));
+				continue;
+			}
+			if (symbol == 256) {
+				break;
+			}
+
+			symbol -= 257;
+			if (symbol >= 29) {
+				fail("Invalid length code");
+			}
+			uint32_t length = lengthBase[symbol] + reader.read(lengthExtra[symbol]);
+			uint32_t distanceSymbol = distances.decode(reader);
+			if (distanceSymbol >= 30) {
+				fail("Invalid distance code");
+			}
+			uint32_t distance = distanceBase[distanceSymbol] + reader.read(distanceExtra[distanceSymbol]);
+			if (distance > out.size()) {
+				fail("Distance before the start of the output");
+			}
+
+			// Byte by byte, since a match may overlap the bytes it is producing.
+			size_t from = out.size() - distance;
+			out.resize(out.size() + length);
+			uint8_t* write = out.data() + out.size() - length;
+			const uint8_t* read = out.data() + from;
+			for (uint32_t i = 0; i < length; ++i) {
+				write[i] = read[i];
+			}
+		}
+		if (reader.overran()) {
+			fail("Truncated deflate stream");
+		}
+	}
+}
+
+ImageFileFormat detectImageFormat(const uint8_t* data, size_t size) {
+	if (size >= sizeof(pngSignature) && memcmp(data, pngSignature, sizeof(pngSignature)) == 0) {
+		return ImageFileFormat::Png;
+	}
+	if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+		return ImageFileFormat::Jpeg;
+	}
+	if (size >= sizeof(ktx2Identifier) && memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) == 0) {
+		return ImageFileFormat::Ktx2;
+	}
+	return ImageFileFormat::Unknown;
+}
+
+DecodedImage decodeImage(const uint8_t* data, size_t size) {
+	switch (detectImageFormat(data, size)) {
+		case ImageFileFormat::Png:
+			return decodePng(data, size);
+		case ImageFileFormat::Jpeg:
+			fail("JPEG is not supported");
+		case ImageFileFormat::Ktx2:
+			fail("KTX2 holds GPU blocks, not pixels");
+		default:
+			fail("Unrecognised image format");
+	}
+}
+
+DecodedImage decodePng(const uint8_t* data, size_t size) {
+	if (detectImageFormat(data, size) != ImageFileFormat::Png) {
+		fail("Not a PNG");
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint8_t bitDepth = 0;
+	uint8_t colorType = 0;
+	uint8_t palette[256][4];
+	uint32_t paletteSize = 0;
+	bool hasTransparentGray = false;
+	uint16_t transparentGray = 0;
+	std::vector<uint8_t> compressed;
+
+	// Chunks: length, type, data, CRC. The CRC isn't checked; inflate catches real corruption.
+	size_t offset = sizeof(pngSignature);
+	bool sawEnd = false;
+	while (!sawEnd) {
+		if (size - offset < 12) {
+			fail("Truncated PNG");
+		}
+		uint32_t length = readBigEndian(data + offset);
+		const uint8_t* type = data + offset + 4;
+		const uint8_t* chunk = data + offset + 8;
+		if (length > size - offset - 12) {
+			fail("PNG chunk runs past the end of the file");
+		}
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+			width = readBigEndian(chunk);
+			height = readBigEndian(chunk + 4);
+			bitDepth = chunk[8];
+			colorType = chunk[9];
+			if (chunk[12] != 0) {
+				fail("Interlaced PNGs are not supported");
+			}
+		}
+		else if (memcmp(type, "PLTE", 4) == 0) {
+			paletteSize = std::min(length / 3, 256u);
+			for (uint32_t i = 0; i < paletteSize; ++i) {
+				palette[i][0] = chunk[i * 3];
+				palette[i][1] = chunk[i * 3 + 1];
+				palette[i][2] = chunk[i * 3 + 2];
+				palette[i][3] = 255;
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0) {
+			if (colorType == 3) {
+				for (uint32_t i = 0; i < std::min(length, paletteSize); ++i) {
+					palette[i][3] = chunk[i];
+				}
+			}
+			else if (colorType == 0 && length >= 2) {
+				hasTransparentGray = true;
+				transparentGray = static_cast<uint16_t>(chunk[0] << 8 | chunk[1]);
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0) {
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0) {
+			sawEnd = true;
+		}
+		offset += 12 + static_cast<size_t>(length);
+	}
+
+	uint32_t channels = 0;
+	switch (colorType) {
+		case 0: channels = 1; break;
+		case 2: channels = 3; break;
+		case 3: channels = 1; break;
+		case 4: channels = 2; break;
+		case 6: channels = 4; break;
+		default: fail("Invalid PNG colour type");
+	}
+	bool validDepth = bitDepth == 8 || (bitDepth == 16 && colorType != 3) || (bitDepth < 8 && (colorType == 0 || colorType == 3) && (bitDepth == 1 || bitDepth == 2 || bitDepth == 4));
+	if (!validDepth || width == 0 || height == 0 || width > maxImageDimension || height > maxImageDimension) {
+		fail("Unsupported PNG header");
+	}
+	if (colorType == 3 && paletteSize == 0) {
+		fail("Palette PNG without a palette");
+	}
+
+	size_t stride = (static_cast<size_t>(width) * channels * bitDepth + 7) / 8;
+	size_t filterStep = std::max<size_t>(1, channels * bitDepth / 8); // Bytes per pixel, at least one.
+	std::vector<uint8_t> raw;
+	raw.reserve((stride + 1) * height);
+	inflateZlib(compressed.data(), compressed.size(), raw);
+	if (raw.size() < (stride + 1) * height) {
+		fail("PNG image data is short");
+	}
+
+	// Unfilter in place. Each row is a filter type byte followed by stride bytes.
+	std::vector<uint8_t> zeroRow(stride, 0);
+	for (uint32_t y = 0; y < height; ++y) {
+		uint8_t* row = raw.data() + y * (stride + 1);
+		uint8_t filter = row[0];
+		uint8_t* current = row + 1;
+		const uint8_t* previous = y > 0 ? raw.data() + (y - 1) * (stride + 1) + 1 : zeroRow.data();
+		for (size_t x = 0; x < stride; ++x) {
+			uint8_t left = x >= filterStep ? current[x - filterStep] : 0;
+			uint8_t upLeft = x >= filterStep ? previous[x - filterStep] : 0;
+			switch (filter) {
+				case 0: break;
+				case 1: current[x] = static_cast<uint8_t>(current[x] + left); break;
+				case 2: current[x] = static_cast<uint8_t>(current[x] + previous[x]); break;
+				case 3: current[x] = static_cast<uint8_t>(current[x] + ((left + previous[x]) >> 1)); break;
+				case 4: current[x] = static_cast<uint8_t>(current[x] + paeth(left, previous[x], upLeft)); break;
+				default: fail("Invalid PNG filter");
+			}
+		}
+	}
+
+	DecodedImage image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height * 4);
+	uint32_t sampleMax = (1u << std::min<uint32_t>(bitDepth, 8)) - 1;
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* row = raw.data() + y * (stride + 1) + 1;
+		uint8_t* outRow = image.pixels.data() + static_cast<size_t>(y) * width * 4;
+		for (uint32_t x = 0; x < width; ++x) {
+			uint8_t* pixel = outRow + x * 4;
+			if (bitDepth < 8) {
+				// Packed samples, most significant bits first.
+				uint32_t bit = x * bitDepth;
+				uint32_t sample = (row[bit / 8] >> (8 - bitDepth - bit % 8)) & sampleMax;
+				if (colorType == 3) {
+					memcpy(pixel, palette[std::min(sample, paletteSize - 1)], 4);
+				}
+				else {
+					uint8_t gray = static_cast<uint8_t>(sample * 255 / sampleMax);
+					pixel[0] = pixel[1] = pixel[2] = gray;
+					pixel[3] = hasTransparentGray && sample == transparentGray ? 0 : 255;
+				}
+				continue;
+			}
+
+			// 16-bit samples are big endian, so the first byte of each is the high byte.
+			size_t sampleBytes = bitDepth / 8;
+			const uint8_t* source = row + static_cast<size_t>(x) * channels * sampleBytes;
+			auto sample = [&](uint32_t channel) { return source[channel * sampleBytes]; };
+			switch (colorType) {
+				case 0: {
+					pixel[0] = pixel[1] = pixel[2] = sample(0);
+					uint16_t full = sampleBytes == 2 ? static_cast<uint16_t>(source[0] << 8 | source[1]) : source[0];
+					pixel[3] = hasTransparentGray && full == transparentGray ? 0 : 255;
+					break;
+				}
+				case 2: pixel[0] = sample(0); pixel[1] = sample(1); pixel[2] = sample(2); pixel[3] = 255; break;
+				case 3: memcpy(pixel, palette[std::min<uint32_t>(source[0], paletteSize - 1)], 4); break;
+				case 4: pixel[0] = pixel[1] = pixel[2] = sample(0); pixel[3] = sample(1); break;
+				case 6: pixel[0] = sample(0); pixel[1] = sample(1); pixel[2] = sample(2); pixel[3] = sample(3); break;
+			}
+		}
+	}
+	return image;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tightly packed RGBA8 rows, top row first.
+struct DecodedImage {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+enum class ImageFileFormat {
+	Unknown,
+	Png,
+	Jpeg,
+	Ktx2 // GPU blocks rather than pixels: ktx2Texture.h loads these.
+};
+
+// From the leading bytes, since glTF mime types are optional and file extensions can lie.
+ImageFileFormat detectImageFormat(const uint8_t* data, size_t size);
+
+/*
+	Image Decoder
+	- PNG: every colour type and bit depth, converted to RGBA8. 16-bit channels keep their high byte. Adam7
+	  interlacing is not supported.
+	- Inflate uses a single-level table per Huffman code, so each symbol is one lookup.
+	- JPEG is recognised but not decoded; callers keep their placeholder for it. KTX2 is recognised and left to loadKtx2.
+	- Throws std::runtime_error on anything it can't decode.
+*/
+DecodedImage decodeImage(const uint8_t* data, size_t size);
+DecodedImage decodePng(const uint8_t* data, size_t size);
+
+// zlib stream (RFC 1950 wrapper around RFC 1951 deflate) into out, which is appended to.
+void inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
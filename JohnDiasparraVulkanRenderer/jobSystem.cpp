@@ -0,0 +1,218 @@
+#include "jobSystem.h"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	thread_local uint32_t threadIndex = 0;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) {
+	if (workerCount == 0) {
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i <= workerCount; ++i) {
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+	for (uint32_t i = 1; i <= workerCount; ++i) {
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		running.store(false);
+	}
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+uint32_t JobSystem::currentThreadIndex() {
+	return threadIndex;
+}
+
+JobSystem::Job JobSystem::countJob(Job job, JobCounter* counter) {
+	if (!counter) {
+		return job;
+	}
+	counter->pending.fetch_add(1, std::memory_order_relaxed);
+	return [inner = std::move(job), counter]() {
+		try {
+			inner();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(counter->errorMutex);
+			if (!counter->error) {
+				counter->error = std::current_exception();
+			}
+		}
+		counter->pending.fetch_sub(1, std::memory_order_release);
+	};
+}
+
+void JobSystem::submit(Job job, JobCounter* counter) {
+	push(*queues[threadIndex], countJob(std::move(job), counter));
+}
+
+void JobSystem::submitBackground(Job job, JobCounter* counter) {
+	push(backgroundQueue, countJob(std::move(job), counter));
+}
+
+void JobSystem::push(WorkQueue& queue, Job job) {
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	// Taking the sleep lock orders this increment against a worker checking the count before it sleeps.
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedJobs.fetch_add(1, std::memory_order_release);
+	}
+	wakeCondition.notify_one();
+}
+
+bool JobSystem::popLocal(uint32_t index, Job& job) {
+	WorkQueue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) {
+		return false;
+	}
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool JobSystem::steal(uint32_t index, Job& job) {
+	uint32_t queueCount = static_cast<uint32_t>(queues.size());
+
+	// Start at the next queue over so thieves spread out instead of all hammering queue 0.
+	for (uint32_t offset = 1; offset < queueCount; ++offset) {
+		WorkQueue& victim = *queues[(index + offset) % queueCount];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+		if (!lock.owns_lock() || victim.jobs.empty()) {
+			continue;
+		}
+		job = std::move(victim.jobs.front());
+		victim.jobs.pop_front();
+		return true;
+	}
+	return false;
+}
+
+bool JobSystem::popBackground(Job& job) {
+	std::lock_guard<std::mutex> lock(backgroundQueue.mutex);
+	if (backgroundQueue.jobs.empty()) {
+		return false;
+	}
+	job = std::move(backgroundQueue.jobs.front());
+	backgroundQueue.jobs.pop_front();
+	return true;
+}
+
+bool JobSystem::tryRunOne(uint32_t index) {
+	// Workers fall back on background jobs, including while they wait, so background jobs may wait on each other.
+	Job job;
+	if (!popLocal(index, job) && !steal(index, job) && (index == 0 || !popBackground(job))) {
+		return false;
+	}
+	queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	job();
+	return true;
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+	threadIndex = index;
+	CpuProfiler::setThreadName("Job Worker " + std::to_string(index));
+
+	while (running.load(std::memory_order_relaxed)) {
+		if (tryRunOne(index)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this]() {
+			return queuedJobs.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_relaxed);
+		});
+	}
+}
+
+void JobSystem::wait(JobCounter& counter) {
+	uint32_t index = threadIndex;
+	while (!counter.isDone()) {
+		if (!tryRunOne(index)) {
+			// Whatever is left is running on another thread; don't burn the core it may need.
+			std::this_thread::yield();
+		}
+	}
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.errorMutex);
+		error.swap(counter.error);
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& body) {
+	batchSize = std::max(1u, batchSize);
+
+	JobCounter counter;
+	for (uint32_t begin = 0; begin < count; begin += batchSize) {
+		uint32_t end = std::min(count, begin + batchSize);
+		submit([&body, begin, end]() { body(begin, end); }, &counter);
+	}
+	wait(counter);
+}
+
+TaskGraph::TaskId TaskGraph::addTask(std::function<void()> task) {
+	auto node = std::make_unique<Node>();
+	node->task = std::move(task);
+	nodes.push_back(std::move(node));
+	return static_cast<TaskId>(nodes.size() - 1);
+}
+
+void TaskGraph::addDependency(TaskId before, TaskId after) {
+	nodes[before]->successors.push_back(after);
+	nodes[after]->dependencyCount++;
+}
+
+void TaskGraph::schedule(JobSystem& jobSystem, TaskId id, JobCounter& counter) {
+	jobSystem.submit([this, &jobSystem, id, &counter]() {
+		Node& node = *nodes[id];
+		node.task();
+
+		// Whichever predecessor finishes last releases the successor.
+		for (TaskId successor : node.successors) {
+			if (nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				schedule(jobSystem, successor, counter);
+			}
+		}
+	}, &counter);
+}
+
+void TaskGraph::execute(JobSystem& jobSystem) {
+	for (auto& node : nodes) {
+		node->remaining.store(node->dependencyCount, std::memory_order_relaxed);
+	}
+
+	JobCounter counter;
+	for (TaskId id = 0; id < nodes.size(); ++id) {
+		if (nodes[id]->dependencyCount == 0) {
+			schedule(jobSystem, id, counter);
+		}
+	}
+	jobSystem.wait(counter);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tracks a group of submitted jobs. JobSystem::wait on it runs other jobs instead of blocking, then rethrows the first
+// exception any of them threw.
+class JobCounter {
+
+	public:
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+		std::atomic<uint32_t> pending{ 0 };
+		std::mutex errorMutex;
+		std::exception_ptr error;
+};
+
+/*
+	Job System
+	- One deque per thread. Owners push and pop at the back (LIFO, cache warm); idle threads steal from the front of others.
+	- Thread index 0 is whichever thread is not a worker (normally the main thread), so per-thread resources can be
+	  sized with getThreadCount() and indexed with currentThreadIndex().
+	- Waiting is cooperative: a thread waiting on a counter keeps executing jobs, so nested parallelism cannot deadlock.
+	- Background jobs go to a separate queue that only workers take from, once they are out of other work. Long jobs
+	  submitted from the main thread that way never end up running inside one of its waits.
+*/
+class JobSystem {
+
+	public:
+		using Job = std::function<void()>;
+
+		explicit JobSystem(uint32_t workerCount = 0); // Zero uses one worker per hardware thread beyond the caller's.
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// A job that throws still counts as finished; its counter carries the exception back to wait. One without a
+		// counter has nowhere to send it, and would terminate the process if it threw on a worker.
+		void submit(Job job, JobCounter* counter = nullptr);
+		// For work that must not hold up the thread submitting it: loading, decoding, startup stages.
+		void submitBackground(Job job, JobCounter* counter = nullptr);
+		void wait(JobCounter& counter);
+		// Splits [0, count) into batches and blocks (while helping) until every batch has run.
+		void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& body);
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(queues.size()); }
+		static uint32_t currentThreadIndex();
+
+	private:
+		struct WorkQueue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		WorkQueue backgroundQueue; // First in, first out.
+		std::vector<std::thread> workers;
+		std::atomic<bool> running{ true };
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+
+		static Job countJob(Job job, JobCounter* counter);
+		void push(WorkQueue& queue, Job job);
+		bool tryRunOne(uint32_t threadIndex);
+		bool popLocal(uint32_t threadIndex, Job& job);
+		bool steal(uint32_t threadIndex, Job& job);
+		bool popBackground(Job& job);
+		void workerLoop(uint32_t threadIndex);
+};
+
+/*
+	Task Graph
+	- Tasks plus "runs before" edges. execute() submits every task with no unfinished dependencies and releases
+	  successors as their dependencies complete, so independent branches run in parallel.
+*/
+class TaskGraph {
+
+	public:
+		using TaskId = uint32_t;
+
+		TaskId addTask(std::function<void()> task);
+		void addDependency(TaskId before, TaskId after);
+		void execute(JobSystem& jobSystem); // Blocks (while helping) until every task has run.
+
+	private:
+		struct Node {
+			std::function<void()> task;
+			std::vector<TaskId> successors;
+			uint32_t dependencyCount = 0;
+			std::atomic<uint32_t> remaining{ 0 };
+		};
+
+		std::vector<std::unique_ptr<Node>> nodes;
+
+		void schedule(JobSystem& jobSystem, TaskId id, JobCounter& counter);
+};
@@ -0,0 +1,293 @@
+#include "json.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+	const JsonValue nullValue;
+	const uint32_t maxDepth = 256; // Deeper than any real asset, shallow enough that recursion can't overflow the stack.
+}
+
+// Recursive descent over the whole buffer. The text needn't be null terminated.
+class JsonParser {
+
+	public:
+		JsonParser(const char* text, size_t length) : cursor(text), begin(text), end(text + length) {}
+
+		JsonValue parseDocument() {
+			JsonValue value = parseValue(0);
+			skipWhitespace();
+			if (cursor != end) {
+				fail("Unexpected data after the document");
+			}
+			return value;
+		}
+
+	private:
+		const char* cursor;
+		const char* begin;
+		const char* end;
+
+		[[noreturn]] void fail(const char* message) const {
+			throw std::runtime_error(std::string("JSON: ") + message + " at byte " + std::to_string(cursor - begin) + ".");
+		}
+
+		void skipWhitespace() {
+			while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+				++cursor;
+			}
+		}
+
+		bool consume(char c) {
+			skipWhitespace();
+			if (cursor < end && *cursor == c) {
+				++cursor;
+				return true;
+			}
+			return false;
+		}
+
+		void expect(char c, const char* message) {
+			if (!consume(c)) {
+				fail(message);
+			}
+		}
+
+		bool consumeLiteral(const char* literal) {
+			size_t length = strlen(literal);
+			if (static_cast<size_t>(end - cursor) >= length && memcmp(cursor, literal, length) == 0) {
+				cursor += length;
+				return true;
+			}
+			return false;
+		}
+
+		JsonValue parseValue(uint32_t depth) {
+			if (depth > maxDepth) {
+				fail("Nesting too deep");
+			}
+			skipWhitespace();
+			if (cursor >= end) {
+				fail("Unexpected end of input");
+			}
+
+			JsonValue value;
+			switch (*cursor) {
+				case '{':
+					++cursor;
+					value.type = JsonValue::Type::Object;
+					if (consume('}')) {
+						break;
+					}
+					do {
+						skipWhitespace();
+						if (cursor >= end || *cursor != '"') {
+							fail("Expected a member name");
+						}
+						std::string key = parseString();
+						expect(':', "Expected ':' after a member name");
+						value.members.emplace_back(std::move(key), parseValue(depth + 1));
+					} while (consume(','));
+					expect('}', "Expected ',' or '}' in an object");
+					break;
+				case '[':
+					++cursor;
+					value.type = JsonValue::Type::Array;
+					if (consume(']')) {
+						break;
+					}
+					do {
+						value.elements.push_back(parseValue(depth + 1));
+					} while (consume(','));
+					expect(']', "Expected ',' or ']' in an array");
+					break;
+				case '"':
+					value.type = JsonValue::Type::String;
+					value.text = parseString();
+					break;
+				case 't':
+				case 'f':
+					value.type = JsonValue::Type::Bool;
+					if (consumeLiteral("true")) {
+						value.boolean = true;
+					}
+					else if (!consumeLiteral("false")) {
+						fail("Invalid literal");
+					}
+					break;
+				case 'n':
+					if (!consumeLiteral("null")) {
+						fail("Invalid literal");
+					}
+					break;
+				default:
+					value.type = JsonValue::Type::Number;
+					value.number = parseNumber();
+					break;
+			}
+			return value;
+		}
+
+		double parseNumber() {
+			const char* start = cursor;
+			bool negative = cursor < end && *cursor == '-';
+			if (negative) {
+				++cursor;
+			}
+
+			double value = 0.0;
+			bool anyDigits = false;
+			while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+				value = value * 10.0 + (*cursor++ - '0');
+				anyDigits = true;
+			}
+			if (cursor < end && *cursor == '.') {
+				++cursor;
+				double scale = 0.1;
+				while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+					value += (*cursor++ - '0') * scale;
+					scale *= 0.1;
+					anyDigits = true;
+				}
+			}
+			if (!anyDigits) {
+				cursor = start;
+				fail("Expected a value");
+			}
+			if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+				++cursor;
+				bool negativeExponent = cursor < end && *cursor == '-';
+				if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+					++cursor;
+				}
+				int exponent = 0;
+				while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+					exponent = std::min(exponent * 10 + (*cursor++ - '0'), 1000);
+				}
+				value *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+			}
+			return negative ? -value : value;
+		}
+
+		uint32_t parseHex4() {
+			if (end - cursor < 4) {
+				fail("Truncated \\u escape");
+			}
+			uint32_t code = 0;
+			for (int i = 0; i < 4; ++i) {
+				char c = *cursor++;
+				code <<= 4;
+				if (c >= '0' && c <= '9') {
+					code |= c - '0';
+				}
+				else if (c >= 'a' && c <= 'f') {
+					code |= c - 'a' + 10;
+				}
+				else if (c >= 'A' && c <= 'F') {
+					code |= c - 'A' + 10;
+				}
+				else {
+					fail("Invalid \\u escape");
+				}
+			}
+			return code;
+		}
+
+		static void appendUtf8(std::string& out, uint32_t code) {
+			if (code < 0x80) {
+				out.push_back(static_cast<char>(code));
+			}
+			else if (code < 0x800) {
+				out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+			else if (code < 0x10000) {
+				out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+			else {
+				out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+		}
+
+		// Called with the cursor on the opening quote.
+		std::string parseString() {
+			++cursor;
+			std::string out;
+			while (true) {
+				// Copy runs without escapes in one go; asset strings rarely have any.
+				const char* run = cursor;
+				while (cursor < end && *cursor != '"' && *cursor != '\\') {
+					++cursor;
+				}
+				out.append(run, cursor);
+				if (cursor >= end) {
+					fail("Unterminated string");
+				}
+				if (*cursor++ == '"') {
+					return out;
+				}
+
+				if (cursor >= end) {
+					fail("Unterminated string");
+				}
+				char escape = *cursor++;
+				switch (escape) {
+					case '"': out.push_back('"'); break;
+					case '\\': out.push_back('\\'); break;
+					case '/': out.push_back('/'); break;
+					case 'b': out.push_back('\b'); break;
+					case 'f': out.push_back('\f'); break;
+					case 'n': out.push_back('\n'); break;
+					case 'r': out.push_back('\r'); break;
+					case 't': out.push_back('\t'); break;
+					case 'u': {
+						uint32_t code = parseHex4();
+						// A high surrogate must be followed by a low one; together they make one code point.
+						if (code >= 0xD800 && code <= 0xDBFF && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+							cursor += 2;
+							uint32_t low = parseHex4();
+							code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						}
+						appendUtf8(out, code);
+						break;
+					}
+					default:
+						fail("Invalid escape");
+				}
+			}
+		}
+};
+
+uint32_t JsonValue::asUint(uint32_t fallback) const {
+	if (type != Type::Number || number < 0.0 || number > 4294967295.0) {
+		return fallback;
+	}
+	return static_cast<uint32_t>(number);
+}
+
+const JsonValue& JsonValue::at(size_t index) const {
+	return type == Type::Array && index < elements.size() ? elements[index] : nullValue;
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const {
+	if (type == Type::Object) {
+		for (const auto& member : members) {
+			if (member.first == key) {
+				return member.second;
+			}
+		}
+	}
+	return nullValue;
+}
+
+JsonValue parseJson(const char* text, size_t length) {
+	return JsonParser(text, length).parseDocument();
+}
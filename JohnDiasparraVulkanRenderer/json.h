@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+	JSON
+	- Just enough for asset manifests like glTF: the whole document is parsed once into a tree, which is then only read.
+	- Objects keep their members in file order and look keys up linearly. Asset JSON objects have a handful of keys,
+	  where that beats hashing.
+	- Lookups of missing members, or of the wrong type, return the caller's fallback rather than throwing, since most
+	  glTF properties are optional.
+*/
+class JsonValue {
+
+	public:
+		enum class Type {
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type getType() const { return type; }
+		bool isNull() const { return type == Type::Null; }
+		bool isNumber() const { return type == Type::Number; }
+		bool isString() const { return type == Type::String; }
+		bool isArray() const { return type == Type::Array; }
+		bool isObject() const { return type == Type::Object; }
+
+		bool asBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+		double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+		uint32_t asUint(uint32_t fallback = 0) const;
+		const std::string& asString() const { return text; } // Empty unless this is a string.
+
+		// Arrays: elements. Objects: member values in file order.
+		size_t size() const { return type == Type::Object ? members.size() : elements.size(); }
+		const JsonValue& at(size_t index) const; // A null value when out of range or not an array.
+		const JsonValue& operator[](const char* key) const; // A null value when missing or not an object.
+		bool has(const char* key) const { return !(*this)[key].isNull(); }
+		const std::vector<JsonValue>& getElements() const { return elements; }
+		const std::vector<std::pair<std::string, JsonValue>>& getMembers() const { return members; }
+
+	private:
+		friend class JsonParser;
+
+		Type type = Type::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string text;
+		std::vector<JsonValue> elements;
+		std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+// Throws std::runtime_error with the byte offset of the first syntax error.
+JsonValue parseJson(const char* text, size_t length);
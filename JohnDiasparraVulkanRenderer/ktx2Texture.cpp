@@ -0,0 +1,319 @@
+#include "ktx2Texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "cpuProfiler.h"
+#include "imageDecoder.h"
+
+namespace {
+
+	const size_t ktx2HeaderSize = 80; // Identifier, header and index; the level index follows.
+	const size_t ktx2LevelEntrySize = 24;
+	const uint32_t maxTextureDimension = 16384; // The largest 2D image any Vulkan device has to support.
+
+	const uint32_t supercompressionNone = 0;
+	const uint32_t supercompressionBasisLz = 1;
+	const uint32_t supercompressionZstd = 2;
+	const uint32_t supercompressionZlib = 3;
+	const uint8_t colorModelUastc = 166; // Khronos Data Format colorModel of UASTC payloads.
+
+	struct BlockFormat {
+		VkFormat format; // As stored in the file.
+		VkFormat loaded; // What the image is created with.
+		uint32_t blockWidth;
+		uint32_t blockHeight;
+		uint32_t blockBytes;
+	};
+
+	const BlockFormat blockFormats[] = {
+		{ VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4 },
+		{ VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4 },
+		{ VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC2_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_BC2_SRGB_BLOCK, VK_FORMAT_BC2_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK, 4, 4, 8 },
+		{ VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 4, 4, 16 },
+		{ VK_FORMAT_ASTC_4x4_SRGB_BLOCK, VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 4, 4, 16 },
+	};
+
+	[[noreturn]] void fail(const std::string& message) {
+		throw std::runtime_error("KTX2: " + message + ".");
+	}
+
+	uint32_t readU32(const uint8_t* bytes) {
+		uint32_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	uint64_t readU64(const uint8_t* bytes) {
+		uint64_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	const BlockFormat* findBlockFormat(VkFormat format) {
+		for (const BlockFormat& blockFormat : blockFormats) {
+			if (blockFormat.format == format) {
+				return &blockFormat;
+			}
+		}
+		return nullptr;
+	}
+
+	uint64_t levelSize(const BlockFormat& format, uint32_t width, uint32_t height) {
+		uint64_t blocksWide = (width + format.blockWidth - 1) / format.blockWidth;
+		uint64_t blocksHigh = (height + format.blockHeight - 1) / format.blockHeight;
+		return blocksWide * blocksHigh * format.blockBytes;
+	}
+
+	// The four BC1 palette entries. BC2 and BC3 always use four opaque colours; BC1 switches to three plus transparent
+	// black when the endpoints are in descending order.
+	void decodeBc1Palette(const uint8_t* block, bool allowTransparent, uint8_t palette[4][4]) {
+		uint32_t endpoints[2] = { static_cast<uint32_t>(block[0] | (block[1] << 8)), static_cast<uint32_t>(block[2] | (block[3] << 8)) };
+		for (uint32_t i = 0; i < 2; ++i) {
+			uint32_t r = (endpoints[i] >> 11) & 31;
+			uint32_t g = (endpoints[i] >> 5) & 63;
+			uint32_t b = endpoints[i] & 31;
+			palette[i][0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+			palette[i][1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+			palette[i][2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+			palette[i][3] = 255;
+		}
+		bool fourColors = !allowTransparent || endpoints[0] > endpoints[1];
+		for (uint32_t channel = 0; channel < 3; ++channel) {
+			uint32_t c0 = palette[0][channel];
+			uint32_t c1 = palette[1][channel];
+			palette[2][channel] = static_cast<uint8_t>(fourColors ? (2 * c0 + c1) / 3 : (c0 + c1) / 2);
+			palette[3][channel] = static_cast<uint8_t>(fourColors ? (c0 + 2 * c1) / 3 : 0);
+		}
+		palette[2][3] = 255;
+		palette[3][3] = fourColors ? 255 : 0;
+	}
+
+	// BC1-BC3 to RGBA8, for devices without BC support. One block's 16 texels at a time, clipped at the edges.
+	std::vector<uint8_t> decodeBcLevel(VkFormat format, const uint8_t* data, uint32_t width, uint32_t height) {
+		bool hasAlphaBlock = format == VK_FORMAT_BC2_UNORM_BLOCK || format == VK_FORMAT_BC3_UNORM_BLOCK;
+		uint32_t blockBytes = hasAlphaBlock ? 16 : 8;
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+
+		for (uint32_t blockY = 0; blockY < height; blockY += 4) {
+			for (uint32_t blockX = 0; blockX < width; blockX += 4, data += blockBytes) {
+				const uint8_t* colorBlock = data + (hasAlphaBlock ? 8 : 0);
+				uint8_t palette[4][4];
+				decodeBc1Palette(colorBlock, format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK, palette);
+				uint32_t colorIndices = readU32(colorBlock + 4);
+
+				uint8_t alphas[8] = {};
+				uint64_t alphaBits = 0;
+				if (format == VK_FORMAT_BC3_UNORM_BLOCK) {
+					uint32_t a0 = data[0];
+					uint32_t a1 = data[1];
+					alphas[0] = static_cast<uint8_t>(a0);
+					alphas[1] = static_cast<uint8_t>(a1);
+					for (uint32_t i = 2; i < 8; ++i) {
+						alphas[i] = static_cast<uint8_t>(a0 > a1 ? ((8 - i) * a0 + (i - 1) * a1) / 7
+							: i < 6 ? ((6 - i) * a0 + (i - 1) * a1) / 5 : (i == 6 ? 0 : 255));
+					}
+					for (uint32_t i = 0; i < 6; ++i) {
+						alphaBits |= static_cast<uint64_t>(data[2 + i]) << (8 * i);
+					}
+				}
+				else if (format == VK_FORMAT_BC2_UNORM_BLOCK) {
+					alphaBits = readU64(data);
+				}
+
+				for (uint32_t y = 0; y < 4 && blockY + y < height; ++y) {
+					for (uint32_t x = 0; x < 4 && blockX + x < width; ++x) {
+						uint32_t texel = y * 4 + x;
+						uint8_t* out = &pixels[(static_cast<size_t>(blockY + y) * width + blockX + x) * 4];
+						memcpy(out, palette[(colorIndices >> (2 * texel)) & 3], 4);
+						if (format == VK_FORMAT_BC2_UNORM_BLOCK) {
+							out[3] = static_cast<uint8_t>(((alphaBits >> (4 * texel)) & 15) * 17);
+						}
+						else if (format == VK_FORMAT_BC3_UNORM_BLOCK) {
+							out[3] = alphas[(alphaBits >> (3 * texel)) & 7];
+						}
+					}
+				}
+			}
+		}
+		return pixels;
+	}
+}
+
+bool TextureFormatSupport::supports(VkFormat format) const {
+	return std::find(formats.begin(), formats.end(), format) != formats.end();
+}
+
+void TextureFormatSupport::enableFeatures(VkPhysicalDeviceFeatures& features) const {
+	if (bc) {
+		features.textureCompressionBC = VK_TRUE;
+	}
+	if (etc2) {
+		features.textureCompressionETC2 = VK_TRUE;
+	}
+	if (astc) {
+		features.textureCompressionASTC_LDR = VK_TRUE;
+	}
+}
+
+std::string TextureFormatSupport::describe() const {
+	std::string families;
+	for (const auto& family : { std::make_pair(bc, "BC"), std::make_pair(etc2, "ETC2"), std::make_pair(astc, "ASTC 4x4") }) {
+		if (family.first) {
+			families += (families.empty() ? "" : ", ") + std::string(family.second);
+		}
+	}
+	return families.empty() ? "none" : families;
+}
+
+TextureFormatSupport queryTextureFormatSupport(VkPhysicalDevice physicalDevice) {
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	TextureFormatSupport support;
+	for (const BlockFormat& blockFormat : blockFormats) {
+		if (blockFormat.format != blockFormat.loaded) {
+			continue; // sRGB twins load as their UNORM format.
+		}
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, blockFormat.format, &properties);
+		if ((properties.optimalTilingFeatures & required) == required) {
+			support.formats.push_back(blockFormat.format);
+		}
+	}
+	for (VkFormat format : support.formats) {
+		support.bc |= format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+		support.etc2 |= format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK;
+		support.astc |= format == VK_FORMAT_ASTC_4x4_UNORM_BLOCK;
+	}
+	return support;
+}
+
+TextureFormatSupport allTextureFormats() {
+	TextureFormatSupport support;
+	for (const BlockFormat& blockFormat : blockFormats) {
+		if (blockFormat.format == blockFormat.loaded) {
+			support.formats.push_back(blockFormat.format);
+		}
+	}
+	support.bc = true;
+	support.etc2 = true;
+	support.astc = true;
+	return support;
+}
+
+TextureLevels loadKtx2(const uint8_t* data, size_t size, const TextureFormatSupport& support) {
+	CPU_PROFILE_SCOPE("loadKtx2");
+	if (detectImageFormat(data, size) != ImageFileFormat::Ktx2 || size < ktx2HeaderSize) {
+		fail("Not a KTX2 file");
+	}
+
+	VkFormat fileFormat = static_cast<VkFormat>(readU32(data + 12));
+	uint32_t width = readU32(data + 20);
+	uint32_t height = readU32(data + 24);
+	uint32_t depth = readU32(data + 28);
+	uint32_t layerCount = readU32(data + 32);
+	uint32_t faceCount = readU32(data + 36);
+	uint32_t levelCount = std::max(readU32(data + 40), 1u); // Zero asks the loader to generate mips; level 0 is all there is.
+	uint32_t supercompression = readU32(data + 44);
+	uint32_t dfdOffset = readU32(data + 48);
+	uint32_t dfdSize = readU32(data + 52);
+
+	if (depth != 0 || layerCount > 1 || faceCount != 1 || height == 0) {
+		fail("Only single 2D textures are supported");
+	}
+	if (width == 0 || width > maxTextureDimension || height > maxTextureDimension) {
+		fail("Texture size is out of range");
+	}
+	if (levelCount > 32 || (std::max(width, height) >> (levelCount - 1)) == 0) {
+		fail("More levels than the texture size allows");
+	}
+	if (size - ktx2HeaderSize < static_cast<size_t>(levelCount) * ktx2LevelEntrySize) {
+		fail("Truncated level index");
+	}
+
+	// Basis Universal stores UNDEFINED and says what it holds through the supercompression scheme or the DFD colour model.
+	if (supercompression == supercompressionBasisLz) {
+		fail("BasisLZ/ETC1S needs the Basis Universal transcoder, which this build doesn't include");
+	}
+	if (fileFormat == VK_FORMAT_UNDEFINED) {
+		bool uastc = dfdSize >= 16 && dfdOffset <= size - 16 && data[dfdOffset + 12] == colorModelUastc;
+		fail(uastc ? "UASTC needs the Basis Universal transcoder, which this build doesn't include" : "Texture has no Vulkan format");
+	}
+	if (supercompression == supercompressionZstd) {
+		fail("Zstd supercompression needs a decoder this build doesn't include");
+	}
+	if (supercompression != supercompressionNone && supercompression != supercompressionZlib) {
+		fail("Unknown supercompression scheme " + std::to_string(supercompression));
+	}
+
+	const BlockFormat* format = findBlockFormat(fileFormat);
+	if (!format) {
+		fail("Format " + std::to_string(fileFormat) + " is not supported");
+	}
+	// Only RGBA8 and BC1-BC3 have a fallback when the device can't sample the blocks.
+	VkFormat loadedFormat = format->loaded;
+	bool decodeToRgba = false;
+	if (loadedFormat != VK_FORMAT_R8G8B8A8_UNORM && !support.supports(loadedFormat)) {
+		decodeToRgba = loadedFormat == VK_FORMAT_BC1_RGB_UNORM_BLOCK || loadedFormat == VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+			|| loadedFormat == VK_FORMAT_BC2_UNORM_BLOCK || loadedFormat == VK_FORMAT_BC3_UNORM_BLOCK;
+		if (!decodeToRgba) {
+			fail("Device can't sample format " + std::to_string(loadedFormat) + " and there is no fallback for it");
+		}
+	}
+
+	TextureLevels texture;
+	texture.format = decodeToRgba ? VK_FORMAT_R8G8B8A8_UNORM : loadedFormat;
+	texture.width = width;
+	texture.height = height;
+	texture.levels.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		const uint8_t* entry = data + ktx2HeaderSize + static_cast<size_t>(level) * ktx2LevelEntrySize;
+		uint64_t offset = readU64(entry);
+		uint64_t length = readU64(entry + 8);
+		uint64_t uncompressedLength = readU64(entry + 16);
+		uint32_t levelWidth = std::max(width >> level, 1u);
+		uint32_t levelHeight = std::max(height >> level, 1u);
+		uint64_t expected = levelSize(*format, levelWidth, levelHeight);
+		if (offset > size || length > size - offset) {
+			fail("Level " + std::to_string(level) + " runs past the end of the file");
+		}
+
+		std::vector<uint8_t>& blocks = texture.levels[level];
+		if (supercompression == supercompressionZlib) {
+			if (uncompressedLength != expected) {
+				fail("Level " + std::to_string(level) + " has the wrong size for its format");
+			}
+			blocks.reserve(static_cast<size_t>(expected));
+			inflateZlib(data + offset, static_cast<size_t>(length), blocks);
+		}
+		else {
+			blocks.assign(data + offset, data + offset + length);
+		}
+		if (blocks.size() != expected) {
+			fail("Level " + std::to_string(level) + " has the wrong size for its format");
+		}
+
+		if (decodeToRgba) {
+			blocks = decodeBcLevel(loadedFormat, blocks.data(), levelWidth, levelHeight);
+		}
+	}
+	return texture;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A texture in the format its image is created with: every level finest first, each tightly packed blocks (or texels).
+struct TextureLevels {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0; // Of level 0.
+	uint32_t height = 0;
+	std::vector<std::vector<uint8_t>> levels;
+};
+
+// Block formats the picked device can copy into and sample with linear filtering.
+struct TextureFormatSupport {
+	std::vector<VkFormat> formats;
+	bool bc = false; // Any of each family.
+	bool etc2 = false;
+	bool astc = false; // ASTC 4x4 LDR.
+
+	bool supports(VkFormat format) const;
+	// Each family's formats report support only when its device feature does, but are usable only once it is enabled.
+	void enableFeatures(VkPhysicalDeviceFeatures& features) const;
+	std::string describe() const; // "BC, ETC2, ASTC 4x4" or "none".
+};
+
+// vkGetPhysicalDeviceFormatProperties for every block format loadKtx2 understands.
+TextureFormatSupport queryTextureFormatSupport(VkPhysicalDevice physicalDevice);
+// Every one of them, for offline tools that keep blocks exactly as stored.
+TextureFormatSupport allTextureFormats();
+
+/*
+	KTX2 Loader
+	- 2D textures of BC1-BC5, BC7, ETC2 or ASTC 4x4 blocks, or RGBA8, with or without zlib supercompression. The blocks
+	  go to the GPU as they are, so a texture costs 4-8x less memory and upload bandwidth than decoding it to RGBA8.
+	- Formats the device can't sample are transcoded instead: BC1-BC3 are decoded to RGBA8 (on whichever thread calls
+	  this, so decode jobs keep it off the main thread). Other unsupported formats are rejected.
+	- sRGB formats load as their UNORM twins, like every other texture the renderer samples.
+	- Basis Universal payloads (BasisLZ/ETC1S and UASTC) and Zstd supercompression need libraries this build doesn't
+	  include, so they are rejected with a message saying so.
+	- Throws std::runtime_error on anything it can't load; callers keep their placeholder.
+*/
+TextureLevels loadKtx2(const uint8_t* data, size_t size, const TextureFormatSupport& support);
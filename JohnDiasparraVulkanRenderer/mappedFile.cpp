@@ -0,0 +1,125 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		close();
+		data = std::exchange(other.data, nullptr);
+		size = std::exchange(other.size, 0);
+		path = std::move(other.path);
+#ifdef _WIN32
+		fileHandle = std::exchange(other.fileHandle, nullptr);
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+	}
+	return *this;
+}
+
+void MappedFile::open(const std::string& path) {
+	close();
+	this->path = path;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open " + path + ".");
+	}
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map " + path + ": empty or unreadable.");
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map " + path + ".");
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw std::runtime_error("Failed to open " + path + ".");
+	}
+	struct stat status {};
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		::close(file);
+		throw std::runtime_error("Failed to map " + path + ": empty or unreadable.");
+	}
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file); // The mapping keeps its own reference to the file.
+	if (view == MAP_FAILED) {
+		throw std::runtime_error("Failed to map " + path + ".");
+	}
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<size_t>(status.st_size);
+#endif
+}
+
+void MappedFile::close() {
+	if (!data) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(static_cast<HANDLE>(mappingHandle));
+	CloseHandle(static_cast<HANDLE>(fileHandle));
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+	if (!data || offset >= this->size) {
+		return;
+	}
+	size = std::min(size, this->size - offset);
+
+	// Only a hint, so failure is ignored.
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<uint8_t*>(data) + offset, size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	// madvise wants a page-aligned start.
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t alignedOffset = offset / pageSize * pageSize;
+	madvise(const_cast<uint8_t*>(data) + alignedOffset, size + (offset - alignedOffset), MADV_WILLNEED);
+#endif
+}
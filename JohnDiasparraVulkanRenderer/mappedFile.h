@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+	Mapped File
+	- Read-only view of a whole file through the OS page cache. Nothing is read until a page is touched, and pages the
+	  OS already has cached cost no copy at all.
+	- prefetch() asks the OS to start reading a range in the background, so a later memcpy out of it doesn't stall on
+	  one page fault after another.
+*/
+class MappedFile {
+
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		void open(const std::string& path); // Throws if the file can't be opened or mapped.
+		void close();
+		void prefetch(size_t offset, size_t size) const;
+
+		bool isOpen() const { return data != nullptr; }
+		const uint8_t* getData() const { return data; }
+		size_t getSize() const { return size; }
+		const std::string& getPath() const { return path; }
+
+	private:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		std::string path;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,275 @@
+#include "meshFile.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	const uint8_t notInMeshlet = 0xFF; // maxMeshletVertices is well below this.
+
+	glm::vec3 vertexPosition(const MeshData& mesh, uint32_t index) {
+		const float* position = mesh.vertices[index].position;
+		return glm::vec3(position[0], position[1], position[2]);
+	}
+
+	// Centre of the bounding box and the furthest vertex from it. Not minimal, but within a few percent for real meshes.
+	void boundingSphere(const MeshData& mesh, const uint32_t* indices, size_t count, float sphere[4]) {
+		glm::vec3 boundsMin(FLT_MAX);
+		glm::vec3 boundsMax(-FLT_MAX);
+		for (size_t i = 0; i < count; ++i) {
+			glm::vec3 position = vertexPosition(mesh, indices[i]);
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+
+		glm::vec3 centre = count > 0 ? (boundsMin + boundsMax) * 0.5f : glm::vec3(0.0f);
+		float radiusSquared = 0.0f;
+		for (size_t i = 0; i < count; ++i) {
+			glm::vec3 offset = vertexPosition(mesh, indices[i]) - centre;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		sphere[0] = centre.x;
+		sphere[1] = centre.y;
+		sphere[2] = centre.z;
+		sphere[3] = std::sqrt(radiusSquared);
+	}
+
+	uint64_t alignUp(uint64_t value) {
+		return (value + meshFileAlignment - 1) / meshFileAlignment * meshFileAlignment;
+	}
+}
+
+void buildMeshlets(MeshData& mesh) {
+	CPU_PROFILE_SCOPE("buildMeshlets");
+	mesh.meshlets.clear();
+	mesh.meshletVertices.clear();
+	mesh.meshletTriangles.clear();
+
+	// Where each vertex sits in the meshlet being filled, so shared vertices are only added once.
+	std::vector<uint8_t> localIndex(mesh.vertices.size(), notInMeshlet);
+	MeshMeshlet meshlet{};
+
+	auto finishMeshlet = [&]() {
+		if (meshlet.triangleCount == 0) {
+			return;
+		}
+		const uint32_t* vertices = mesh.meshletVertices.data() + meshlet.vertexOffset;
+		boundingSphere(mesh, vertices, meshlet.vertexCount, meshlet.boundingSphere);
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			localIndex[vertices[i]] = notInMeshlet;
+		}
+		mesh.meshlets.push_back(meshlet);
+		meshlet = MeshMeshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(mesh.meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(mesh.meshletTriangles.size());
+	};
+
+	for (MeshSubmesh& submesh : mesh.submeshes) {
+		if (static_cast<uint64_t>(submesh.firstIndex) + submesh.indexCount > mesh.indices.size() || submesh.indexCount % 3 != 0) {
+			throw std::runtime_error("Submesh index range is outside the mesh or not whole triangles.");
+		}
+
+		submesh.firstMeshlet = static_cast<uint32_t>(mesh.meshlets.size());
+		meshlet.vertexOffset = static_cast<uint32_t>(mesh.meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(mesh.meshletTriangles.size());
+
+		// Greedy, in index order. Importers emit triangles with good locality already, so this packs well enough.
+		const uint32_t* triangle = mesh.indices.data() + submesh.firstIndex;
+		for (uint32_t i = 0; i < submesh.indexCount; i += 3, triangle += 3) {
+			uint32_t newVertices = 0;
+			for (int corner = 0; corner < 3; ++corner) {
+				bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+				newVertices += localIndex[triangle[corner]] == notInMeshlet && !repeated ? 1 : 0;
+			}
+			if (meshlet.vertexCount + newVertices > maxMeshletVertices || meshlet.triangleCount + 1 > maxMeshletTriangles) {
+				finishMeshlet();
+			}
+
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t vertex = triangle[corner];
+				if (localIndex[vertex] == notInMeshlet) {
+					localIndex[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+					mesh.meshletVertices.push_back(vertex);
+				}
+				mesh.meshletTriangles.push_back(localIndex[vertex]);
+			}
+			meshlet.triangleCount++;
+		}
+		finishMeshlet();
+
+		submesh.meshletCount = static_cast<uint32_t>(mesh.meshlets.size()) - submesh.firstMeshlet;
+		boundingSphere(mesh, mesh.indices.data() + submesh.firstIndex, submesh.indexCount, submesh.boundingSphere);
+	}
+}
+
+void writeMeshFile(const std::string& path, const MeshData& source) {
+	CPU_PROFILE_SCOPE("writeMeshFile");
+	MeshData built;
+	const MeshData* mesh = &source;
+	if (source.meshlets.empty() && !source.indices.empty()) {
+		built = source;
+		buildMeshlets(built);
+		mesh = &built;
+	}
+
+	MeshFileHeader header{};
+	header.magic = meshFileMagic;
+	header.version = meshFileVersion;
+	header.vertexCount = static_cast<uint32_t>(mesh->vertices.size());
+	header.vertexStride = sizeof(MeshVertex);
+	header.indexCount = static_cast<uint32_t>(mesh->indices.size());
+	header.indexSize = mesh->vertices.size() <= 65536 ? 2 : 4;
+	header.submeshCount = static_cast<uint32_t>(mesh->submeshes.size());
+	header.meshletCount = static_cast<uint32_t>(mesh->meshlets.size());
+
+	glm::vec3 boundsMin(mesh->vertices.empty() ? 0.0f : FLT_MAX);
+	glm::vec3 boundsMax(mesh->vertices.empty() ? 0.0f : -FLT_MAX);
+	for (uint32_t i = 0; i < header.vertexCount; ++i) {
+		boundsMin = glm::min(boundsMin, vertexPosition(*mesh, i));
+		boundsMax = glm::max(boundsMax, vertexPosition(*mesh, i));
+	}
+	memcpy(header.boundsMin, &boundsMin, sizeof(header.boundsMin));
+	memcpy(header.boundsMax, &boundsMax, sizeof(header.boundsMax));
+
+	std::vector<uint16_t> shortIndices;
+	const void* indexData = mesh->indices.data();
+	if (header.indexSize == 2) {
+		shortIndices.assign(mesh->indices.begin(), mesh->indices.end());
+		indexData = shortIndices.data();
+	}
+
+	const void* streamData[] = {
+		mesh->vertices.data(),
+		indexData,
+		mesh->submeshes.data(),
+		mesh->meshlets.data(),
+		mesh->meshletVertices.data(),
+		mesh->meshletTriangles.data()
+	};
+	const uint64_t streamSizes[] = {
+		static_cast<uint64_t>(header.vertexCount) * header.vertexStride,
+		static_cast<uint64_t>(header.indexCount) * header.indexSize,
+		static_cast<uint64_t>(header.submeshCount) * sizeof(MeshSubmesh),
+		static_cast<uint64_t>(header.meshletCount) * sizeof(MeshMeshlet),
+		mesh->meshletVertices.size() * sizeof(uint32_t),
+		mesh->meshletTriangles.size()
+	};
+	static_assert(sizeof(streamSizes) / sizeof(streamSizes[0]) == static_cast<size_t>(MeshStream::Count), "One entry per stream.");
+
+	uint64_t offset = alignUp(sizeof(MeshFileHeader));
+	for (uint32_t i = 0; i < static_cast<uint32_t>(MeshStream::Count); ++i) {
+		header.sections[i] = { offset, streamSizes[i] };
+		offset = alignUp(offset + streamSizes[i]);
+	}
+	header.fileSize = offset;
+
+	std::filesystem::path target(path);
+	if (target.has_parent_path()) {
+		std::filesystem::create_directories(target.parent_path());
+	}
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open " + tempPath + " for writing.");
+		}
+
+		const char padding[meshFileAlignment] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MeshStream::Count); ++i) {
+			file.write(padding, static_cast<std::streamsize>(header.sections[i].offset - written));
+			file.write(static_cast<const char*>(streamData[i]), static_cast<std::streamsize>(streamSizes[i]));
+			written = header.sections[i].offset + streamSizes[i];
+		}
+		file.write(padding, static_cast<std::streamsize>(header.fileSize - written));
+		if (!file.good()) {
+			throw std::runtime_error("Failed to write " + tempPath + ".");
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		throw std::runtime_error("Failed to move " + tempPath + " to " + path + ": " + error.message());
+	}
+}
+
+void MeshFile::open(const std::string& path) {
+	CPU_PROFILE_SCOPE("MeshFile::open");
+	close();
+	file.open(path);
+
+	if (file.getSize() < sizeof(MeshFileHeader)) {
+		close();
+		throw std::runtime_error(path + " is too small to be a mesh file.");
+	}
+	memcpy(&header, file.getData(), sizeof(header));
+
+	std::string problem;
+	if (header.magic != meshFileMagic) {
+		problem = "is not a mesh file";
+	}
+	else if (header.version != meshFileVersion || header.vertexStride != sizeof(MeshVertex)) {
+		problem = "was written by a different version of the converter, reconvert it";
+	}
+	else if (header.fileSize != file.getSize()) {
+		problem = "is truncated";
+	}
+	else if (header.indexSize != 2 && header.indexSize != 4) {
+		problem = "has an invalid index size";
+	}
+
+	const uint64_t expectedSizes[] = {
+		static_cast<uint64_t>(header.vertexCount) * header.vertexStride,
+		static_cast<uint64_t>(header.indexCount) * header.indexSize,
+		static_cast<uint64_t>(header.submeshCount) * sizeof(MeshSubmesh),
+		static_cast<uint64_t>(header.meshletCount) * sizeof(MeshMeshlet)
+	};
+	for (uint32_t i = 0; i < static_cast<uint32_t>(MeshStream::Count) && problem.empty(); ++i) {
+		const MeshFileSection& section = header.sections[i];
+		if (section.offset % meshFileAlignment != 0 || section.offset > header.fileSize || section.size > header.fileSize - section.offset
+			|| (i < sizeof(expectedSizes) / sizeof(expectedSizes[0]) && section.size != expectedSizes[i])) {
+			problem = "has a corrupt section table";
+		}
+	}
+
+	// Submeshes are the one table small enough to check without defeating the point of mapping.
+	for (uint32_t i = 0; i < header.submeshCount && problem.empty(); ++i) {
+		const MeshSubmesh& submesh = getSubmeshes()[i];
+		if (static_cast<uint64_t>(submesh.firstIndex) + submesh.indexCount > header.indexCount
+			|| static_cast<uint64_t>(submesh.firstMeshlet) + submesh.meshletCount > header.meshletCount) {
+			problem = "has a submesh outside its streams";
+		}
+	}
+
+	if (!problem.empty()) {
+		close();
+		throw std::runtime_error(path + " " + problem + ".");
+	}
+}
+
+void MeshFile::close() {
+	file.close();
+	header = MeshFileHeader{};
+}
+
+void MeshFile::prefetch() const {
+	uint64_t begin = header.sections[0].offset;
+	file.prefetch(static_cast<size_t>(begin), static_cast<size_t>(header.fileSize - begin));
+}
+
+const uint8_t* MeshFile::getStreamData(MeshStream stream) const {
+	return file.getData() + header.sections[static_cast<uint32_t>(stream)].offset;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mappedFile.h"
+
+const uint32_t meshFileMagic = 0x534D544D; // "MTMS"
+const uint32_t meshFileVersion = 1;
+// Every stream starts on this boundary, which covers optimalBufferCopyOffsetAlignment and storage buffer offset
+// alignment on every device, so a stream can be copied or bound at its file offset within a staging buffer.
+const uint64_t meshFileAlignment = 256;
+
+const uint32_t maxMeshletVertices = 64;
+const uint32_t maxMeshletTriangles = 124; // Fits the 126 primitive limit with room for the usual padding.
+
+// The one vertex layout the format stores, so loading is a copy, never a conversion.
+struct MeshVertex {
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+
+static_assert(sizeof(MeshVertex) == 32, "MeshVertex is stored as-is in mesh files.");
+
+// A range of indices drawn with one material.
+struct MeshSubmesh {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	float boundingSphere[4]; // Centre in xyz, radius in w.
+};
+
+struct MeshMeshlet {
+	uint32_t vertexOffset; // Into the meshlet vertex stream, which holds indices into the vertex stream.
+	uint32_t triangleOffset; // Into the meshlet triangle stream, three bytes per triangle.
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	float boundingSphere[4];
+};
+
+static_assert(sizeof(MeshSubmesh) == 32 && sizeof(MeshMeshlet) == 32, "Mesh file tables are stored as-is.");
+
+enum class MeshStream : uint32_t {
+	Vertices = 0, // MeshVertex
+	Indices, // uint16_t or uint32_t, see MeshFileHeader::indexSize
+	Submeshes, // MeshSubmesh
+	Meshlets, // MeshMeshlet
+	MeshletVertices, // uint32_t
+	MeshletTriangles, // uint8_t triples
+	Count
+};
+
+struct MeshFileSection {
+	uint64_t offset; // From the start of the file, a multiple of meshFileAlignment.
+	uint64_t size;
+};
+
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t vertexStride; // sizeof(MeshVertex) when written. A mismatch means the file predates a layout change.
+	uint32_t indexCount;
+	uint32_t indexSize; // 2 when every index fits in 16 bits, otherwise 4.
+	uint32_t submeshCount;
+	uint32_t meshletCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t fileSize; // Catches truncated copies without reading the streams.
+	MeshFileSection sections[static_cast<uint32_t>(MeshStream::Count)];
+};
+
+static_assert(sizeof(MeshFileHeader) == 160, "MeshFileHeader has no implicit padding, so it reads the same on every compiler.");
+
+// A mesh on the CPU side, as importers produce and writeMeshFile consumes. Indices are always 32-bit here.
+struct MeshData {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshSubmesh> submeshes; // Only firstIndex and indexCount need filling in; the rest is derived.
+	std::vector<MeshMeshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+};
+
+// Splits every submesh into meshlets and fills in the submesh bounds and meshlet ranges.
+void buildMeshlets(MeshData& mesh);
+// Writes the mesh, building meshlets first if there are none. Write-then-rename, so readers never see half a file.
+void writeMeshFile(const std::string& path, const MeshData& mesh);
+
+/*
+	Mesh File
+	- Binary mesh container, written offline and memory-mapped at load. Every stream is stored exactly as the GPU
+	  consumes it, at an aligned offset, so loading is validating a header and copying bytes.
+	- open() only checks the header and that every section lies inside the file; stream contents are never touched
+	  until they are copied, so opening costs the same for any mesh size.
+	- getStreamData() points into the mapping. A staging upload is one memcpy per stream, or one for the whole range
+	  from the first stream to the last when the destination mirrors the file layout.
+*/
+class MeshFile {
+
+	public:
+		void open(const std::string& path); // Throws on a missing, foreign, outdated or truncated file.
+		void close();
+		// Starts the OS reading every stream in the background.
+		void prefetch() const;
+
+		const std::string& getPath() const { return file.getPath(); }
+		const MeshFileHeader& getHeader() const { return header; }
+		const uint8_t* getStreamData(MeshStream stream) const;
+		uint64_t getStreamSize(MeshStream stream) const { return header.sections[static_cast<uint32_t>(stream)].size; }
+		uint64_t getStreamOffset(MeshStream stream) const { return header.sections[static_cast<uint32_t>(stream)].offset; }
+		const MeshSubmesh* getSubmeshes() const { return reinterpret_cast<const MeshSubmesh*>(getStreamData(MeshStream::Submeshes)); }
+		const MeshMeshlet* getMeshlets() const { return reinterpret_cast<const MeshMeshlet*>(getStreamData(MeshStream::Meshlets)); }
+
+	private:
+		MappedFile file;
+		MeshFileHeader header{};
+};
@@ -0,0 +1,164 @@
+#include "mipChainFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+#include "jobSystem.h"
+
+namespace {
+
+	uint64_t alignUp(uint64_t value) {
+		return (value + mipChainFileAlignment - 1) / mipChainFileAlignment * mipChainFileAlignment;
+	}
+}
+
+std::vector<std::vector<uint8_t>> buildMipChain(const DecodedImage& image) {
+	CPU_PROFILE_SCOPE("buildMipChain");
+	std::vector<std::vector<uint8_t>> levels;
+	levels.push_back(image.pixels);
+
+	uint32_t width = image.width;
+	uint32_t height = image.height;
+	while ((width > 1 || height > 1) && levels.size() < maxMipChainLevels) {
+		uint32_t nextWidth = std::max(width / 2, 1u);
+		uint32_t nextHeight = std::max(height / 2, 1u);
+		const std::vector<uint8_t>& source = levels.back();
+		std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+		for (uint32_t y = 0; y < nextHeight; ++y) {
+			uint32_t y0 = std::min(y * 2, height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < nextWidth; ++x) {
+				uint32_t x0 = std::min(x * 2, width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				for (uint32_t channel = 0; channel < 4; ++channel) {
+					uint32_t sum = source[(static_cast<size_t>(y0) * width + x0) * 4 + channel] + source[(static_cast<size_t>(y0) * width + x1) * 4 + channel]
+						+ source[(static_cast<size_t>(y1) * width + x0) * 4 + channel] + source[(static_cast<size_t>(y1) * width + x1) * 4 + channel];
+					next[(static_cast<size_t>(y) * nextWidth + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		levels.push_back(std::move(next));
+		width = nextWidth;
+		height = nextHeight;
+	}
+	return levels;
+}
+
+void writeMipChainFile(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels) {
+	CPU_PROFILE_SCOPE("writeMipChainFile");
+	if (levels.empty() || levels.size() > maxMipChainLevels) {
+		throw std::runtime_error("Mip chain for " + path + " has " + std::to_string(levels.size()) + " levels.");
+	}
+
+	MipChainFileHeader header{};
+	header.magic = mipChainFileMagic;
+	header.version = mipChainFileVersion;
+	header.format = static_cast<uint32_t>(format);
+	header.width = width;
+	header.height = height;
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	uint64_t offset = alignUp(sizeof(header));
+	for (uint32_t i = 0; i < header.levelCount; ++i) {
+		header.levels[i] = { offset, levels[i].size() };
+		offset = alignUp(offset + levels[i].size());
+	}
+	header.fileSize = offset;
+
+	std::filesystem::path target(path);
+	if (target.has_parent_path()) {
+		std::filesystem::create_directories(target.parent_path());
+	}
+
+	// Per-thread temp name: two prepare jobs for identical pixels write the same cache path at the same time.
+	std::string tempPath = path + "." + std::to_string(JobSystem::currentThreadIndex()) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open " + tempPath + " for writing.");
+		}
+
+		const char padding[mipChainFileAlignment] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+		for (uint32_t i = 0; i < header.levelCount; ++i) {
+			file.write(padding, static_cast<std::streamsize>(header.levels[i].offset - written));
+			file.write(reinterpret_cast<const char*>(levels[i].data()), static_cast<std::streamsize>(levels[i].size()));
+			written = header.levels[i].offset + levels[i].size();
+		}
+		file.write(padding, static_cast<std::streamsize>(header.fileSize - written));
+		if (!file.good()) {
+			throw std::runtime_error("Failed to write " + tempPath + ".");
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error && std::filesystem::exists(path)) {
+		// Another writer got there first with the same content, and may already have it mapped, which makes the
+		// rename fail on Windows. Its file is as good as this one.
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+	if (error) {
+		throw std::runtime_error("Failed to move " + tempPath + " to " + path + ": " + error.message());
+	}
+}
+
+void MipChainFile::open(const std::string& path) {
+	close();
+	file.open(path);
+
+	if (file.getSize() < sizeof(MipChainFileHeader)) {
+		close();
+		throw std::runtime_error(path + " is too small to be a mip chain file.");
+	}
+	memcpy(&header, file.getData(), sizeof(header));
+
+	std::string problem;
+	if (header.magic != mipChainFileMagic) {
+		problem = "is not a mip chain file";
+	}
+	else if (header.version != mipChainFileVersion) {
+		problem = "was written by a different version of the renderer";
+	}
+	else if (header.fileSize != file.getSize()) {
+		problem = "is truncated";
+	}
+	else if (header.levelCount == 0 || header.levelCount > maxMipChainLevels || header.width == 0 || header.height == 0) {
+		problem = "has an invalid level count or size";
+	}
+	for (uint32_t i = 0; i < header.levelCount && problem.empty(); ++i) {
+		const MipChainLevel& level = header.levels[i];
+		if (level.offset % mipChainFileAlignment != 0 || level.offset > header.fileSize || level.size > header.fileSize - level.offset) {
+			problem = "has a corrupt level table";
+		}
+	}
+
+	if (!problem.empty()) {
+		close();
+		throw std::runtime_error(path + " " + problem + ".");
+	}
+}
+
+void MipChainFile::close() {
+	file.close();
+	header = MipChainFileHeader{};
+}
+
+void MipChainFile::prefetch(uint32_t firstLevel) const {
+	uint64_t begin = header.levels[firstLevel].offset;
+	file.prefetch(static_cast<size_t>(begin), static_cast<size_t>(header.fileSize - begin));
+}
+
+uint64_t MipChainFile::getChainSize(uint32_t firstLevel) const {
+	uint64_t size = 0;
+	for (uint32_t level = firstLevel; level < header.levelCount; ++level) {
+		size += header.levels[level].size;
+	}
+	return size;
+}
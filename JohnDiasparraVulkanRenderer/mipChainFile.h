@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "imageDecoder.h"
+#include "mappedFile.h"
+
+const uint32_t mipChainFileMagic = 0x5043494D; // "MICP"
+const uint32_t mipChainFileVersion = 1;
+// Every level starts on this boundary: a multiple of every texel and block size, and of optimalBufferCopyOffsetAlignment.
+const uint64_t mipChainFileAlignment = 256;
+const uint32_t maxMipChainLevels = 16;
+
+struct MipChainLevel {
+	uint64_t offset; // From the start of the file, a multiple of mipChainFileAlignment.
+	uint64_t size;
+};
+
+struct MipChainFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format; // VkFormat of every level, as stored.
+	uint32_t width; // Of level 0.
+	uint32_t height;
+	uint32_t levelCount;
+	uint64_t fileSize; // Catches truncated copies without reading the levels.
+	MipChainLevel levels[maxMipChainLevels]; // Finest first, so any level and everything coarser is one range.
+};
+
+static_assert(sizeof(MipChainFileHeader) == 288, "MipChainFileHeader has no implicit padding, so it reads the same on every compiler.");
+
+// Full chain down to 1x1, each level a 2x2 box filter of the one above (edge texels repeat on odd sizes).
+std::vector<std::vector<uint8_t>> buildMipChain(const DecodedImage& image);
+// levels[0] is width x height. Write-then-rename, so readers never see half a file.
+void writeMipChainFile(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels);
+
+/*
+	Mip Chain File
+	- A texture's mip levels exactly as an image expects them, so uploading a level is one copy from the mapping.
+	  TextureResidency streams levels out of these on demand; the texture cache holds one per decoded image.
+	- Like MeshFile, open() only checks the header; level contents aren't touched until they are copied.
+*/
+class MipChainFile {
+
+	public:
+		void open(const std::string& path); // Throws on a missing, foreign, outdated or truncated file.
+		void close();
+		// Starts the OS reading levels [firstLevel, levelCount) in the background.
+		void prefetch(uint32_t firstLevel) const;
+
+		bool isOpen() const { return file.isOpen(); }
+		VkFormat getFormat() const { return static_cast<VkFormat>(header.format); }
+		uint32_t getLevelCount() const { return header.levelCount; }
+		uint32_t getWidth(uint32_t level) const { return std::max(header.width >> level, 1u); }
+		uint32_t getHeight(uint32_t level) const { return std::max(header.height >> level, 1u); }
+		const uint8_t* getLevelData(uint32_t level) const { return file.getData() + header.levels[level].offset; }
+		uint64_t getLevelSize(uint32_t level) const { return header.levels[level].size; }
+		// Bytes of levels [firstLevel, levelCount): what an image holding them needs, give or take alignment.
+		uint64_t getChainSize(uint32_t firstLevel) const;
+
+	private:
+		MappedFile file;
+		MipChainFileHeader header{};
+};
@@ -0,0 +1,289 @@
+#include "objImport.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "cpuProfiler.h"
+#include "hash.h"
+#include "mappedFile.h"
+
+namespace {
+
+	// One face corner. Zero means the attribute was left out.
+	struct Corner {
+		uint32_t position;
+		uint32_t uv;
+		uint32_t normal;
+
+		bool operator==(const Corner& other) const { return position == other.position && uv == other.uv && normal == other.normal; }
+	};
+
+	struct CornerHash {
+		size_t operator()(const Corner& corner) const { return static_cast<size_t>(hashValue(corner)); }
+	};
+
+	// Walks the mapped text without copying it. Nothing here reads past end, since the mapping needn't be terminated.
+	class ObjReader {
+
+		public:
+			ObjReader(const uint8_t* begin, const uint8_t* end) : cursor(begin), end(end) {}
+
+			bool atEnd() const { return cursor >= end; }
+			uint32_t getLine() const { return line; }
+
+			void skipSpaces() {
+				while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+					++cursor;
+				}
+			}
+
+			void nextLine() {
+				while (cursor < end && *cursor != '\n') {
+					++cursor;
+				}
+				if (cursor < end) {
+					++cursor;
+					++line;
+				}
+			}
+
+			bool atLineEnd() {
+				skipSpaces();
+				return cursor >= end || *cursor == '\n' || *cursor == '#';
+			}
+
+			// The keyword at the start of a line: "v", "vt", "f", ...
+			std::string keyword() {
+				skipSpaces();
+				const uint8_t* start = cursor;
+				while (cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '\n') {
+					++cursor;
+				}
+				return std::string(start, cursor);
+			}
+
+			float readFloat() {
+				skipSpaces();
+				bool negative = consume('-');
+				if (!negative) {
+					consume('+');
+				}
+
+				double value = 0.0;
+				bool anyDigits = false;
+				while (cursor < end && isDigit(*cursor)) {
+					value = value * 10.0 + (*cursor++ - '0');
+					anyDigits = true;
+				}
+				if (consume('.')) {
+					double scale = 0.1;
+					while (cursor < end && isDigit(*cursor)) {
+						value += (*cursor++ - '0') * scale;
+						scale *= 0.1;
+						anyDigits = true;
+					}
+				}
+				if (!anyDigits) {
+					fail("Expected a number");
+				}
+				if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+					++cursor;
+					bool negativeExponent = consume('-');
+					if (!negativeExponent) {
+						consume('+');
+					}
+					int exponent = 0;
+					while (cursor < end && isDigit(*cursor)) {
+						exponent = exponent * 10 + (*cursor++ - '0');
+					}
+					value *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+				}
+				return static_cast<float>(negative ? -value : value);
+			}
+
+			// Resolves OBJ's 1-based and negative (counted back from the latest) indices to 1-based. Zero when absent.
+			uint32_t readIndex(size_t count) {
+				if (cursor >= end || !(isDigit(*cursor) || *cursor == '-')) {
+					return 0;
+				}
+				bool negative = consume('-');
+				int64_t value = 0;
+				while (cursor < end && isDigit(*cursor)) {
+					value = value * 10 + (*cursor++ - '0');
+				}
+				int64_t resolved = negative ? static_cast<int64_t>(count) + 1 - value : value;
+				if (resolved < 1 || resolved > static_cast<int64_t>(count)) {
+					fail("Index out of range");
+				}
+				return static_cast<uint32_t>(resolved);
+			}
+
+			Corner readCorner(size_t positionCount, size_t uvCount, size_t normalCount) {
+				skipSpaces();
+				Corner corner{};
+				corner.position = readIndex(positionCount);
+				if (corner.position == 0) {
+					fail("Expected a vertex index");
+				}
+				if (consume('/')) {
+					corner.uv = readIndex(uvCount);
+					if (consume('/')) {
+						corner.normal = readIndex(normalCount);
+					}
+				}
+				return corner;
+			}
+
+			[[noreturn]] void fail(const char* message) const {
+				throw std::runtime_error(std::string(message) + " on line " + std::to_string(line));
+			}
+
+		private:
+			const uint8_t* cursor;
+			const uint8_t* end;
+			uint32_t line = 1;
+
+			static bool isDigit(uint8_t c) { return c >= '0' && c <= '9'; }
+
+			bool consume(uint8_t c) {
+				if (cursor < end && *cursor == c) {
+					++cursor;
+					return true;
+				}
+				return false;
+			}
+	};
+}
+
+MeshData importObj(const std::string& path) {
+	CPU_PROFILE_SCOPE("importObj");
+	MappedFile file;
+	file.open(path);
+	ObjReader reader(file.getData(), file.getData() + file.getSize());
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	MeshData mesh;
+	std::vector<bool> needsNormal; // Per output vertex: no normal in the file, so one is generated.
+	std::unordered_map<Corner, uint32_t, CornerHash> vertexLookup;
+	std::vector<uint32_t> face;
+
+	auto startSubmesh = [&]() {
+		if (mesh.submeshes.empty() || mesh.submeshes.back().indexCount > 0) {
+			MeshSubmesh submesh{};
+			submesh.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+			mesh.submeshes.push_back(submesh);
+		}
+	};
+	startSubmesh();
+
+	try {
+		while (!reader.atEnd()) {
+			if (reader.atLineEnd()) {
+				reader.nextLine();
+				continue;
+			}
+
+			std::string keyword = reader.keyword();
+			if (keyword == "v") {
+				float x = reader.readFloat();
+				float y = reader.readFloat();
+				float z = reader.readFloat();
+				positions.emplace_back(x, y, z);
+			}
+			else if (keyword == "vt") {
+				float u = reader.readFloat();
+				float v = reader.atLineEnd() ? 0.0f : reader.readFloat();
+				uvs.emplace_back(u, 1.0f - v);
+			}
+			else if (keyword == "vn") {
+				float x = reader.readFloat();
+				float y = reader.readFloat();
+				float z = reader.readFloat();
+				normals.emplace_back(x, y, z);
+			}
+			else if (keyword == "f") {
+				face.clear();
+				while (!reader.atLineEnd()) {
+					Corner corner = reader.readCorner(positions.size(), uvs.size(), normals.size());
+					auto found = vertexLookup.find(corner);
+					if (found == vertexLookup.end()) {
+						MeshVertex vertex{};
+						glm::vec3 position = positions[corner.position - 1];
+						glm::vec3 normal = corner.normal ? normals[corner.normal - 1] : glm::vec3(0.0f);
+						glm::vec2 uv = corner.uv ? uvs[corner.uv - 1] : glm::vec2(0.0f);
+						vertex.position[0] = position.x; vertex.position[1] = position.y; vertex.position[2] = position.z;
+						vertex.normal[0] = normal.x; vertex.normal[1] = normal.y; vertex.normal[2] = normal.z;
+						vertex.uv[0] = uv.x; vertex.uv[1] = uv.y;
+						found = vertexLookup.emplace(corner, static_cast<uint32_t>(mesh.vertices.size())).first;
+						mesh.vertices.push_back(vertex);
+						needsNormal.push_back(corner.normal == 0);
+					}
+					face.push_back(found->second);
+				}
+				if (face.size() < 3) {
+					reader.fail("Face with fewer than three vertices");
+				}
+				for (size_t i = 1; i + 1 < face.size(); ++i) {
+					mesh.indices.push_back(face[0]);
+					mesh.indices.push_back(face[i]);
+					mesh.indices.push_back(face[i + 1]);
+				}
+				mesh.submeshes.back().indexCount = static_cast<uint32_t>(mesh.indices.size()) - mesh.submeshes.back().firstIndex;
+			}
+			else if (keyword == "o" || keyword == "g" || keyword == "usemtl") {
+				startSubmesh();
+			}
+			// Anything else (mtllib, s, l, p, ...) carries nothing the mesh format stores.
+			reader.nextLine();
+		}
+	}
+	catch (const std::exception& e) {
+		throw std::runtime_error(path + ": " + e.what() + ".");
+	}
+
+	if (mesh.submeshes.back().indexCount == 0) {
+		mesh.submeshes.pop_back();
+	}
+	if (mesh.indices.empty()) {
+		throw std::runtime_error(path + " has no faces.");
+	}
+
+	// Unnormalized cross products are weighted by face area, so big faces dominate the average as they should.
+	std::vector<glm::vec3> generated(mesh.vertices.size(), glm::vec3(0.0f));
+	bool anyGenerated = false;
+	for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+		const uint32_t* triangle = &mesh.indices[i];
+		if (!needsNormal[triangle[0]] && !needsNormal[triangle[1]] && !needsNormal[triangle[2]]) {
+			continue;
+		}
+		const float* a = mesh.vertices[triangle[0]].position;
+		const float* b = mesh.vertices[triangle[1]].position;
+		const float* c = mesh.vertices[triangle[2]].position;
+		glm::vec3 faceNormal = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+		for (int corner = 0; corner < 3; ++corner) {
+			generated[triangle[corner]] += faceNormal;
+		}
+		anyGenerated = true;
+	}
+	if (anyGenerated) {
+		for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+			if (!needsNormal[i]) {
+				continue;
+			}
+			float length = glm::length(generated[i]);
+			glm::vec3 normal = length > 0.0f ? generated[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+			mesh.vertices[i].normal[0] = normal.x;
+			mesh.vertices[i].normal[1] = normal.y;
+			mesh.vertices[i].normal[2] = normal.z;
+		}
+	}
+	return mesh;
+}
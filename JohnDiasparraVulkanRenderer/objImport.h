@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "meshFile.h"
+
+/*
+	OBJ Import
+	- Positions, texture coordinates and normals; faces of any size are fanned into triangles. Negative (relative)
+	  indices are supported, materials are not read.
+	- Every o, g or usemtl line starts a new submesh, so material boundaries survive as draw ranges.
+	- Identical position/uv/normal triples share one vertex. Vertices without a normal get the area-weighted average
+	  of the faces around them.
+	- Texture coordinates are flipped to Vulkan's top-left origin.
+*/
+MeshData importObj(const std::string& path); // Throws on a file it can't read or an index out of range.
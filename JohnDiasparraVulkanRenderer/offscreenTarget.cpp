@@ -0,0 +1,97 @@
+#include "offscreenTarget.h"
+
+#include <fstream>
+#include <stdexcept>
+
+OffscreenImage createOffscreenImage(VkDevice device, GpuMemoryAllocator& allocator, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, const VkAllocationCallbacks* allocationCallbacks) {
+	OffscreenImage offscreenImage;
+	offscreenImage.format = format;
+	offscreenImage.extent = extent;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { extent.width, extent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, allocationCallbacks, &offscreenImage.image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create offscreen image.");
+	}
+	offscreenImage.allocation = allocator.allocateForImage(offscreenImage.image, MemoryUsage::GpuOnly);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = offscreenImage.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	if (vkCreateImageView(device, &viewInfo, allocationCallbacks, &offscreenImage.view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create offscreen image view.");
+	}
+	return offscreenImage;
+}
+
+void destroyOffscreenImage(VkDevice device, GpuMemoryAllocator& allocator, OffscreenImage& offscreenImage, const VkAllocationCallbacks* allocationCallbacks) {
+	vkDestroyImageView(device, offscreenImage.view, allocationCallbacks);
+	vkDestroyImage(device, offscreenImage.image, allocationCallbacks);
+	allocator.free(offscreenImage.allocation);
+	offscreenImage = {};
+}
+
+void ReadbackRing::init(VkDevice device, GpuMemoryAllocator& allocator, uint32_t slotCount, VkDeviceSize slotSize, const VkAllocationCallbacks* allocationCallbacks) {
+	slots.resize(slotCount);
+
+	for (Slot& slot : slots) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = slotSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, allocationCallbacks, &slot.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create readback buffer.");
+		}
+		slot.allocation = allocator.allocateForBuffer(slot.buffer, MemoryUsage::GpuToCpu);
+	}
+}
+
+void ReadbackRing::destroy(VkDevice device, GpuMemoryAllocator& allocator, const VkAllocationCallbacks* allocationCallbacks) {
+	for (Slot& slot : slots) {
+		vkDestroyBuffer(device, slot.buffer, allocationCallbacks);
+		allocator.free(slot.allocation);
+	}
+	slots.clear();
+}
+
+void ReadbackRing::markPending(uint32_t slot, uint64_t frameIndex) {
+	slots[slot].frameIndex = frameIndex;
+	slots[slot].pending = true;
+}
+
+void writeFramePPM(const std::string& path, const void* rgbaPixels, VkExtent2D extent) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open " + path + " for writing.");
+	}
+	file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+	const uint8_t* pixels = static_cast<const uint8_t*>(rgbaPixels);
+	std::vector<uint8_t> row(extent.width * 3);
+	for (uint32_t y = 0; y < extent.height; ++y) {
+		for (uint32_t x = 0; x < extent.width; ++x) {
+			const uint8_t* pixel = pixels + (static_cast<size_t>(y) * extent.width + x) * 4;
+			row[x * 3 + 0] = pixel[0];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = pixel[2];
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
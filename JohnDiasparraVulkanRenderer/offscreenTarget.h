@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gpuMemoryAllocator.h"
+
+// A render target that lives only in device memory, used where there is no swapchain to render into.
+struct OffscreenImage {
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	GpuAllocation* allocation = nullptr;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent{};
+};
+
+OffscreenImage createOffscreenImage(VkDevice device, GpuMemoryAllocator& allocator, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, const VkAllocationCallbacks* allocationCallbacks);
+void destroyOffscreenImage(VkDevice device, GpuMemoryAllocator& allocator, OffscreenImage& offscreenImage, const VkAllocationCallbacks* allocationCallbacks);
+
+/*
+	Readback Ring
+	- One host visible buffer per frame in flight, so copying frame N out never waits on the CPU reading frame N - 1.
+	- A slot is only read once the frame that wrote it is known to be complete, which the caller tracks.
+*/
+class ReadbackRing {
+
+	public:
+		void init(VkDevice device, GpuMemoryAllocator& allocator, uint32_t slotCount, VkDeviceSize slotSize, const VkAllocationCallbacks* allocationCallbacks);
+		void destroy(VkDevice device, GpuMemoryAllocator& allocator, const VkAllocationCallbacks* allocationCallbacks);
+
+		VkBuffer getBuffer(uint32_t slot) const { return slots[slot].buffer; }
+		const void* getData(uint32_t slot) const { return slots[slot].allocation->mappedData; }
+		uint32_t getSlotCount() const { return static_cast<uint32_t>(slots.size()); }
+
+		void markPending(uint32_t slot, uint64_t frameIndex);
+		bool isPending(uint32_t slot) const { return slots[slot].pending; }
+		uint64_t getPendingFrame(uint32_t slot) const { return slots[slot].frameIndex; }
+		void clearPending(uint32_t slot) { slots[slot].pending = false; }
+
+	private:
+		struct Slot {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			GpuAllocation* allocation = nullptr;
+			uint64_t frameIndex = 0;
+			bool pending = false;
+		};
+
+		std::vector<Slot> slots;
+};
+
+// Writes tightly packed RGBA8 pixels out as a binary PPM, dropping alpha.
+void writeFramePPM(const std::string& path, const void* rgbaPixels, VkExtent2D extent);
@@ -0,0 +1,164 @@
+#include "pipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "cpuProfiler.h"
+#include "hash.h"
+
+namespace {
+
+	const uint32_t pipelineCacheFileMagic = 0x4350544D; // "MTPC"
+	const uint32_t pipelineCacheFileVersion = 1;
+	const uint64_t maxPipelineCacheSize = 512ull * 1024 * 1024; // Anything bigger is a corrupt size field, not a real cache.
+
+	struct PipelineCacheFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataChecksum;
+	};
+}
+
+void PipelineCache::load(const DeviceCapabilityProfile& profile, const std::string& directory) {
+	CPU_PROFILE_SCOPE("loadPipelineCache");
+	this->directory = directory;
+	properties = profile.properties;
+
+	std::string driverVersion = toHex(reinterpret_cast<const uint8_t*>(&properties.driverVersion), sizeof(properties.driverVersion));
+	path = (std::filesystem::path(directory) / (toHex(properties.pipelineCacheUUID, VK_UUID_SIZE) + "-" + driverVersion + ".pipelinecache")).string();
+
+	if (!loadBlob(initialData) || !isBlobCompatible(initialData)) {
+		initialData.clear();
+	}
+	savedChecksum = initialData.empty() ? 0 : fnv1a64(initialData);
+}
+
+void PipelineCache::init(VkDevice device, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->callbacks = callbacks;
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = initialData.size();
+	createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+	if (vkCreatePipelineCache(device, &createInfo, callbacks, &cache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache.");
+	}
+
+	std::cout << "Pipeline Cache: " << (initialData.empty() ? std::string("starting empty") : "loaded " + std::to_string(initialData.size()) + " bytes") << "\n";
+	std::string().swap(initialData);
+}
+
+void PipelineCache::destroy() {
+	if (cache == VK_NULL_HANDLE) {
+		return;
+	}
+
+	save();
+	vkDestroyPipelineCache(device, cache, callbacks);
+	cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::loadBlob(std::string& blob) const {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	PipelineCacheFileHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good()
+		|| header.magic != pipelineCacheFileMagic
+		|| header.version != pipelineCacheFileVersion
+		|| header.vendorID != properties.vendorID
+		|| header.deviceID != properties.deviceID
+		|| header.driverVersion != properties.driverVersion
+		|| memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0
+		|| header.dataSize > maxPipelineCacheSize) {
+		return false;
+	}
+
+	blob.resize(static_cast<size_t>(header.dataSize));
+	file.read(blob.data(), blob.size());
+	if (!file.good() || fnv1a64(blob) != header.dataChecksum) {
+		std::cout << "\t" << "Pipeline cache at " << path << " is truncated or corrupt, discarding.\n";
+		return false;
+	}
+	return true;
+}
+
+bool PipelineCache::isBlobCompatible(const std::string& blob) const {
+	// The driver is meant to reject foreign data itself, but not all of them do, so check its header as well.
+	VkPipelineCacheHeaderVersionOne vulkanHeader{};
+	if (blob.size() < sizeof(vulkanHeader)) {
+		return false;
+	}
+	memcpy(&vulkanHeader, blob.data(), sizeof(vulkanHeader));
+
+	return vulkanHeader.headerSize >= sizeof(vulkanHeader)
+		&& vulkanHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& vulkanHeader.vendorID == properties.vendorID
+		&& vulkanHeader.deviceID == properties.deviceID
+		&& memcmp(vulkanHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save() {
+	CPU_PROFILE_SCOPE("savePipelineCache");
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+		return;
+	}
+
+	std::string blob(dataSize, '\0');
+	if (vkGetPipelineCacheData(device, cache, &dataSize, blob.data()) != VK_SUCCESS) {
+		return;
+	}
+	blob.resize(dataSize);
+
+	uint64_t checksum = fnv1a64(blob);
+	if (checksum == savedChecksum) {
+		return;
+	}
+
+	// Like the device profiles, the cache is an optimisation only, so failing to write it is not an error.
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+
+		PipelineCacheFileHeader header{};
+		header.magic = pipelineCacheFileMagic;
+		header.version = pipelineCacheFileVersion;
+		header.vendorID = properties.vendorID;
+		header.deviceID = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = blob.size();
+		header.dataChecksum = checksum;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(blob.data(), blob.size());
+		if (!file.good()) {
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (!error) {
+		savedChecksum = checksum;
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+
+#include "deviceProfile.h"
+
+/*
+	Pipeline Cache
+	- One VkPipelineCache for the whole device, seeded from disk at startup and written back at shutdown.
+	- Files are named after pipelineCacheUUID and driverVersion, so a driver update starts from a fresh cache.
+	- Loaded blobs are checked against our own header (device, driver, size, checksum) and against the header Vulkan
+	  puts at the front of the data. Anything that fails is discarded and the cache starts empty.
+	- Loading is split from creation: load() only needs the device profile, so it can read and checksum the file on a
+	  worker while the logical device is still being created.
+*/
+class PipelineCache {
+
+	public:
+		// Reads and validates the file for this device. Makes no Vulkan calls.
+		void load(const DeviceCapabilityProfile& profile, const std::string& directory);
+		// Creates the VkPipelineCache, seeded with whatever load() accepted.
+		void init(VkDevice device, const VkAllocationCallbacks* callbacks);
+		void destroy(); // Saves before destroying.
+
+		// Writes the current contents to disk. Skipped when nothing was added since the last load or save.
+		void save();
+		VkPipelineCache getCache() const { return cache; }
+
+	private:
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		VkPhysicalDeviceProperties properties{};
+		std::string directory;
+		std::string path;
+		std::string initialData; // Accepted by load(), released once the cache is created.
+
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		uint64_t savedChecksum = 0; // Checksum of what is on disk, so unchanged data is not rewritten.
+
+		bool loadBlob(std::string& blob) const;
+		bool isBlobCompatible(const std::string& blob) const;
+};
@@ -0,0 +1,548 @@
+#include "renderGraph.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "hash.h"
+
+namespace {
+
+	const VkAccessFlags2 writeAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+		| VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	const VkPipelineStageFlags2 shaderStages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	const VkPipelineStageFlags2 depthStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+	VkImageUsageFlags getImageUsage(RenderGraphAccess access) {
+		switch (access) {
+			case RenderGraphAccess::ColorAttachmentWrite: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			case RenderGraphAccess::DepthAttachmentWrite:
+			case RenderGraphAccess::DepthAttachmentRead: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			case RenderGraphAccess::SampledRead: return VK_IMAGE_USAGE_SAMPLED_BIT;
+			case RenderGraphAccess::StorageRead:
+			case RenderGraphAccess::StorageWrite: return VK_IMAGE_USAGE_STORAGE_BIT;
+			case RenderGraphAccess::TransferRead: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			case RenderGraphAccess::TransferWrite: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			default: return 0;
+		}
+	}
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// What the barrier compiler knows about a resource between passes.
+	struct TrackedState {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE; // Last write, or the barrier that last changed the layout.
+		VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE; // Part of that write not yet made available.
+		VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE; // Reads since, which the next write must wait for.
+		VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE; // Stages and access the last write is already visible to.
+		VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+	};
+
+	// Moves state on to a new use, returning true (and filling barrier) when a barrier is needed first.
+	bool transition(TrackedState& state, const RenderGraphResourceState& use, bool write, bool isImage, RenderGraphBarrier& barrier) {
+		bool layoutChange = isImage && use.layout != state.layout;
+		bool needed;
+
+		if (write || layoutChange) {
+			// Write-after-write, write-after-read and layout transitions all order against everything since the last write.
+			barrier.before = { state.writeStages | state.readStages, state.writeAccess, state.layout };
+			needed = layoutChange || barrier.before.stages != VK_PIPELINE_STAGE_2_NONE;
+
+			if (write) {
+				state.writeStages = use.stages;
+				state.writeAccess = use.access & writeAccessMask;
+				state.readStages = VK_PIPELINE_STAGE_2_NONE;
+				state.visibleStages = VK_PIPELINE_STAGE_2_NONE;
+				state.visibleAccess = VK_ACCESS_2_NONE;
+			}
+			else {
+				// The transition becomes the last write. Its barrier already made everything before it available.
+				state.writeStages = use.stages;
+				state.writeAccess = VK_ACCESS_2_NONE;
+				state.readStages = use.stages;
+				state.visibleStages = use.stages;
+				state.visibleAccess = use.access;
+			}
+			state.layout = isImage ? use.layout : state.layout;
+		}
+		else {
+			barrier.before = { state.writeStages, state.writeAccess, state.layout };
+			needed = state.writeStages != VK_PIPELINE_STAGE_2_NONE
+				&& ((use.stages & ~state.visibleStages) != 0 || (use.access & ~state.visibleAccess) != 0);
+
+			if (needed) {
+				state.visibleStages |= use.stages;
+				state.visibleAccess |= use.access;
+			}
+			state.readStages |= use.stages;
+		}
+
+		barrier.after = use;
+		if (!isImage) {
+			barrier.before.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.after.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+		return needed;
+	}
+}
+
+RenderGraphResourceState getAccessState(RenderGraphAccess access) {
+	switch (access) {
+		case RenderGraphAccess::ColorAttachmentWrite:
+			// Includes reads, for blending and LOAD_OP_LOAD.
+			return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		case RenderGraphAccess::DepthAttachmentWrite:
+			return { depthStages, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		case RenderGraphAccess::DepthAttachmentRead:
+			return { depthStages, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		case RenderGraphAccess::SampledRead:
+			return { shaderStages, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		case RenderGraphAccess::StorageRead:
+			return { shaderStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		case RenderGraphAccess::StorageWrite:
+			return { shaderStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+		case RenderGraphAccess::TransferRead:
+			return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+		case RenderGraphAccess::TransferWrite:
+			return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+		case RenderGraphAccess::VertexBufferRead:
+			return { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case RenderGraphAccess::IndexBufferRead:
+			return { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case RenderGraphAccess::IndirectRead:
+			return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case RenderGraphAccess::UniformRead:
+			return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | shaderStages, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+		case RenderGraphAccess::HostRead:
+			return { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+	}
+	throw std::runtime_error("Unknown render graph access.");
+}
+
+bool isWriteAccess(RenderGraphAccess access) {
+	return access == RenderGraphAccess::ColorAttachmentWrite || access == RenderGraphAccess::DepthAttachmentWrite
+		|| access == RenderGraphAccess::StorageWrite || access == RenderGraphAccess::TransferWrite;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::read(RenderGraphResource resource, RenderGraphAccess access) {
+	if (isWriteAccess(access)) {
+		throw std::runtime_error("Render graph pass " + graph.passes[pass].name + " declares a write access as a read.");
+	}
+	graph.passes[pass].usages.push_back({ resource, access });
+	graph.resources[resource].usage |= getImageUsage(access);
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::write(RenderGraphResource resource, RenderGraphAccess access) {
+	if (!isWriteAccess(access)) {
+		throw std::runtime_error("Render graph pass " + graph.passes[pass].name + " declares a read access as a write.");
+	}
+	graph.passes[pass].usages.push_back({ resource, access });
+	graph.resources[resource].usage |= getImageUsage(access);
+	return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::keepAlive() {
+	graph.passes[pass].keepAlive = true;
+	return *this;
+}
+
+RenderGraphResource RenderGraph::addResource(Resource resource) {
+	resources.push_back(std::move(resource));
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view, const RenderGraphImageDesc& desc, const RenderGraphResourceState& initialState) {
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.initialState = initialState;
+	resource.image = image;
+	resource.view = view;
+	return addResource(std::move(resource));
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer, const RenderGraphResourceState& initialState) {
+	Resource resource;
+	resource.name = name;
+	resource.isImage = false;
+	resource.initialState = initialState;
+	resource.buffer = buffer;
+	return addResource(std::move(resource));
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.transient = true;
+	resource.desc = desc;
+	return addResource(std::move(resource));
+}
+
+void RenderGraph::markOutput(RenderGraphResource resource) {
+	resources[resource].output = true;
+}
+
+void RenderGraph::setFinalState(RenderGraphResource resource, RenderGraphAccess access) {
+	if (resources[resource].transient) {
+		throw std::runtime_error("Render graph transient " + resources[resource].name + " cannot have a final state.");
+	}
+	resources[resource].output = true;
+	resources[resource].hasFinalState = true;
+	resources[resource].finalState = getAccessState(access);
+}
+
+RenderGraphPassBuilder RenderGraph::addPass(const std::string& name, RecordFunction record) {
+	Pass pass;
+	pass.name = name;
+	pass.record = std::move(record);
+	passes.push_back(std::move(pass));
+	return RenderGraphPassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+void RenderGraph::compile(const MemoryRequirementsFunction& memoryRequirements) {
+	cullPasses();
+	planTransients(memoryRequirements);
+	buildBarriers();
+}
+
+void RenderGraph::cullPasses() {
+	// Walk backwards from the outputs: a pass survives if something downstream needs one of its writes.
+	std::vector<bool> needed(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i) {
+		needed[i] = resources[i].output;
+	}
+
+	std::vector<bool> kept(passes.size());
+	for (size_t i = passes.size(); i-- > 0;) {
+		const Pass& pass = passes[i];
+		bool keep = pass.keepAlive;
+		for (const Usage& usage : pass.usages) {
+			keep = keep || (isWriteAccess(usage.access) && needed[usage.resource]);
+		}
+		if (!keep) {
+			continue;
+		}
+
+		kept[i] = true;
+		for (const Usage& usage : pass.usages) {
+			if (!isWriteAccess(usage.access)) {
+				needed[usage.resource] = true;
+			}
+		}
+	}
+
+	compiledPasses.clear();
+	for (uint32_t i = 0; i < passes.size(); ++i) {
+		if (kept[i]) {
+			compiledPasses.push_back(i);
+		}
+	}
+}
+
+void RenderGraph::planTransients(const MemoryRequirementsFunction& memoryRequirements) {
+	transientPlan = {};
+	transientPlan.memory.memoryTypeBits = ~0u;
+
+	std::vector<uint32_t> firstPass(resources.size(), UINT32_MAX);
+	std::vector<uint32_t> lastPass(resources.size(), 0);
+	for (uint32_t i = 0; i < compiledPasses.size(); ++i) {
+		for (const Usage& usage : passes[compiledPasses[i]].usages) {
+			firstPass[usage.resource] = std::min(firstPass[usage.resource], i);
+			lastPass[usage.resource] = std::max(lastPass[usage.resource], i);
+		}
+	}
+
+	std::vector<VkDeviceSize> alignments;
+	for (RenderGraphResource i = 0; i < resources.size(); ++i) {
+		const Resource& resource = resources[i];
+		// Transients only culled passes touched are never created.
+		if (!resource.transient || firstPass[i] == UINT32_MAX) {
+			continue;
+		}
+
+		VkImageCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		createInfo.imageType = VK_IMAGE_TYPE_2D;
+		createInfo.format = resource.desc.format;
+		createInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+		createInfo.mipLevels = 1;
+		createInfo.arrayLayers = 1;
+		createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		createInfo.usage = resource.usage;
+		createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkMemoryRequirements requirements = memoryRequirements(createInfo);
+		transientPlan.images.push_back({ i, createInfo, 0, requirements.size, firstPass[i], lastPass[i] });
+		alignments.push_back(requirements.alignment);
+		transientPlan.memory.memoryTypeBits &= requirements.memoryTypeBits;
+	}
+	if (transientPlan.images.empty()) {
+		return;
+	}
+
+	// Largest first, each at the lowest offset clear of every image alive at the same time.
+	std::vector<size_t> order(transientPlan.images.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return transientPlan.images[a].size > transientPlan.images[b].size; });
+
+	VkMemoryRequirements& memory = transientPlan.memory;
+	memory.alignment = 1;
+	std::vector<size_t> placed;
+	for (size_t index : order) {
+		RenderGraphTransientPlan::Image& image = transientPlan.images[index];
+
+		VkDeviceSize offset = 0;
+		bool moved = true;
+		while (moved) {
+			moved = false;
+			for (size_t other : placed) {
+				const RenderGraphTransientPlan::Image& placedImage = transientPlan.images[other];
+				bool livesOverlap = image.firstPass <= placedImage.lastPass && placedImage.firstPass <= image.lastPass;
+				bool memoryOverlaps = offset < placedImage.offset + placedImage.size && placedImage.offset < offset + image.size;
+				if (livesOverlap && memoryOverlaps) {
+					offset = alignUp(placedImage.offset + placedImage.size, alignments[index]);
+					moved = true;
+				}
+			}
+		}
+
+		image.offset = offset;
+		placed.push_back(index);
+		memory.size = std::max(memory.size, offset + image.size);
+		memory.alignment = std::max(memory.alignment, alignments[index]);
+	}
+	if (memory.memoryTypeBits == 0) {
+		throw std::runtime_error("Render graph transients have no memory type in common.");
+	}
+
+	uint64_t hash = hashValue(memory.size);
+	for (const RenderGraphTransientPlan::Image& image : transientPlan.images) {
+		hash = hashValue(image.resource, hash);
+		hash = hashValue(image.createInfo.format, hash);
+		hash = hashValue(image.createInfo.extent, hash);
+		hash = hashValue(image.createInfo.usage, hash);
+		hash = hashValue(resources[image.resource].desc.aspect, hash);
+		hash = hashValue(image.offset, hash);
+	}
+	transientPlan.hash = hash;
+}
+
+void RenderGraph::buildBarriers() {
+	std::vector<TrackedState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); ++i) {
+		const RenderGraphResourceState& initial = resources[i].initialState;
+		states[i].layout = initial.layout;
+		states[i].writeStages = initial.stages;
+		states[i].writeAccess = initial.access & writeAccessMask;
+	}
+
+	// A transient's first use must wait for the images that used its memory before it.
+	std::vector<std::vector<RenderGraphResource>> aliasedBefore(resources.size());
+	const std::vector<RenderGraphTransientPlan::Image>& images = transientPlan.images;
+	for (const RenderGraphTransientPlan::Image& image : images) {
+		for (const RenderGraphTransientPlan::Image& other : images) {
+			bool memoryOverlaps = other.offset < image.offset + image.size && image.offset < other.offset + other.size;
+			if (other.lastPass < image.firstPass && memoryOverlaps) {
+				aliasedBefore[image.resource].push_back(other.resource);
+			}
+		}
+	}
+	std::vector<bool> used(resources.size());
+
+	passBarriers.assign(compiledPasses.size(), {});
+	for (uint32_t i = 0; i < compiledPasses.size(); ++i) {
+		const Pass& pass = passes[compiledPasses[i]];
+
+		// Combine every use of a resource in the pass first, so it gets one barrier however often it is declared.
+		std::vector<RenderGraphResource> touched;
+		std::vector<RenderGraphResourceState> combined(resources.size());
+		std::vector<bool> writes(resources.size());
+		for (const Usage& usage : pass.usages) {
+			RenderGraphResourceState state = getAccessState(usage.access);
+			RenderGraphResourceState& merged = combined[usage.resource];
+			if (std::find(touched.begin(), touched.end(), usage.resource) == touched.end()) {
+				touched.push_back(usage.resource);
+				merged = state;
+			}
+			else if (resources[usage.resource].isImage && merged.layout != state.layout) {
+				throw std::runtime_error("Render graph pass " + pass.name + " uses " + resources[usage.resource].name + " in two layouts.");
+			}
+			merged.stages |= state.stages;
+			merged.access |= state.access;
+			writes[usage.resource] = writes[usage.resource] || isWriteAccess(usage.access);
+		}
+
+		for (RenderGraphResource resource : touched) {
+			TrackedState& state = states[resource];
+			if (!used[resource]) {
+				used[resource] = true;
+				for (RenderGraphResource previous : aliasedBefore[resource]) {
+					state.writeStages |= states[previous].writeStages | states[previous].readStages;
+					state.writeAccess |= states[previous].writeAccess;
+				}
+			}
+
+			RenderGraphBarrier barrier{};
+			barrier.resource = resource;
+			if (transition(state, combined[resource], writes[resource], resources[resource].isImage, barrier)) {
+				passBarriers[i].push_back(barrier);
+			}
+		}
+	}
+
+	finalBarriers.clear();
+	for (RenderGraphResource i = 0; i < resources.size(); ++i) {
+		RenderGraphBarrier barrier{};
+		barrier.resource = i;
+		if (resources[i].hasFinalState && transition(states[i], resources[i].finalState, false, resources[i].isImage, barrier)) {
+			finalBarriers.push_back(barrier);
+		}
+	}
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphBarrier>& barriers) const {
+	if (barriers.empty()) {
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+	for (const RenderGraphBarrier& barrier : barriers) {
+		const Resource& resource = resources[barrier.resource];
+		if (resource.isImage) {
+			VkImageMemoryBarrier2 imageBarrier{};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			imageBarrier.srcStageMask = barrier.before.stages;
+			imageBarrier.srcAccessMask = barrier.before.access;
+			imageBarrier.dstStageMask = barrier.after.stages;
+			imageBarrier.dstAccessMask = barrier.after.access;
+			imageBarrier.oldLayout = barrier.before.layout;
+			imageBarrier.newLayout = barrier.after.layout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange = { resource.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			imageBarriers.push_back(imageBarrier);
+		}
+		else {
+			VkBufferMemoryBarrier2 bufferBarrier{};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			bufferBarrier.srcStageMask = barrier.before.stages;
+			bufferBarrier.srcAccessMask = barrier.before.access;
+			bufferBarrier.dstStageMask = barrier.after.stages;
+			bufferBarrier.dstAccessMask = barrier.after.access;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = resource.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarriers.push_back(bufferBarrier);
+		}
+	}
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+	dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+	dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+	dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void RenderGraph::execute(FrameScheduler& frameScheduler, JobSystem& jobSystem) const {
+	std::vector<FrameScheduler::RecordPass> recordPasses;
+	for (uint32_t i = 0; i < compiledPasses.size(); ++i) {
+		bool last = i + 1 == compiledPasses.size();
+		recordPasses.push_back([this, i, last](VkCommandBuffer commandBuffer) {
+			recordBarriers(commandBuffer, passBarriers[i]);
+			passes[compiledPasses[i]].record(commandBuffer);
+			if (last) {
+				recordBarriers(commandBuffer, finalBarriers);
+			}
+		});
+	}
+	if (recordPasses.empty() && !finalBarriers.empty()) {
+		recordPasses.push_back([this](VkCommandBuffer commandBuffer) { recordBarriers(commandBuffer, finalBarriers); });
+	}
+	frameScheduler.recordParallel(jobSystem, recordPasses);
+}
+
+void RenderGraphTransients::init(VkDevice device, GpuMemoryAllocator& allocator, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->callbacks = callbacks;
+}
+
+void RenderGraphTransients::destroy() {
+	release();
+}
+
+void RenderGraphTransients::release() {
+	for (Image& image : images) {
+		vkDestroyImageView(device, image.view, callbacks);
+		vkDestroyImage(device, image.image, callbacks);
+	}
+	images.clear();
+	if (memory) {
+		allocator->free(memory);
+		memory = nullptr;
+	}
+	planHash = 0;
+}
+
+VkMemoryRequirements RenderGraphTransients::getMemoryRequirements(const VkImageCreateInfo& createInfo) const {
+	// Core in 1.3: requirements without creating the image first.
+	VkDeviceImageMemoryRequirements requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+	requirementsInfo.pCreateInfo = &createInfo;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	vkGetDeviceImageMemoryRequirements(device, &requirementsInfo, &requirements);
+	return requirements.memoryRequirements;
+}
+
+void RenderGraphTransients::bind(RenderGraph& graph) {
+	const RenderGraphTransientPlan& plan = graph.getTransientPlan();
+	if (plan.hash != planHash) {
+		release();
+	}
+
+	if (images.empty() && !plan.images.empty()) {
+		memory = allocator->allocateForAliasing(plan.memory, MemoryUsage::GpuOnly, false);
+
+		for (const RenderGraphTransientPlan::Image& planned : plan.images) {
+			Image image;
+			if (vkCreateImage(device, &planned.createInfo, callbacks, &image.image) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create render graph image " + graph.resources[planned.resource].name + ".");
+			}
+			images.push_back(image);
+			if (vkBindImageMemory(device, image.image, memory->memory, memory->offset + planned.offset) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to bind render graph image memory.");
+			}
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = planned.createInfo.format;
+			viewInfo.subresourceRange = { graph.getImageDesc(planned.resource).aspect, 0, 1, 0, 1 };
+			if (vkCreateImageView(device, &viewInfo, callbacks, &images.back().view) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create render graph image view.");
+			}
+		}
+		planHash = plan.hash;
+	}
+
+	for (size_t i = 0; i < plan.images.size(); ++i) {
+		graph.resources[plan.images[i].resource].image = images[i].image;
+		graph.resources[plan.images[i].resource].view = images[i].view;
+	}
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "frameScheduler.h"
+#include "gpuMemoryAllocator.h"
+#include "jobSystem.h"
+
+using RenderGraphResource = uint32_t;
+
+// How a pass touches a resource. Each one maps to fixed stages, access and (for images) layout.
+enum class RenderGraphAccess {
+	ColorAttachmentWrite,
+	DepthAttachmentWrite,
+	DepthAttachmentRead,
+	SampledRead, // Fragment and compute shaders.
+	StorageRead,
+	StorageWrite,
+	TransferRead,
+	TransferWrite,
+	VertexBufferRead,
+	IndexBufferRead,
+	IndirectRead,
+	UniformRead,
+	HostRead // Only meaningful as the final state of an imported resource.
+};
+
+struct RenderGraphResourceState {
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // Ignored for buffers.
+};
+
+RenderGraphResourceState getAccessState(RenderGraphAccess access);
+bool isWriteAccess(RenderGraphAccess access);
+
+struct RenderGraphImageDesc {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent{};
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// One barrier the compiled graph records, by resource rather than handle so compiling needs no device.
+struct RenderGraphBarrier {
+	RenderGraphResource resource;
+	RenderGraphResourceState before;
+	RenderGraphResourceState after;
+};
+
+// Where each transient image lives in the frame's shared memory, and how big that memory must be.
+struct RenderGraphTransientPlan {
+	struct Image {
+		RenderGraphResource resource;
+		VkImageCreateInfo createInfo;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t firstPass; // Index into the compiled pass order.
+		uint32_t lastPass;
+	};
+
+	std::vector<Image> images;
+	VkMemoryRequirements memory{};
+	uint64_t hash = 0; // Equal hashes mean the images from a previous frame can be reused as they are.
+};
+
+class RenderGraph;
+
+// Chains read/write declarations onto a pass just added with RenderGraph::addPass.
+class RenderGraphPassBuilder {
+
+	public:
+		RenderGraphPassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+		RenderGraphPassBuilder& read(RenderGraphResource resource, RenderGraphAccess access);
+		RenderGraphPassBuilder& write(RenderGraphResource resource, RenderGraphAccess access);
+		// Keeps the pass even when nothing reads what it writes, e.g. a pass that only writes to host memory.
+		RenderGraphPassBuilder& keepAlive();
+
+	private:
+		RenderGraph& graph;
+		uint32_t pass;
+};
+
+/*
+	Render Graph
+	- Rebuilt every frame: passes declare which resources they read and write, then compile() works out the rest.
+	- Passes run in the order they were added. Passes whose writes reach no output are culled.
+	- Each pass gets at most one vkCmdPipelineBarrier2 in front of it, holding every transition and hazard for the
+	  resources it touches. Reads that an earlier barrier already made visible get none.
+	- Transient images share one memory allocation. Images whose lifetimes (first to last pass) don't overlap are
+	  placed at overlapping offsets, and the first use of each one waits for whatever used that memory before it.
+	- compile() makes no Vulkan calls; memory requirements come from the caller, so the compiler runs on the CPU alone.
+*/
+class RenderGraph {
+
+	public:
+		using RecordFunction = std::function<void(VkCommandBuffer)>;
+		using MemoryRequirementsFunction = std::function<VkMemoryRequirements(const VkImageCreateInfo&)>;
+
+		// initialState is whatever the resource was last used for before this graph, including by earlier frames.
+		RenderGraphResource importImage(const std::string& name, VkImage image, VkImageView view, const RenderGraphImageDesc& desc, const RenderGraphResourceState& initialState);
+		RenderGraphResource importBuffer(const std::string& name, VkBuffer buffer, const RenderGraphResourceState& initialState);
+		// Lives only within the graph; contents are undefined at its first use.
+		RenderGraphResource createImage(const std::string& name, const RenderGraphImageDesc& desc);
+
+		// Outputs keep the passes that write them. A final state also gets a barrier after the last pass.
+		void markOutput(RenderGraphResource resource);
+		void setFinalState(RenderGraphResource resource, RenderGraphAccess access);
+
+		RenderGraphPassBuilder addPass(const std::string& name, RecordFunction record);
+
+		void compile(const MemoryRequirementsFunction& memoryRequirements);
+		// Records each compiled pass, with its barriers, into its own secondary command buffer.
+		void execute(FrameScheduler& frameScheduler, JobSystem& jobSystem) const;
+
+		VkImage getImage(RenderGraphResource resource) const { return resources[resource].image; }
+		VkImageView getImageView(RenderGraphResource resource) const { return resources[resource].view; }
+		VkBuffer getBuffer(RenderGraphResource resource) const { return resources[resource].buffer; }
+		const RenderGraphImageDesc& getImageDesc(RenderGraphResource resource) const { return resources[resource].desc; }
+
+		// Results of compile(), in the compiled pass order.
+		const std::vector<uint32_t>& getCompiledPasses() const { return compiledPasses; }
+		const std::vector<RenderGraphBarrier>& getPassBarriers(uint32_t compiledIndex) const { return passBarriers[compiledIndex]; }
+		const std::vector<RenderGraphBarrier>& getFinalBarriers() const { return finalBarriers; }
+		const RenderGraphTransientPlan& getTransientPlan() const { return transientPlan; }
+		const std::string& getPassName(uint32_t pass) const { return passes[pass].name; }
+
+	private:
+		friend class RenderGraphPassBuilder;
+		friend class RenderGraphTransients;
+
+		struct Resource {
+			std::string name;
+			bool isImage = true;
+			bool transient = false;
+			bool output = false;
+			RenderGraphImageDesc desc;
+			RenderGraphResourceState initialState;
+			bool hasFinalState = false;
+			RenderGraphResourceState finalState;
+			VkImageUsageFlags usage = 0; // Accumulated from every pass that touches a transient.
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkBuffer buffer = VK_NULL_HANDLE;
+		};
+
+		struct Usage {
+			RenderGraphResource resource;
+			RenderGraphAccess access;
+		};
+
+		struct Pass {
+			std::string name;
+			RecordFunction record;
+			std::vector<Usage> usages;
+			bool keepAlive = false;
+		};
+
+		std::vector<Resource> resources;
+		std::vector<Pass> passes;
+
+		std::vector<uint32_t> compiledPasses;
+		std::vector<std::vector<RenderGraphBarrier>> passBarriers;
+		std::vector<RenderGraphBarrier> finalBarriers;
+		RenderGraphTransientPlan transientPlan;
+
+		RenderGraphResource addResource(Resource resource);
+		void cullPasses();
+		void planTransients(const MemoryRequirementsFunction& memoryRequirements);
+		void buildBarriers();
+		void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphBarrier>& barriers) const;
+};
+
+/*
+	Render Graph Transients
+	- Backs a graph's transient images for one frame slot. Slots are never shared between frames in flight, so an
+	  image here is only ever in use by one frame at a time.
+	- Images are kept while the transient plan is unchanged and recreated when it changes, which only happens when
+	  the set of passes or attachment sizes change.
+*/
+class RenderGraphTransients {
+
+	public:
+		void init(VkDevice device, GpuMemoryAllocator& allocator, const VkAllocationCallbacks* callbacks);
+		void destroy();
+
+		VkMemoryRequirements getMemoryRequirements(const VkImageCreateInfo& createInfo) const;
+		// Call after compile() and only once this slot's previous frame has completed.
+		void bind(RenderGraph& graph);
+
+	private:
+		struct Image {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		GpuMemoryAllocator* allocator = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+
+		uint64_t planHash = 0;
+		GpuAllocation* memory = nullptr;
+		std::vector<Image> images; // Same order as the plan's images.
+
+		void release();
+};
@@ -0,0 +1,459 @@
+#include "sceneBvh.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	const uint32_t binCount = 16;
+	const uint32_t maxLeafSize = 8;
+	const uint32_t maxDepth = 60; // Keeps every traversal within stackSize.
+	const uint32_t stackSize = 64;
+	const float traversalCost = 1.0f; // Relative to testing one primitive.
+
+	const uint32_t parallelSubtreeSize = 4096; // Subtrees at least this big are built as their own job.
+	const uint32_t parallelRangeSize = 65536; // Nodes at least this big bound and bin their primitives in parallel.
+	const uint32_t parallelBatchSize = 16384;
+
+	struct BuildPrimitive {
+		Aabb bounds;
+		glm::vec3 centroid;
+		uint32_t index;
+	};
+
+	struct Bin {
+		Aabb bounds;
+		uint32_t count = 0;
+	};
+
+	struct Bins {
+		Bin axes[3][binCount];
+
+		void merge(const Bins& other) {
+			for (int axis = 0; axis < 3; ++axis) {
+				for (uint32_t i = 0; i < binCount; ++i) {
+					axes[axis][i].bounds.grow(other.axes[axis][i].bounds);
+					axes[axis][i].count += other.axes[axis][i].count;
+				}
+			}
+		}
+	};
+
+	struct RangeBounds {
+		Aabb bounds;
+		Aabb centroids;
+
+		void merge(const RangeBounds& other) {
+			bounds.grow(other.bounds);
+			centroids.grow(other.centroids);
+		}
+	};
+
+	enum class Overlap {
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	Overlap classifyBox(const glm::vec4 planes[6], const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		Overlap overlap = Overlap::Inside;
+		for (int i = 0; i < 6; ++i) {
+			const glm::vec4& plane = planes[i];
+			// The corners furthest along and against the plane normal.
+			glm::vec3 positive(plane.x >= 0.0f ? boxMax.x : boxMin.x, plane.y >= 0.0f ? boxMax.y : boxMin.y, plane.z >= 0.0f ? boxMax.z : boxMin.z);
+			glm::vec3 negative(plane.x >= 0.0f ? boxMin.x : boxMax.x, plane.y >= 0.0f ? boxMin.y : boxMax.y, plane.z >= 0.0f ? boxMin.z : boxMax.z);
+			if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+				return Overlap::Outside;
+			}
+			if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f) {
+				overlap = Overlap::Intersecting;
+			}
+		}
+		return overlap;
+	}
+
+	bool boxesOverlap(const Aabb& box, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		return box.min.x <= boxMax.x && box.max.x >= boxMin.x && box.min.y <= boxMax.y && box.max.y >= boxMin.y
+			&& box.min.z <= boxMax.z && box.max.z >= boxMin.z;
+	}
+
+	bool sphereOverlapsBox(const glm::vec3& centre, float radiusSquared, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		glm::vec3 offset = centre - glm::clamp(centre, boxMin, boxMax);
+		return glm::dot(offset, offset) <= radiusSquared;
+	}
+
+	// Slab test. Returns the entry distance, or FLT_MAX when the ray misses or enters beyond maxDistance.
+	float rayBoxEntry(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+		glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+		glm::vec3 nearest = glm::min(t0, t1);
+		glm::vec3 furthest = glm::max(t0, t1);
+		float entry = std::max(std::max(nearest.x, nearest.y), std::max(nearest.z, 0.0f));
+		float exit = std::min(std::min(furthest.x, furthest.y), std::min(furthest.z, maxDistance));
+		return entry <= exit ? entry : FLT_MAX;
+	}
+}
+
+struct SceneBvh::BuildContext {
+	JobSystem& jobSystem;
+	JobCounter jobs;
+	std::vector<BuildPrimitive> primitives; // Partitioned in place, so every pass over a node reads memory in order.
+	std::atomic<uint32_t> nodeCount{ 1 }; // The root is allocated up front.
+
+	explicit BuildContext(JobSystem& jobSystem) : jobSystem(jobSystem) {}
+};
+
+void SceneBvh::build(JobSystem& jobSystem, const std::vector<Aabb>& primitiveBounds) {
+	CPU_PROFILE_SCOPE("SceneBvh::build");
+	clear();
+	if (primitiveBounds.empty()) {
+		return;
+	}
+
+	uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+	bounds = primitiveBounds;
+	primitiveOrder.resize(primitiveCount);
+	nodes.resize(2 * static_cast<size_t>(primitiveCount) - 1); // The most a binary tree with single-primitive leaves needs.
+
+	BuildContext context(jobSystem);
+	context.primitives.resize(primitiveCount);
+	jobSystem.parallelFor(primitiveCount, parallelBatchSize, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			context.primitives[i] = BuildPrimitive{ bounds[i], bounds[i].centre(), i };
+		}
+	});
+
+	buildNode(context, 0, 0, primitiveCount, 0);
+	jobSystem.wait(context.jobs);
+	nodes.resize(context.nodeCount.load());
+	for (uint32_t i = 0; i < primitiveCount; ++i) {
+		primitiveOrder[i] = context.primitives[i].index;
+	}
+}
+
+void SceneBvh::buildNode(BuildContext& context, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth) {
+	uint32_t count = end - begin;
+
+	// Node bounds and the bounds of its centroids, which is what the bins divide up.
+	RangeBounds range;
+	auto boundRange = [&](uint32_t first, uint32_t last, RangeBounds& result) {
+		for (uint32_t i = first; i < last; ++i) {
+			const BuildPrimitive& primitive = context.primitives[i];
+			result.bounds.grow(primitive.bounds);
+			result.centroids.grow(primitive.centroid);
+		}
+	};
+	if (count >= parallelRangeSize) {
+		std::vector<RangeBounds> batches((count + parallelBatchSize - 1) / parallelBatchSize);
+		context.jobSystem.parallelFor(count, parallelBatchSize, [&](uint32_t first, uint32_t last) {
+			boundRange(begin + first, begin + last, batches[first / parallelBatchSize]);
+		});
+		for (const RangeBounds& batch : batches) {
+			range.merge(batch);
+		}
+	}
+	else {
+		boundRange(begin, end, range);
+	}
+
+	BvhNode& node = nodes[nodeIndex];
+	node.boundsMin = range.bounds.min;
+	node.boundsMax = range.bounds.max;
+	node.first = begin;
+	node.count = count;
+
+	glm::vec3 extent = range.centroids.max - range.centroids.min;
+	bool coincident = extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f;
+	if (count <= 2 || depth >= maxDepth || (coincident && count <= maxLeafSize)) {
+		return;
+	}
+
+	uint32_t middle = begin + count / 2;
+	if (!coincident) {
+		// Bin index of a centroid along an axis. The scale keeps the largest centroid inside the last bin.
+		glm::vec3 scale;
+		for (int axis = 0; axis < 3; ++axis) {
+			scale[axis] = extent[axis] > 0.0f ? static_cast<float>(binCount) * 0.9999f / extent[axis] : 0.0f;
+		}
+		auto binOf = [&](const BuildPrimitive& primitive, int axis) {
+			return std::min(binCount - 1, static_cast<uint32_t>((primitive.centroid[axis] - range.centroids.min[axis]) * scale[axis]));
+		};
+
+		Bins bins;
+		auto binRange = [&](uint32_t first, uint32_t last, Bins& result) {
+			for (uint32_t i = first; i < last; ++i) {
+				const BuildPrimitive& primitive = context.primitives[i];
+				for (int axis = 0; axis < 3; ++axis) {
+					Bin& bin = result.axes[axis][binOf(primitive, axis)];
+					bin.bounds.grow(primitive.bounds);
+					bin.count++;
+				}
+			}
+		};
+		if (count >= parallelRangeSize) {
+			std::vector<Bins> batches((count + parallelBatchSize - 1) / parallelBatchSize);
+			context.jobSystem.parallelFor(count, parallelBatchSize, [&](uint32_t first, uint32_t last) {
+				binRange(begin + first, begin + last, batches[first / parallelBatchSize]);
+			});
+			for (const Bins& batch : batches) {
+				bins.merge(batch);
+			}
+		}
+		else {
+			binRange(begin, end, bins);
+		}
+
+		// Sweep each axis from both ends, then cost every split plane between bins.
+		float nodeArea = std::max(range.bounds.halfArea(), FLT_MIN);
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+			float leftArea[binCount - 1];
+			uint32_t leftCount[binCount - 1];
+			Aabb left;
+			uint32_t leftTotal = 0;
+			for (uint32_t i = 0; i < binCount - 1; ++i) {
+				left.grow(bins.axes[axis][i].bounds);
+				leftTotal += bins.axes[axis][i].count;
+				leftArea[i] = leftTotal > 0 ? left.halfArea() : 0.0f;
+				leftCount[i] = leftTotal;
+			}
+
+			Aabb right;
+			uint32_t rightTotal = 0;
+			for (uint32_t i = binCount - 1; i > 0; --i) {
+				right.grow(bins.axes[axis][i].bounds);
+				rightTotal += bins.axes[axis][i].count;
+				if (leftCount[i - 1] == 0 || rightTotal == 0) {
+					continue;
+				}
+				float cost = traversalCost + (leftArea[i - 1] * leftCount[i - 1] + right.halfArea() * rightTotal) / nodeArea;
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i - 1; // Bins up to and including this one go left.
+				}
+			}
+		}
+
+		// Splitting has to beat testing every primitive, unless the leaf would be too big.
+		if (bestAxis < 0 || (bestCost >= static_cast<float>(count) && count <= maxLeafSize)) {
+			return;
+		}
+
+		auto split = std::partition(context.primitives.begin() + begin, context.primitives.begin() + end,
+			[&](const BuildPrimitive& primitive) { return binOf(primitive, bestAxis) <= bestSplit; });
+		middle = static_cast<uint32_t>(split - context.primitives.begin());
+	}
+	// Coincident centroids can't be told apart, so an oversized group is just halved.
+
+	uint32_t children = context.nodeCount.fetch_add(2);
+	node.first = children;
+	node.count = 0;
+
+	auto buildChild = [this, &context, depth](uint32_t child, uint32_t childBegin, uint32_t childEnd) {
+		if (childEnd - childBegin >= parallelSubtreeSize) {
+			context.jobSystem.submit([this, &context, child, childBegin, childEnd, depth]() {
+				buildNode(context, child, childBegin, childEnd, depth + 1);
+			}, &context.jobs);
+		}
+		else {
+			buildNode(context, child, childBegin, childEnd, depth + 1);
+		}
+	};
+	buildChild(children, begin, middle);
+	buildChild(children + 1, middle, end);
+}
+
+void SceneBvh::refit(const std::vector<Aabb>& primitiveBounds) {
+	CPU_PROFILE_SCOPE("SceneBvh::refit");
+	bounds = primitiveBounds;
+
+	// Children are always allocated after their parent, so a reverse sweep sees every child before its parent.
+	for (size_t i = nodes.size(); i-- > 0;) {
+		BvhNode& node = nodes[i];
+		Aabb box;
+		if (node.count > 0) {
+			for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+				box.grow(bounds[primitiveOrder[j]]);
+			}
+		}
+		else {
+			for (uint32_t child = node.first; child < node.first + 2; ++child) {
+				box.grow(Aabb{ nodes[child].boundsMin, nodes[child].boundsMax });
+			}
+		}
+		node.boundsMin = box.min;
+		node.boundsMax = box.max;
+	}
+}
+
+void SceneBvh::clear() {
+	nodes.clear();
+	primitiveOrder.clear();
+	bounds.clear();
+}
+
+void SceneBvh::queryFrustum(const glm::vec4 planes[6], std::vector<uint32_t>& visible) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	uint32_t stack[stackSize];
+	uint32_t stackTop = 0;
+	stack[stackTop++] = 0;
+	while (stackTop > 0) {
+		uint32_t nodeIndex = stack[--stackTop];
+		const BvhNode& node = nodes[nodeIndex];
+		Overlap overlap = classifyBox(planes, node.boundsMin, node.boundsMax);
+		if (overlap == Overlap::Outside) {
+			continue;
+		}
+		if (overlap == Overlap::Inside) {
+			appendSubtree(nodeIndex, visible); // Nothing below can be outside, so skip the tests.
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				const Aabb& box = bounds[primitiveOrder[i]];
+				if (classifyBox(planes, box.min, box.max) != Overlap::Outside) {
+					visible.push_back(primitiveOrder[i]);
+				}
+			}
+		}
+		else {
+			stack[stackTop++] = node.first;
+			stack[stackTop++] = node.first + 1;
+		}
+	}
+}
+
+void SceneBvh::queryBox(const Aabb& box, std::vector<uint32_t>& overlapping) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	uint32_t stack[stackSize];
+	uint32_t stackTop = 0;
+	stack[stackTop++] = 0;
+	while (stackTop > 0) {
+		const BvhNode& node = nodes[stack[--stackTop]];
+		if (!boxesOverlap(box, node.boundsMin, node.boundsMax)) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				const Aabb& primitiveBox = bounds[primitiveOrder[i]];
+				if (boxesOverlap(box, primitiveBox.min, primitiveBox.max)) {
+					overlapping.push_back(primitiveOrder[i]);
+				}
+			}
+		}
+		else {
+			stack[stackTop++] = node.first;
+			stack[stackTop++] = node.first + 1;
+		}
+	}
+}
+
+void SceneBvh::querySphere(const glm::vec3& centre, float radius, std::vector<uint32_t>& overlapping) const {
+	if (nodes.empty()) {
+		return;
+	}
+
+	float radiusSquared = radius * radius;
+	uint32_t stack[stackSize];
+	uint32_t stackTop = 0;
+	stack[stackTop++] = 0;
+	while (stackTop > 0) {
+		const BvhNode& node = nodes[stack[--stackTop]];
+		if (!sphereOverlapsBox(centre, radiusSquared, node.boundsMin, node.boundsMax)) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				const Aabb& box = bounds[primitiveOrder[i]];
+				if (sphereOverlapsBox(centre, radiusSquared, box.min, box.max)) {
+					overlapping.push_back(primitiveOrder[i]);
+				}
+			}
+		}
+		else {
+			stack[stackTop++] = node.first;
+			stack[stackTop++] = node.first + 1;
+		}
+	}
+}
+
+bool SceneBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit, const RayIntersectFunction& intersect) const {
+	hit = BvhRayHit{};
+	if (nodes.empty()) {
+		return false;
+	}
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float closest = maxDistance;
+	if (rayBoxEntry(origin, inverseDirection, closest, nodes[0].boundsMin, nodes[0].boundsMax) == FLT_MAX) {
+		return false;
+	}
+
+	uint32_t stack[stackSize];
+	uint32_t stackTop = 0;
+	stack[stackTop++] = 0;
+	while (stackTop > 0) {
+		const BvhNode& node = nodes[stack[--stackTop]];
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t primitive = primitiveOrder[i];
+				float distance = intersect ? intersect(primitive)
+					: rayBoxEntry(origin, inverseDirection, closest, bounds[primitive].min, bounds[primitive].max);
+				if (distance >= 0.0f && distance < closest) {
+					closest = distance;
+					hit.primitive = primitive;
+					hit.distance = distance;
+				}
+			}
+			continue;
+		}
+
+		// Nearer child on top of the stack, so it is searched first and shrinks closest for the other.
+		const BvhNode& left = nodes[node.first];
+		const BvhNode& right = nodes[node.first + 1];
+		float leftEntry = rayBoxEntry(origin, inverseDirection, closest, left.boundsMin, left.boundsMax);
+		float rightEntry = rayBoxEntry(origin, inverseDirection, closest, right.boundsMin, right.boundsMax);
+		uint32_t nearChild = leftEntry <= rightEntry ? node.first : node.first + 1;
+		uint32_t farChild = leftEntry <= rightEntry ? node.first + 1 : node.first;
+		if (std::max(leftEntry, rightEntry) != FLT_MAX) {
+			stack[stackTop++] = farChild;
+		}
+		if (std::min(leftEntry, rightEntry) != FLT_MAX) {
+			stack[stackTop++] = nearChild;
+		}
+	}
+	return hit.primitive != UINT32_MAX;
+}
+
+void SceneBvh::appendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& primitives) const {
+	uint32_t stack[stackSize];
+	uint32_t stackTop = 0;
+	stack[stackTop++] = nodeIndex;
+	while (stackTop > 0) {
+		const BvhNode& node = nodes[stack[--stackTop]];
+		if (node.count > 0) {
+			primitives.insert(primitives.end(), primitiveOrder.begin() + node.first, primitiveOrder.begin() + node.first + node.count);
+		}
+		else {
+			stack[stackTop++] = node.first;
+			stack[stackTop++] = node.first + 1;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/common.hpp>
+
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "jobSystem.h"
+
+struct Aabb {
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	void grow(const glm::vec3& point) { min = glm::min(min, point); max = glm::max(max, point); }
+	void grow(const Aabb& other) { min = glm::min(min, other.min); max = glm::max(max, other.max); }
+	glm::vec3 centre() const { return (min + max) * 0.5f; }
+	// Half the surface area; SAH only compares areas, so the factor of two never matters.
+	float halfArea() const {
+		glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+};
+
+// 32 bytes, two per cache line. Siblings are always adjacent, so one index reaches both children.
+struct BvhNode {
+	glm::vec3 boundsMin;
+	uint32_t first; // Leaf: first entry in the primitive order. Interior: left child; the right child is first + 1.
+	glm::vec3 boundsMax;
+	uint32_t count; // Primitives in a leaf. Zero for interior nodes.
+};
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode should stay half a cache line.");
+
+struct BvhRayHit {
+	uint32_t primitive = UINT32_MAX;
+	float distance = FLT_MAX;
+};
+
+/*
+	Scene BVH
+	- Bounding volume hierarchy over primitive AABBs, for scene queries: frustum culling, ray picking and finding what
+	  a light's sphere of influence touches.
+	- Built top down with binned SAH (16 bins per axis). Large subtrees are built as separate jobs, and large nodes
+	  bin their primitives in parallel too, so the whole machine is busy from the root down.
+	- refit() updates bounds for moved primitives without changing the tree. Quality drops as things move further
+	  from where they were at build time, so rebuild once motion is more than local.
+	- Queries append primitive indices (positions in the bounds array given to build) and never allocate otherwise.
+*/
+class SceneBvh {
+
+	public:
+		// Returns the hit distance along the ray, or a negative value for a miss.
+		using RayIntersectFunction = std::function<float(uint32_t primitive)>;
+
+		void build(JobSystem& jobSystem, const std::vector<Aabb>& bounds);
+		// Same primitives, new bounds.
+		void refit(const std::vector<Aabb>& bounds);
+		void clear();
+
+		// planes as from extractFrustumPlanes: inward-facing and normalized.
+		void queryFrustum(const glm::vec4 planes[6], std::vector<uint32_t>& visible) const;
+		void queryBox(const Aabb& box, std::vector<uint32_t>& overlapping) const;
+		void querySphere(const glm::vec3& centre, float radius, std::vector<uint32_t>& overlapping) const;
+		// Closest hit within maxDistance. Without intersect the primitives' own boxes are hit, which is enough for picking.
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit, const RayIntersectFunction& intersect = nullptr) const;
+
+		const std::vector<BvhNode>& getNodes() const { return nodes; }
+		uint32_t getPrimitiveCount() const { return static_cast<uint32_t>(bounds.size()); }
+
+	private:
+		struct BuildContext;
+
+		std::vector<BvhNode> nodes; // Root first.
+		std::vector<uint32_t> primitiveOrder; // Leaves index into this; every subtree covers a contiguous range of it.
+		std::vector<Aabb> bounds;
+
+		void buildNode(BuildContext& context, uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth);
+		void appendSubtree(uint32_t nodeIndex, std::vector<uint32_t>& primitives) const;
+};
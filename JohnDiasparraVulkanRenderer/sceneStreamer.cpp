@@ -0,0 +1,411 @@
+#include "sceneStreamer.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	const VkFormat textureFormat = VK_FORMAT_R8G8B8A8_UNORM; // The colour target is UNORM too, so texels stay encoded end to end.
+	const VkImageSubresourceRange textureRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+}
+
+void SceneStreamer::init(VkDevice device, DeviceQueues& queues, UploadManager& uploads, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless, TextureResidency& residency, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->uploads = &uploads;
+	this->allocator = &allocator;
+	this->bindless = &bindless;
+	this->residency = &residency;
+	this->callbacks = callbacks;
+
+	uint32_t graphicsFamily = queues.getFamilyIndex(QueueType::Graphics);
+	uint32_t transferFamily = queues.getFamilyIndex(QueueType::Transfer);
+	sharingFamilies = { graphicsFamily };
+	if (transferFamily != graphicsFamily) {
+		sharingFamilies.push_back(transferFamily);
+	}
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	if (vkCreateSampler(device, &samplerInfo, callbacks, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create scene texture sampler.");
+	}
+}
+
+void SceneStreamer::destroy() {
+	if (device == VK_NULL_HANDLE) {
+		return;
+	}
+	uploads->wait(inFlight.empty() ? publishedValue : inFlight.back().timelineValue);
+
+	destroyTexture(placeholder);
+	if (vertexBuffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device, vertexBuffer, callbacks);
+		allocator->free(vertexAllocation);
+		vkDestroyBuffer(device, indexBuffer, callbacks);
+		allocator->free(indexAllocation);
+		vertexBuffer = indexBuffer = VK_NULL_HANDLE;
+	}
+	vkDestroySampler(device, sampler, callbacks);
+	inFlight.clear();
+	pending.clear();
+	device = VK_NULL_HANDLE;
+}
+
+void SceneStreamer::begin(JobSystem& jobSystem, GltfLoader& loader, GpuCuller& culler) {
+	CPU_PROFILE_SCOPE("beginSceneStreaming");
+	this->loader = &loader;
+	this->culler = &culler;
+	sourcePath = loader.getPath();
+	boundsMin = loader.getBoundsMin();
+	boundsMax = loader.getBoundsMax();
+	startTime = Clock::now();
+
+	const std::vector<GltfPrimitive>& primitives = loader.getPrimitives();
+	const std::vector<GltfInstance>& sceneInstances = loader.getInstances();
+	if (sceneInstances.empty()) {
+		throw std::runtime_error(loader.getPath() + " has nothing to draw.");
+	}
+
+	VkDeviceSize vertexCount = 0;
+	VkDeviceSize indexCount = 0;
+	for (const GltfPrimitive& primitive : primitives) {
+		vertexCount = std::max<VkDeviceSize>(vertexCount, primitive.firstVertex + static_cast<VkDeviceSize>(primitive.vertexCount));
+		indexCount = std::max<VkDeviceSize>(indexCount, primitive.firstIndex + static_cast<VkDeviceSize>(primitive.indexCount));
+	}
+	createGeometry(sizeof(MeshVertex) * vertexCount, sizeof(uint32_t) * indexCount);
+	createPlaceholder();
+
+	// Every mesh starts empty: indexCount zero draws nothing until its geometry has landed.
+	meshes.resize(primitives.size());
+	for (size_t i = 0; i < primitives.size(); ++i) {
+		meshes[i] = { 0, primitives[i].firstIndex, static_cast<int32_t>(primitives[i].firstVertex), placeholder.bindlessIndex };
+	}
+
+	textureUsers.assign(loader.getImageCount(), {});
+	for (uint32_t i = 0; i < primitives.size(); ++i) {
+		uint32_t material = primitives[i].material;
+		if (material != gltfNone && loader.getMaterials()[material].baseColorImage != gltfNone) {
+			textureUsers[loader.getMaterials()[material].baseColorImage].push_back(i);
+		}
+	}
+
+	std::vector<CullInstance> instances;
+	instances.reserve(sceneInstances.size());
+	for (const GltfInstance& sceneInstance : sceneInstances) {
+		CullInstance instance{};
+		instance.transform = sceneInstance.transform;
+		instance.boundingSphere = sceneInstance.boundingSphere;
+		instance.mesh = sceneInstance.primitive;
+		instance.bucket = 0;
+		instances.push_back(instance);
+	}
+	setInstances(jobSystem, instances);
+}
+
+void SceneStreamer::beginMeshFile(JobSystem& jobSystem, const MeshFile& file, GpuCuller& culler) {
+	CPU_PROFILE_SCOPE("beginSceneStreaming");
+	const MeshFileHeader& header = file.getHeader();
+	if (header.submeshCount == 0) {
+		throw std::runtime_error(file.getPath() + " has nothing to draw.");
+	}
+	meshFile = &file;
+	this->culler = &culler;
+	sourcePath = file.getPath();
+	boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	startTime = Clock::now();
+
+	// The streams go in exactly as stored, so the buffers take the file's index width.
+	indexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	createGeometry(file.getStreamSize(MeshStream::Vertices), file.getStreamSize(MeshStream::Indices));
+	createPlaceholder();
+	file.prefetch(); // Reading ahead of the copies, so the memcpys don't fault page by page.
+
+	// Submeshes share the one vertex stream, so they are all published when the whole file has landed.
+	const MeshSubmesh* submeshes = file.getSubmeshes();
+	meshes.resize(header.submeshCount);
+	std::vector<CullInstance> instances(header.submeshCount);
+	for (uint32_t i = 0; i < header.submeshCount; ++i) {
+		meshes[i] = { 0, submeshes[i].firstIndex, 0, placeholder.bindlessIndex };
+		instances[i].transform = glm::mat4(1.0f);
+		instances[i].boundingSphere = glm::vec4(submeshes[i].boundingSphere[0], submeshes[i].boundingSphere[1], submeshes[i].boundingSphere[2],
+			submeshes[i].boundingSphere[3]);
+		instances[i].mesh = i;
+		instances[i].bucket = 0;
+	}
+	setInstances(jobSystem, instances);
+	pending.push_back({ { GltfReadyItem::Kind::Primitive, 0 }, 0 });
+}
+
+void SceneStreamer::createGeometry(VkDeviceSize vertexBytes, VkDeviceSize indexBytes) {
+	// Never zero sized, even for a scene whose primitives are all empty.
+	vertexBuffer = createBuffer(std::max<VkDeviceSize>(vertexBytes, sizeof(MeshVertex)), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, vertexAllocation);
+	indexBuffer = createBuffer(std::max<VkDeviceSize>(indexBytes, sizeof(uint32_t)), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, indexAllocation);
+}
+
+void SceneStreamer::createPlaceholder() {
+	// The placeholder is the one upload frames can't do without, so it is the one thing waited for here.
+	placeholder = createTexture(1, 1);
+	const uint32_t white = 0xFFFFFFFF;
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { 1, 1, 1 };
+	uploads->beginImage(placeholder.image, textureRange);
+	uploads->uploadImage(placeholder.image, region, &white, sizeof(white));
+	uploads->finishImage(placeholder.image, textureRange, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	publishedValue = uploads->flush();
+	uploads->wait(publishedValue);
+	placeholder.bindlessIndex = bindless->addTexture(placeholder.view, sampler);
+	placeholder.published = true;
+}
+
+void SceneStreamer::setInstances(JobSystem& jobSystem, const std::vector<CullInstance>& instances) {
+	culler->setScene(instances, meshes, 1);
+
+	std::vector<Aabb> instanceBounds(instances.size());
+	instanceSpheres.resize(instances.size());
+	instanceMeshes.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); ++i) {
+		glm::vec3 centre(instances[i].boundingSphere);
+		instanceBounds[i].grow(centre - instances[i].boundingSphere.w);
+		instanceBounds[i].grow(centre + instances[i].boundingSphere.w);
+		instanceSpheres[i] = instances[i].boundingSphere;
+		instanceMeshes[i] = instances[i].mesh;
+	}
+	instanceBvh.build(jobSystem, instanceBounds);
+	primitiveVisible.assign(meshes.size(), false);
+}
+
+void SceneStreamer::update(const glm::mat4& viewProjection) {
+	CPU_PROFILE_SCOPE("updateSceneStreaming");
+	if (!loader && !meshFile) {
+		return;
+	}
+	// Texture levels keep streaming for as long as the scene is shown, so this goes on after loading completes.
+	for (const TextureResidencyChange& change : residency->takeChanges()) {
+		for (uint32_t primitive : textureUsers[imageOfTexture[change.texture]]) {
+			meshes[primitive].texture = change.bindlessIndex;
+			culler->updateMesh(primitive, meshes[primitive]);
+		}
+	}
+	if (complete) {
+		return;
+	}
+
+	uint64_t completedValue = uploads->getCompletedValue();
+	while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue) {
+		for (const GltfReadyItem& item : inFlight.front().completed) {
+			publish(item);
+		}
+		publishedValue = inFlight.front().timelineValue;
+		inFlight.pop_front();
+	}
+
+	// Read before taking the queue: jobs report done only after queueing their item, so this sees everything. A mesh
+	// file has no decode; its upload was queued by beginMeshFile.
+	bool decodeDone = !loader || loader->isDecodeComplete();
+	for (const GltfReadyItem& item : loader ? loader->takeReady() : std::vector<GltfReadyItem>()) {
+		if (item.kind == GltfReadyItem::Kind::Primitive) {
+			pending.push_back({ item, 0 });
+			continue;
+		}
+		// Images never upload at full resolution from here: residency mipmaps them and streams the levels frames ask for.
+		uint32_t texture = !loader->getCookedChainPath(item.index).empty() ? residency->addCookedTexture(loader->getCookedChainPath(item.index))
+			: loader->hasTextureLevels(item.index) ? residency->addTexture(loader->takeTextureLevels(item.index))
+			: residency->addTexture(loader->takeImage(item.index));
+		imageOfTexture.resize(std::max<size_t>(imageOfTexture.size(), texture + 1));
+		imageOfTexture[texture] = item.index;
+		++publishedTextures;
+	}
+
+	if (!pending.empty()) {
+		prioritiseVisible(viewProjection);
+		VkDeviceSize frameBytes = 0;
+		std::vector<GltfReadyItem> completed;
+		while (!pending.empty() && frameBytes < bytesPerFrame) {
+			PendingUpload& upload = pending.front();
+			if (!stagePrimitive(upload, frameBytes)) {
+				break;
+			}
+			completed.push_back(upload.item);
+			pending.pop_front();
+		}
+		// Nothing fitted: the ring is full of copies still in flight. Try again next frame.
+		if (frameBytes > 0 || !completed.empty()) {
+			inFlight.push_back({ uploads->getPendingValue(), std::move(completed) });
+			uploadedBytes += frameBytes;
+			++batchCount;
+		}
+	}
+
+	if (decodeDone && pending.empty() && inFlight.empty()) {
+		complete = true;
+		printSummary();
+	}
+}
+
+SceneStreamer::UploadStreams SceneStreamer::getStreams(const GltfReadyItem& item) const {
+	if (meshFile) {
+		return { meshFile->getStreamData(MeshStream::Vertices), meshFile->getStreamSize(MeshStream::Vertices), 0,
+			meshFile->getStreamData(MeshStream::Indices), meshFile->getStreamSize(MeshStream::Indices), 0 };
+	}
+	const GltfPrimitive& primitive = loader->getPrimitives()[item.index];
+	return { reinterpret_cast<const uint8_t*>(loader->getVertices(item.index)), sizeof(MeshVertex) * static_cast<VkDeviceSize>(primitive.vertexCount),
+		sizeof(MeshVertex) * static_cast<VkDeviceSize>(primitive.firstVertex),
+		reinterpret_cast<const uint8_t*>(loader->getIndices(item.index)), sizeof(uint32_t) * static_cast<VkDeviceSize>(primitive.indexCount),
+		sizeof(uint32_t) * static_cast<VkDeviceSize>(primitive.firstIndex) };
+}
+
+bool SceneStreamer::stagePrimitive(PendingUpload& upload, VkDeviceSize& frameBytes) {
+	UploadStreams streams = getStreams(upload.item);
+
+	// Vertices then indices, in chunks, so one huge primitive can't hold the ring or the frame's budget.
+	while (upload.progress < streams.vertexBytes + streams.indexBytes) {
+		bool vertices = upload.progress < streams.vertexBytes;
+		VkDeviceSize streamProgress = vertices ? upload.progress : upload.progress - streams.vertexBytes;
+		VkDeviceSize chunk = std::min((vertices ? streams.vertexBytes : streams.indexBytes) - streamProgress, maxChunkSize);
+
+		const uint8_t* source = vertices ? streams.vertices : streams.indices;
+		VkBuffer destination = vertices ? vertexBuffer : indexBuffer;
+		VkDeviceSize destinationOffset = (vertices ? streams.vertexOffset : streams.indexOffset) + streamProgress;
+		if (frameBytes >= bytesPerFrame || !uploads->uploadBuffer(destination, destinationOffset, source + streamProgress, chunk, false)) {
+			return false;
+		}
+		upload.progress += chunk;
+		frameBytes += chunk;
+	}
+	return true;
+}
+
+void SceneStreamer::prioritiseVisible(const glm::mat4& viewProjection) {
+	CPU_PROFILE_SCOPE("prioritiseVisibleUploads");
+	if (pending.size() < 2) {
+		return;
+	}
+	glm::vec4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+	visibleInstances.clear();
+	instanceBvh.queryFrustum(planes, visibleInstances);
+
+	for (uint32_t instance : visibleInstances) {
+		primitiveVisible[instanceMeshes[instance]] = true;
+	}
+	auto begin = pending.front().progress > 0 ? pending.begin() + 1 : pending.begin();
+	std::stable_partition(begin, pending.end(), [this](const PendingUpload& upload) { return primitiveVisible[upload.item.index]; });
+	for (uint32_t instance : visibleInstances) {
+		primitiveVisible[instanceMeshes[instance]] = false;
+	}
+}
+
+bool SceneStreamer::pick(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) const {
+	// The boxes only narrow it down; the hit is against the sphere the culler uses, so a pick matches what can draw.
+	return instanceBvh.raycast(origin, direction, maxDistance, hit, [&](uint32_t instance) {
+		glm::vec3 toCentre = glm::vec3(instanceSpheres[instance]) - origin;
+		float radius = instanceSpheres[instance].w;
+		float along = glm::dot(toCentre, direction);
+		float squaredMiss = glm::dot(toCentre, toCentre) - along * along;
+		if (squaredMiss > radius * radius) {
+			return -1.0f;
+		}
+		float entry = along - std::sqrt(radius * radius - squaredMiss);
+		return entry >= 0.0f ? entry : along + std::sqrt(radius * radius - squaredMiss); // From inside, where it leaves.
+	});
+}
+
+void SceneStreamer::publish(const GltfReadyItem& item) {
+	if (meshFile) {
+		for (uint32_t i = 0; i < meshes.size(); ++i) {
+			meshes[i].indexCount = meshFile->getSubmeshes()[i].indexCount;
+			culler->updateMesh(i, meshes[i]);
+		}
+		publishedMeshes += static_cast<uint32_t>(meshes.size());
+		return;
+	}
+	meshes[item.index].indexCount = loader->getPrimitives()[item.index].indexCount;
+	culler->updateMesh(item.index, meshes[item.index]);
+	++publishedMeshes;
+}
+
+VkBuffer SceneStreamer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, GpuAllocation*& allocation) const {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = sharingFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharingFamilies.size());
+	bufferInfo.pQueueFamilyIndices = sharingFamilies.data();
+
+	VkBuffer buffer;
+	if (vkCreateBuffer(device, &bufferInfo, callbacks, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create scene buffer.");
+	}
+	allocation = allocator->allocateForBuffer(buffer, MemoryUsage::GpuOnly);
+	return buffer;
+}
+
+SceneStreamer::Texture SceneStreamer::createTexture(uint32_t width, uint32_t height) const {
+	Texture texture;
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = textureFormat;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = sharingFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharingFamilies.size());
+	imageInfo.pQueueFamilyIndices = sharingFamilies.data();
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, callbacks, &texture.image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create scene texture.");
+	}
+	texture.allocation = allocator->allocateForImage(texture.image, MemoryUsage::GpuOnly);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = texture.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = textureFormat;
+	viewInfo.subresourceRange = textureRange;
+	if (vkCreateImageView(device, &viewInfo, callbacks, &texture.view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create scene texture view.");
+	}
+	return texture;
+}
+
+void SceneStreamer::destroyTexture(Texture& texture) const {
+	if (texture.image == VK_NULL_HANDLE) {
+		return;
+	}
+	if (texture.published) {
+		bindless->releaseTexture(texture.bindlessIndex);
+	}
+	vkDestroyImageView(device, texture.view, callbacks);
+	vkDestroyImage(device, texture.image, callbacks);
+	allocator->free(texture.allocation);
+	texture = Texture{};
+}
+
+void SceneStreamer::printSummary() const {
+	double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - startTime).count();
+	std::cout << "Scene Streamer: " << sourcePath << " resident in " << milliseconds << " ms. "
+		<< publishedMeshes << " meshes, " << publishedTextures << " textures handed to residency, "
+		<< uploadedBytes / (1024.0 * 1024.0) << " MB in " << batchCount << " transfer batches\n";
+}
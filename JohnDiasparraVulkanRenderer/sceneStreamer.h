@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "bindlessDescriptors.h"
+#include "deviceQueues.h"
+#include "gltfLoader.h"
+#include "gpuCulling.h"
+#include "gpuMemoryAllocator.h"
+#include "jobSystem.h"
+#include "meshFile.h"
+#include "sceneBvh.h"
+#include "textureResidency.h"
+#include "uploadManager.h"
+
+/*
+	Scene Streamer
+	- Moves a GltfLoader's decoded primitives into device local memory on the transfer queue while frames keep
+	  rendering. Each primitive's vertices and indices go to its slice of one shared vertex and index buffer. Images
+	  go to TextureResidency, which streams in only the mip levels frames sample; its index changes are applied to
+	  the meshes that use each image.
+	- begin() hands the culler the full instance table straight away, with every mesh empty and every texture the
+	  white placeholder. As uploads complete, update() fills in the mesh entries and texture indices, so the scene
+	  appears piece by piece instead of after one long load.
+	- Uploads go through the UploadManager in chunks, at most bytesPerFrame per update, and go out with its per-frame
+	  flush. Nothing is published until the CPU has seen the batch's timeline value; frames wait on the upload timeline
+	  so the copies are visible to the graphics queue.
+	- A BVH over the instances' bounds culls them against each frame's camera on the CPU. Primitives that a visible
+	  instance draws move to the front of the upload queue, so what is on screen fills in first. The same BVH answers
+	  picking rays.
+	- A cooked mesh file is the other source: beginMeshFile() draws each submesh as an instance and copies the vertex
+	  and index streams straight out of the mapping into the staging ring, in the same chunks. Indices stay 16-bit
+	  when the file stores them that way, so bind with getIndexType().
+	- Buffers use concurrent sharing when the transfer and graphics families differ, which avoids ownership transfers.
+	- Base colour factors aren't applied yet; only the base colour texture is.
+*/
+class SceneStreamer {
+
+	public:
+		static const VkDeviceSize bytesPerFrame = 32ull << 20; // Bounds how long a frame's update can spend copying.
+		static const VkDeviceSize maxChunkSize = 16ull << 20;
+
+		void init(VkDevice device, DeviceQueues& queues, UploadManager& uploads, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless, TextureResidency& residency, const VkAllocationCallbacks* callbacks);
+		// Waits for outstanding uploads first. The frames that read the scene must be complete.
+		void destroy();
+
+		// Call once the loader is open. Blocks only on the placeholder texture's upload and the BVH build.
+		void begin(JobSystem& jobSystem, GltfLoader& loader, GpuCuller& culler);
+		// Instead of begin(), for an open mesh file. The file must stay open until the streamer is complete.
+		void beginMeshFile(JobSystem& jobSystem, const MeshFile& file, GpuCuller& culler);
+		// Once per frame, after residency's update and before the culler's beginFrame. Queues uploads without flushing them,
+		// visible primitives first for the frame's camera.
+		void update(const glm::mat4& viewProjection);
+
+		// The closest instance whose bounding sphere the ray hits within maxDistance. direction must be normalized.
+		bool pick(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) const;
+
+		bool isComplete() const { return complete; }
+		VkBuffer getVertexBuffer() const { return vertexBuffer; }
+		VkBuffer getIndexBuffer() const { return indexBuffer; }
+		VkIndexType getIndexType() const { return indexType; }
+		uint32_t getInstanceMesh(uint32_t instance) const { return instanceMeshes[instance]; }
+		glm::vec3 getBoundsMin() const { return boundsMin; }
+		glm::vec3 getBoundsMax() const { return boundsMax; }
+
+	private:
+		struct Texture {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			GpuAllocation* allocation = nullptr;
+			uint32_t bindlessIndex = 0;
+			bool published = false;
+		};
+
+		// Where an upload's bytes come from and where in the vertex and index buffers they go.
+		struct UploadStreams {
+			const uint8_t* vertices;
+			VkDeviceSize vertexBytes;
+			VkDeviceSize vertexOffset;
+			const uint8_t* indices;
+			VkDeviceSize indexBytes;
+			VkDeviceSize indexOffset;
+		};
+
+		struct PendingUpload {
+			GltfReadyItem item;
+			VkDeviceSize progress; // Bytes.
+		};
+
+		struct Batch {
+			uint64_t timelineValue;
+			std::vector<GltfReadyItem> completed;
+		};
+
+		using Clock = std::chrono::steady_clock;
+
+		VkDevice device = VK_NULL_HANDLE;
+		UploadManager* uploads = nullptr;
+		GpuMemoryAllocator* allocator = nullptr;
+		BindlessDescriptors* bindless = nullptr;
+		TextureResidency* residency = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		std::vector<uint32_t> sharingFamilies; // Two when graphics and transfer differ.
+
+		uint64_t publishedValue = 0;
+		VkSampler sampler = VK_NULL_HANDLE;
+		Texture placeholder;
+
+		GltfLoader* loader = nullptr;
+		const MeshFile* meshFile = nullptr; // Set instead of loader for a mesh file, whose one upload is every stream.
+		std::string sourcePath;
+		GpuCuller* culler = nullptr;
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		GpuAllocation* vertexAllocation = nullptr;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		GpuAllocation* indexAllocation = nullptr;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		glm::vec3 boundsMin{ 0.0f };
+		glm::vec3 boundsMax{ 0.0f };
+		std::vector<CullMesh> meshes;
+		std::vector<std::vector<uint32_t>> textureUsers; // Primitives whose material samples each image.
+		std::vector<uint32_t> imageOfTexture; // Residency texture id to image index.
+		std::deque<PendingUpload> pending;
+		std::deque<Batch> inFlight;
+		bool complete = false;
+
+		SceneBvh instanceBvh;
+		std::vector<glm::vec4> instanceSpheres;
+		std::vector<uint32_t> instanceMeshes;
+		std::vector<uint32_t> visibleInstances;
+		std::vector<bool> primitiveVisible;
+
+		Clock::time_point startTime;
+		VkDeviceSize uploadedBytes = 0;
+		uint32_t batchCount = 0;
+		uint32_t publishedMeshes = 0;
+		uint32_t publishedTextures = 0;
+
+		VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, GpuAllocation*& allocation) const;
+		Texture createTexture(uint32_t width, uint32_t height) const;
+		void destroyTexture(Texture& texture) const;
+		void createGeometry(VkDeviceSize vertexBytes, VkDeviceSize indexBytes);
+		// The one upload begin waits for.
+		void createPlaceholder();
+		void setInstances(JobSystem& jobSystem, const std::vector<CullInstance>& instances);
+
+		void publish(const GltfReadyItem& item);
+		// Stable, so uploads keep their decode order within each half. A partly queued upload stays at the front.
+		void prioritiseVisible(const glm::mat4& viewProjection);
+		UploadStreams getStreams(const GltfReadyItem& item) const;
+		// True once the upload has been fully queued. False when the frame's budget or the staging ring is used up.
+		bool stagePrimitive(PendingUpload& upload, VkDeviceSize& frameBytes);
+		void printSummary() const;
+};
@@ -0,0 +1,331 @@
+#include "shaderCompiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+#include "hash.h"
+
+namespace {
+
+	const uint32_t shaderCacheFileMagic = 0x4353544D; // "MTSC"
+	const uint32_t shaderCacheFileVersion = 1; // Bump when compiler settings change in a way the key does not capture.
+	const uint32_t spirvMagic = 0x07230203;
+
+	struct ShaderCacheFileHeader {
+		uint64_t key;
+		uint32_t magic;
+		uint32_t version;
+		uint32_t spirvWordCount;
+		uint32_t dependencyCount;
+		uint64_t spirvChecksum;
+	};
+
+	bool readTextFile(const std::string& path, std::string& text) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		text = contents.str();
+		return true;
+	}
+
+	shaderc_shader_kind shaderKind(ShaderStage stage) {
+		switch (stage) {
+			case ShaderStage::Vertex: return shaderc_vertex_shader;
+			case ShaderStage::Fragment: return shaderc_fragment_shader;
+			case ShaderStage::Compute: return shaderc_compute_shader;
+		}
+		throw std::runtime_error("Unknown shader stage.");
+	}
+
+	bool isHlsl(const std::string& path) {
+		return std::filesystem::path(path).extension() == ".hlsl";
+	}
+
+	// Resolves #include against the including file first, then the shader root, and records every file it hands out
+	// so the cache entry can be invalidated when any of them changes.
+	class FileIncluder : public shaderc::CompileOptions::IncluderInterface {
+
+		public:
+			struct Include {
+				std::string path;
+				uint64_t contentHash;
+			};
+
+			FileIncluder(std::string shaderDirectory, std::vector<Include>& includes) : shaderDirectory(std::move(shaderDirectory)), includes(includes) {}
+
+			shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t) override {
+				auto resolved = std::make_unique<Resolved>();
+
+				std::filesystem::path candidate;
+				if (type == shaderc_include_type_relative) {
+					candidate = std::filesystem::path(requestingSource).parent_path() / requestedSource;
+				}
+				if (candidate.empty() || !std::filesystem::exists(candidate)) {
+					candidate = std::filesystem::path(shaderDirectory) / requestedSource;
+				}
+
+				std::string path = candidate.lexically_normal().string();
+				if (readTextFile(path, resolved->content)) {
+					resolved->name = path;
+					auto seen = std::find_if(includes.begin(), includes.end(), [&](const Include& include) { return include.path == path; });
+					if (seen == includes.end()) {
+						includes.push_back({ path, fnv1a64(resolved->content) });
+					}
+				}
+				else {
+					// Empty name plus an error message in content is how shaderc expects a failed include.
+					resolved->content = "Cannot find include file: " + std::string(requestedSource);
+				}
+
+				resolved->result.source_name = resolved->name.c_str();
+				resolved->result.source_name_length = resolved->name.size();
+				resolved->result.content = resolved->content.c_str();
+				resolved->result.content_length = resolved->content.size();
+				resolved->result.user_data = resolved.get();
+				return &resolved.release()->result;
+			}
+
+			void ReleaseInclude(shaderc_include_result* data) override {
+				delete static_cast<Resolved*>(data->user_data);
+			}
+
+		private:
+			struct Resolved {
+				shaderc_include_result result{};
+				std::string name;
+				std::string content;
+			};
+
+			std::string shaderDirectory;
+			std::vector<Include>& includes;
+	};
+}
+
+ShaderCompiler::ShaderCompiler(std::string shaderDirectory, std::string cacheDirectory, bool optimize)
+	: shaderDirectory(std::move(shaderDirectory)), cacheDirectory(std::move(cacheDirectory)), optimize(optimize) {
+	if (!compiler.IsValid()) {
+		throw std::runtime_error("Failed to initialize shaderc compiler.");
+	}
+}
+
+uint64_t ShaderCompiler::cacheKey(const ShaderRequest& request, const std::string& source) const {
+	uint64_t key = hashValue(shaderCacheFileVersion);
+	key = fnv1a64(source, key);
+	key = fnv1a64(request.path, key);
+	key = hashValue(request.stage, key);
+	key = fnv1a64(request.entryPoint, key);
+	for (const ShaderDefine& define : request.defines) {
+		key = fnv1a64(define.name + "=" + define.value + "\n", key);
+	}
+	key = hashValue(optimize, key);
+	return key;
+}
+
+std::string ShaderCompiler::cachePath(uint64_t key) const {
+	return (std::filesystem::path(cacheDirectory) / (toHex(reinterpret_cast<const uint8_t*>(&key), sizeof(key)) + ".spv")).string();
+}
+
+CompiledShader ShaderCompiler::compile(const ShaderRequest& request) const {
+	CPU_PROFILE_SCOPE("compileShader");
+	auto start = std::chrono::steady_clock::now();
+
+	std::string sourcePath = (std::filesystem::path(shaderDirectory) / request.path).lexically_normal().string();
+	std::string source;
+	if (!readTextFile(sourcePath, source)) {
+		throw std::runtime_error("Failed to open shader source: " + sourcePath);
+	}
+
+	CompiledShader shader;
+	shader.path = request.path;
+	shader.stage = request.stage;
+	shader.entryPoint = request.entryPoint;
+	shader.dependencies.push_back(sourcePath);
+
+	uint64_t key = cacheKey(request, source);
+	if (loadCached(key, shader)) {
+		shader.cacheHit = true;
+		shader.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return shader;
+	}
+
+	std::vector<FileIncluder::Include> includes;
+
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	options.SetSourceLanguage(isHlsl(request.path) ? shaderc_source_language_hlsl : shaderc_source_language_glsl);
+	if (optimize) {
+		options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	}
+	else {
+		options.SetOptimizationLevel(shaderc_optimization_level_zero);
+		options.SetGenerateDebugInfo();
+	}
+	for (const ShaderDefine& define : request.defines) {
+		options.AddMacroDefinition(define.name, define.value);
+	}
+	options.SetIncluder(std::make_unique<FileIncluder>(shaderDirectory, includes));
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, shaderKind(request.stage), sourcePath.c_str(), request.entryPoint.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		throw std::runtime_error("Failed to compile shader " + request.path + ":\n" + result.GetErrorMessage());
+	}
+	shader.spirv.assign(result.cbegin(), result.cend());
+
+	std::vector<CacheDependency> dependencies;
+	for (const FileIncluder::Include& include : includes) {
+		shader.dependencies.push_back(include.path);
+		dependencies.push_back({ include.path, include.contentHash });
+	}
+	saveCached(key, shader, dependencies);
+
+	shader.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return shader;
+}
+
+std::vector<CompiledShader> ShaderCompiler::compileAll(JobSystem& jobSystem, const std::vector<ShaderRequest>& requests) const {
+	std::vector<CompiledShader> shaders(requests.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(requests.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			shaders[i] = compile(requests[i]);
+		}
+	});
+	return shaders;
+}
+
+bool ShaderCompiler::loadCached(uint64_t key, CompiledShader& shader) const {
+	std::ifstream file(cachePath(key), std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	ShaderCacheFileHeader header{};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file.good()
+		|| header.magic != shaderCacheFileMagic
+		|| header.version != shaderCacheFileVersion
+		|| header.key != key
+		|| header.spirvWordCount == 0
+		|| header.spirvWordCount > 16 * 1024 * 1024
+		|| header.dependencyCount > 256) {
+		return false;
+	}
+
+	std::vector<std::string> includePaths;
+	for (uint32_t i = 0; i < header.dependencyCount; ++i) {
+		uint32_t pathLength = 0;
+		file.read(reinterpret_cast<char*>(&pathLength), sizeof(pathLength));
+		if (!file.good() || pathLength > 4096) {
+			return false;
+		}
+
+		std::string path(pathLength, '\0');
+		uint64_t contentHash = 0;
+		file.read(path.data(), pathLength);
+		file.read(reinterpret_cast<char*>(&contentHash), sizeof(contentHash));
+		if (!file.good()) {
+			return false;
+		}
+
+		// An include that changed or disappeared since this entry was written makes it stale.
+		std::string content;
+		if (!readTextFile(path, content) || fnv1a64(content) != contentHash) {
+			return false;
+		}
+		includePaths.push_back(path);
+	}
+
+	std::vector<uint32_t> spirv(header.spirvWordCount);
+	file.read(reinterpret_cast<char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+	if (!file.good() || fnv1a64(spirv.data(), spirv.size() * sizeof(uint32_t)) != header.spirvChecksum) {
+		return false;
+	}
+
+	shader.spirv = std::move(spirv);
+	shader.dependencies.insert(shader.dependencies.end(), includePaths.begin(), includePaths.end());
+	return true;
+}
+
+void ShaderCompiler::saveCached(uint64_t key, const CompiledShader& shader, const std::vector<CacheDependency>& includes) const {
+	// As with the other caches, a failed write only costs a recompile next launch.
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	std::string path = cachePath(key);
+	// Per-thread temp name, since two threads may be compiling the same shader.
+	std::string tempPath = path + "." + std::to_string(JobSystem::currentThreadIndex()) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+
+		ShaderCacheFileHeader header{};
+		header.key = key;
+		header.magic = shaderCacheFileMagic;
+		header.version = shaderCacheFileVersion;
+		header.spirvWordCount = static_cast<uint32_t>(shader.spirv.size());
+		header.dependencyCount = static_cast<uint32_t>(includes.size());
+		header.spirvChecksum = fnv1a64(shader.spirv.data(), shader.spirv.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		for (const CacheDependency& include : includes) {
+			uint32_t pathLength = static_cast<uint32_t>(include.path.size());
+			file.write(reinterpret_cast<const char*>(&pathLength), sizeof(pathLength));
+			file.write(include.path.data(), pathLength);
+			file.write(reinterpret_cast<const char*>(&include.contentHash), sizeof(include.contentHash));
+		}
+		file.write(reinterpret_cast<const char*>(shader.spirv.data()), shader.spirv.size() * sizeof(uint32_t));
+		if (!file.good()) {
+			return;
+		}
+	}
+
+	// Identical requests produce identical bytes, so whichever rename lands last is fine.
+	std::filesystem::rename(tempPath, path, error);
+}
+
+CompiledShader ShaderCompiler::loadSpirv(const ShaderRequest& request, const std::string& path) {
+	CPU_PROFILE_SCOPE("loadSpirv");
+	auto start = std::chrono::steady_clock::now();
+	std::string bytes;
+	if (!readTextFile(path, bytes)) {
+		throw std::runtime_error("Failed to open cooked shader " + path);
+	}
+	uint32_t magic = 0;
+	if (bytes.size() >= sizeof(magic)) {
+		memcpy(&magic, bytes.data(), sizeof(magic));
+	}
+	if (magic != spirvMagic || bytes.size() % sizeof(uint32_t) != 0) {
+		throw std::runtime_error("Cooked shader " + path + " is not SPIR-V.");
+	}
+
+	CompiledShader shader;
+	shader.path = request.path;
+	shader.stage = request.stage;
+	shader.entryPoint = request.entryPoint;
+	shader.spirv.resize(bytes.size() / sizeof(uint32_t));
+	memcpy(shader.spirv.data(), bytes.data(), bytes.size());
+	shader.dependencies.push_back(path);
+	shader.cacheHit = true;
+	shader.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return shader;
+}
+
+void ShaderCompiler::printReport(const std::vector<CompiledShader>& shaders) {
+	std::cout << "Shader Compiles:\n";
+	for (const CompiledShader& shader : shaders) {
+		std::cout << "\t" << shader.path << ": " << shader.milliseconds << " ms" << (shader.cacheHit ? " (cached)" : "")
+			<< ", " << shader.spirv.size() * sizeof(uint32_t) << " bytes\n";
+	}
+}
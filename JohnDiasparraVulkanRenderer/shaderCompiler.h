@@ -0,0 +1,78 @@
+#pragma once
+
+#include <shaderc/shaderc.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "jobSystem.h"
+
+enum class ShaderStage : uint32_t {
+	Vertex = 0,
+	Fragment,
+	Compute
+};
+
+struct ShaderDefine {
+	std::string name;
+	std::string value;
+};
+
+struct ShaderRequest {
+	std::string path; // Relative to the shader directory. ".hlsl" files are compiled as HLSL, anything else as GLSL.
+	ShaderStage stage = ShaderStage::Vertex;
+	std::string entryPoint = "main";
+	std::vector<ShaderDefine> defines = {};
+};
+
+struct CompiledShader {
+	std::string path;
+	ShaderStage stage = ShaderStage::Vertex;
+	std::string entryPoint;
+	std::vector<uint32_t> spirv;
+	std::vector<std::string> dependencies; // The source itself plus everything it included, as on-disk paths.
+	bool cacheHit = false;
+	double milliseconds = 0.0; // Time to compile, or to load and validate the cache entry on a hit.
+};
+
+/*
+	Shader Compiler
+	- Compiles GLSL and HLSL to SPIR-V at runtime through shaderc. One shaderc::Compiler is shared by every thread;
+	  each compile gets its own options and includer, so batches run in parallel on the job system.
+	- SPIR-V is cached on disk under a hash of the source, path, stage, entry point, defines and compiler options.
+	  Included files are not known until compile time, so each entry also stores the hash of every include and is
+	  only used if they all still match.
+*/
+class ShaderCompiler {
+
+	public:
+		ShaderCompiler(std::string shaderDirectory, std::string cacheDirectory, bool optimize = true);
+
+		// Throws with shaderc's diagnostics when the source does not compile.
+		CompiledShader compile(const ShaderRequest& request) const;
+		// Results are in request order. The first failure is rethrown once every compile has finished.
+		std::vector<CompiledShader> compileAll(JobSystem& jobSystem, const std::vector<ShaderRequest>& requests) const;
+
+		// A shader AssetCooker already compiled: raw SPIR-V words at path, used as they are. Throws if the file is
+		// missing or is not SPIR-V.
+		static CompiledShader loadSpirv(const ShaderRequest& request, const std::string& path);
+
+		static void printReport(const std::vector<CompiledShader>& shaders);
+
+	private:
+		struct CacheDependency {
+			std::string path;
+			uint64_t contentHash;
+		};
+
+		shaderc::Compiler compiler;
+		std::string shaderDirectory;
+		std::string cacheDirectory;
+		bool optimize;
+
+		uint64_t cacheKey(const ShaderRequest& request, const std::string& source) const;
+		std::string cachePath(uint64_t key) const;
+		bool loadCached(uint64_t key, CompiledShader& shader) const;
+		void saveCached(uint64_t key, const CompiledShader& shader, const std::vector<CacheDependency>& includes) const;
+};
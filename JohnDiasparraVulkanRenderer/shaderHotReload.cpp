@@ -0,0 +1,140 @@
+#include "shaderHotReload.h"
+
+#include <exception>
+#include <iostream>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	std::filesystem::file_time_type lastWriteTime(const std::string& path) {
+		// A file mid-save can briefly not exist; treat that as "unknown" rather than an error.
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+		return error ? std::filesystem::file_time_type::min() : time;
+	}
+}
+
+ShaderHotReloader::ShaderHotReloader(const ShaderCompiler& compiler, std::chrono::milliseconds pollInterval)
+	: compiler(compiler), pollInterval(pollInterval) {}
+
+ShaderHotReloader::~ShaderHotReloader() {
+	stop();
+}
+
+void ShaderHotReloader::addProgram(std::vector<ShaderRequest> requests, const std::vector<CompiledShader>& current, RebuildFunction rebuild) {
+	Program program;
+	program.requests = std::move(requests);
+	program.rebuild = std::move(rebuild);
+	watchFiles(program, current);
+	programs.push_back(std::move(program));
+}
+
+void ShaderHotReloader::watchFiles(Program& program, const std::vector<CompiledShader>& shaders) {
+	// Rebuilt from scratch each time, since an edit can add or remove includes.
+	program.files.clear();
+	for (const CompiledShader& shader : shaders) {
+		for (const std::string& path : shader.dependencies) {
+			program.files[path] = { lastWriteTime(path), false };
+		}
+	}
+}
+
+void ShaderHotReloader::start() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (running) {
+		return;
+	}
+	running = true;
+	thread = std::thread(&ShaderHotReloader::watchLoop, this);
+	std::cout << "Shader Hot Reload: watching " << programs.size() << " programs\n";
+}
+
+void ShaderHotReloader::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	stopCondition.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+uint32_t ShaderHotReloader::applyPendingSwaps() {
+	std::vector<Swap> swaps;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		swaps.swap(pendingSwaps);
+	}
+
+	for (Swap& swap : swaps) {
+		swap();
+	}
+	return static_cast<uint32_t>(swaps.size());
+}
+
+void ShaderHotReloader::watchLoop() {
+	CpuProfiler::setThreadName("Shader Hot Reload");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (running) {
+		stopCondition.wait_for(lock, pollInterval, [this]() { return !running; });
+		if (!running) {
+			break;
+		}
+
+		lock.unlock();
+		for (Program& program : programs) {
+			if (pollProgram(program)) {
+				rebuildProgram(program);
+			}
+		}
+		lock.lock();
+	}
+}
+
+bool ShaderHotReloader::pollProgram(Program& program) {
+	bool anyMoving = false;
+	bool anySettled = false;
+
+	for (auto& entry : program.files) {
+		WatchedFile& file = entry.second;
+		std::filesystem::file_time_type time = lastWriteTime(entry.first);
+		if (time != file.lastWriteTime) {
+			// Editors often save in several writes, so wait for the time to stop moving before compiling.
+			file.lastWriteTime = time;
+			file.changed = true;
+			anyMoving = true;
+		}
+		else if (file.changed) {
+			anySettled = true;
+		}
+	}
+	return anySettled && !anyMoving;
+}
+
+void ShaderHotReloader::rebuildProgram(Program& program) {
+	CPU_PROFILE_SCOPE("rebuildProgram");
+	for (auto& entry : program.files) {
+		entry.second.changed = false;
+	}
+
+	try {
+		// Unchanged stages come back from the shader cache, so only the edited ones pay for a compile.
+		std::vector<CompiledShader> shaders;
+		for (const ShaderRequest& request : program.requests) {
+			shaders.push_back(compiler.compile(request));
+		}
+		Swap swap = program.rebuild(shaders);
+		watchFiles(program, shaders);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingSwaps.push_back(std::move(swap));
+		for (const CompiledShader& shader : shaders) {
+			std::cout << "Shader Hot Reload: " << shader.path << " " << shader.milliseconds << " ms" << (shader.cacheHit ? " (cached)" : "") << "\n";
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Shader Hot Reload: keeping previous pipeline.\n" << e.what() << std::endl;
+	}
+}
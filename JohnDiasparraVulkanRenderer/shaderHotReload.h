@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shaderCompiler.h"
+
+/*
+	Shader Hot Reload
+	- A background thread polls the modification time of every source and include a program was built from.
+	- Once a changed file has stopped changing for one poll, the program is recompiled and its rebuild function
+	  creates new pipelines, all on that thread, so the render loop never waits on a compile.
+	- The rebuild returns a swap that the render thread applies at the next frame boundary (applyPendingSwaps).
+	  The swap installs the new pipelines and hands the old ones to the frame scheduler's deferred release.
+	- A compile or build error is printed and the old pipelines stay in use until the file is saved again.
+*/
+class ShaderHotReloader {
+
+	public:
+		using Swap = std::function<void()>;
+		// Runs on the reload thread. Must only create new objects; all mutation of render state goes in the returned swap.
+		using RebuildFunction = std::function<Swap(const std::vector<CompiledShader>& shaders)>;
+
+		explicit ShaderHotReloader(const ShaderCompiler& compiler, std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+		~ShaderHotReloader();
+
+		// current is what the program was last built from; its dependency lists seed the watch set.
+		void addProgram(std::vector<ShaderRequest> requests, const std::vector<CompiledShader>& current, RebuildFunction rebuild);
+		void start();
+		void stop();
+
+		// Call between frames on the render thread. Returns how many programs were swapped.
+		uint32_t applyPendingSwaps();
+
+	private:
+		struct WatchedFile {
+			std::filesystem::file_time_type lastWriteTime;
+			bool changed = false; // Seen a new time; compile once it has been stable for a poll.
+		};
+
+		struct Program {
+			std::vector<ShaderRequest> requests;
+			RebuildFunction rebuild;
+			std::map<std::string, WatchedFile> files;
+		};
+
+		const ShaderCompiler& compiler;
+		std::chrono::milliseconds pollInterval;
+
+		std::vector<Program> programs; // Only touched by the reload thread once started.
+		std::thread thread;
+		bool running = false;
+		std::mutex mutex; // Guards running and pendingSwaps.
+		std::condition_variable stopCondition;
+		std::vector<Swap> pendingSwaps;
+
+		void watchLoop();
+		bool pollProgram(Program& program); // True when the program should be rebuilt.
+		void rebuildProgram(Program& program);
+		static void watchFiles(Program& program, const std::vector<CompiledShader>& shaders);
+};
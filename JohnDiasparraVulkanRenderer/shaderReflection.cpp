@@ -0,0 +1,322 @@
+#include "shaderReflection.h"
+
+#include <spirv_cross/spirv_cross.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+#include "hash.h"
+
+namespace {
+
+	VkShaderStageFlagBits stageFlag(spv::ExecutionModel model) {
+		switch (model) {
+			case spv::ExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+			case spv::ExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case spv::ExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: throw std::runtime_error("Unsupported shader execution model for reflection.");
+		}
+	}
+
+	uint32_t descriptorCount(const spirv_cross::SPIRType& type) {
+		uint32_t count = 1;
+		for (size_t i = 0; i < type.array.size(); ++i) {
+			// Runtime-sized arrays report 0; they still need one slot until the layout opts into variable counts.
+			if (type.array_size_literal[i] && type.array[i] > 0) {
+				count *= type.array[i];
+			}
+		}
+		return count;
+	}
+
+	VkFormat vertexFormat(const spirv_cross::SPIRType& type) {
+		if (type.width != 32 || type.columns != 1 || type.vecsize < 1 || type.vecsize > 4) {
+			throw std::runtime_error("Vertex inputs must be 32-bit scalars or vectors.");
+		}
+
+		static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		switch (type.basetype) {
+			case spirv_cross::SPIRType::Float: return floatFormats[type.vecsize - 1];
+			case spirv_cross::SPIRType::Int: return intFormats[type.vecsize - 1];
+			case spirv_cross::SPIRType::UInt: return uintFormats[type.vecsize - 1];
+			default: throw std::runtime_error("Unsupported vertex input base type.");
+		}
+	}
+
+	void addBindings(const spirv_cross::Compiler& compiler, const spirv_cross::SmallVector<spirv_cross::Resource>& resources, VkDescriptorType type, std::vector<ReflectedBinding>& bindings) {
+		for (const spirv_cross::Resource& resource : resources) {
+			const spirv_cross::SPIRType& resourceType = compiler.get_type(resource.type_id);
+
+			// Texel buffers show up as images with a buffer dimension.
+			VkDescriptorType bindingType = type;
+			if (resourceType.basetype == spirv_cross::SPIRType::Image && resourceType.image.dim == spv::DimBuffer) {
+				bindingType = type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+
+			ReflectedBinding binding{};
+			binding.set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+			binding.binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+			binding.type = bindingType;
+			binding.count = descriptorCount(resourceType);
+			bindings.push_back(binding);
+		}
+	}
+}
+
+ShaderReflection reflectShader(const CompiledShader& shader) {
+	spirv_cross::Compiler compiler(shader.spirv);
+	spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+	ShaderReflection reflection;
+	reflection.stage = stageFlag(compiler.get_execution_model());
+
+	addBindings(compiler, resources.uniform_buffers, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, reflection.bindings);
+	addBindings(compiler, resources.storage_buffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, reflection.bindings);
+	addBindings(compiler, resources.sampled_images, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, reflection.bindings);
+	addBindings(compiler, resources.separate_images, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, reflection.bindings);
+	addBindings(compiler, resources.separate_samplers, VK_DESCRIPTOR_TYPE_SAMPLER, reflection.bindings);
+	addBindings(compiler, resources.storage_images, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, reflection.bindings);
+	addBindings(compiler, resources.subpass_inputs, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, reflection.bindings);
+
+	for (const spirv_cross::Resource& resource : resources.push_constant_buffers) {
+		const spirv_cross::SPIRType& type = compiler.get_type(resource.base_type_id);
+		uint32_t offset = type.member_types.empty() ? 0 : compiler.type_struct_member_offset(type, 0);
+
+		VkPushConstantRange range{};
+		range.stageFlags = reflection.stage;
+		range.offset = offset;
+		range.size = static_cast<uint32_t>(compiler.get_declared_struct_size(type)) - offset;
+		reflection.pushConstants.push_back(range);
+	}
+
+	if (reflection.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+		for (const spirv_cross::Resource& resource : resources.stage_inputs) {
+			ReflectedVertexInput input{};
+			input.location = compiler.get_decoration(resource.id, spv::DecorationLocation);
+			input.format = vertexFormat(compiler.get_type(resource.type_id));
+			input.size = compiler.get_type(resource.type_id).vecsize * 4;
+			reflection.vertexInputs.push_back(input);
+		}
+		std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(),
+			[](const ReflectedVertexInput& a, const ReflectedVertexInput& b) { return a.location < b.location; });
+	}
+
+	return reflection;
+}
+
+VertexInputLayout buildVertexInputLayout(const ShaderReflection& vertexStage) {
+	VertexInputLayout layout;
+	layout.binding.binding = 0;
+	layout.binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	uint32_t offset = 0;
+	for (const ReflectedVertexInput& input : vertexStage.vertexInputs) {
+		VkVertexInputAttributeDescription attribute{};
+		attribute.location = input.location;
+		attribute.binding = 0;
+		attribute.format = input.format;
+		attribute.offset = offset;
+		layout.attributes.push_back(attribute);
+		offset += input.size;
+	}
+	layout.binding.stride = offset;
+	return layout;
+}
+
+bool LayoutCache::SetLayoutKey::operator==(const SetLayoutKey& other) const {
+	return std::equal(bindings.begin(), bindings.end(), other.bindings.begin(), other.bindings.end(),
+		[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+			return a.binding == b.binding && a.descriptorType == b.descriptorType && a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+		});
+}
+
+bool LayoutCache::PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const {
+	return setLayouts == other.setLayouts
+		&& std::equal(pushConstants.begin(), pushConstants.end(), other.pushConstants.begin(), other.pushConstants.end(),
+			[](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+				return a.stageFlags == b.stageFlags && a.offset == b.offset && a.size == b.size;
+			});
+}
+
+size_t LayoutCache::KeyHash::operator()(const SetLayoutKey& key) const {
+	// Field by field rather than whole structs, so padding and the sampler pointer never reach the hash.
+	uint64_t hash = fnv1aOffsetBasis;
+	for (const VkDescriptorSetLayoutBinding& binding : key.bindings) {
+		hash = hashValue(binding.binding, hash);
+		hash = hashValue(binding.descriptorType, hash);
+		hash = hashValue(binding.descriptorCount, hash);
+		hash = hashValue(binding.stageFlags, hash);
+	}
+	return static_cast<size_t>(hash);
+}
+
+size_t LayoutCache::KeyHash::operator()(const PipelineLayoutKey& key) const {
+	uint64_t hash = fnv1a64(key.setLayouts.data(), key.setLayouts.size() * sizeof(VkDescriptorSetLayout));
+	for (const VkPushConstantRange& range : key.pushConstants) {
+		hash = hashValue(range.stageFlags, hash);
+		hash = hashValue(range.offset, hash);
+		hash = hashValue(range.size, hash);
+	}
+	return static_cast<size_t>(hash);
+}
+
+void LayoutCache::init(VkDevice device, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->callbacks = callbacks;
+}
+
+void LayoutCache::destroy() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& entry : pipelineLayouts) {
+		vkDestroyPipelineLayout(device, entry.second, callbacks);
+	}
+	for (auto& entry : setLayouts) {
+		vkDestroyDescriptorSetLayout(device, entry.second, callbacks);
+	}
+	pipelineLayouts.clear();
+	setLayouts.clear();
+	reservedSets.clear();
+}
+
+void LayoutCache::reserveSet(uint32_t set, VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+	std::lock_guard<std::mutex> lock(mutex);
+	reservedSets[set] = ReservedSet{ setLayout, bindings };
+}
+
+VkDescriptorSetLayout LayoutCache::getSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+	std::sort(bindings.begin(), bindings.end(),
+		[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	for (VkDescriptorSetLayoutBinding& binding : bindings) {
+		binding.pImmutableSamplers = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	lookups++;
+	SetLayoutKey key{ std::move(bindings) };
+	auto found = setLayouts.find(key);
+	if (found != setLayouts.end()) {
+		hits++;
+		return found->second;
+	}
+
+	VkDescriptorSetLayoutCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	createInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+	createInfo.pBindings = key.bindings.data();
+
+	VkDescriptorSetLayout setLayout;
+	if (vkCreateDescriptorSetLayout(device, &createInfo, callbacks, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor set layout.");
+	}
+	setLayouts.emplace(std::move(key), setLayout);
+	return setLayout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayoutHandles, std::vector<VkPushConstantRange> pushConstants) {
+	std::sort(pushConstants.begin(), pushConstants.end(), [](const VkPushConstantRange& a, const VkPushConstantRange& b) {
+		return std::tie(a.offset, a.stageFlags) < std::tie(b.offset, b.stageFlags);
+	});
+
+	std::lock_guard<std::mutex> lock(mutex);
+	lookups++;
+	PipelineLayoutKey key{ setLayoutHandles, std::move(pushConstants) };
+	auto found = pipelineLayouts.find(key);
+	if (found != pipelineLayouts.end()) {
+		hits++;
+		return found->second;
+	}
+
+	VkPipelineLayoutCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	createInfo.setLayoutCount = static_cast<uint32_t>(key.setLayouts.size());
+	createInfo.pSetLayouts = key.setLayouts.data();
+	createInfo.pushConstantRangeCount = static_cast<uint32_t>(key.pushConstants.size());
+	createInfo.pPushConstantRanges = key.pushConstants.data();
+
+	VkPipelineLayout pipelineLayout;
+	if (vkCreatePipelineLayout(device, &createInfo, callbacks, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout.");
+	}
+	pipelineLayouts.emplace(std::move(key), pipelineLayout);
+	return pipelineLayout;
+}
+
+VkPipelineLayout LayoutCache::getPipelineLayout(const std::vector<ShaderReflection>& stages) {
+	// set -> binding -> merged binding. A binding used by several stages becomes one entry visible to all of them.
+	std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+	std::vector<VkPushConstantRange> pushConstants;
+
+	std::unordered_map<uint32_t, ReservedSet> reserved;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		reserved = reservedSets;
+	}
+
+	for (const ShaderReflection& stage : stages) {
+		for (const ReflectedBinding& reflected : stage.bindings) {
+			auto reservedSet = reserved.find(reflected.set);
+			if (reservedSet != reserved.end()) {
+				// Counts aren't compared: the reserved arrays are sized by the device, shaders declare them unsized.
+				const std::vector<VkDescriptorSetLayoutBinding>& bindings = reservedSet->second.bindings;
+				auto match = std::find_if(bindings.begin(), bindings.end(),
+					[&](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == reflected.binding && binding.descriptorType == reflected.type; });
+				if (match == bindings.end() || (match->stageFlags & stage.stage) == 0) {
+					throw std::runtime_error("Shader binding " + std::to_string(reflected.binding) + " doesn't match reserved descriptor set " + std::to_string(reflected.set) + ".");
+				}
+				continue;
+			}
+
+			auto inserted = sets[reflected.set].emplace(reflected.binding, VkDescriptorSetLayoutBinding{ reflected.binding, reflected.type, reflected.count, 0, nullptr });
+			VkDescriptorSetLayoutBinding& binding = inserted.first->second;
+			if (binding.descriptorType != reflected.type || binding.descriptorCount != reflected.count) {
+				throw std::runtime_error("Shader stages disagree on descriptor set " + std::to_string(reflected.set) + " binding " + std::to_string(reflected.binding) + ".");
+			}
+			binding.stageFlags |= stage.stage;
+		}
+
+		// Stages with identical ranges share one; anything else keeps its own, which Vulkan allows to overlap.
+		for (const VkPushConstantRange& range : stage.pushConstants) {
+			auto same = std::find_if(pushConstants.begin(), pushConstants.end(),
+				[&](const VkPushConstantRange& existing) { return existing.offset == range.offset && existing.size == range.size; });
+			if (same != pushConstants.end()) {
+				same->stageFlags |= range.stageFlags;
+			}
+			else {
+				pushConstants.push_back(range);
+			}
+		}
+	}
+
+	// Set numbers are positional in the pipeline layout, so gaps get an empty layout.
+	std::vector<VkDescriptorSetLayout> setLayoutHandles;
+	uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+	for (auto& entry : reserved) {
+		setCount = std::max(setCount, entry.first + 1);
+	}
+	for (uint32_t set = 0; set < setCount; ++set) {
+		auto reservedSet = reserved.find(set);
+		if (reservedSet != reserved.end()) {
+			setLayoutHandles.push_back(reservedSet->second.setLayout);
+			continue;
+		}
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		for (auto& entry : sets[set]) {
+			bindings.push_back(entry.second);
+		}
+		setLayoutHandles.push_back(getSetLayout(std::move(bindings)));
+	}
+
+	return getPipelineLayout(setLayoutHandles, std::move(pushConstants));
+}
+
+void LayoutCache::printStats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::cout << "Layout Cache: " << setLayouts.size() << " set layouts, " << pipelineLayouts.size() << " pipeline layouts, "
+		<< hits << "/" << lookups << " lookups shared\n";
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "shaderCompiler.h"
+
+struct ReflectedBinding {
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	uint32_t count;
+};
+
+struct ReflectedVertexInput {
+	uint32_t location;
+	VkFormat format;
+	uint32_t size;
+};
+
+// Everything the pipeline layout and vertex input state need from one shader stage.
+struct ShaderReflection {
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::vector<ReflectedBinding> bindings;
+	std::vector<VkPushConstantRange> pushConstants;
+	std::vector<ReflectedVertexInput> vertexInputs; // Vertex stage only, sorted by location.
+};
+
+ShaderReflection reflectShader(const CompiledShader& shader);
+
+// Attributes packed tightly into a single interleaved binding 0, in location order.
+struct VertexInputLayout {
+	VkVertexInputBindingDescription binding{};
+	std::vector<VkVertexInputAttributeDescription> attributes;
+};
+
+VertexInputLayout buildVertexInputLayout(const ShaderReflection& vertexStage);
+
+/*
+	Layout Cache
+	- Descriptor set layouts and pipeline layouts are hash-consed: structurally identical requests return the same
+	  handle, so pipelines built from different shaders share layouts and bound sets stay compatible across them.
+	- Layouts are built from the merged reflection of every stage in a pipeline, never written by hand.
+	- Everything lives until destroy(); layouts are tiny and the set of distinct ones is small.
+	- Lookups are locked, so pipelines can be rebuilt off the render thread (shader hot reload).
+	- A reserved set (e.g. the bindless set) uses a layout owned elsewhere. Every pipeline layout includes it, whether
+	  or not the shaders use it, and reflected bindings in it are only checked against it.
+*/
+class LayoutCache {
+
+	public:
+		void init(VkDevice device, const VkAllocationCallbacks* callbacks);
+		void destroy();
+
+		VkDescriptorSetLayout getSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+		// Call before any pipeline layout is built from reflection. The layout isn't destroyed by the cache.
+		void reserveSet(uint32_t set, VkDescriptorSetLayout setLayout, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, std::vector<VkPushConstantRange> pushConstants);
+		// Merges bindings and push constants across the stages, then looks up (or creates) the layouts.
+		VkPipelineLayout getPipelineLayout(const std::vector<ShaderReflection>& stages);
+
+		void printStats() const;
+
+	private:
+		struct SetLayoutKey {
+			std::vector<VkDescriptorSetLayoutBinding> bindings; // Sorted by binding, no immutable samplers.
+			bool operator==(const SetLayoutKey& other) const;
+		};
+
+		struct PipelineLayoutKey {
+			std::vector<VkDescriptorSetLayout> setLayouts;
+			std::vector<VkPushConstantRange> pushConstants; // Sorted by offset then stage.
+			bool operator==(const PipelineLayoutKey& other) const;
+		};
+
+		struct KeyHash {
+			size_t operator()(const SetLayoutKey& key) const;
+			size_t operator()(const PipelineLayoutKey& key) const;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		const VkAllocationCallbacks* callbacks = nullptr;
+
+		struct ReservedSet {
+			VkDescriptorSetLayout setLayout;
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+		};
+
+		mutable std::mutex mutex;
+		std::unordered_map<uint32_t, ReservedSet> reservedSets;
+		std::unordered_map<SetLayoutKey, VkDescriptorSetLayout, KeyHash> setLayouts;
+		std::unordered_map<PipelineLayoutKey, VkPipelineLayout, KeyHash> pipelineLayouts;
+		uint64_t lookups = 0;
+		uint64_t hits = 0;
+};
@@ -0,0 +1,10 @@
+// The bindless set (BindlessDescriptors). Bound once per command buffer; draws pick resources by index,
+// normally through a push constant. Indices that can differ within a draw or dispatch need nonuniformEXT().
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform sampler2D bindlessTextures[];
+
+// Typed views of the storage buffer array. Every view aliases binding 1, so one index works through any of them.
+#define BINDLESS_BUFFER(Type, name) layout(set = 0, binding = 1) readonly buffer name##Block { Type items[]; } name[]
+#define BINDLESS_RW_BUFFER(Type, name) layout(set = 0, binding = 1) buffer name##Block { Type items[]; } name[]
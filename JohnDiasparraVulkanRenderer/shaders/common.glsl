@@ -0,0 +1,6 @@
+// Shared by every stage of the triangle pipeline.
+
+layout(push_constant) uniform FrameConstants {
+	float phase; // Cycles 0..1 so successive frames are visibly different.
+	uint instances; // Bindless index of the scene's Instance buffer.
+} frameConstants;
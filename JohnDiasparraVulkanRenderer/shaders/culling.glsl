@@ -0,0 +1,45 @@
+// GPU-driven rendering data. Must match the std430 mirrors in gpuCulling.h.
+
+struct Instance {
+	mat4 transform;
+	vec4 boundingSphere; // World space centre and radius.
+	uint mesh;
+	uint bucket; // Material bucket: one indirect draw call per bucket.
+	uint padding0;
+	uint padding1;
+};
+
+struct Mesh {
+	uint indexCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint texture; // Bindless index of the base colour texture.
+};
+
+// Where a bucket's commands start, and how many it has room for.
+struct Bucket {
+	uint firstCommand;
+	uint capacity;
+};
+
+struct CullView {
+	mat4 viewProjection;
+	vec4 frustumPlanes[6]; // Normals point inwards; xyz normalized.
+	uint instanceCount;
+	uint bucketCount;
+	uint hiZLevels; // Zero disables occlusion culling.
+	uint hiZWidth;
+	uint hiZHeight;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+// VkDrawIndexedIndirectCommand.
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
@@ -0,0 +1,33 @@
+#version 450
+
+#include "bindless.glsl" // First: it enables an extension.
+#include "scene.glsl"
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+// Per bindless texture index, the finest mip wanted relative to the level sampled, plus textureFeedbackBias.
+BINDLESS_RW_BUFFER(uint, feedbackBuffers);
+
+const vec3 lightDirection = vec3(0.36, 0.80, 0.48); // Normalized, towards the light.
+const float feedbackBias = 16.0; // textureFeedbackBias in textureResidency.h.
+
+void main() {
+	// One indirect call draws many meshes, so the index can differ between invocations of the same draw.
+	vec4 baseColor = texture(bindlessTextures[nonuniformEXT(fragTexture)], fragUV);
+	float diffuse = max(dot(normalize(fragNormal), lightDirection), 0.0);
+	outColor = vec4(baseColor.rgb * (0.25 + 0.75 * diffuse), 1.0);
+
+	// Outside the branch below: LOD needs derivatives, which are undefined in non-uniform control flow.
+	float lod = textureQueryLod(bindlessTextures[nonuniformEXT(fragTexture)], fragUV).y;
+	// One pixel in sixteen finds every texture's finest request just as well, for a sixteenth of the atomics.
+	if ((uint(gl_FragCoord.x) & 3u) == 0u && (uint(gl_FragCoord.y) & 3u) == 0u) {
+		uint request = uint(clamp(floor(lod), -feedbackBias, feedbackBias) + feedbackBias);
+		if (feedbackBuffers[sceneConstants.textureFeedback].items[fragTexture] > request) {
+			atomicMin(feedbackBuffers[sceneConstants.textureFeedback].items[fragTexture], request);
+		}
+	}
+}
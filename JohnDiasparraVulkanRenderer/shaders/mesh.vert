@@ -0,0 +1,27 @@
+#version 450
+
+#include "bindless.glsl" // First: it enables an extension.
+#include "scene.glsl"
+#include "culling.glsl"
+
+// MeshVertex in meshFile.h.
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTexture;
+
+BINDLESS_BUFFER(Instance, instanceBuffers);
+BINDLESS_BUFFER(Mesh, meshBuffers);
+
+void main() {
+	// Drawn through indirect commands from cull.comp, whose firstInstance is the instance index.
+	Instance instance = instanceBuffers[sceneConstants.instances].items[gl_InstanceIndex];
+	gl_Position = sceneConstants.viewProjection * instance.transform * vec4(inPosition, 1.0);
+	// Good enough for lighting under uniform scale, which is what scenes use in practice.
+	fragNormal = mat3(instance.transform) * inNormal;
+	fragUV = inUV;
+	fragTexture = meshBuffers[sceneConstants.meshes].items[instance.mesh].texture;
+}
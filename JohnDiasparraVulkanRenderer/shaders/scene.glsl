@@ -0,0 +1,8 @@
+// Shared by every stage of the scene pipeline.
+
+layout(push_constant) uniform SceneConstants {
+	mat4 viewProjection;
+	uint instances; // Bindless index of the scene's Instance buffer.
+	uint meshes; // Bindless index of this frame slot's Mesh table.
+	uint textureFeedback; // Bindless index of this frame slot's feedback buffer (TextureResidency).
+} sceneConstants;
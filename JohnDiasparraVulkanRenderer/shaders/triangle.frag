@@ -0,0 +1,11 @@
+#version 450
+
+#include "common.glsl"
+
+layout(location = 0) in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = vec4(mix(fragColor, fragColor.bgr, frameConstants.phase), 1.0);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+#include "bindless.glsl" // First: it enables an extension.
+#include "common.glsl"
+#include "culling.glsl"
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+BINDLESS_BUFFER(Instance, instanceBuffers);
+
+void main() {
+	// Drawn through indirect commands from cull.comp, whose firstInstance is the instance index.
+	Instance instance = instanceBuffers[frameConstants.instances].items[gl_InstanceIndex];
+	gl_Position = instance.transform * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
+}
@@ -0,0 +1,71 @@
+#include "stagingRing.h"
+
+#include <stdexcept>
+
+void StagingRing::init(VkDevice device, GpuMemoryAllocator& allocator, VkDeviceSize size, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->callbacks = callbacks;
+	this->size = size;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, callbacks, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create staging ring buffer.");
+	}
+	// Coherent, so writes need no flush before the copy is submitted.
+	allocation = allocator.allocateForBuffer(buffer, MemoryUsage::CpuToGpu);
+}
+
+void StagingRing::destroy() {
+	if (buffer == VK_NULL_HANDLE) {
+		return;
+	}
+	vkDestroyBuffer(device, buffer, callbacks);
+	allocator->free(allocation);
+	buffer = VK_NULL_HANDLE;
+	allocation = nullptr;
+	head = tail = 0;
+	inFlight.clear();
+}
+
+bool StagingRing::allocate(VkDeviceSize bytes, VkDeviceSize alignment, VkDeviceSize& offset) {
+	if (bytes > size) {
+		return false;
+	}
+
+	uint64_t start = (head + alignment - 1) / alignment * alignment;
+	// Allocations never straddle the end. Skipping to the start wastes the tail, which is freed with this allocation.
+	if (start % size + bytes > size) {
+		start = (start / size + 1) * size;
+	}
+	if (start + bytes - tail > size) {
+		return false;
+	}
+
+	offset = start % size;
+	head = start + bytes;
+	return true;
+}
+
+void StagingRing::markSubmitted(uint64_t timelineValue) {
+	if (!inFlight.empty() && inFlight.back().end == head) {
+		return;
+	}
+	inFlight.push_back({ timelineValue, head });
+}
+
+void StagingRing::reclaim(uint64_t completedValue) {
+	while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue) {
+		tail = inFlight.front().end;
+		inFlight.pop_front();
+	}
+	// Nothing outstanding: start again from the beginning rather than wrapping sooner than needed.
+	if (inFlight.empty() && tail == head) {
+		head = tail = (head + size - 1) / size * size;
+	}
+}
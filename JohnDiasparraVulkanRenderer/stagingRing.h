@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+
+#include "gpuMemoryAllocator.h"
+
+/*
+	Staging Ring
+	- One persistently mapped, host visible buffer that uploads are written into front to back and wrap around.
+	- Space is handed out between submissions and tagged with the timeline value of the submission that reads it
+	  (markSubmitted). reclaim() frees everything up to the newest completed value, so the ring never waits on its own;
+	  allocate() just returns false until enough of the GPU's work has finished.
+	- Head and tail are running byte totals rather than offsets, so full and empty are never ambiguous.
+*/
+class StagingRing {
+
+	public:
+		void init(VkDevice device, GpuMemoryAllocator& allocator, VkDeviceSize size, const VkAllocationCallbacks* callbacks);
+		void destroy();
+
+		// False when there isn't room until earlier submissions complete, or when size exceeds the ring.
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		// Everything allocated since the previous call is read by the submission that signals timelineValue.
+		void markSubmitted(uint64_t timelineValue);
+		void reclaim(uint64_t completedValue);
+
+		VkBuffer getBuffer() const { return buffer; }
+		uint8_t* getMapped() const { return static_cast<uint8_t*>(allocation->mappedData); }
+		VkDeviceSize getSize() const { return size; }
+		VkDeviceSize getUsedBytes() const { return head - tail; }
+
+	private:
+		struct Span {
+			uint64_t timelineValue;
+			uint64_t end; // Head when the submission was made.
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		GpuMemoryAllocator* allocator = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		GpuAllocation* allocation = nullptr;
+		VkDeviceSize size = 0;
+		uint64_t head = 0;
+		uint64_t tail = 0;
+		std::deque<Span> inFlight;
+};
@@ -0,0 +1,34 @@
+#include "startupTimeline.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "jobSystem.h"
+
+void StartupTimeline::record(const std::string& stage, Clock::time_point begin, Clock::time_point end) {
+	std::lock_guard<std::mutex> lock(mutex);
+	stages.push_back({ stage, JobSystem::currentThreadIndex(), millisecondsSinceOrigin(begin), millisecondsSinceOrigin(end) });
+}
+
+void StartupTimeline::finish() {
+	if (finished) {
+		return;
+	}
+	finished = true;
+	double firstFrameMs = millisecondsSinceOrigin(Clock::now());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	// Stages finish out of order when they overlap; list them by start time so the overlap reads top to bottom.
+	std::sort(stages.begin(), stages.end(), [](const Stage& a, const Stage& b) { return a.beginMs < b.beginMs; });
+
+	std::cout << "Startup Timeline (ms since launch):\n";
+	for (const Stage& stage : stages) {
+		std::cout << "\t" << stage.name << ": " << stage.beginMs << " - " << stage.endMs << " (" << stage.endMs - stage.beginMs << " ms, "
+			<< (stage.threadIndex == 0 ? std::string("main thread") : "worker " + std::to_string(stage.threadIndex)) << ")\n";
+	}
+	std::cout << "\t" << "First frame submitted: " << firstFrameMs << " ms\n";
+}
+
+double StartupTimeline::millisecondsSinceOrigin(Clock::time_point time) const {
+	return std::chrono::duration<double, std::milli>(time - origin).count();
+}
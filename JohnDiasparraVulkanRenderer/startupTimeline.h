@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+	Startup Timeline
+	- Wall time of each startup stage, measured from construction (normally the top of main), along with the thread it
+	  ran on, so stages that were meant to overlap can be seen to.
+	- Stages may be recorded from any thread. The report is printed once, when the first frame has been submitted.
+*/
+class StartupTimeline {
+
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		void record(const std::string& stage, Clock::time_point begin, Clock::time_point end);
+		// Prints the report the first time it is called; later calls do nothing, so it can sit in the frame loop.
+		void finish();
+
+	private:
+		struct Stage {
+			std::string name;
+			uint32_t threadIndex;
+			double beginMs;
+			double endMs;
+		};
+
+		Clock::time_point origin = Clock::now();
+		std::mutex mutex;
+		std::vector<Stage> stages;
+		bool finished = false;
+
+		double millisecondsSinceOrigin(Clock::time_point time) const;
+};
+
+// Records the enclosing block as one stage.
+class StartupStage {
+
+	public:
+		StartupStage(StartupTimeline& timeline, const char* name) : timeline(timeline), name(name), begin(StartupTimeline::Clock::now()) {}
+		~StartupStage() { timeline.record(name, begin, StartupTimeline::Clock::now()); }
+
+		StartupStage(const StartupStage&) = delete;
+		StartupStage& operator=(const StartupStage&) = delete;
+
+	private:
+		StartupTimeline& timeline;
+		const char* name;
+		StartupTimeline::Clock::time_point begin;
+};
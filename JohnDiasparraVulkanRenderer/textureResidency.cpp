@@ -0,0 +1,423 @@
+#include "textureResidency.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <queue>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+#include "hash.h"
+
+namespace {
+
+	const VkFormat decodedFormat = VK_FORMAT_R8G8B8A8_UNORM; // What DecodedImage holds, and so what cached chains store.
+
+	VkImageSubresourceRange levelRange(uint32_t levelCount) {
+		return { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	}
+}
+
+bool TextureResidency::isSupported(const VkPhysicalDeviceFeatures& features) {
+	return features.fragmentStoresAndAtomics;
+}
+
+void TextureResidency::enableFeatures(VkPhysicalDeviceFeatures& features) {
+	features.fragmentStoresAndAtomics = VK_TRUE; // The scene's fragment shader writes mip feedback.
+}
+
+void TextureResidency::init(VkDevice device, DeviceQueues& queues, UploadManager& uploads, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless,
+	FrameScheduler& frameScheduler, JobSystem& jobSystem, uint32_t framesInFlight, const std::string& cacheDirectory, VkDeviceSize budget, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->uploads = &uploads;
+	this->allocator = &allocator;
+	this->bindless = &bindless;
+	this->frameScheduler = &frameScheduler;
+	this->jobSystem = &jobSystem;
+	this->cacheDirectory = cacheDirectory;
+	this->budget = budget;
+	this->callbacks = callbacks;
+
+	uint32_t graphicsFamily = queues.getFamilyIndex(QueueType::Graphics);
+	uint32_t transferFamily = queues.getFamilyIndex(QueueType::Transfer);
+	sharingFamilies = { graphicsFamily };
+	if (transferFamily != graphicsFamily) {
+		sharingFamilies.push_back(transferFamily);
+	}
+	std::filesystem::create_directories(cacheDirectory);
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	if (vkCreateSampler(device, &samplerInfo, callbacks, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create streamed texture sampler.");
+	}
+
+	// One entry per bindless texture slot, so the shader can index feedback with the index it samples through.
+	indexOwners.resize(bindless.getTextureCapacity());
+	VkDeviceSize feedbackSize = sizeof(uint32_t) * static_cast<VkDeviceSize>(indexOwners.size());
+	feedback.resize(framesInFlight);
+	for (FeedbackSlot& slot : feedback) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = feedbackSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device, &bufferInfo, callbacks, &slot.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create texture feedback buffer.");
+		}
+		slot.allocation = allocator.allocateForBuffer(slot.buffer, MemoryUsage::GpuToCpu);
+		memset(slot.allocation->mappedData, 0xFF, static_cast<size_t>(feedbackSize));
+		slot.bindlessIndex = bindless.addBuffer(slot.buffer);
+	}
+}
+
+void TextureResidency::destroy() {
+	if (device == VK_NULL_HANDLE) {
+		return;
+	}
+	jobSystem->wait(jobs);
+	// Swaps may still be waiting for their copies, some of them not even flushed yet.
+	uploads->wait(uploads->flush());
+
+	for (Swap& swap : swaps) {
+		vkDestroyImageView(device, swap.view, callbacks);
+		vkDestroyImage(device, swap.image, callbacks);
+		allocator->free(swap.allocation);
+	}
+	swaps.clear();
+	for (std::unique_ptr<Texture>& texture : textures) {
+		if (texture->image != VK_NULL_HANDLE) {
+			bindless->releaseTexture(texture->bindlessIndex);
+			vkDestroyImageView(device, texture->view, callbacks);
+			vkDestroyImage(device, texture->image, callbacks);
+			allocator->free(texture->allocation);
+		}
+	}
+	textures.clear();
+	for (FeedbackSlot& slot : feedback) {
+		bindless->releaseBuffer(slot.bindlessIndex);
+		vkDestroyBuffer(device, slot.buffer, callbacks);
+		allocator->free(slot.allocation);
+	}
+	feedback.clear();
+	vkDestroySampler(device, sampler, callbacks);
+	completedLoads.clear();
+	preparedTextures.clear();
+	device = VK_NULL_HANDLE;
+}
+
+uint32_t TextureResidency::addTexture(DecodedImage image) {
+	return submitPrepare([this, image = std::move(image)](Texture& texture) { prepareTexture(texture, image); });
+}
+
+uint32_t TextureResidency::addTexture(TextureLevels levels) {
+	return submitPrepare([this, levels = std::move(levels)](Texture& texture) { prepareTexture(texture, levels); });
+}
+
+uint32_t TextureResidency::addCookedTexture(std::string path) {
+	return submitPrepare([this, path = std::move(path)](Texture& texture) {
+		if (!openCachedChain(texture, path)) {
+			std::cerr << "Texture Residency: keeping the placeholder for cooked texture " << path << "\n";
+			texture.failed = true;
+		}
+	});
+}
+
+void TextureResidency::readFeedback(uint32_t slot, uint64_t frameIndex) {
+	CPU_PROFILE_SCOPE("readTextureFeedback");
+	this->frameIndex = frameIndex;
+	uint32_t* values = static_cast<uint32_t*>(feedback[slot].allocation->mappedData);
+	for (size_t i = 0; i < indexOwners.size(); ++i) {
+		const IndexOwner& owner = indexOwners[i];
+		if (values[i] == textureFeedbackUnused || owner.texture == textureFeedbackUnused) {
+			continue;
+		}
+		Texture& texture = *textures[owner.texture];
+		int32_t wanted = static_cast<int32_t>(owner.mip) + static_cast<int32_t>(values[i]) - textureFeedbackBias;
+		uint32_t mip = static_cast<uint32_t>(std::clamp(wanted, 0, static_cast<int32_t>(texture.tailMip)));
+		// The first sighting this frame replaces older requests, so textures that moved away can be trimmed.
+		texture.wantedMip = texture.lastUsedFrame == frameIndex ? std::min(texture.wantedMip, mip) : mip;
+		texture.lastUsedFrame = frameIndex;
+	}
+	// Coherent, and this slot's next frame is submitted after this, so the shader sees the reset.
+	memset(values, 0xFF, sizeof(uint32_t) * indexOwners.size());
+}
+
+void TextureResidency::update() {
+	CPU_PROFILE_SCOPE("updateTextureResidency");
+	std::vector<uint32_t> prepared;
+	std::vector<Load> loaded;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		prepared.swap(preparedTextures);
+		loaded.swap(completedLoads);
+	}
+
+	// The tail comes first and regardless of budget: without it the texture has nothing to show.
+	for (uint32_t index : prepared) {
+		Texture& texture = *textures[index];
+		texture.prepared = true;
+		if (texture.failed) {
+			continue;
+		}
+		uint32_t levelCount = texture.file.getLevelCount();
+		texture.tailMip = levelCount - 1;
+		while (texture.tailMip > 0 && std::max(texture.file.getWidth(texture.tailMip - 1), texture.file.getHeight(texture.tailMip - 1)) <= minResidentSize) {
+			--texture.tailMip;
+		}
+		texture.committedMip = levelCount; // Nothing resident yet.
+		texture.wantedMip = texture.tailMip;
+		startLoad(index, texture.tailMip);
+	}
+
+	for (Load& load : loaded) {
+		uploadLoad(load);
+	}
+
+	uint64_t completedValue = uploads->getCompletedValue();
+	for (Swap& swap : swaps) {
+		if (swap.uploadValue > completedValue) {
+			continue;
+		}
+		Texture& texture = *textures[swap.texture];
+		if (texture.image != VK_NULL_HANDLE) {
+			releaseImage(texture.image, texture.view, texture.allocation, texture.bindlessIndex);
+		}
+		texture.image = swap.image;
+		texture.view = swap.view;
+		texture.allocation = swap.allocation;
+		texture.bindlessIndex = bindless->addTexture(swap.view, sampler);
+		texture.residentMip = swap.mip;
+		texture.loading = false;
+		indexOwners[texture.bindlessIndex] = { swap.texture, swap.mip };
+		changes.push_back({ swap.texture, texture.bindlessIndex });
+		--loadsInFlight;
+		swap.image = VK_NULL_HANDLE;
+	}
+	swaps.erase(std::remove_if(swaps.begin(), swaps.end(), [](const Swap& swap) { return swap.image == VK_NULL_HANDLE; }), swaps.end());
+
+	// Most missing levels first; among equals, the most recently used.
+	using Request = std::pair<std::pair<uint32_t, uint64_t>, uint32_t>;
+	std::priority_queue<Request> requests;
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		const Texture& texture = *textures[i];
+		if (texture.prepared && !texture.failed && !texture.loading && texture.wantedMip < texture.committedMip) {
+			requests.push({ { texture.committedMip - texture.wantedMip, texture.lastUsedFrame }, i });
+		}
+	}
+	while (!requests.empty() && loadsInFlight < maxLoadsInFlight) {
+		uint32_t index = requests.top().second;
+		requests.pop();
+		const Texture& texture = *textures[index];
+		VkDeviceSize bytes = texture.file.getChainSize(texture.wantedMip) - texture.file.getChainSize(texture.committedMip);
+		if (residentBytes + bytes > budget && !evict(index, residentBytes + bytes - budget)) {
+			++deferredLoads;
+			continue; // A smaller request may still fit.
+		}
+		startLoad(index, texture.wantedMip);
+	}
+}
+
+std::vector<TextureResidencyChange> TextureResidency::takeChanges() {
+	std::vector<TextureResidencyChange> taken;
+	taken.swap(changes);
+	return taken;
+}
+
+void TextureResidency::printStats() const {
+	std::cout << "Texture Residency: " << textures.size() << " textures, " << residentBytes / (1024.0 * 1024.0) << " of "
+		<< budget / (1024.0 * 1024.0) << " MB resident, " << loadCount << " loads, " << evictionCount << " evictions, "
+		<< deferredLoads << " requests deferred by the budget\n";
+}
+
+uint32_t TextureResidency::submitPrepare(std::function<void(Texture&)> prepare) {
+	uint32_t index = static_cast<uint32_t>(textures.size());
+	textures.push_back(std::make_unique<Texture>());
+	Texture* texture = textures.back().get();
+	// Background: mipmapping and cache writes take milliseconds, too long to run inside a wait of the frame's.
+	jobSystem->submitBackground([this, index, texture, prepare = std::move(prepare)]() {
+		prepare(*texture);
+		std::lock_guard<std::mutex> lock(jobMutex);
+		preparedTextures.push_back(index);
+	}, &jobs);
+	return index;
+}
+
+void TextureResidency::prepareTexture(Texture& texture, const DecodedImage& image) {
+	CPU_PROFILE_SCOPE("prepareStreamedTexture");
+	try {
+		if (image.width == 0 || image.height == 0 || image.pixels.size() != static_cast<size_t>(image.width) * image.height * 4) {
+			throw std::runtime_error("image has no pixels");
+		}
+		// Named after the pixels, so an image is mipmapped once no matter how many scenes or launches use it.
+		std::string path = getCachePath(fnv1a64(image.pixels.data(), image.pixels.size(), hashValue(image.width, hashValue(image.height))));
+		if (!openCachedChain(texture, path)) {
+			writeMipChainFile(path, decodedFormat, image.width, image.height, buildMipChain(image));
+			texture.file.open(path);
+		}
+	}
+	catch (const std::exception& error) {
+		std::cerr << "Texture Residency: keeping the placeholder for a texture: " << error.what() << "\n";
+		texture.failed = true;
+	}
+}
+
+void TextureResidency::prepareTexture(Texture& texture, const TextureLevels& levels) {
+	CPU_PROFILE_SCOPE("prepareStreamedTexture");
+	try {
+		if (levels.width == 0 || levels.height == 0 || levels.levels.empty()) {
+			throw std::runtime_error("texture has no levels");
+		}
+		uint64_t key = hashValue(static_cast<uint32_t>(levels.format), hashValue(levels.width, hashValue(levels.height)));
+		for (const std::vector<uint8_t>& level : levels.levels) {
+			key = fnv1a64(level.data(), level.size(), key);
+		}
+		std::string path = getCachePath(key);
+		if (!openCachedChain(texture, path)) {
+			writeMipChainFile(path, levels.format, levels.width, levels.height, levels.levels);
+			texture.file.open(path);
+		}
+	}
+	catch (const std::exception& error) {
+		std::cerr << "Texture Residency: keeping the placeholder for a texture: " << error.what() << "\n";
+		texture.failed = true;
+	}
+}
+
+std::string TextureResidency::getCachePath(uint64_t key) const {
+	return (std::filesystem::path(cacheDirectory) / (toHex(reinterpret_cast<const uint8_t*>(&key), sizeof(key)) + ".mips")).string();
+}
+
+bool TextureResidency::openCachedChain(Texture& texture, const std::string& path) const {
+	if (!std::filesystem::exists(path)) {
+		return false;
+	}
+	try {
+		texture.file.open(path);
+	}
+	catch (const std::exception& error) {
+		std::cerr << "Texture Residency: rebuilding " << error.what() << "\n";
+	}
+	return texture.file.isOpen();
+}
+
+void TextureResidency::startLoad(uint32_t index, uint32_t mip) {
+	Texture& texture = *textures[index];
+	residentBytes = residentBytes + texture.file.getChainSize(mip) - texture.file.getChainSize(texture.committedMip);
+	texture.committedMip = mip;
+	texture.loading = true;
+	++loadsInFlight;
+	++loadCount;
+
+	Texture* source = &texture;
+	jobSystem->submitBackground([this, index, source, mip]() {
+		CPU_PROFILE_SCOPE("loadTextureLevels");
+		const MipChainFile& file = source->file;
+		uint32_t last = file.getLevelCount() - 1;
+		const uint8_t* begin = file.getLevelData(mip);
+		const uint8_t* end = file.getLevelData(last) + file.getLevelSize(last);
+		file.prefetch(mip);
+
+		Load load{ index, mip, std::vector<uint8_t>(begin, end) };
+		std::lock_guard<std::mutex> lock(jobMutex);
+		completedLoads.push_back(std::move(load));
+	}, &jobs);
+}
+
+void TextureResidency::uploadLoad(Load& load) {
+	const MipChainFile& file = textures[load.texture]->file;
+	uint32_t levelCount = file.getLevelCount() - load.mip;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = file.getFormat();
+	imageInfo.extent = { file.getWidth(load.mip), file.getHeight(load.mip), 1 };
+	imageInfo.mipLevels = levelCount;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = sharingFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharingFamilies.size());
+	imageInfo.pQueueFamilyIndices = sharingFamilies.data();
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	Swap swap{};
+	swap.texture = load.texture;
+	swap.mip = load.mip;
+	if (vkCreateImage(device, &imageInfo, callbacks, &swap.image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create streamed texture.");
+	}
+	swap.allocation = allocator->allocateForImage(swap.image, MemoryUsage::GpuOnly);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = swap.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = imageInfo.format;
+	viewInfo.subresourceRange = levelRange(levelCount);
+	if (vkCreateImageView(device, &viewInfo, callbacks, &swap.view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create streamed texture view.");
+	}
+
+	// Every level is a whole subresource, which any transfer granularity allows.
+	const uint8_t* first = file.getLevelData(load.mip);
+	uploads->beginImage(swap.image, levelRange(levelCount));
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		uint32_t fileLevel = load.mip + level;
+		VkBufferImageCopy region{};
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		region.imageExtent = { file.getWidth(fileLevel), file.getHeight(fileLevel), 1 };
+		uploads->uploadImage(swap.image, region, load.data.data() + (file.getLevelData(fileLevel) - first), file.getLevelSize(fileLevel));
+	}
+	uploads->finishImage(swap.image, levelRange(levelCount), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	swap.uploadValue = uploads->getPendingValue();
+	swaps.push_back(swap);
+}
+
+bool TextureResidency::evict(uint32_t requester, VkDeviceSize bytes) {
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < textures.size(); ++i) {
+		const Texture& texture = *textures[i];
+		if (i == requester || !texture.prepared || texture.failed || texture.loading || texture.committedMip >= texture.tailMip) {
+			continue;
+		}
+		if (texture.wantedMip > texture.committedMip || texture.lastUsedFrame + evictionGraceFrames < frameIndex) {
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return textures[a]->lastUsedFrame < textures[b]->lastUsedFrame; });
+
+	VkDeviceSize freed = 0;
+	for (uint32_t index : candidates) {
+		if (freed >= bytes) {
+			break;
+		}
+		const Texture& texture = *textures[index];
+		// Recently used textures only lose what they no longer ask for; stale ones a level at a time.
+		uint32_t mip = std::min(std::max(texture.committedMip + 1, texture.wantedMip), texture.tailMip);
+		freed += texture.file.getChainSize(texture.committedMip) - texture.file.getChainSize(mip);
+		startLoad(index, mip);
+		++evictionCount;
+	}
+	return freed >= bytes;
+}
+
+void TextureResidency::releaseImage(VkImage image, VkImageView view, GpuAllocation* allocation, uint32_t bindlessIndex) {
+	frameScheduler->deferUntilComplete([this, image, view, allocation, bindlessIndex]() {
+		indexOwners[bindlessIndex] = IndexOwner{};
+		bindless->releaseTexture(bindlessIndex);
+		vkDestroyImageView(device, view, callbacks);
+		vkDestroyImage(device, image, callbacks);
+		allocator->free(allocation);
+	});
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bindlessDescriptors.h"
+#include "deviceQueues.h"
+#include "frameScheduler.h"
+#include "gpuMemoryAllocator.h"
+#include "imageDecoder.h"
+#include "jobSystem.h"
+#include "ktx2Texture.h"
+#include "mipChainFile.h"
+#include "uploadManager.h"
+
+// Added to the mip a fragment wants, relative to the level it sampled, so the feedback value fits an unsigned atomicMin.
+const int32_t textureFeedbackBias = 16;
+const uint32_t textureFeedbackUnused = ~0u;
+
+struct TextureResidencyChange {
+	uint32_t texture;
+	uint32_t bindlessIndex; // Replaces the texture's previous index, which stays valid for frames already recorded.
+};
+
+/*
+	Texture Residency
+	- Keeps only the mip levels frames actually sample in device memory. Every texture is a mip chain file in the
+	  texture cache; its image holds the levels from its resident mip down to 1x1, and levels are streamed in and out
+	  by replacing the image.
+	- The scene's fragment shader writes, per bindless texture index, the finest mip it wanted relative to the level
+	  it sampled into this frame slot's feedback buffer (shaders/mesh.frag). readFeedback() reads a slot once its
+	  frame has finished, so the GPU never waits for the CPU.
+	- update() queues the textures missing the most levels first and starts up to maxLoadsInFlight loads. A load reads
+	  the levels in a background job, the main thread uploads them into a new image, and once the upload completes
+	  the new image takes over under a new bindless index (takeChanges). The old image is released after the frames
+	  that may still sample it.
+	- Resident bytes stay under budget. A load that would exceed it first drops one level from each of the least
+	  recently used textures, and from textures holding levels finer than they asked for. Textures used within the last
+	  evictionGraceFrames are only ever trimmed to what they ask for, so a full budget defers loads instead of thrashing.
+	  Replacing an image briefly holds both, so the budget is exceeded by the images in flight.
+	- Every texture keeps the levels up to minResidentSize, so there is always something to sample.
+	- Block-compressed textures (ktx2Texture.h) stream the same way; their chain file keeps the blocks and whatever
+	  levels the file came with.
+*/
+class TextureResidency {
+
+	public:
+		static const uint32_t minResidentSize = 64; // Largest dimension of the level every texture keeps resident.
+		static const uint32_t maxLoadsInFlight = 8;
+		static const uint64_t evictionGraceFrames = 30;
+
+		static bool isSupported(const VkPhysicalDeviceFeatures& features);
+		static void enableFeatures(VkPhysicalDeviceFeatures& features);
+
+		void init(VkDevice device, DeviceQueues& queues, UploadManager& uploads, GpuMemoryAllocator& allocator, BindlessDescriptors& bindless,
+			FrameScheduler& frameScheduler, JobSystem& jobSystem, uint32_t framesInFlight, const std::string& cacheDirectory, VkDeviceSize budget, const VkAllocationCallbacks* callbacks);
+		// The frame scheduler must be destroyed first, so deferred releases have run.
+		void destroy();
+
+		// Mipmapping and writing the cache file happen on a worker. Returns the texture's id for takeChanges.
+		uint32_t addTexture(DecodedImage image);
+		// Already in its final format with its own levels (KTX2), so only the cache file is written.
+		uint32_t addTexture(TextureLevels levels);
+		// A mip chain file AssetCooker already wrote: opened where it is, nothing is built or cached. Its format must be
+		// one the device samples; GltfLoader falls back to the source image when it isn't.
+		uint32_t addCookedTexture(std::string path);
+		// Once the slot's previous frame has finished (after beginFrame), before update().
+		void readFeedback(uint32_t slot, uint64_t frameIndex);
+		// Publishes completed loads and starts new ones. Loads are uploaded but not flushed.
+		void update();
+		std::vector<TextureResidencyChange> takeChanges();
+
+		VkBuffer getFeedbackBuffer(uint32_t slot) const { return feedback[slot].buffer; }
+		uint32_t getFeedbackBufferIndex(uint32_t slot) const { return feedback[slot].bindlessIndex; }
+		VkDeviceSize getResidentBytes() const { return residentBytes; }
+		void printStats() const;
+
+	private:
+		struct Texture {
+			// Filled in by the prepare job; the main thread reads it only once the texture is in preparedTextures.
+			MipChainFile file;
+			bool prepared = false;
+			bool failed = false;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			GpuAllocation* allocation = nullptr;
+			uint32_t bindlessIndex = textureFeedbackUnused;
+			uint32_t residentMip = 0; // Finest level in the image. Meaningless until the image exists.
+			uint32_t committedMip = 0; // residentMip once the load in flight lands.
+			uint32_t tailMip = 0; // Coarsest level that is still kept resident.
+			uint32_t wantedMip = 0;
+			uint64_t lastUsedFrame = 0;
+			bool loading = false;
+		};
+
+		struct Load {
+			uint32_t texture;
+			uint32_t mip;
+			std::vector<uint8_t> data; // Levels [mip, levelCount), each at its offset relative to the first.
+		};
+
+		struct Swap {
+			uint64_t uploadValue;
+			uint32_t texture;
+			uint32_t mip;
+			VkImage image;
+			VkImageView view;
+			GpuAllocation* allocation;
+		};
+
+		struct FeedbackSlot {
+			VkBuffer buffer = VK_NULL_HANDLE;
+			GpuAllocation* allocation = nullptr;
+			uint32_t bindlessIndex = 0;
+		};
+
+		// Which texture and level a bindless index samples, to turn relative feedback into an absolute mip.
+		struct IndexOwner {
+			uint32_t texture = textureFeedbackUnused;
+			uint32_t mip = 0;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		UploadManager* uploads = nullptr;
+		GpuMemoryAllocator* allocator = nullptr;
+		BindlessDescriptors* bindless = nullptr;
+		FrameScheduler* frameScheduler = nullptr;
+		JobSystem* jobSystem = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		std::string cacheDirectory;
+		VkDeviceSize budget = 0;
+		std::vector<uint32_t> sharingFamilies; // Two when graphics and transfer differ.
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		// unique_ptr so jobs can hold a Texture while addTexture grows the list.
+		std::vector<std::unique_ptr<Texture>> textures;
+		std::vector<FeedbackSlot> feedback;
+		std::vector<IndexOwner> indexOwners;
+		JobCounter jobs;
+		std::mutex jobMutex;
+		std::vector<uint32_t> preparedTextures;
+		std::vector<Load> completedLoads;
+		std::vector<Swap> swaps;
+		std::vector<TextureResidencyChange> changes;
+		VkDeviceSize residentBytes = 0; // Of committed mips, so loads in flight count already.
+		uint64_t frameIndex = 0;
+		uint32_t loadsInFlight = 0;
+
+		uint64_t loadCount = 0;
+		uint64_t evictionCount = 0;
+		uint64_t deferredLoads = 0; // Requests left for a later frame because the budget was full.
+
+		uint32_t submitPrepare(std::function<void(Texture&)> prepare);
+		void prepareTexture(Texture& texture, const DecodedImage& image);
+		void prepareTexture(Texture& texture, const TextureLevels& levels);
+		std::string getCachePath(uint64_t key) const;
+		// Opens path if it holds a valid chain. False means it has to be (re)written.
+		bool openCachedChain(Texture& texture, const std::string& path) const;
+		// Starts reading levels [mip, levelCount) and accounts for them in residentBytes.
+		void startLoad(uint32_t index, uint32_t mip);
+		void uploadLoad(Load& load);
+		// Frees at least bytes by starting smaller loads for other textures. False when that isn't possible this frame.
+		bool evict(uint32_t requester, VkDeviceSize bytes);
+		void releaseImage(VkImage image, VkImageView view, GpuAllocation* allocation, uint32_t bindlessIndex);
+};
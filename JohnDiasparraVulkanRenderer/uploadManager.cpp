@@ -0,0 +1,313 @@
+#include "uploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "cpuProfiler.h"
+
+namespace {
+
+	const VkDeviceSize copyAlignment = 16; // A multiple of every texel and compressed block size, and of 4 for buffer copies.
+}
+
+void UploadManager::init(VkDevice device, DeviceQueues& queues, GpuMemoryAllocator& allocator, VkDeviceSize ringSize, const VkAllocationCallbacks* callbacks) {
+	this->device = device;
+	this->queues = &queues;
+	this->allocator = &allocator;
+	this->callbacks = callbacks;
+	// Anything bigger would take a large share of the ring on its own and stall the uploads queued behind it.
+	maxRingUpload = ringSize / 4;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queues.getFamilyIndex(QueueType::Transfer);
+	if (vkCreateCommandPool(device, &poolInfo, callbacks, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create upload command pool.");
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, callbacks, &timeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create upload timeline semaphore.");
+	}
+
+	ring.init(device, allocator, ringSize, callbacks);
+}
+
+void UploadManager::destroy() {
+	if (device == VK_NULL_HANDLE) {
+		return;
+	}
+	wait(submittedValue);
+
+	// Queued but never flushed: nothing reads these any more.
+	for (const DedicatedStaging& staging : pendingDedicated) {
+		vkDestroyBuffer(device, staging.buffer, callbacks);
+		allocator->free(staging.allocation);
+	}
+	pendingDedicated.clear();
+	bufferGroups.clear();
+	imageGroups.clear();
+	preBarriers.clear();
+	postBarriers.clear();
+	openImages.clear();
+
+	ring.destroy();
+	vkDestroySemaphore(device, timeline, callbacks);
+	vkDestroyCommandPool(device, commandPool, callbacks); // Frees every command buffer allocated from it.
+	freeCommandBuffers.clear();
+	device = VK_NULL_HANDLE;
+}
+
+bool UploadManager::uploadBuffer(VkBuffer destination, VkDeviceSize destinationOffset, const void* data, VkDeviceSize size, bool wait) {
+	VkBuffer source;
+	VkDeviceSize offset = 0;
+	if (!stage(data, size, copyAlignment, wait, source, offset)) {
+		return false;
+	}
+
+	auto group = std::find_if(bufferGroups.begin(), bufferGroups.end(), [&](const BufferCopyGroup& candidate) {
+		return candidate.source == source && candidate.destination == destination;
+	});
+	if (group == bufferGroups.end()) {
+		bufferGroups.push_back({ source, destination, {} });
+		group = bufferGroups.end() - 1;
+	}
+	group->regions.push_back({ offset, destinationOffset, size });
+	return true;
+}
+
+bool UploadManager::uploadImage(VkImage destination, VkBufferImageCopy region, const void* data, VkDeviceSize size, bool wait) {
+	if (openImages.count(destination) == 0) {
+		throw std::runtime_error("Upload Manager: image uploaded outside beginImage and finishImage.");
+	}
+	VkBuffer source;
+	VkDeviceSize offset = 0;
+	if (!stage(data, size, copyAlignment, wait, source, offset)) {
+		return false;
+	}
+
+	region.bufferOffset = offset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	auto group = std::find_if(imageGroups.begin(), imageGroups.end(), [&](const ImageCopyGroup& candidate) {
+		return candidate.source == source && candidate.destination == destination;
+	});
+	if (group == imageGroups.end()) {
+		imageGroups.push_back({ source, destination, {} });
+		group = imageGroups.end() - 1;
+	}
+	group->regions.push_back(region);
+	return true;
+}
+
+void UploadManager::beginImage(VkImage image, const VkImageSubresourceRange& range) {
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	preBarriers.push_back(barrier);
+	openImages.insert(image);
+}
+
+void UploadManager::finishImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout finalLayout) {
+	// The reading queue's timeline wait orders its work after this, so there is nothing to wait for on this side.
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = finalLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	postBarriers.push_back(barrier);
+	openImages.erase(image);
+}
+
+uint64_t UploadManager::flush() {
+	CPU_PROFILE_SCOPE("flushUploads");
+	retireCompleted();
+	if (!hasPending()) {
+		return submittedValue;
+	}
+
+	VkCommandBuffer commandBuffer = acquireCommandBuffer();
+	VkDependencyInfo dependency{};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	if (!preBarriers.empty()) {
+		dependency.imageMemoryBarrierCount = static_cast<uint32_t>(preBarriers.size());
+		dependency.pImageMemoryBarriers = preBarriers.data();
+		vkCmdPipelineBarrier2(commandBuffer, &dependency);
+	}
+	for (const BufferCopyGroup& group : bufferGroups) {
+		vkCmdCopyBuffer(commandBuffer, group.source, group.destination, static_cast<uint32_t>(group.regions.size()), group.regions.data());
+	}
+	for (const ImageCopyGroup& group : imageGroups) {
+		vkCmdCopyBufferToImage(commandBuffer, group.source, group.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(group.regions.size()), group.regions.data());
+	}
+	if (!postBarriers.empty()) {
+		dependency.imageMemoryBarrierCount = static_cast<uint32_t>(postBarriers.size());
+		dependency.pImageMemoryBarriers = postBarriers.data();
+		vkCmdPipelineBarrier2(commandBuffer, &dependency);
+	}
+	vkEndCommandBuffer(commandBuffer);
+
+	VkCommandBufferSubmitInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+	commandBufferInfo.commandBuffer = commandBuffer;
+
+	VkSemaphoreSubmitInfo signal{};
+	signal.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	signal.semaphore = timeline;
+	signal.value = submittedValue + 1;
+	signal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo2 submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.commandBufferInfoCount = 1;
+	submitInfo.pCommandBufferInfos = &commandBufferInfo;
+	submitInfo.signalSemaphoreInfoCount = 1;
+	submitInfo.pSignalSemaphoreInfos = &signal;
+	queues->submit2(QueueType::Transfer, 1, &submitInfo, VK_NULL_HANDLE);
+
+	++submittedValue;
+	ring.markSubmitted(submittedValue);
+	inFlight.push_back({ submittedValue, commandBuffer, std::move(pendingDedicated) });
+	pendingDedicated.clear();
+	bufferGroups.clear();
+	imageGroups.clear();
+	preBarriers.clear();
+	postBarriers.clear();
+	pendingBytes = 0;
+	++batchCount;
+	return submittedValue;
+}
+
+uint64_t UploadManager::getCompletedValue() {
+	retireCompleted();
+	return completedValue;
+}
+
+void UploadManager::wait(uint64_t value) {
+	if (value > completedValue) {
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &value;
+		vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+	}
+	retireCompleted();
+}
+
+VkSemaphoreSubmitInfo UploadManager::getWaitInfo(uint64_t value, VkPipelineStageFlags2 stages) const {
+	VkSemaphoreSubmitInfo wait{};
+	wait.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	wait.semaphore = timeline;
+	wait.value = value;
+	wait.stageMask = stages;
+	return wait;
+}
+
+void UploadManager::printStats() const {
+	std::cout << "Upload Manager: " << uploadCount << " uploads, " << uploadedBytes / (1024.0 * 1024.0) << " MB in " << batchCount << " batches, "
+		<< dedicatedCount << " through dedicated staging, " << ringStalls << " waited for ring space\n";
+}
+
+bool UploadManager::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment, bool wait, VkBuffer& source, VkDeviceSize& offset) {
+	if (size > maxRingUpload) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		DedicatedStaging staging;
+		if (vkCreateBuffer(device, &bufferInfo, callbacks, &staging.buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create dedicated staging buffer.");
+		}
+		staging.allocation = allocator->allocateForBuffer(staging.buffer, MemoryUsage::CpuToGpu);
+		memcpy(staging.allocation->mappedData, data, static_cast<size_t>(size));
+		pendingDedicated.push_back(staging);
+		source = staging.buffer;
+		offset = 0;
+		++dedicatedCount;
+	}
+	else {
+		if (!ring.allocate(size, alignment, offset)) {
+			if (!wait) {
+				return false;
+			}
+			// Everything still queued has to go first, or the space it holds would never come back.
+			++ringStalls;
+			flush();
+			while (!ring.allocate(size, alignment, offset)) {
+				if (inFlight.empty()) {
+					throw std::runtime_error("Upload Manager: staging ring has no room with nothing in flight.");
+				}
+				this->wait(inFlight.front().timelineValue);
+			}
+		}
+		memcpy(ring.getMapped() + offset, data, static_cast<size_t>(size));
+		source = ring.getBuffer();
+	}
+
+	pendingBytes += size;
+	uploadedBytes += size;
+	++uploadCount;
+	return true;
+}
+
+void UploadManager::retireCompleted() {
+	vkGetSemaphoreCounterValue(device, timeline, &completedValue);
+	while (!inFlight.empty() && inFlight.front().timelineValue <= completedValue) {
+		Batch& batch = inFlight.front();
+		for (const DedicatedStaging& staging : batch.dedicated) {
+			vkDestroyBuffer(device, staging.buffer, callbacks);
+			allocator->free(staging.allocation);
+		}
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		freeCommandBuffers.push_back(batch.commandBuffer);
+		inFlight.pop_front();
+	}
+	ring.reclaim(completedValue);
+}
+
+VkCommandBuffer UploadManager::acquireCommandBuffer() {
+	VkCommandBuffer commandBuffer;
+	if (!freeCommandBuffers.empty()) {
+		commandBuffer = freeCommandBuffers.back();
+		freeCommandBuffers.pop_back();
+	}
+	else {
+		VkCommandBufferAllocateInfo allocateInfo{};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = commandPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate upload command buffer.");
+		}
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	return commandBuffer;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+#include "deviceQueues.h"
+#include "gpuMemoryAllocator.h"
+#include "stagingRing.h"
+
+/*
+	Upload Manager
+	- Every CPU to GPU copy goes through here. Data is written into a persistently mapped staging ring when the upload
+	  call is made; the copies themselves are only recorded by flush(), which submits everything queued since the
+	  last flush as one transfer queue submission. Buffer copies are merged into one vkCmdCopyBuffer per source and
+	  destination pair, image copies into one vkCmdCopyBufferToImage per image, and layout transitions into one
+	  barrier before and one after.
+	- Each flush signals the next value of a timeline semaphore. Uploads are complete once that value is, and another
+	  queue can wait on it (getWaitInfo) without the CPU ever blocking.
+	- Uploads larger than maxRingUpload get a dedicated staging buffer, freed when their batch completes, so one huge
+	  resource can neither fail for lack of ring space nor evict every small upload behind it.
+	- Destinations are written on the transfer queue: they need concurrent sharing with the queues that read them,
+	  or an ownership transfer by the caller.
+	- Regions written in one batch must not overlap, since merged copies have no order among themselves.
+*/
+class UploadManager {
+
+	public:
+		static const VkDeviceSize defaultRingSize = 64ull << 20;
+
+		void init(VkDevice device, DeviceQueues& queues, GpuMemoryAllocator& allocator, VkDeviceSize ringSize, const VkAllocationCallbacks* callbacks);
+		// Waits for every submitted batch first.
+		void destroy();
+
+		// Returns false only when wait is false and the ring has no room until earlier batches complete. With wait set,
+		// a full ring flushes and blocks until enough has completed.
+		bool uploadBuffer(VkBuffer destination, VkDeviceSize destinationOffset, const void* data, VkDeviceSize size, bool wait = true);
+		// data holds region's texels tightly packed; region.bufferOffset, bufferRowLength and bufferImageHeight are filled in here.
+		// Throws unless the image is between beginImage and finishImage.
+		bool uploadImage(VkImage destination, VkBufferImageCopy region, const void* data, VkDeviceSize size, bool wait = true);
+		// Bracket an image's uploads: the first discards its contents into TRANSFER_DST_OPTIMAL, the second moves it to
+		// finalLayout. beginImage must come before the image's first upload, since an upload that finds the ring full
+		// flushes the batch, and that batch's copies must already have their barrier. The uploads may then span
+		// several batches; a batch records every begin before its copies and every finish after.
+		void beginImage(VkImage image, const VkImageSubresourceRange& range);
+		void finishImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout finalLayout);
+
+		// Submits everything queued since the last flush. Returns the timeline value that signals its completion, or the
+		// last submitted value when nothing was queued.
+		uint64_t flush();
+		// Everything queued so far has completed once this value has: the next flush's if anything is waiting for one.
+		uint64_t getPendingValue() const { return hasPending() ? submittedValue + 1 : submittedValue; }
+		uint64_t getCompletedValue();
+		void wait(uint64_t value);
+		// For another queue's submission to wait on value. Free once the value has completed.
+		VkSemaphoreSubmitInfo getWaitInfo(uint64_t value, VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT) const;
+
+		VkDeviceSize getRingSize() const { return ring.getSize(); }
+		VkDeviceSize getMaxRingUpload() const { return maxRingUpload; }
+		VkDeviceSize getPendingBytes() const { return pendingBytes; }
+		bool hasPending() const { return !bufferGroups.empty() || !imageGroups.empty() || !preBarriers.empty() || !postBarriers.empty(); }
+		void printStats() const;
+
+	private:
+		struct BufferCopyGroup {
+			VkBuffer source;
+			VkBuffer destination;
+			std::vector<VkBufferCopy> regions;
+		};
+
+		struct ImageCopyGroup {
+			VkBuffer source;
+			VkImage destination;
+			std::vector<VkBufferImageCopy> regions;
+		};
+
+		struct DedicatedStaging {
+			VkBuffer buffer;
+			GpuAllocation* allocation;
+		};
+
+		struct Batch {
+			uint64_t timelineValue;
+			VkCommandBuffer commandBuffer;
+			std::vector<DedicatedStaging> dedicated;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		DeviceQueues* queues = nullptr;
+		GpuMemoryAllocator* allocator = nullptr;
+		const VkAllocationCallbacks* callbacks = nullptr;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		uint64_t submittedValue = 0;
+		uint64_t completedValue = 0;
+		StagingRing ring;
+		VkDeviceSize maxRingUpload = 0;
+
+		// The batch being gathered.
+		std::vector<BufferCopyGroup> bufferGroups;
+		std::vector<ImageCopyGroup> imageGroups;
+		std::vector<VkImageMemoryBarrier2> preBarriers;
+		std::vector<VkImageMemoryBarrier2> postBarriers;
+		std::unordered_set<VkImage> openImages; // Between beginImage and finishImage.
+		std::vector<DedicatedStaging> pendingDedicated;
+		VkDeviceSize pendingBytes = 0;
+		std::deque<Batch> inFlight;
+
+		uint64_t uploadCount = 0;
+		uint64_t uploadedBytes = 0;
+		uint64_t batchCount = 0;
+		uint64_t dedicatedCount = 0;
+		uint64_t ringStalls = 0; // Uploads that had to wait for the ring.
+
+		// Where the data went: the ring or a fresh dedicated buffer. False when the ring is full and wait is false.
+		bool stage(const void* data, VkDeviceSize size, VkDeviceSize alignment, bool wait, VkBuffer& source, VkDeviceSize& offset);
+		void retireCompleted();
+		VkCommandBuffer acquireCommandBuffer();
+};
@@ -0,0 +1,36 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "benchmarks.h"
+
+int main(int argc, char** argv) {
+	struct Benchmark {
+		const char* name;
+		int (*run)();
+	};
+	const Benchmark benchmarks[] = {
+		{ "jobSystem", benchJobSystem },
+		{ "cpuProfiler", benchCpuProfiler },
+		{ "frustumCulling", benchFrustumCulling },
+		{ "sceneBvh", benchSceneBvh },
+	};
+
+	int errors = 0;
+	for (const Benchmark& benchmark : benchmarks) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; ++i) {
+			selected = selected || std::string(argv[i]) == benchmark.name;
+		}
+		if (!selected) {
+			continue;
+		}
+		std::printf("%s\n", benchmark.name);
+		errors += benchmark.run();
+	}
+
+	if (errors != 0) {
+		std::printf("%d benchmark results were wrong.\n", errors);
+	}
+	return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
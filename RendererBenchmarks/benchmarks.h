@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/*
+	CPU Benchmarks
+	- Each benchmark prints its timings in the style of glm/test/perf and returns how many of its results were wrong,
+	  so a fast but broken path can't pass unnoticed. Build and run the Release configuration.
+	- benchMain runs every benchmark, or only those whose names are given on the command line.
+	- Release|x64 builds with /arch:AVX2 so all three frustum culling loops are compiled in, which means running it
+	  needs an AVX2 machine. The other configurations only have the scalar and SSE2 loops.
+*/
+using BenchClock = std::chrono::high_resolution_clock;
+
+inline double elapsedMicroseconds(BenchClock::time_point start, BenchClock::time_point end = BenchClock::now()) {
+	return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Runs body repeatedly and returns its fastest time, which is the least disturbed by everything else on the machine.
+template <typename Body>
+double bestOfMicroseconds(uint32_t repetitions, Body body) {
+	double best = 0.0;
+	for (uint32_t i = 0; i < repetitions; ++i) {
+		BenchClock::time_point start = BenchClock::now();
+		body();
+		double elapsed = elapsedMicroseconds(start);
+		best = i == 0 ? elapsed : std::min(best, elapsed);
+	}
+	return best;
+}
+
+// The given fraction (0-1) of the way through the sorted samples.
+inline double percentile(std::vector<double> samples, double fraction) {
+	if (samples.empty()) {
+		return 0.0;
+	}
+	size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+int benchJobSystem();
+int benchCpuProfiler();
+int benchFrustumCulling();
+int benchSceneBvh();
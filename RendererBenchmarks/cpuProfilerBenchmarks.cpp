@@ -0,0 +1,74 @@
+#include "benchmarks.h"
+#include "cpuProfiler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	const uint32_t scopeCount = 1000000;
+
+	// The same tiny body with and without a scope around it; the difference is what the scope costs.
+	uint32_t bareLoop(uint32_t seed) {
+		uint32_t value = seed;
+		for (uint32_t i = 0; i < scopeCount; ++i) {
+			value = value * 1664525u + 1013904223u;
+		}
+		return value;
+	}
+
+	uint32_t scopedLoop(uint32_t seed) {
+		uint32_t value = seed;
+		for (uint32_t i = 0; i < scopeCount; ++i) {
+			CPU_PROFILE_SCOPE("bench scope");
+			value = value * 1664525u + 1013904223u;
+		}
+		return value;
+	}
+
+	// Records from several threads at once; per-thread buffers mean this should cost what one thread does.
+	double scopedThreads(uint32_t threadCount, std::vector<uint32_t>& results) {
+		std::vector<std::thread> threads;
+		BenchClock::time_point start = BenchClock::now();
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			threads.emplace_back([&results, i]() { results[i] = scopedLoop(i); });
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		return elapsedMicroseconds(start);
+	}
+}
+
+int benchCpuProfiler() {
+	int errors = 0;
+	uint32_t expected = 0;
+	uint32_t result = 0;
+
+	double bare = bestOfMicroseconds(5, [&]() { expected = bareLoop(1); });
+	CpuProfiler::disable();
+	double disabled = bestOfMicroseconds(5, [&]() { result = scopedLoop(1); });
+	errors += result == expected ? 0 : 1;
+
+	CpuProfiler::enable();
+	double enabled = bestOfMicroseconds(5, [&]() { result = scopedLoop(1); });
+	errors += result == expected ? 0 : 1;
+
+	uint32_t threadCount = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+	std::vector<uint32_t> results(threadCount);
+	double threaded = scopedThreads(threadCount, results);
+	CpuProfiler::disable();
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		errors += results[i] == bareLoop(i) ? 0 : 1;
+	}
+
+	auto perScope = [](double microseconds) { return microseconds * 1000.0 / scopeCount; };
+	std::printf("- No scope: %.0f us for %u iterations\n", bare, scopeCount);
+	std::printf("- Disabled at runtime: %.2f ns per scope\n", perScope(disabled - bare));
+	std::printf("- Enabled: %.2f ns per scope\n", perScope(enabled - bare));
+	// Near 1x when there are cores for every thread, since no two threads touch the same buffer.
+	std::printf("- Enabled, %u threads at once: %.0f us, %.2fx the single thread time\n", threadCount, threaded, threaded / enabled);
+	return errors;
+}
@@ -0,0 +1,103 @@
+#include "benchmarks.h"
+#include "cullingReference.h"
+#include "frustumCulling.h"
+#include "jobSystem.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	const FrustumCullingPath paths[] = { FrustumCullingPath::Scalar, FrustumCullingPath::Sse2, FrustumCullingPath::Avx2 };
+
+	// Spheres scattered through a 200 unit cube around a camera at the origin looking down -z, so about a fifth of
+	// them are visible and the SIMD paths see mixed masks rather than all-in or all-out batches.
+	BoundingSpheres makeSpheres(uint32_t count) {
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+
+		BoundingSpheres spheres;
+		spheres.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			spheres.add(glm::vec4(position(random), position(random), position(random), radius(random)));
+		}
+		return spheres;
+	}
+
+	void makePlanes(glm::vec4 planes[6]) {
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+		extractFrustumPlanes(projection * view, planes);
+	}
+
+	// Every path against the scalar loop on one thread: the SIMD speedup alone.
+	int benchPaths(uint32_t count) {
+		BoundingSpheres spheres = makeSpheres(count);
+		glm::vec4 planes[6];
+		makePlanes(planes);
+		uint32_t repetitions = std::max(3u, 20000000u / count);
+
+		std::vector<uint32_t> expected(spheres.paddedSize());
+		expected.resize(cullSpheresScalar(planes, spheres, 0, spheres.paddedSize(), expected.data()));
+
+		int errors = 0;
+		double scalar = 0.0;
+		for (FrustumCullingPath path : paths) {
+			if (!isFrustumCullingPathAvailable(path)) {
+				std::printf("- %u spheres, %s: not in this build\n", count, getFrustumCullingPathName(path));
+				continue;
+			}
+
+			std::vector<uint32_t> visible(spheres.paddedSize());
+			uint32_t visibleCount = 0;
+			double best = bestOfMicroseconds(repetitions, [&]() {
+				visibleCount = cullSpheresWithPath(path, planes, spheres, 0, spheres.paddedSize(), visible.data());
+			});
+			visible.resize(visibleCount);
+			errors += visible == expected ? 0 : 1;
+
+			scalar = path == FrustumCullingPath::Scalar ? best : scalar;
+			std::printf("- %u spheres, %s: %.1f us, %.0f M spheres/s, %.2fx scalar, %.1f%% visible\n", count, getFrustumCullingPathName(path), best,
+				count / best, scalar / best, 100.0 * visibleCount / count);
+		}
+		return errors;
+	}
+
+	// The widest path split across the job system, against the same path on this thread.
+	int benchParallel(uint32_t count, uint32_t workers) {
+		BoundingSpheres spheres = makeSpheres(count);
+		glm::vec4 planes[6];
+		makePlanes(planes);
+		JobSystem jobSystem(workers);
+
+		std::vector<uint32_t> expected(spheres.paddedSize());
+		double serial = bestOfMicroseconds(10, [&]() {
+			expected.resize(spheres.paddedSize());
+			expected.resize(cullSpheres(planes, spheres, 0, spheres.paddedSize(), expected.data()));
+		});
+
+		std::vector<uint32_t> visible;
+		double parallel = bestOfMicroseconds(10, [&]() { cullSpheresParallel(jobSystem, planes, spheres, visible); });
+
+		std::printf("- %u spheres, %s, %u workers: %.0f us serial, %.0f us parallel, %.2fx speedup\n", count,
+			getFrustumCullingPathName(getFrustumCullingPath()), workers, serial, parallel, serial / parallel);
+		return visible == expected ? 0 : 1;
+	}
+}
+
+int benchFrustumCulling() {
+	int errors = 0;
+	for (uint32_t count : { 10000u, 100000u, 1000000u }) {
+		errors += benchPaths(count);
+	}
+	uint32_t workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+	errors += benchParallel(1000000, workers);
+	return errors;
+}
@@ -0,0 +1,118 @@
+#include "benchmarks.h"
+#include "jobSystem.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	// Busy work of a fixed cost the optimiser can't remove.
+	uint32_t spin(uint32_t iterations, uint32_t seed) {
+		uint32_t value = seed;
+		for (uint32_t i = 0; i < iterations; ++i) {
+			value = value * 1664525u + 1013904223u;
+		}
+		return value;
+	}
+
+	// Many empty jobs from one submitter, so the time is all queueing, stealing and waking.
+	int benchThroughput(uint32_t workers) {
+		const uint32_t jobCount = 200000;
+		const uint32_t repetitions = 5;
+		JobSystem jobSystem(workers);
+
+		std::atomic<uint32_t> runs{ 0 };
+		double best = bestOfMicroseconds(repetitions, [&]() {
+			JobCounter counter;
+			for (uint32_t i = 0; i < jobCount; ++i) {
+				jobSystem.submit([&runs]() { runs.fetch_add(1, std::memory_order_relaxed); }, &counter);
+			}
+			jobSystem.wait(counter);
+		});
+
+		std::printf("- Throughput, %u workers: %.0f us for %u empty jobs, %.2f M jobs/s\n", workers, best, jobCount, jobCount / best);
+		return runs.load() == jobCount * repetitions ? 0 : 1;
+	}
+
+	// Equal jobs all submitted from this thread, so every job a worker runs was stolen from it.
+	int benchStealing(uint32_t workers) {
+		const uint32_t jobCount = 20000;
+		const uint32_t jobIterations = 4000;
+		JobSystem jobSystem(workers);
+
+		std::vector<uint32_t> serialResults(jobCount);
+		double serial = bestOfMicroseconds(3, [&]() {
+			for (uint32_t i = 0; i < jobCount; ++i) {
+				serialResults[i] = spin(jobIterations, i);
+			}
+		});
+
+		std::vector<uint32_t> results(jobCount);
+		std::vector<std::atomic<uint32_t>> runsPerThread(jobSystem.getThreadCount());
+		double parallel = bestOfMicroseconds(3, [&]() {
+			for (auto& runs : runsPerThread) {
+				runs.store(0);
+			}
+			JobCounter counter;
+			for (uint32_t i = 0; i < jobCount; ++i) {
+				jobSystem.submit([&, i]() {
+					results[i] = spin(jobIterations, i);
+					runsPerThread[JobSystem::currentThreadIndex()].fetch_add(1, std::memory_order_relaxed);
+				}, &counter);
+			}
+			jobSystem.wait(counter);
+		});
+
+		double stolen = 100.0 * (jobCount - runsPerThread[0].load()) / jobCount;
+		std::printf("- Stealing, %u workers: %.0f us serial, %.0f us parallel, %.2fx speedup, %.1f%% of jobs stolen\n",
+			workers, serial, parallel, serial / parallel, stolen);
+		return results == serialResults ? 0 : 1;
+	}
+
+	// One job at a time into an idle pool: from submit until the job starts on a worker. This thread polls the
+	// counter rather than waiting on it, since wait would run the job here.
+	int benchLatency(uint32_t workers) {
+		const uint32_t samples = 2000;
+		JobSystem jobSystem(workers);
+
+		std::vector<double> latencies;
+		for (uint32_t i = 0; i < samples; ++i) {
+			// Long enough for every worker to go back to sleep, so each sample includes a wakeup.
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+			BenchClock::time_point started;
+			JobCounter counter;
+			BenchClock::time_point submitted = BenchClock::now();
+			jobSystem.submit([&started]() { started = BenchClock::now(); }, &counter);
+			while (!counter.isDone()) {
+				std::this_thread::yield();
+			}
+			latencies.push_back(elapsedMicroseconds(submitted, started));
+		}
+
+		std::printf("- Wakeup latency, %u workers: %.1f us median, %.1f us p99, %.1f us max\n",
+			workers, percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 1.0));
+		return latencies.size() == samples ? 0 : 1;
+	}
+}
+
+int benchJobSystem() {
+	uint32_t hardwareThreads = std::max(2u, std::thread::hardware_concurrency());
+	std::vector<uint32_t> workerCounts;
+	for (uint32_t workers = 1; workers < hardwareThreads - 1; workers *= 2) {
+		workerCounts.push_back(workers);
+	}
+	workerCounts.push_back(hardwareThreads - 1);
+
+	int errors = 0;
+	for (uint32_t workers : workerCounts) {
+		errors += benchThroughput(workers);
+	}
+	for (uint32_t workers : workerCounts) {
+		errors += benchStealing(workers);
+	}
+	errors += benchLatency(workerCounts.back());
+	return errors;
+}
@@ -0,0 +1,209 @@
+#include "benchmarks.h"
+#include "cullingReference.h"
+#include "jobSystem.h"
+#include "sceneBvh.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	const uint32_t rayCount = 1000;
+
+	// Boxes at a constant density in a cube that grows with the count, so every size sees about the same fraction
+	// visible and the same number of boxes along each ray.
+	float getSceneSize(uint32_t count) {
+		return 10.0f * std::cbrt(static_cast<float>(count));
+	}
+
+	std::vector<Aabb> makeBounds(uint32_t count) {
+		std::mt19937 random(1234);
+		float half = getSceneSize(count) * 0.5f;
+		std::uniform_real_distribution<float> position(-half, half);
+		std::uniform_real_distribution<float> extent(0.25f, 1.0f);
+
+		std::vector<Aabb> bounds(count);
+		for (Aabb& box : bounds) {
+			glm::vec3 centre(position(random), position(random), position(random));
+			glm::vec3 size(extent(random), extent(random), extent(random));
+			box.grow(centre - size);
+			box.grow(centre + size);
+		}
+		return bounds;
+	}
+
+	// The same corner test the BVH applies to its leaves, one box at a time.
+	bool isBoxVisible(const glm::vec4 planes[6], const Aabb& box) {
+		for (int i = 0; i < 6; ++i) {
+			glm::vec3 positive(planes[i].x >= 0.0f ? box.max.x : box.min.x, planes[i].y >= 0.0f ? box.max.y : box.min.y,
+				planes[i].z >= 0.0f ? box.max.z : box.min.z);
+			if (glm::dot(glm::vec3(planes[i]), positive) + planes[i].w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	float rayBoxEntry(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const Aabb& box) {
+		glm::vec3 t0 = (box.min - origin) * inverseDirection;
+		glm::vec3 t1 = (box.max - origin) * inverseDirection;
+		glm::vec3 nearest = glm::min(t0, t1);
+		glm::vec3 furthest = glm::max(t0, t1);
+		float entry = std::max(std::max(nearest.x, nearest.y), std::max(nearest.z, 0.0f));
+		float exit = std::min(std::min(furthest.x, furthest.y), std::min(furthest.z, maxDistance));
+		return entry <= exit ? entry : FLT_MAX;
+	}
+
+	bool isSphereOverlapping(const glm::vec3& centre, float radius, const Aabb& box) {
+		glm::vec3 offset = centre - glm::clamp(centre, box.min, box.max);
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	// The rays and spheres every size is queried with.
+	struct Queries {
+		glm::vec4 planes[6];
+		std::vector<glm::vec3> directions;
+		float size;
+		float sphereRadius = 5.0f;
+
+		glm::vec3 sphereCentre(uint32_t i) const { return directions[i] * size * 0.25f; }
+	};
+
+	Queries makeQueries(uint32_t count) {
+		Queries queries;
+		queries.size = getSceneSize(count);
+
+		// A camera in the middle looking down -z, seeing a quarter of the way to the edge.
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, queries.size * 0.25f);
+		extractFrustumPlanes(projection * view, queries.planes);
+
+		// Rays from the centre in every direction; the spheres sit a quarter of the way along them.
+		std::mt19937 random(99);
+		std::normal_distribution<float> axis(0.0f, 1.0f);
+		queries.directions.resize(rayCount);
+		for (glm::vec3& direction : queries.directions) {
+			direction = glm::normalize(glm::vec3(axis(random), axis(random), axis(random)));
+		}
+		return queries;
+	}
+
+	// Every query type against testing every box. Only the brute force side is limited to a few rays and spheres at
+	// the larger sizes, where it is the slow part.
+	int checkQueries(const SceneBvh& bvh, const std::vector<Aabb>& bounds, const Queries& queries) {
+		uint32_t count = static_cast<uint32_t>(bounds.size());
+		int errors = 0;
+
+		std::vector<uint32_t> visible;
+		bvh.queryFrustum(queries.planes, visible);
+		std::vector<uint32_t> expected;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (isBoxVisible(queries.planes, bounds[i])) {
+				expected.push_back(i);
+			}
+		}
+		std::sort(visible.begin(), visible.end());
+		errors += visible == expected ? 0 : 1;
+
+		uint32_t checked = std::max(10u, std::min(rayCount, 100000000u / count));
+		for (uint32_t i = 0; i < checked; ++i) {
+			BvhRayHit hit;
+			bvh.raycast(glm::vec3(0.0f), queries.directions[i], queries.size, hit);
+			glm::vec3 inverseDirection = 1.0f / queries.directions[i];
+			float closest = FLT_MAX;
+			for (const Aabb& box : bounds) {
+				closest = std::min(closest, rayBoxEntry(glm::vec3(0.0f), inverseDirection, queries.size, box));
+			}
+			errors += closest == hit.distance ? 0 : 1;
+
+			std::vector<uint32_t> overlapping;
+			bvh.querySphere(queries.sphereCentre(i), queries.sphereRadius, overlapping);
+			std::sort(overlapping.begin(), overlapping.end());
+			expected.clear();
+			for (uint32_t j = 0; j < count; ++j) {
+				if (isSphereOverlapping(queries.sphereCentre(i), queries.sphereRadius, bounds[j])) {
+					expected.push_back(j);
+				}
+			}
+			errors += overlapping == expected ? 0 : 1;
+		}
+		return errors;
+	}
+
+	// Build and every query, then local motion and a refit, each checked against testing every box.
+	int benchCount(JobSystem& jobSystem, uint32_t count) {
+		std::vector<Aabb> bounds = makeBounds(count);
+		Queries queries = makeQueries(count);
+		uint32_t repetitions = std::max(1u, 2000000u / count);
+
+		SceneBvh bvh;
+		double build = bestOfMicroseconds(repetitions, [&]() { bvh.build(jobSystem, bounds); });
+
+		std::vector<uint32_t> visible;
+		visible.reserve(count);
+		double frustum = bestOfMicroseconds(repetitions * 4, [&]() {
+			visible.clear();
+			bvh.queryFrustum(queries.planes, visible);
+		});
+		double visibleFraction = static_cast<double>(visible.size()) / count;
+		std::vector<uint32_t> expected;
+		expected.reserve(count);
+		double bruteFrustum = bestOfMicroseconds(repetitions, [&]() {
+			expected.clear();
+			for (uint32_t i = 0; i < count; ++i) {
+				if (isBoxVisible(queries.planes, bounds[i])) {
+					expected.push_back(i);
+				}
+			}
+		});
+
+		BvhRayHit hit;
+		double rays = bestOfMicroseconds(3, [&]() {
+			for (uint32_t i = 0; i < rayCount; ++i) {
+				bvh.raycast(glm::vec3(0.0f), queries.directions[i], queries.size, hit);
+			}
+		});
+		std::vector<uint32_t> overlapping;
+		double spheres = bestOfMicroseconds(3, [&]() {
+			for (uint32_t i = 0; i < rayCount; ++i) {
+				overlapping.clear();
+				bvh.querySphere(queries.sphereCentre(i), queries.sphereRadius, overlapping);
+			}
+		});
+		int errors = checkQueries(bvh, bounds, queries);
+
+		// Every box moves up to a box size, the kind of motion refit is meant for, and the queries must still match.
+		std::mt19937 random(4321);
+		std::uniform_real_distribution<float> motion(-1.0f, 1.0f);
+		for (Aabb& box : bounds) {
+			glm::vec3 offset(motion(random), motion(random), motion(random));
+			box.min += offset;
+			box.max += offset;
+		}
+		double refit = bestOfMicroseconds(repetitions, [&]() { bvh.refit(bounds); });
+		errors += checkQueries(bvh, bounds, queries);
+
+		std::printf("- %u boxes, %u nodes: build %.1f ms (%.1f M boxes/s), refit %.1f ms, frustum %.1f us against %.1f us brute force "
+			"(%.1f%% visible), %.2f us per ray, %.2f us per sphere\n", count, static_cast<uint32_t>(bvh.getNodes().size()), build / 1000.0,
+			count / build, refit / 1000.0, frustum, bruteFrustum, 100.0 * visibleFraction, rays / rayCount, spheres / rayCount);
+		return errors;
+	}
+}
+
+int benchSceneBvh() {
+	JobSystem jobSystem(std::max(2u, std::thread::hardware_concurrency()) - 1);
+	int errors = 0;
+	for (uint32_t count : { 10000u, 100000u, 1000000u, 10000000u }) {
+		errors += benchCount(jobSystem, count);
+	}
+	return errors;
+}
@@ -0,0 +1,197 @@
+#include "assetCooker.h"
+#include "meshFile.h"
+#include "mipChainFile.h"
+#include "tests.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+	std::filesystem::path getCookerPath(const char* name) {
+		return std::filesystem::temp_directory_path() / "rendererTests" / "cooker" / name;
+	}
+
+	void writeText(const std::filesystem::path& path, const std::string& text) {
+		std::filesystem::create_directories(path.parent_path());
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << text;
+	}
+
+	std::string readText(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void appendBigEndian(std::string& bytes, uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			bytes.push_back(static_cast<char>(value >> shift));
+		}
+	}
+
+	// A 2x2 RGBA8 PNG: one unfiltered stored deflate block, zero CRCs and Adler-32, none of which the decoder checks.
+	std::string makePng(uint8_t shade) {
+		std::string rows;
+		for (int y = 0; y < 2; ++y) {
+			rows += '\0';
+			rows += std::string(8, static_cast<char>(shade));
+		}
+		std::string stream = { 0x78, 0x01, 0x01, static_cast<char>(rows.size()), 0, static_cast<char>(~rows.size()), static_cast<char>(0xFF) };
+		stream += rows + std::string(4, '\0');
+
+		std::string png = "\x89PNG\r\n\x1A\n";
+		auto appendChunk = [&png](const char* type, const std::string& data) {
+			appendBigEndian(png, static_cast<uint32_t>(data.size()));
+			png += std::string(type, 4) + data;
+			appendBigEndian(png, 0);
+		};
+		std::string header;
+		appendBigEndian(header, 2);
+		appendBigEndian(header, 2);
+		header += std::string({ 8, 6, 0, 0, 0 });
+		appendChunk("IHDR", header);
+		appendChunk("IDAT", stream);
+		appendChunk("IEND", "");
+		return png;
+	}
+
+	const char* const triangleObj = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+	const char* const quadObj = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n";
+
+	// Three assets, and a glTF scene and a buffer the cooker leaves alone.
+	void writeSourceTree(const std::filesystem::path& source) {
+		writeText(source / "meshes/triangle.obj", triangleObj);
+		writeText(source / "meshes/quad.obj", quadObj);
+		writeText(source / "textures/grass tile.png", makePng(200));
+		writeText(source / "scenes/hall.gltf", "{\"asset\": {\"version\": \"2.0\"}}");
+		writeText(source / "scenes/hall.bin", "0123");
+	}
+
+	void touch(const std::filesystem::path& path) {
+		std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(2));
+	}
+
+	// Each run is a new cooker, as each launch of the tool is.
+	CookCounts cook(const std::filesystem::path& source, const std::filesystem::path& output, uint32_t version = assetCookerVersion, bool* succeeded = nullptr) {
+		CookOptions options;
+		options.sourceDirectory = source.string();
+		options.outputDirectory = output.string();
+		options.cacheDirectory = getCookerPath("cache").string();
+		options.workerThreads = 1;
+		options.cookerVersion = version;
+		AssetCooker cooker(options);
+		bool result = cooker.run();
+		if (succeeded) {
+			*succeeded = result;
+		}
+		return cooker.getCounts();
+	}
+
+	bool countsAre(const CookCounts& counts, uint32_t upToDate, uint32_t fromCache, uint32_t cooked, uint32_t failed = 0, uint32_t removed = 0) {
+		return counts.upToDate == upToDate && counts.fromCache == fromCache && counts.cooked == cooked && counts.failed == failed && counts.removed == removed;
+	}
+
+	int testCookAndSkip() {
+		int errors = 0;
+		std::filesystem::path source = getCookerPath("source");
+		std::filesystem::path output = getCookerPath("output");
+		writeSourceTree(source);
+
+		errors += EXPECT(countsAre(cook(source, output), 0, 0, 3));
+		errors += EXPECT(std::filesystem::exists(output / "meshes/triangle.mesh"));
+		errors += EXPECT(!std::filesystem::exists(output / "scenes/hall.mesh"));
+		MeshFile mesh;
+		mesh.open((output / "meshes/quad.mesh").string());
+		errors += EXPECT(mesh.getHeader().indexCount == 6u);
+		MipChainFile chain;
+		chain.open((output / "textures/grass tile.mips").string());
+		errors += EXPECT(chain.getFormat() == VK_FORMAT_R8G8B8A8_UNORM && chain.getLevelCount() == 2u);
+		errors += EXPECT(chain.getLevelData(1)[0] == 200);
+		chain.close();
+		mesh.close();
+
+		// The manifest records every asset, including a path with a space, and the next run reads it back.
+		std::string manifest = readText(output / "cook.manifest");
+		errors += EXPECT(manifest.find("AssetCooker manifest " + std::to_string(assetCookerVersion) + "\n") == 0);
+		errors += EXPECT(manifest.find(" textures/grass tile.png\n") != std::string::npos);
+		errors += EXPECT(manifest.find("hall") == std::string::npos);
+		errors += EXPECT(countsAre(cook(source, output), 3, 0, 0));
+
+		// A newer stamp with the same bytes is hashed again and found in the cache; new bytes are cooked.
+		touch(source / "meshes/triangle.obj");
+		errors += EXPECT(countsAre(cook(source, output), 2, 1, 0));
+		writeText(source / "meshes/triangle.obj", "v 0 0 0\nv 2 0 0\nv 0 2 0\nf 1 2 3\n");
+		touch(source / "meshes/triangle.obj");
+		errors += EXPECT(countsAre(cook(source, output), 2, 0, 1));
+		mesh.open((output / "meshes/triangle.mesh").string());
+		const MeshVertex* vertices = reinterpret_cast<const MeshVertex*>(mesh.getStreamData(MeshStream::Vertices));
+		errors += EXPECT(mesh.getHeader().vertexCount == 3u && (vertices[1].position[0] == 2.0f || vertices[2].position[0] == 2.0f));
+		mesh.close();
+
+		// A missing output is restored from the cache.
+		std::filesystem::remove(output / "meshes/quad.mesh");
+		errors += EXPECT(countsAre(cook(source, output), 2, 1, 0));
+		errors += EXPECT(std::filesystem::exists(output / "meshes/quad.mesh"));
+		return errors;
+	}
+
+	int testManifestAndCache() {
+		int errors = 0;
+		std::filesystem::path source = getCookerPath("source");
+		std::filesystem::path output = getCookerPath("output");
+
+		// Another tree with the same files shares the cache, so nothing is cooked.
+		std::filesystem::path copy = getCookerPath("copy");
+		writeSourceTree(copy);
+		writeText(copy / "meshes/triangle.obj", readText(source / "meshes/triangle.obj"));
+		errors += EXPECT(countsAre(cook(copy, getCookerPath("copyOutput")), 0, 3, 0));
+
+		// A manifest that doesn't parse only costs the hashing.
+		writeText(output / "cook.manifest", "AssetCooker manifest " + std::to_string(assetCookerVersion) + "\nasset 9 nonsense\ninput x y\n");
+		errors += EXPECT(countsAre(cook(source, output), 0, 3, 0));
+		errors += EXPECT(countsAre(cook(source, output), 3, 0, 0));
+
+		// A new cooker version ignores the manifest and every key it made.
+		errors += EXPECT(countsAre(cook(source, output, assetCookerVersion + 1), 0, 0, 3));
+		errors += EXPECT(countsAre(cook(source, output, assetCookerVersion + 1), 3, 0, 0));
+		errors += EXPECT(countsAre(cook(source, output), 0, 3, 0));
+		return errors;
+	}
+
+	int testFailuresAndStaleOutputs() {
+		int errors = 0;
+		std::filesystem::path source = getCookerPath("source");
+		std::filesystem::path output = getCookerPath("output");
+
+		// A broken asset fails alone and stays out of the manifest, so it is retried.
+		writeText(source / "textures/broken.png", "not a png");
+		bool succeeded = true;
+		errors += EXPECT(countsAre(cook(source, output, assetCookerVersion, &succeeded), 3, 0, 0, 1));
+		errors += EXPECT(!succeeded);
+		errors += EXPECT(readText(output / "cook.manifest").find("broken") == std::string::npos);
+		errors += EXPECT(countsAre(cook(source, output, assetCookerVersion, &succeeded), 3, 0, 0, 1));
+
+		// Once a source is gone, so is its output.
+		std::filesystem::remove(source / "textures/broken.png");
+		std::filesystem::remove(source / "meshes/quad.obj");
+		errors += EXPECT(countsAre(cook(source, output, assetCookerVersion, &succeeded), 2, 0, 0, 0, 1));
+		errors += EXPECT(succeeded);
+		errors += EXPECT(!std::filesystem::exists(output / "meshes/quad.mesh"));
+		errors += EXPECT(std::filesystem::exists(output / "meshes/triangle.mesh"));
+		return errors;
+	}
+}
+
+int testAssetCooker() {
+	int errors = 0;
+	std::filesystem::remove_all(getCookerPath(""));
+	errors += testCookAndSkip();
+	errors += testManifestAndCache();
+	errors += testFailuresAndStaleOutputs();
+	std::filesystem::remove_all(getCookerPath(""));
+	return errors;
+}
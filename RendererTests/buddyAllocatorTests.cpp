@@ -0,0 +1,112 @@
+#include "buddyAllocator.h"
+#include "tests.h"
+
+#include <vector>
+
+namespace {
+
+	int testSplit() {
+		int errors = 0;
+		BuddyAllocator buddy(1024, 64);
+
+		// The first allocation splits the range all the way down; each later one takes the lowest free buddy.
+		errors += EXPECT(buddy.allocate(64, 1) == 0u);
+		errors += EXPECT(buddy.allocate(64, 1) == 64u);
+		errors += EXPECT(buddy.allocate(128, 1) == 128u);
+		errors += EXPECT(buddy.allocate(256, 1) == 256u);
+		errors += EXPECT(buddy.allocate(512, 1) == 512u);
+		errors += EXPECT(buddy.getUsedSize() == 1024u);
+		errors += EXPECT(buddy.getAllocationCount() == 5u);
+		errors += EXPECT(buddy.allocationSize(128) == 128u);
+		errors += EXPECT(buddy.allocationSize(96) == 0u);
+		return errors;
+	}
+
+	int testMerge() {
+		int errors = 0;
+		BuddyAllocator buddy(1024, 64);
+
+		std::vector<uint64_t> offsets;
+		for (uint32_t i = 0; i < 16; ++i) {
+			offsets.push_back(buddy.allocate(64, 1).value());
+		}
+
+		// Freeing every other block leaves no two free buddies, so nothing larger than 64 fits.
+		for (uint32_t i = 0; i < 16; i += 2) {
+			buddy.free(offsets[i]);
+		}
+		errors += EXPECT(!buddy.allocate(128, 1).has_value());
+
+		// Freeing the rest merges all the way back to the whole range.
+		for (uint32_t i = 1; i < 16; i += 2) {
+			buddy.free(offsets[i]);
+		}
+		errors += EXPECT(buddy.isEmpty());
+		errors += EXPECT(buddy.getUsedSize() == 0u);
+		errors += EXPECT(buddy.allocate(1024, 1) == 0u);
+		return errors;
+	}
+
+	int testAlignment() {
+		int errors = 0;
+		BuddyAllocator buddy(4096, 64);
+
+		errors += EXPECT(buddy.blockSizeFor(100, 1) == 128u);
+		errors += EXPECT(buddy.blockSizeFor(1, 1) == 64u);
+		errors += EXPECT(buddy.blockSizeFor(64, 512) == 512u);
+
+		// A small allocation first, so an aligned one can't simply land at zero.
+		buddy.allocate(64, 1);
+		uint64_t aligned = buddy.allocate(64, 512).value();
+		errors += EXPECT(aligned % 512 == 0);
+		errors += EXPECT(aligned != 0);
+		errors += EXPECT(buddy.allocationSize(aligned) == 512u);
+
+		uint64_t odd = buddy.allocate(100, 1).value();
+		errors += EXPECT(odd % 128 == 0);
+		errors += EXPECT(buddy.allocationSize(odd) == 128u);
+		return errors;
+	}
+
+	int testExhaustion() {
+		int errors = 0;
+		BuddyAllocator buddy(1024, 256);
+
+		errors += EXPECT(!buddy.allocate(2048, 1).has_value());
+		errors += EXPECT(!buddy.allocate(64, 2048).has_value());
+
+		for (uint32_t i = 0; i < 4; ++i) {
+			errors += EXPECT(buddy.allocate(1, 1).has_value());
+		}
+		errors += EXPECT(!buddy.allocate(1, 1).has_value());
+
+		// A freed block is reused in place.
+		buddy.free(512);
+		errors += EXPECT(buddy.allocate(200, 1) == 512u);
+		return errors;
+	}
+
+	int testMisuse() {
+		int errors = 0;
+		errors += EXPECT(throwsRuntimeError([]() { BuddyAllocator(1000, 64); }));
+		errors += EXPECT(throwsRuntimeError([]() { BuddyAllocator(1024, 48); }));
+		errors += EXPECT(throwsRuntimeError([]() { BuddyAllocator(64, 128); }));
+
+		BuddyAllocator buddy(1024, 64);
+		uint64_t offset = buddy.allocate(64, 1).value();
+		errors += EXPECT(throwsRuntimeError([&]() { buddy.free(offset + 64); }));
+		buddy.free(offset);
+		errors += EXPECT(throwsRuntimeError([&]() { buddy.free(offset); }));
+		return errors;
+	}
+}
+
+int testBuddyAllocator() {
+	int errors = 0;
+	errors += testSplit();
+	errors += testMerge();
+	errors += testAlignment();
+	errors += testExhaustion();
+	errors += testMisuse();
+	return errors;
+}
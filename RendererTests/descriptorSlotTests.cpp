@@ -0,0 +1,48 @@
+#include "bindlessDescriptors.h"
+#include "tests.h"
+
+namespace {
+
+	int testAllocation() {
+		int errors = 0;
+		DescriptorSlotAllocator slots(4);
+
+		for (uint32_t i = 0; i < 4; ++i) {
+			errors += EXPECT(slots.allocate() == i);
+		}
+		errors += EXPECT(slots.getUsedCount() == 4u);
+		errors += EXPECT(throwsRuntimeError([&]() { slots.allocate(); }));
+
+		// Freed slots come back most recent first, before the array grows.
+		slots.free(1);
+		slots.free(3);
+		errors += EXPECT(slots.getUsedCount() == 2u);
+		errors += EXPECT(slots.allocate() == 3u);
+		errors += EXPECT(slots.allocate() == 1u);
+		errors += EXPECT(slots.getUsedCount() == 4u);
+		return errors;
+	}
+
+	int testMisuse() {
+		int errors = 0;
+		DescriptorSlotAllocator slots(8);
+
+		uint32_t slot = slots.allocate();
+		errors += EXPECT(throwsRuntimeError([&]() { slots.free(5); }));
+		slots.free(slot);
+		errors += EXPECT(throwsRuntimeError([&]() { slots.free(slot); }));
+		errors += EXPECT(slots.getUsedCount() == 0u);
+
+		// Once handed out again the slot can be freed again.
+		errors += EXPECT(slots.allocate() == slot);
+		errors += EXPECT(!throwsRuntimeError([&]() { slots.free(slot); }));
+		return errors;
+	}
+}
+
+int testDescriptorSlotAllocator() {
+	int errors = 0;
+	errors += testAllocation();
+	errors += testMisuse();
+	return errors;
+}
@@ -0,0 +1,269 @@
+#include "cookedAssets.h"
+#include "gltfLoader.h"
+#include "jobSystem.h"
+#include "mipChainFile.h"
+#include "tests.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+	// A unit quad in the xy plane: four float positions, then six 16-bit indices.
+	const float quadPositions[] = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+	const uint16_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+	std::string getTestPath(const char* name) {
+		std::filesystem::path directory = std::filesystem::temp_directory_path() / "rendererTests";
+		std::filesystem::create_directories(directory);
+		return (directory / name).string();
+	}
+
+	void writeBytes(const std::string& path, const void* data, size_t size) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	}
+
+	std::vector<uint8_t> makeQuadBuffer() {
+		std::vector<uint8_t> buffer(sizeof(quadPositions) + sizeof(quadIndices));
+		memcpy(buffer.data(), quadPositions, sizeof(quadPositions));
+		memcpy(buffer.data() + sizeof(quadPositions), quadIndices, sizeof(quadIndices));
+		return buffer;
+	}
+
+	std::string encodeBase64(const std::vector<uint8_t>& bytes) {
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string out;
+		for (size_t i = 0; i < bytes.size(); i += 3) {
+			uint32_t chunk = bytes[i] << 16 | (i + 1 < bytes.size() ? bytes[i + 1] << 8 : 0) | (i + 2 < bytes.size() ? bytes[i + 2] : 0);
+			out.push_back(alphabet[chunk >> 18 & 63]);
+			out.push_back(alphabet[chunk >> 12 & 63]);
+			out.push_back(i + 1 < bytes.size() ? alphabet[chunk >> 6 & 63] : '=');
+			out.push_back(i + 2 < bytes.size() ? alphabet[chunk & 63] : '=');
+		}
+		return out;
+	}
+
+	// One mesh drawn by two nodes: a translated parent and its scaled child. bufferUri is left out for GLB.
+	std::string makeQuadDocument(const std::string& bufferUri, uint32_t positionCount = 4, const char* version = "2.0") {
+		std::string uri = bufferUri.empty() ? "" : "\"uri\": \"" + bufferUri + "\", ";
+		return std::string("{\"asset\": {\"version\": \"") + version + "\"},"
+			"\"buffers\": [{" + uri + "\"byteLength\": 60}],"
+			"\"bufferViews\": [{\"buffer\": 0, \"byteLength\": 48}, {\"buffer\": 0, \"byteOffset\": 48, \"byteLength\": 12}],"
+			"\"accessors\": ["
+				"{\"bufferView\": 0, \"componentType\": 5126, \"type\": \"VEC3\", \"count\": " + std::to_string(positionCount) + ", \"min\": [0, 0, 0], \"max\": [1, 1, 0]},"
+				"{\"bufferView\": 1, \"componentType\": 5123, \"type\": \"SCALAR\", \"count\": 6}],"
+			"\"meshes\": [{\"primitives\": [{\"attributes\": {\"POSITION\": 0}, \"indices\": 1}]}],"
+			"\"nodes\": [{\"mesh\": 0, \"translation\": [10, 0, 0], \"children\": [1]}, {\"mesh\": 0, \"scale\": [2, 2, 2]}],"
+			"\"scenes\": [{\"nodes\": [0]}]}";
+	}
+
+	std::vector<uint8_t> makeGlb(const std::string& json, const std::vector<uint8_t>& binary, uint32_t version = 2) {
+		std::string paddedJson = json + std::string((4 - json.size() % 4) % 4, ' ');
+		std::vector<uint8_t> paddedBinary = binary;
+		paddedBinary.resize((binary.size() + 3) & ~static_cast<size_t>(3), 0);
+		uint32_t header[] = { 0x46546C67, version, static_cast<uint32_t>(12 + 8 + paddedJson.size() + 8 + paddedBinary.size()) };
+		uint32_t jsonChunk[] = { static_cast<uint32_t>(paddedJson.size()), 0x4E4F534A };
+		uint32_t binChunk[] = { static_cast<uint32_t>(paddedBinary.size()), 0x004E4942 };
+
+		std::vector<uint8_t> glb;
+		auto append = [&glb](const void* data, size_t size) {
+			glb.insert(glb.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+		};
+		append(header, sizeof(header));
+		append(jsonChunk, sizeof(jsonChunk));
+		append(paddedJson.data(), paddedJson.size());
+		append(binChunk, sizeof(binChunk));
+		append(paddedBinary.data(), paddedBinary.size());
+		return glb;
+	}
+
+	// The layout after open, then the decoded geometry.
+	int checkQuadScene(GltfLoader& loader) {
+		int errors = 0;
+		errors += EXPECT(loader.getPrimitives().size() == 1u);
+		errors += EXPECT(loader.getPrimitives()[0].vertexCount == 4u);
+		errors += EXPECT(loader.getPrimitives()[0].indexCount == 6u);
+		errors += EXPECT(loader.getPrimitives()[0].material == gltfNone);
+		errors += EXPECT(loader.getImageCount() == 0u);
+
+		// The child inherits the parent's translation and adds its own scale.
+		const std::vector<GltfInstance>& instances = loader.getInstances();
+		errors += EXPECT(instances.size() == 2u);
+		uint32_t scaled = 0;
+		for (const GltfInstance& instance : instances) {
+			errors += EXPECT(instance.primitive == 0u);
+			errors += EXPECT(instance.transform[3][0] == 10.0f);
+			scaled += instance.transform[0][0] == 2.0f ? 1 : 0;
+		}
+		errors += EXPECT(scaled == 1u);
+		// Bounds come from the instances' spheres, so they hold both quads with room to spare.
+		errors += EXPECT(loader.getBoundsMin().x <= 10.0f && loader.getBoundsMax().x >= 12.0f && loader.getBoundsMax().y >= 2.0f);
+
+		JobSystem jobSystem(1);
+		JobCounter decodeJobs;
+		loader.decode(jobSystem, decodeJobs);
+		jobSystem.wait(decodeJobs);
+		errors += EXPECT(loader.isDecodeComplete());
+		std::vector<GltfReadyItem> ready = loader.takeReady();
+		errors += EXPECT(ready.size() == 1u && ready[0].kind == GltfReadyItem::Kind::Primitive && ready[0].index == 0u);
+
+		const MeshVertex* vertices = loader.getVertices(0);
+		for (uint32_t i = 0; i < 4; ++i) {
+			errors += EXPECT(memcmp(vertices[i].position, quadPositions + i * 3, sizeof(vertices[i].position)) == 0);
+			// No normals in the file, so they are generated: the quad faces +z.
+			errors += EXPECT(std::fabs(vertices[i].normal[2]) > 0.99f);
+			errors += EXPECT(vertices[i].uv[0] == 0.0f && vertices[i].uv[1] == 0.0f);
+		}
+		for (uint32_t i = 0; i < 6; ++i) {
+			errors += EXPECT(loader.getIndices(0)[i] == quadIndices[i]);
+		}
+
+		MeshData mesh = loader.toMeshData();
+		errors += EXPECT(mesh.vertices.size() == 4u && mesh.indices.size() == 6u && mesh.submeshes.size() == 1u);
+		return errors;
+	}
+
+	int testExternalBuffer() {
+		std::vector<uint8_t> buffer = makeQuadBuffer();
+		writeBytes(getTestPath("quad data.bin"), buffer.data(), buffer.size());
+		std::string document = makeQuadDocument("quad%20data.bin");
+		writeBytes(getTestPath("external.gltf"), document.data(), document.size());
+
+		GltfLoader loader;
+		loader.open(getTestPath("external.gltf"));
+		int errors = checkQuadScene(loader);
+		errors += EXPECT(loader.getExternalBufferPaths().size() == 1u);
+		return errors;
+	}
+
+	int testDataUri() {
+		std::string document = makeQuadDocument("data:application/octet-stream;base64," + encodeBase64(makeQuadBuffer()));
+		writeBytes(getTestPath("embedded.gltf"), document.data(), document.size());
+
+		GltfLoader loader;
+		loader.open(getTestPath("embedded.gltf"));
+		int errors = checkQuadScene(loader);
+		errors += EXPECT(loader.getExternalBufferPaths().empty());
+		return errors;
+	}
+
+	int testGlb() {
+		std::vector<uint8_t> glb = makeGlb(makeQuadDocument(""), makeQuadBuffer());
+		writeBytes(getTestPath("binary.glb"), glb.data(), glb.size());
+
+		GltfLoader loader;
+		loader.open(getTestPath("binary.glb"));
+		return checkQuadScene(loader);
+	}
+
+	// An image with a cooked mip chain is never decoded: here the source image doesn't even exist.
+	int testCookedImages() {
+		int errors = 0;
+		errors += EXPECT(getCookedAssetName("scenes/Hall.OBJ") == "scenes/Hall.mesh");
+		errors += EXPECT(getCookedAssetName("scenes/Hall.gltf").empty());
+		errors += EXPECT(getCookedAssetName("textures/wood.png") == "textures/wood.mips");
+		errors += EXPECT(getCookedAssetName("shaders/mesh.vert") == "shaders/mesh.vert.spv");
+		errors += EXPECT(getCookedAssetName("shaders/common.glsl").empty());
+
+		// Cooked paths are relative to the working directory, as the renderer runs from the cooker's source root.
+		std::filesystem::path previous = std::filesystem::current_path();
+		std::filesystem::current_path(std::filesystem::path(getTestPath("external.gltf")).parent_path());
+		std::string document = makeQuadDocument("quad%20data.bin");
+		document.insert(1, "\"images\": [{\"uri\": \"textures/missing.png\"}, {\"uri\": \"textures/uncooked.png\"}, {\"uri\": \"textures/blocks.png\"}], ");
+		writeBytes("cooked.gltf", document.data(), document.size());
+		std::filesystem::create_directories("cooked/textures");
+		writeMipChainFile("cooked/textures/missing.mips", VK_FORMAT_R8G8B8A8_UNORM, 1, 1, { { 1, 2, 3, 4 } });
+		writeMipChainFile("cooked/textures/blocks.mips", VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4, 4, { std::vector<uint8_t>(8) });
+		errors += EXPECT(findCookedAsset("cooked", "textures/missing.png") == (std::filesystem::path("cooked") / "textures/missing.mips").string());
+		errors += EXPECT(findCookedAsset("cooked", "textures/uncooked.png").empty());
+		errors += EXPECT(findCookedAsset("cooked", "../outside.png").empty());
+
+		// Which images are ready, and which still use their cooked chain. None of the sources exist, so an image
+		// that falls back to its source never becomes ready.
+		auto decodeCooked = [](const TextureFormatSupport& formats, std::vector<bool>& ready, std::vector<bool>& cooked) {
+			GltfLoader loader;
+			loader.open("cooked.gltf");
+			loader.setTextureFormats(formats);
+			loader.setCookedDirectory("cooked");
+			JobSystem jobSystem(1);
+			JobCounter decodeJobs;
+			loader.decode(jobSystem, decodeJobs);
+			jobSystem.wait(decodeJobs);
+			ready.assign(3, false);
+			cooked.assign(3, false);
+			for (const GltfReadyItem& item : loader.takeReady()) {
+				if (item.kind == GltfReadyItem::Kind::Image) {
+					ready[item.index] = true;
+				}
+			}
+			for (uint32_t i = 0; i < 3; ++i) {
+				cooked[i] = !loader.getCookedChainPath(i).empty();
+			}
+		};
+		std::vector<bool> ready;
+		std::vector<bool> cooked;
+		decodeCooked(allTextureFormats(), ready, cooked);
+		errors += EXPECT(ready == std::vector<bool>({ true, false, true }));
+		errors += EXPECT(cooked == std::vector<bool>({ true, false, true }));
+
+		// BC1 blocks the device can't sample: the loader goes back to the source rather than handing residency the chain.
+		decodeCooked(TextureFormatSupport(), ready, cooked);
+		errors += EXPECT(ready == std::vector<bool>({ true, false, false }));
+		errors += EXPECT(cooked == std::vector<bool>({ true, false, false }));
+		std::filesystem::current_path(previous);
+		return errors;
+	}
+
+	int testRejection() {
+		int errors = 0;
+		auto rejects = [](const std::string& name, const std::vector<uint8_t>& bytes) {
+			writeBytes(getTestPath(name.c_str()), bytes.data(), bytes.size());
+			return throwsRuntimeError([&]() {
+				GltfLoader loader;
+				loader.open(getTestPath(name.c_str()));
+			});
+		};
+		auto rejectsDocument = [&rejects](const std::string& document) {
+			return rejects("rejected.gltf", std::vector<uint8_t>(document.begin(), document.end()));
+		};
+		std::string dataUri = "data:application/octet-stream;base64," + encodeBase64(makeQuadBuffer());
+
+		errors += EXPECT(rejectsDocument("{\"asset\": {\"version\": \"2.0\"}"));
+		errors += EXPECT(rejectsDocument(makeQuadDocument(dataUri, 4, "1.0")));
+		// Five positions don't fit in the 48 byte view.
+		errors += EXPECT(rejectsDocument(makeQuadDocument(dataUri, 5)));
+		errors += EXPECT(rejectsDocument(makeQuadDocument("missing.bin")));
+		// A data URI shorter than the byteLength it claims.
+		errors += EXPECT(rejectsDocument(makeQuadDocument("data:application/octet-stream;base64," + encodeBase64(std::vector<uint8_t>(30)))));
+		errors += EXPECT(rejectsDocument(makeQuadDocument("data:text/plain,abc")));
+
+		std::string required = makeQuadDocument(dataUri);
+		required.insert(1, "\"extensionsRequired\": [\"KHR_draco_mesh_compression\"], ");
+		errors += EXPECT(rejectsDocument(required));
+
+		errors += EXPECT(rejects("version1.glb", makeGlb(makeQuadDocument(""), makeQuadBuffer(), 1)));
+		std::vector<uint8_t> truncated = makeGlb(makeQuadDocument(""), makeQuadBuffer());
+		truncated.resize(truncated.size() - 8);
+		errors += EXPECT(rejects("truncated.glb", truncated));
+		// A GLB buffer without a URI needs the binary chunk.
+		std::string document = makeQuadDocument("");
+		errors += EXPECT(rejectsDocument(document));
+		return errors;
+	}
+}
+
+int testGltfLoader() {
+	int errors = 0;
+	errors += testExternalBuffer();
+	errors += testDataUri();
+	errors += testGlb();
+	errors += testCookedImages();
+	errors += testRejection();
+	std::filesystem::remove_all(std::filesystem::temp_directory_path() / "rendererTests");
+	return errors;
+}
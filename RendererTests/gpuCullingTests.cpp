@@ -0,0 +1,180 @@
+#include "cullingReference.h"
+#include "tests.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+	// With an identity view projection world space is clip space: x and y in [-1, 1], z in [0, 1].
+	const glm::mat4 identity(1.0f);
+
+	CullInstance makeInstance(const glm::vec4& sphere, uint32_t mesh, uint32_t bucket) {
+		CullInstance instance{};
+		instance.transform = identity;
+		instance.boundingSphere = sphere;
+		instance.mesh = mesh;
+		instance.bucket = bucket;
+		return instance;
+	}
+
+	int testBuckets() {
+		int errors = 0;
+		std::vector<CullInstance> instances;
+		for (uint32_t bucket : { 0u, 2u, 0u, 2u, 2u }) {
+			instances.push_back(makeInstance(glm::vec4(0.0f, 0.0f, 0.5f, 0.1f), 0, bucket));
+		}
+
+		// Sized by what is in each bucket, not instances times buckets; an empty bucket gets an empty range.
+		std::vector<CullBucket> buckets = makeCullBuckets(instances, 3);
+		errors += EXPECT(buckets.size() == 3);
+		errors += EXPECT(buckets[0].firstCommand == 0 && buckets[0].capacity == 2);
+		errors += EXPECT(buckets[1].firstCommand == 2 && buckets[1].capacity == 0);
+		errors += EXPECT(buckets[2].firstCommand == 2 && buckets[2].capacity == 3);
+		errors += EXPECT(getCullCommandCount(buckets) == 5u);
+
+		errors += EXPECT(throwsRuntimeError([&]() { makeCullBuckets(instances, 2); }));
+		return errors;
+	}
+
+	int testFrustumCulling() {
+		int errors = 0;
+		std::vector<CullMesh> meshes = { { 3, 0, 0, 0 }, { 6, 3, 10, 0 } };
+		std::vector<CullInstance> instances = {
+			makeInstance(glm::vec4(0.0f, 0.0f, 0.5f, 0.1f), 0, 1), // Inside.
+			makeInstance(glm::vec4(3.0f, 0.0f, 0.5f, 0.1f), 0, 1), // Right of the frustum.
+			makeInstance(glm::vec4(1.05f, 0.0f, 0.5f, 0.1f), 1, 0), // Straddles the right plane.
+			makeInstance(glm::vec4(0.0f, 0.0f, -0.5f, 0.1f), 1, 0), // Behind the near plane.
+			makeInstance(glm::vec4(-0.5f, 0.5f, 0.9f, 0.2f), 1, 1), // Pokes through the far plane.
+		};
+		std::vector<CullBucket> buckets = makeCullBuckets(instances, 2);
+		CullView view = makeCullView(identity, static_cast<uint32_t>(instances.size()), 2);
+
+		CullResult result = cullInstancesReference(view, instances, meshes, buckets, nullptr);
+		errors += EXPECT((result.counts == std::vector<uint32_t>{ 1, 2 }));
+		errors += EXPECT(result.commands.size() == instances.size());
+
+		// Each bucket's commands start at its own range, in instance order, with the mesh's draw parameters.
+		const VkDrawIndexedIndirectCommand& straddling = result.commands[buckets[0].firstCommand];
+		errors += EXPECT(straddling.firstInstance == 2 && straddling.indexCount == 6 && straddling.firstIndex == 3);
+		errors += EXPECT(straddling.vertexOffset == 10 && straddling.instanceCount == 1);
+		errors += EXPECT(result.commands[buckets[1].firstCommand].firstInstance == 0);
+		errors += EXPECT(result.commands[buckets[1].firstCommand + 1].firstInstance == 4);
+
+		// Only the first instanceCount instances are tested.
+		view.instanceCount = 1;
+		errors += EXPECT((cullInstancesReference(view, instances, meshes, buckets, nullptr).counts == std::vector<uint32_t>{ 0, 1 }));
+		return errors;
+	}
+
+	int testHiZPyramid() {
+		int errors = 0;
+
+		// An odd width leaves a column over, which the last texel of the next level takes.
+		std::vector<float> row = { 0.1f, 0.2f, 0.3f, 0.9f, 0.4f };
+		errors += EXPECT(hiZLevelCount(5, 1) == 3u);
+		errors += EXPECT(hiZLevelOffset(5, 1, 1) == 5u && hiZLevelOffset(5, 1, 2) == 7u);
+		std::vector<float> pyramid = buildHiZPyramid(row, 5, 1);
+		errors += EXPECT((pyramid == std::vector<float>{ 0.1f, 0.2f, 0.3f, 0.9f, 0.4f, 0.2f, 0.9f, 0.9f }));
+
+		std::vector<float> block = { 0.5f, 0.25f, 0.75f, 0.5f, 1.0f, 0.0f };
+		errors += EXPECT(hiZLevelCount(3, 2) == 2u);
+		std::vector<float> blockPyramid = buildHiZPyramid(block, 3, 2);
+		errors += EXPECT(blockPyramid.size() == 7 && blockPyramid.back() == 1.0f);
+		return errors;
+	}
+
+	int testOcclusion() {
+		int errors = 0;
+		// An occluder at depth 0.2 covering the whole screen.
+		const uint32_t size = 16;
+		std::vector<float> pyramid = buildHiZPyramid(std::vector<float>(size * size, 0.2f), size, size);
+
+		CullView view = makeCullView(identity, 0, 1);
+		view.hiZLevels = hiZLevelCount(size, size);
+		view.hiZWidth = size;
+		view.hiZHeight = size;
+
+		glm::vec4 behind(0.0f, 0.0f, 0.5f, 0.1f);
+		glm::vec4 inFront(0.0f, 0.0f, 0.1f, 0.05f);
+		glm::vec4 crossing(0.0f, 0.0f, 0.25f, 0.1f);
+		errors += EXPECT(!isInstanceVisible(view, behind, pyramid.data()));
+		errors += EXPECT(isInstanceVisible(view, inFront, pyramid.data()));
+		errors += EXPECT(isInstanceVisible(view, crossing, pyramid.data()));
+
+		// No pyramid, or no levels, is frustum culling alone.
+		errors += EXPECT(isInstanceVisible(view, behind, nullptr));
+		view.hiZLevels = 0;
+		errors += EXPECT(isInstanceVisible(view, behind, pyramid.data()));
+
+		// A hole in the occluder lets what is behind it through, even when the hole is a single texel.
+		std::vector<float> depth(size * size, 0.2f);
+		depth[(size / 2) * size + size / 2] = 1.0f;
+		std::vector<float> holed = buildHiZPyramid(depth, size, size);
+		view.hiZLevels = hiZLevelCount(size, size);
+		errors += EXPECT(isInstanceVisible(view, behind, holed.data()));
+		return errors;
+	}
+
+	// At 800x600, level 5 is 25x18 and its last row covers rows 544-599, not 544-575. Scaling uv by the level size
+	// would read row 16 for an object on rows 546-564, so a hole under the object has to show through.
+	int testOcclusionNonPowerOfTwo() {
+		int errors = 0;
+		const uint32_t width = 800;
+		const uint32_t height = 600;
+		std::vector<float> depth(width * height, 0.2f);
+		std::vector<float> pyramid = buildHiZPyramid(depth, width, height);
+		for (uint32_t y = 544; y < height; ++y) {
+			std::fill(depth.begin() + y * width, depth.begin() + (y + 1) * width, 1.0f);
+		}
+		std::vector<float> holed = buildHiZPyramid(depth, width, height);
+
+		CullView view = makeCullView(identity, 0, 1);
+		view.hiZLevels = hiZLevelCount(width, height);
+		view.hiZWidth = width;
+		view.hiZHeight = height;
+
+		// 24x18 pixels around row 555, so the pyramid is read at level 5.
+		glm::vec4 sphere(0.0f, 0.85f, 0.5f, 0.03f);
+		errors += EXPECT(!isInstanceVisible(view, sphere, pyramid.data()));
+		errors += EXPECT(isInstanceVisible(view, sphere, holed.data()));
+		return errors;
+	}
+
+	int testCompareResults() {
+		int errors = 0;
+		std::vector<CullMesh> meshes = { { 3, 0, 0, 0 } };
+		std::vector<CullInstance> instances;
+		for (uint32_t i = 0; i < 4; ++i) {
+			instances.push_back(makeInstance(glm::vec4(0.0f, 0.0f, 0.5f, 0.1f), 0, i % 2));
+		}
+		std::vector<CullBucket> buckets = makeCullBuckets(instances, 2);
+		CullView view = makeCullView(identity, static_cast<uint32_t>(instances.size()), 2);
+		CullResult expected = cullInstancesReference(view, instances, meshes, buckets, nullptr);
+
+		// The GPU appends in whatever order its threads finish.
+		CullResult reordered = expected;
+		std::swap(reordered.commands[buckets[1].firstCommand], reordered.commands[buckets[1].firstCommand + 1]);
+		errors += EXPECT(compareCullResults(expected, reordered, buckets).empty());
+
+		CullResult wrongInstance = expected;
+		wrongInstance.commands[buckets[0].firstCommand].firstInstance = 1;
+		errors += EXPECT(!compareCullResults(expected, wrongInstance, buckets).empty());
+
+		CullResult wrongCount = expected;
+		wrongCount.counts[0] = 1;
+		errors += EXPECT(!compareCullResults(expected, wrongCount, buckets).empty());
+		return errors;
+	}
+}
+
+int testGpuCulling() {
+	int errors = 0;
+	errors += testBuckets();
+	errors += testFrustumCulling();
+	errors += testHiZPyramid();
+	errors += testOcclusion();
+	errors += testOcclusionNonPowerOfTwo();
+	errors += testCompareResults();
+	return errors;
+}
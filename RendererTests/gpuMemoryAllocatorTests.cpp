@@ -0,0 +1,129 @@
+#include "gpuMemoryAllocator.h"
+#include "tests.h"
+#include "vulkanStubs.h"
+
+#include <limits>
+#include <vector>
+
+namespace {
+
+	const VkDeviceSize MiB = 1024 * 1024;
+	const VkDeviceSize unlimited = std::numeric_limits<VkDeviceSize>::max();
+
+	// The stub's 4 GiB device local heap gets 256 MiB blocks. Fills the first with two halves, frees the second
+	// half and puts a quarter into a new block, which is then the one defragmentation should empty.
+	struct Fixture {
+		GpuMemoryAllocator allocator;
+		GpuAllocation* first = nullptr;
+		GpuAllocation* straggler = nullptr;
+
+		explicit Fixture(bool aliasedStraggler) {
+			allocator.init(VK_NULL_HANDLE, createStubDeviceProfile(), VK_NULL_HANDLE, false);
+			first = allocator.allocateForBuffer(createStubBuffer(128 * MiB, 256), MemoryUsage::GpuOnly);
+			GpuAllocation* second = allocator.allocateForBuffer(createStubBuffer(128 * MiB, 256), MemoryUsage::GpuOnly);
+			if (aliasedStraggler) {
+				VkMemoryRequirements requirements{ 64 * MiB, 256, ~0u };
+				straggler = allocator.allocateForAliasing(requirements, MemoryUsage::GpuOnly, true);
+			}
+			else {
+				straggler = allocator.allocateForBuffer(createStubBuffer(64 * MiB, 256), MemoryUsage::GpuOnly);
+			}
+			allocator.free(second);
+		}
+
+		~Fixture() {
+			allocator.free(first);
+			allocator.free(straggler);
+			allocator.destroy();
+		}
+	};
+
+	int testPlacement() {
+		int errors = 0;
+		{
+			Fixture fixture(false);
+			errors += EXPECT(fixture.first->offset == 0u);
+			errors += EXPECT(fixture.straggler->block != fixture.first->block);
+			errors += EXPECT(getStubDeviceMemoryCount() == 2u);
+
+			// More than half a block gets its own VkDeviceMemory.
+			GpuAllocation* large = fixture.allocator.allocateForBuffer(createStubBuffer(200 * MiB, 256), MemoryUsage::GpuOnly);
+			errors += EXPECT(large->block == nullptr);
+			errors += EXPECT(getStubDeviceMemoryCount() == 3u);
+			fixture.allocator.free(large);
+			errors += EXPECT(getStubDeviceMemoryCount() == 2u);
+		}
+		errors += EXPECT(getStubDeviceMemoryCount() == 0u);
+		return errors;
+	}
+
+	int testDefragmentation() {
+		int errors = 0;
+		Fixture fixture(false);
+
+		std::vector<DefragmentationMove> moves = fixture.allocator.planDefragmentation(unlimited);
+		errors += EXPECT(moves.size() == 1);
+		if (moves.size() != 1) {
+			return errors;
+		}
+		errors += EXPECT(moves[0].allocation == fixture.straggler);
+		errors += EXPECT(moves[0].dstBlock == fixture.first->block);
+		errors += EXPECT(moves[0].dstMemory == fixture.first->memory);
+		errors += EXPECT(moves[0].dstOffset == 128 * MiB);
+
+		// Nothing changes until the caller has rebound and copied the resource.
+		errors += EXPECT(fixture.straggler->block != fixture.first->block);
+
+		fixture.allocator.completeDefragmentation(moves);
+		errors += EXPECT(fixture.straggler->block == fixture.first->block);
+		errors += EXPECT(fixture.straggler->memory == fixture.first->memory);
+		errors += EXPECT(fixture.straggler->offset == 128 * MiB);
+		errors += EXPECT(fixture.first->block->placement.getUsedSize() == 192 * MiB);
+		return errors;
+	}
+
+	int testDefragmentationBudget() {
+		int errors = 0;
+		Fixture fixture(false);
+		errors += EXPECT(fixture.allocator.planDefragmentation(32 * MiB).empty());
+		std::vector<DefragmentationMove> moves = fixture.allocator.planDefragmentation(64 * MiB);
+		errors += EXPECT(moves.size() == 1);
+		fixture.allocator.cancelDefragmentation(moves);
+		return errors;
+	}
+
+	int testDefragmentationSkipsAliased() {
+		int errors = 0;
+		Fixture fixture(true);
+		errors += EXPECT(fixture.straggler->aliased);
+		errors += EXPECT(fixture.allocator.planDefragmentation(unlimited).empty());
+		return errors;
+	}
+
+	int testCancelDefragmentation() {
+		int errors = 0;
+		Fixture fixture(false);
+
+		std::vector<DefragmentationMove> moves = fixture.allocator.planDefragmentation(unlimited);
+		errors += EXPECT(moves.size() == 1);
+		fixture.allocator.cancelDefragmentation(moves);
+		errors += EXPECT(fixture.first->block->placement.getUsedSize() == 128 * MiB);
+
+		// The released destination is free again for the next allocation in that block.
+		GpuAllocation* reuse = fixture.allocator.allocateForBuffer(createStubBuffer(128 * MiB, 256), MemoryUsage::GpuOnly);
+		errors += EXPECT(reuse->block == fixture.first->block);
+		errors += EXPECT(reuse->offset == 128 * MiB);
+		fixture.allocator.free(reuse);
+		return errors;
+	}
+}
+
+int testGpuMemoryAllocator() {
+	int errors = 0;
+	errors += testPlacement();
+	errors += testDefragmentation();
+	errors += testDefragmentationBudget();
+	errors += testDefragmentationSkipsAliased();
+	errors += testCancelDefragmentation();
+	return errors;
+}
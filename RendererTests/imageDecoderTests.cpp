@@ -0,0 +1,284 @@
+#include "imageDecoder.h"
+#include "tests.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+	// Fixed Huffman codes: "abcabcabcabcabcd", where every repeat after the first is one overlapping match.
+	const uint8_t fixedStream[] = { 0x78, 0xDA, 0x4B, 0x4C, 0x4A, 0x4E, 0x44, 0x42, 0x29, 0x00, 0x34, 0x18, 0x06, 0x23 };
+
+	// Dynamic Huffman codes: makeDynamicText() at the highest compression level.
+	const uint8_t dynamicStream[] = {
+		0x78, 0xDA, 0x6D, 0xD1, 0x49, 0x12, 0x82, 0x40, 0x10, 0x44, 0xD1, 0xBD, 0xA7, 0xE0, 0x08, 0x56, 0xA6, 0x03, 0x7A, 0x1B, 0x45, 0x64,
+		0x08, 0x82, 0xFB, 0x2F, 0x15, 0x0B, 0xE9, 0x1A, 0xD8, 0xE5, 0xAF, 0xD5, 0x8B, 0xEE, 0x69, 0x98, 0xDB, 0xEA, 0x78, 0xAF, 0x1E, 0x87,
+		0x69, 0x59, 0xF2, 0x5D, 0x4F, 0x9D, 0x58, 0x66, 0xA3, 0x9B, 0xBF, 0xFD, 0xD2, 0x38, 0x69, 0xB4, 0x5A, 0xE7, 0xB5, 0xDE, 0x9A, 0x97,
+		0x7F, 0x76, 0xDA, 0xD7, 0xAD, 0x7B, 0x3D, 0xD4, 0xE5, 0x30, 0xE8, 0xE5, 0x66, 0x2E, 0xE3, 0xCA, 0x30, 0x22, 0x43, 0x12, 0x6B, 0x12,
+		0x87, 0x12, 0xAF, 0x92, 0xC0, 0x92, 0xE8, 0x92, 0x04, 0x93, 0x2C, 0x93, 0x1D, 0x1A, 0x0A, 0x0D, 0xF6, 0xB5, 0x2C, 0x0D, 0x8E, 0x06,
+		0x4F, 0x43, 0xA0, 0x21, 0xD2, 0x90, 0x68, 0xC8, 0x34, 0xEC, 0xD0, 0x58, 0x68, 0x34, 0x34, 0xBA, 0x9F, 0x74, 0x34, 0x7A, 0x1A, 0x03,
+		0x8D, 0x91, 0xC6, 0x44, 0x63, 0xA6, 0xD1, 0xD3, 0x3E, 0x61, 0x5D, 0xBA, 0xE1
+	};
+
+	std::string makeDynamicText() {
+		std::string text;
+		for (int i = 0; i < 40; ++i) {
+			text += "line " + std::to_string(i) + ": " + std::string("abcdefghij").substr(0, i % 10 + 1) + "\n";
+		}
+		return text;
+	}
+
+	// A zlib stream of stored blocks, at most blockSize bytes each. The Adler-32 trailer is left zero; inflate
+	// doesn't read it.
+	std::vector<uint8_t> storeZlib(const std::vector<uint8_t>& data, size_t blockSize = 65535) {
+		std::vector<uint8_t> stream = { 0x78, 0x01 };
+		size_t offset = 0;
+		do {
+			size_t length = std::min(blockSize, data.size() - offset);
+			bool last = offset + length == data.size();
+			stream.push_back(last ? 1 : 0);
+			stream.push_back(static_cast<uint8_t>(length));
+			stream.push_back(static_cast<uint8_t>(length >> 8));
+			stream.push_back(static_cast<uint8_t>(~length));
+			stream.push_back(static_cast<uint8_t>(~length >> 8));
+			stream.insert(stream.end(), data.begin() + offset, data.begin() + offset + length);
+			offset += length;
+		} while (offset < data.size());
+		stream.insert(stream.end(), 4, 0);
+		return stream;
+	}
+
+	std::vector<uint8_t> inflate(const uint8_t* data, size_t size) {
+		std::vector<uint8_t> out;
+		inflateZlib(data, size, out);
+		return out;
+	}
+
+	bool rejectsStream(const std::vector<uint8_t>& stream) {
+		return throwsRuntimeError([&]() { inflate(stream.data(), stream.size()); });
+	}
+
+	void appendBigEndian(std::vector<uint8_t>& bytes, uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			bytes.push_back(static_cast<uint8_t>(value >> shift));
+		}
+	}
+
+	// CRCs are left zero, since the decoder doesn't check them.
+	void appendChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+		appendBigEndian(png, static_cast<uint32_t>(data.size()));
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		appendBigEndian(png, 0);
+	}
+
+	struct PngHeader {
+		uint32_t width;
+		uint32_t height;
+		uint8_t bitDepth;
+		uint8_t colorType;
+		uint8_t interlace = 0;
+	};
+
+	// rows are already filtered: a filter type byte, then the row's bytes.
+	std::vector<uint8_t> makePng(const PngHeader& header, const std::vector<uint8_t>& rows, const std::vector<std::pair<const char*, std::vector<uint8_t>>>& extraChunks = {}) {
+		std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		std::vector<uint8_t> ihdr;
+		appendBigEndian(ihdr, header.width);
+		appendBigEndian(ihdr, header.height);
+		ihdr.insert(ihdr.end(), { header.bitDepth, header.colorType, 0, 0, header.interlace });
+		appendChunk(png, "IHDR", ihdr);
+		for (const auto& chunk : extraChunks) {
+			appendChunk(png, chunk.first, chunk.second);
+		}
+		// Split across two IDAT chunks, which the decoder has to join.
+		std::vector<uint8_t> stream = storeZlib(rows);
+		size_t half = stream.size() / 2;
+		appendChunk(png, "IDAT", std::vector<uint8_t>(stream.begin(), stream.begin() + half));
+		appendChunk(png, "IDAT", std::vector<uint8_t>(stream.begin() + half, stream.end()));
+		appendChunk(png, "IEND", {});
+		return png;
+	}
+
+	uint8_t paethPredictor(int left, int up, int upLeft) {
+		int estimate = left + up - upLeft;
+		int distanceLeft = std::abs(estimate - left);
+		int distanceUp = std::abs(estimate - up);
+		int distanceUpLeft = std::abs(estimate - upLeft);
+		return static_cast<uint8_t>(distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft ? left : distanceUp <= distanceUpLeft ? up : upLeft);
+	}
+
+	// Filters row y of an RGBA8 image with the given PNG filter type, the encoder's side of what decodePng undoes.
+	std::vector<uint8_t> filterRow(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t y, uint8_t filter) {
+		size_t stride = static_cast<size_t>(width) * 4;
+		const uint8_t* current = pixels.data() + y * stride;
+		std::vector<uint8_t> row = { filter };
+		for (size_t x = 0; x < stride; ++x) {
+			int left = x >= 4 ? current[x - 4] : 0;
+			int up = y > 0 ? current[x - stride] : 0;
+			int upLeft = y > 0 && x >= 4 ? current[x - stride - 4] : 0;
+			int predicted = 0;
+			switch (filter) {
+				case 1: predicted = left; break;
+				case 2: predicted = up; break;
+				case 3: predicted = (left + up) >> 1; break;
+				case 4: predicted = paethPredictor(left, up, upLeft); break;
+			}
+			row.push_back(static_cast<uint8_t>(current[x] - predicted));
+		}
+		return row;
+	}
+
+	int testInflate() {
+		int errors = 0;
+		std::vector<uint8_t> fixed = inflate(fixedStream, sizeof(fixedStream));
+		errors += EXPECT(std::string(fixed.begin(), fixed.end()) == "abcabcabcabcabcd");
+
+		std::vector<uint8_t> dynamic = inflate(dynamicStream, sizeof(dynamicStream));
+		errors += EXPECT(std::string(dynamic.begin(), dynamic.end()) == makeDynamicText());
+
+		// Stored blocks, including an empty one and a split across several.
+		std::vector<uint8_t> data(1000);
+		for (size_t i = 0; i < data.size(); ++i) {
+			data[i] = static_cast<uint8_t>(i * 31 + 7);
+		}
+		std::vector<uint8_t> stored = storeZlib(data, 300);
+		errors += EXPECT(inflate(stored.data(), stored.size()) == data);
+		std::vector<uint8_t> empty = storeZlib({});
+		errors += EXPECT(inflate(empty.data(), empty.size()).empty());
+
+		// Output is appended to what the vector already holds.
+		std::vector<uint8_t> out = { 'x' };
+		inflateZlib(fixedStream, sizeof(fixedStream), out);
+		errors += EXPECT(out.size() == 17u && out[0] == 'x' && out[1] == 'a');
+		return errors;
+	}
+
+	int testInflateErrors() {
+		int errors = 0;
+		std::vector<uint8_t> valid(fixedStream, fixedStream + sizeof(fixedStream));
+
+		errors += EXPECT(rejectsStream({}));
+		errors += EXPECT(rejectsStream({ 0x78 }));
+		// Not deflate, a failing header check, and a preset dictionary.
+		errors += EXPECT(rejectsStream({ 0x79, 0xDA, 0x03, 0x00 }));
+		errors += EXPECT(rejectsStream({ 0x78, 0xDB, 0x03, 0x00 }));
+		errors += EXPECT(rejectsStream({ 0x78, 0xBB, 0x03, 0x00 }));
+		// Block type 3 is reserved.
+		errors += EXPECT(rejectsStream({ 0x78, 0x01, 0x07 }));
+		// A stored block whose length check doesn't match, and one longer than the data left.
+		errors += EXPECT(rejectsStream({ 0x78, 0x01, 0x01, 0x02, 0x00, 0x00, 0x00, 'a', 'b' }));
+		errors += EXPECT(rejectsStream({ 0x78, 0x01, 0x01, 0x08, 0x00, 0xF7, 0xFF, 'a', 'b' }));
+		// Cut short inside the compressed data.
+		errors += EXPECT(rejectsStream(std::vector<uint8_t>(valid.begin(), valid.begin() + 6)));
+		errors += EXPECT(rejectsStream(std::vector<uint8_t>(dynamicStream, dynamicStream + 60)));
+		// A fixed block that opens with a match: there is nothing before it to copy from.
+		errors += EXPECT(rejectsStream({ 0x78, 0x01, 0x03, 0x02, 0x00, 0x00 }));
+		return errors;
+	}
+
+	int testPngRgba() {
+		int errors = 0;
+		// Five rows, one per filter type, of colours that make every filter's prediction matter.
+		const uint32_t width = 3;
+		const uint32_t height = 5;
+		std::vector<uint8_t> pixels(width * height * 4);
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			pixels[i] = static_cast<uint8_t>(i * 53 + (i / 7) * 11);
+		}
+		std::vector<uint8_t> rows;
+		for (uint32_t y = 0; y < height; ++y) {
+			std::vector<uint8_t> row = filterRow(pixels, width, y, static_cast<uint8_t>(y));
+			rows.insert(rows.end(), row.begin(), row.end());
+		}
+
+		std::vector<uint8_t> png = makePng({ width, height, 8, 6 }, rows);
+		DecodedImage image = decodePng(png.data(), png.size());
+		errors += EXPECT(image.width == width && image.height == height);
+		errors += EXPECT(image.pixels == pixels);
+
+		// decodeImage finds the format itself.
+		errors += EXPECT(detectImageFormat(png.data(), png.size()) == ImageFileFormat::Png);
+		errors += EXPECT(decodeImage(png.data(), png.size()).pixels == pixels);
+		return errors;
+	}
+
+	int testPngConversions() {
+		int errors = 0;
+
+		// RGB: opaque alpha is added.
+		std::vector<uint8_t> rgb = makePng({ 2, 1, 8, 2 }, { 0, 10, 20, 30, 40, 50, 60 });
+		DecodedImage image = decodePng(rgb.data(), rgb.size());
+		errors += EXPECT(image.pixels == std::vector<uint8_t>({ 10, 20, 30, 255, 40, 50, 60, 255 }));
+
+		// Gray with alpha.
+		std::vector<uint8_t> grayAlpha = makePng({ 2, 1, 8, 4 }, { 0, 100, 200, 50, 25 });
+		image = decodePng(grayAlpha.data(), grayAlpha.size());
+		errors += EXPECT(image.pixels == std::vector<uint8_t>({ 100, 100, 100, 200, 50, 50, 50, 25 }));
+
+		// 16-bit gray keeps the high byte, and tRNS makes the matching 16-bit value transparent.
+		std::vector<uint8_t> gray16 = makePng({ 2, 1, 16, 0 }, { 0, 0x12, 0x34, 0xAB, 0xCD }, { { "tRNS", { 0xAB, 0xCD } } });
+		image = decodePng(gray16.data(), gray16.size());
+		errors += EXPECT(image.pixels == std::vector<uint8_t>({ 0x12, 0x12, 0x12, 255, 0xAB, 0xAB, 0xAB, 0 }));
+
+		// 2-bit palette, packed most significant bits first, with alpha for the first two entries from tRNS.
+		std::vector<uint8_t> palette = { 255, 0, 0, 0, 255, 0, 0, 0, 255, 255, 255, 255 };
+		std::vector<uint8_t> indexed = makePng({ 5, 1, 2, 3 }, { 0, 0x1B, 0x80 }, { { "PLTE", palette }, { "tRNS", { 128, 64 } } });
+		image = decodePng(indexed.data(), indexed.size());
+		errors += EXPECT(image.pixels == std::vector<uint8_t>({ 255, 0, 0, 128, 0, 255, 0, 64, 0, 0, 255, 255, 255, 255, 255, 255, 0, 0, 255, 255 }));
+
+		// 1-bit gray scales to the full range.
+		std::vector<uint8_t> bits = makePng({ 3, 1, 1, 0 }, { 0, 0xA0 });
+		image = decodePng(bits.data(), bits.size());
+		errors += EXPECT(image.pixels == std::vector<uint8_t>({ 255, 255, 255, 255, 0, 0, 0, 255, 255, 255, 255, 255 }));
+		return errors;
+	}
+
+	int testPngErrors() {
+		int errors = 0;
+		auto rejects = [](const std::vector<uint8_t>& png) {
+			return throwsRuntimeError([&]() { decodePng(png.data(), png.size()); });
+		};
+		std::vector<uint8_t> row = { 0, 1, 2, 3, 4 };
+
+		errors += EXPECT(!rejects(makePng({ 1, 1, 8, 6 }, row)));
+		errors += EXPECT(rejects(makePng({ 1, 1, 8, 6, 1 }, row)));
+		errors += EXPECT(rejects(makePng({ 1, 1, 8, 5 }, row)));
+		errors += EXPECT(rejects(makePng({ 1, 1, 16, 3 }, row)));
+		errors += EXPECT(rejects(makePng({ 1, 1, 3, 0 }, row)));
+		errors += EXPECT(rejects(makePng({ 0, 1, 8, 6 }, row)));
+		errors += EXPECT(rejects(makePng({ 1, 1, 8, 3 }, { 0, 0 })));
+		// Filter type 5 doesn't exist, and the rows must all be there.
+		errors += EXPECT(rejects(makePng({ 1, 1, 8, 6 }, { 5, 1, 2, 3, 4 })));
+		errors += EXPECT(rejects(makePng({ 1, 2, 8, 6 }, row)));
+
+		// Truncated before IEND, and a chunk claiming more than the file holds.
+		std::vector<uint8_t> valid = makePng({ 1, 1, 8, 6 }, row);
+		errors += EXPECT(rejects(std::vector<uint8_t>(valid.begin(), valid.end() - 12)));
+		std::vector<uint8_t> overlong = valid;
+		overlong[8 + 3] = 0xFF;
+		errors += EXPECT(rejects(overlong));
+
+		// Recognised but not decoded.
+		const uint8_t jpeg[] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+		errors += EXPECT(detectImageFormat(jpeg, sizeof(jpeg)) == ImageFileFormat::Jpeg);
+		errors += EXPECT(throwsRuntimeError([&]() { decodeImage(jpeg, sizeof(jpeg)); }));
+		const uint8_t unknown[] = { 'G', 'I', 'F', '8' };
+		errors += EXPECT(detectImageFormat(unknown, sizeof(unknown)) == ImageFileFormat::Unknown);
+		errors += EXPECT(throwsRuntimeError([&]() { decodeImage(unknown, sizeof(unknown)); }));
+		errors += EXPECT(throwsRuntimeError([&]() { decodePng(jpeg, sizeof(jpeg)); }));
+		return errors;
+	}
+}
+
+int testImageDecoder() {
+	int errors = 0;
+	errors += testInflate();
+	errors += testInflateErrors();
+	errors += testPngRgba();
+	errors += testPngConversions();
+	errors += testPngErrors();
+	return errors;
+}
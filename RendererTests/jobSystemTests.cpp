@@ -0,0 +1,148 @@
+#include "jobSystem.h"
+#include "tests.h"
+
+#include <atomic>
+#include <vector>
+
+namespace {
+
+	int testParallelFor() {
+		int errors = 0;
+		JobSystem jobSystem(3);
+
+		std::vector<std::atomic<uint32_t>> visits(1000);
+		jobSystem.parallelFor(1000, 7, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i) {
+				visits[i].fetch_add(1);
+			}
+		});
+		uint32_t visitedOnce = 0;
+		for (const auto& count : visits) {
+			visitedOnce += count.load() == 1 ? 1 : 0;
+		}
+		errors += EXPECT(visitedOnce == 1000u);
+		return errors;
+	}
+
+	int testNestedWait() {
+		int errors = 0;
+		JobSystem jobSystem(2);
+
+		// Every outer job waits on inner jobs; cooperative waiting keeps this from deadlocking with few workers.
+		std::atomic<uint32_t> innerRuns{ 0 };
+		JobCounter outer;
+		for (uint32_t i = 0; i < 8; ++i) {
+			jobSystem.submit([&]() {
+				JobCounter inner;
+				for (uint32_t j = 0; j < 8; ++j) {
+					jobSystem.submit([&]() { innerRuns.fetch_add(1); }, &inner);
+				}
+				jobSystem.wait(inner);
+			}, &outer);
+		}
+		jobSystem.wait(outer);
+		errors += EXPECT(innerRuns.load() == 64u);
+		return errors;
+	}
+
+	int testExceptions() {
+		int errors = 0;
+		JobSystem jobSystem(2);
+
+		// The failing job still counts as finished, so wait returns, and the others all run.
+		std::atomic<uint32_t> runs{ 0 };
+		JobCounter counter;
+		for (uint32_t i = 0; i < 16; ++i) {
+			jobSystem.submit([&runs, i]() {
+				runs.fetch_add(1);
+				if (i % 5 == 0) {
+					throw std::runtime_error("job failed");
+				}
+			}, &counter);
+		}
+		errors += EXPECT(throwsRuntimeError([&]() { jobSystem.wait(counter); }));
+		errors += EXPECT(runs.load() == 16u);
+		errors += EXPECT(counter.isDone());
+
+		// The exception is rethrown once; the counter can then be reused.
+		jobSystem.submit([]() {}, &counter);
+		errors += EXPECT(!throwsRuntimeError([&]() { jobSystem.wait(counter); }));
+
+		errors += EXPECT(throwsRuntimeError([&]() {
+			jobSystem.parallelFor(100, 10, [](uint32_t begin, uint32_t) {
+				if (begin == 50) {
+					throw std::runtime_error("batch failed");
+				}
+			});
+		}));
+		return errors;
+	}
+
+	int testBackground() {
+		int errors = 0;
+		JobSystem jobSystem(2);
+
+		// This thread helps with ordinary jobs while it waits, but never picks up background ones.
+		std::atomic<uint32_t> ranHere{ 0 };
+		std::atomic<uint32_t> runs{ 0 };
+		JobCounter counter;
+		for (uint32_t i = 0; i < 32; ++i) {
+			jobSystem.submitBackground([&]() {
+				ranHere.fetch_add(JobSystem::currentThreadIndex() == 0 ? 1 : 0);
+				runs.fetch_add(1);
+			}, &counter);
+		}
+		jobSystem.wait(counter);
+		errors += EXPECT(runs.load() == 32u);
+		errors += EXPECT(ranHere.load() == 0u);
+
+		// More background jobs waiting on background jobs than there are workers: waiting workers run the inner ones.
+		std::atomic<uint32_t> innerRuns{ 0 };
+		JobCounter outer;
+		for (uint32_t i = 0; i < 6; ++i) {
+			jobSystem.submitBackground([&]() {
+				JobCounter inner;
+				for (uint32_t j = 0; j < 4; ++j) {
+					jobSystem.submitBackground([&]() { innerRuns.fetch_add(1); }, &inner);
+				}
+				jobSystem.wait(inner);
+			}, &outer);
+		}
+		jobSystem.wait(outer);
+		errors += EXPECT(innerRuns.load() == 24u);
+		return errors;
+	}
+
+	int testTaskGraph() {
+		int errors = 0;
+		JobSystem jobSystem(3);
+
+		// A diamond: b and c both need a, d needs both.
+		std::atomic<uint32_t> step{ 0 };
+		uint32_t order[4] = {};
+		TaskGraph graph;
+		TaskGraph::TaskId a = graph.addTask([&]() { order[0] = step.fetch_add(1); });
+		TaskGraph::TaskId b = graph.addTask([&]() { order[1] = step.fetch_add(1); });
+		TaskGraph::TaskId c = graph.addTask([&]() { order[2] = step.fetch_add(1); });
+		TaskGraph::TaskId d = graph.addTask([&]() { order[3] = step.fetch_add(1); });
+		graph.addDependency(a, b);
+		graph.addDependency(a, c);
+		graph.addDependency(b, d);
+		graph.addDependency(c, d);
+		graph.execute(jobSystem);
+
+		errors += EXPECT(order[0] == 0u);
+		errors += EXPECT(order[3] == 3u);
+		return errors;
+	}
+}
+
+int testJobSystem() {
+	int errors = 0;
+	errors += testParallelFor();
+	errors += testNestedWait();
+	errors += testExceptions();
+	errors += testBackground();
+	errors += testTaskGraph();
+	return errors;
+}
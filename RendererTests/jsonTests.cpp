@@ -0,0 +1,106 @@
+#include "json.h"
+#include "tests.h"
+
+#include <cstring>
+#include <string>
+
+namespace {
+
+	JsonValue parse(const std::string& text) {
+		return parseJson(text.data(), text.size());
+	}
+
+	bool rejects(const std::string& text) {
+		return throwsRuntimeError([&]() { parse(text); });
+	}
+
+	int testValues() {
+		int errors = 0;
+		JsonValue document = parse(" {\"b\": true, \"n\": null, \"i\": 42, \"f\": -0.25, \"e\": 1.5e2, \"s\": \"text\", \"a\": [1, [2], {}], \"o\": {\"x\": 1}}\n");
+		errors += EXPECT(document.isObject());
+		errors += EXPECT(document.size() == 8u);
+		errors += EXPECT(document["b"].asBool());
+		errors += EXPECT(document["n"].isNull() && !document.has("n"));
+		errors += EXPECT(document["i"].asUint() == 42u);
+		errors += EXPECT(document["f"].asNumber() == -0.25);
+		errors += EXPECT(document["e"].asNumber() == 150.0);
+		errors += EXPECT(document["s"].asString() == "text");
+		errors += EXPECT(document["a"].isArray() && document["a"].size() == 3u);
+		errors += EXPECT(document["a"].at(1).at(0).asUint() == 2u);
+		errors += EXPECT(document["a"].at(2).isObject() && document["a"].at(2).size() == 0u);
+		errors += EXPECT(document["o"]["x"].asNumber() == 1.0);
+
+		// Members stay in file order.
+		const char* order[] = { "b", "n", "i", "f", "e", "s", "a", "o" };
+		for (size_t i = 0; i < document.getMembers().size(); ++i) {
+			errors += EXPECT(document.getMembers()[i].first == order[i]);
+		}
+
+		errors += EXPECT(parse("[]").isArray() && parse("[]").size() == 0u);
+		errors += EXPECT(parse("\"\"").isString() && parse("\"\"").asString().empty());
+		errors += EXPECT(parse("0").isNumber() && parse("0").asNumber() == 0.0);
+		errors += EXPECT(parse("2E-2").asNumber() > 0.0199 && parse("2E-2").asNumber() < 0.0201);
+		return errors;
+	}
+
+	// Missing members and wrong types give the fallback, since glTF leaves most properties optional.
+	int testFallbacks() {
+		int errors = 0;
+		JsonValue document = parse("{\"count\": -1, \"big\": 5000000000, \"name\": 3, \"list\": [1]}");
+		errors += EXPECT(document["missing"].isNull());
+		errors += EXPECT(document["missing"]["deeper"].at(4).isNull());
+		errors += EXPECT(document["count"].asUint(7) == 7u);
+		errors += EXPECT(document["big"].asUint(7) == 7u);
+		errors += EXPECT(document["name"].asString().empty());
+		errors += EXPECT(document["name"].asBool(true));
+		errors += EXPECT(document["list"].at(1).isNull());
+		errors += EXPECT(document["list"]["key"].isNull());
+		errors += EXPECT(document.at(0).isNull());
+		return errors;
+	}
+
+	int testStrings() {
+		int errors = 0;
+		errors += EXPECT(parse("\"a\\\"b\\\\c\\/d\\n\\t\"").asString() == "a\"b\\c/d\n\t");
+		errors += EXPECT(parse("\"\\u0041\"").asString() == "A");
+		errors += EXPECT(parse("\"\\u00e9\"").asString() == "\xC3\xA9");
+		errors += EXPECT(parse("\"\\u20AC\"").asString() == "\xE2\x82\xAC");
+		errors += EXPECT(parse("\"\\ud83d\\ude00\"").asString() == "\xF0\x9F\x98\x80");
+
+		// Not null terminated: the length given is all that is read.
+		const char text[] = { '"', 'o', 'k', '"', 'x' };
+		errors += EXPECT(parseJson(text, 4).asString() == "ok");
+		return errors;
+	}
+
+	int testSyntaxErrors() {
+		int errors = 0;
+		for (const char* text : { "", "   ", "{", "[1,]", "{\"a\":1,}", "{\"a\" 1}", "{a:1}", "[1 2]", "\"open", "\"\\x\"", "\"\\u12\"",
+				"\"\\u12G4\"", "tru", "nul", "-", ".", "{} {}", "[1]]" }) {
+			errors += EXPECT(rejects(text));
+		}
+
+		// Errors say where they are.
+		try {
+			parse("[1, 2, ?]");
+			errors += EXPECT(false);
+		}
+		catch (const std::runtime_error& e) {
+			errors += EXPECT(std::string(e.what()).find("byte 7") != std::string::npos);
+		}
+
+		// Deep nesting is refused instead of overflowing the stack.
+		errors += EXPECT(rejects(std::string(100000, '[') + std::string(100000, ']')));
+		errors += EXPECT(!rejects(std::string(200, '[') + std::string(200, ']')));
+		return errors;
+	}
+}
+
+int testJson() {
+	int errors = 0;
+	errors += testValues();
+	errors += testFallbacks();
+	errors += testStrings();
+	errors += testSyntaxErrors();
+	return errors;
+}
@@ -0,0 +1,337 @@
+#include "ktx2Texture.h"
+#include "tests.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+	const uint8_t ktx2Identifier[] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Description {
+		VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+		uint32_t width = 4;
+		uint32_t height = 4;
+		std::vector<std::vector<uint8_t>> levels; // As they are before supercompression.
+		uint32_t supercompression = 0;
+		uint32_t depth = 0;
+		uint32_t layerCount = 0;
+		uint32_t faceCount = 1;
+		std::vector<uint8_t> dfd;
+	};
+
+	void writeU32(std::vector<uint8_t>& bytes, size_t offset, uint32_t value) {
+		memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+
+	void writeU64(std::vector<uint8_t>& bytes, size_t offset, uint64_t value) {
+		memcpy(bytes.data() + offset, &value, sizeof(value));
+	}
+
+	// One stored deflate block in a zlib wrapper, which is all inflate needs to see for the zlib scheme.
+	std::vector<uint8_t> storeZlib(const std::vector<uint8_t>& data) {
+		size_t length = data.size();
+		std::vector<uint8_t> stream = { 0x78, 0x01, 0x01, static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+			static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8) };
+		stream.insert(stream.end(), data.begin(), data.end());
+		stream.insert(stream.end(), 4, 0);
+		return stream;
+	}
+
+	// Header, level index, DFD, then the levels in order. Scheme 3 levels are zlib compressed here; other schemes
+	// store the bytes as given.
+	std::vector<uint8_t> makeKtx2(const Ktx2Description& description) {
+		size_t levelCount = description.levels.size();
+		std::vector<uint8_t> file(80 + levelCount * 24);
+		memcpy(file.data(), ktx2Identifier, sizeof(ktx2Identifier));
+		writeU32(file, 12, static_cast<uint32_t>(description.format));
+		writeU32(file, 16, 1);
+		writeU32(file, 20, description.width);
+		writeU32(file, 24, description.height);
+		writeU32(file, 28, description.depth);
+		writeU32(file, 32, description.layerCount);
+		writeU32(file, 36, description.faceCount);
+		writeU32(file, 40, static_cast<uint32_t>(levelCount));
+		writeU32(file, 44, description.supercompression);
+		if (!description.dfd.empty()) {
+			writeU32(file, 48, static_cast<uint32_t>(file.size()));
+			writeU32(file, 52, static_cast<uint32_t>(description.dfd.size()));
+			file.insert(file.end(), description.dfd.begin(), description.dfd.end());
+		}
+		for (size_t level = 0; level < levelCount; ++level) {
+			const std::vector<uint8_t>& raw = description.levels[level];
+			std::vector<uint8_t> stored = description.supercompression == 3 ? storeZlib(raw) : raw;
+			size_t entry = 80 + level * 24;
+			writeU64(file, entry, file.size());
+			writeU64(file, entry + 8, stored.size());
+			writeU64(file, entry + 16, raw.size());
+			file.insert(file.end(), stored.begin(), stored.end());
+		}
+		return file;
+	}
+
+	TextureLevels load(const std::vector<uint8_t>& file, const TextureFormatSupport& support = allTextureFormats()) {
+		return loadKtx2(file.data(), file.size(), support);
+	}
+
+	// loadKtx2 throws, and its message names the problem.
+	bool rejects(const std::vector<uint8_t>& file, const char* reason, const TextureFormatSupport& support = allTextureFormats()) {
+		try {
+			load(file, support);
+		}
+		catch (const std::runtime_error& error) {
+			std::string message = error.what();
+			if (message.find(reason) == std::string::npos) {
+				std::cerr << "KTX2 error \"" << message << "\" doesn't mention \"" << reason << "\"\n";
+				return false;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<uint8_t> makeRgba(uint32_t width, uint32_t height, uint8_t seed) {
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			pixels[i] = static_cast<uint8_t>(seed + i * 7);
+		}
+		return pixels;
+	}
+
+	// Two RGB565 endpoints, then every texel's index: texel x of each row uses palette entry x.
+	std::vector<uint8_t> makeBc1Block(uint16_t color0, uint16_t color1) {
+		return { static_cast<uint8_t>(color0), static_cast<uint8_t>(color0 >> 8), static_cast<uint8_t>(color1), static_cast<uint8_t>(color1 >> 8),
+			0xE4, 0xE4, 0xE4, 0xE4 };
+	}
+
+	const uint16_t red565 = 0xF800;
+	const uint16_t blue565 = 0x001F;
+
+	bool pixelIs(const TextureLevels& texture, uint32_t x, uint32_t y, std::vector<uint8_t> rgba) {
+		const uint8_t* pixel = &texture.levels[0][(static_cast<size_t>(y) * texture.width + x) * 4];
+		return std::vector<uint8_t>(pixel, pixel + 4) == rgba;
+	}
+
+	int testUncompressed() {
+		int errors = 0;
+		Ktx2Description description;
+		description.levels = { makeRgba(4, 4, 1), makeRgba(2, 2, 2), makeRgba(1, 1, 3) };
+		TextureLevels texture = load(makeKtx2(description));
+		errors += EXPECT(texture.format == VK_FORMAT_R8G8B8A8_UNORM);
+		errors += EXPECT(texture.width == 4 && texture.height == 4);
+		errors += EXPECT(texture.levels == description.levels);
+
+		// sRGB loads as its UNORM twin, with the bytes unchanged.
+		description.format = VK_FORMAT_R8G8B8A8_SRGB;
+		texture = load(makeKtx2(description));
+		errors += EXPECT(texture.format == VK_FORMAT_R8G8B8A8_UNORM);
+		errors += EXPECT(texture.levels == description.levels);
+
+		// zlib supercompression inflates each level.
+		description.supercompression = 3;
+		texture = load(makeKtx2(description));
+		errors += EXPECT(texture.levels == description.levels);
+
+		// RGBA8 needs no device support.
+		texture = load(makeKtx2(description), TextureFormatSupport());
+		errors += EXPECT(texture.levels == description.levels);
+		return errors;
+	}
+
+	int testBlocksKept() {
+		int errors = 0;
+		Ktx2Description description;
+		description.format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+		description.width = 8;
+		description.levels = { makeBc1Block(red565, blue565), makeBc1Block(blue565, red565) };
+		description.levels[0].resize(16, 0x55);
+		std::vector<uint8_t> file = makeKtx2(description);
+
+		TextureFormatSupport support;
+		support.formats = { VK_FORMAT_BC1_RGB_UNORM_BLOCK };
+		support.bc = true;
+		TextureLevels texture = load(file, support);
+		errors += EXPECT(texture.format == VK_FORMAT_BC1_RGB_UNORM_BLOCK);
+		errors += EXPECT(texture.width == 8 && texture.height == 4);
+		errors += EXPECT(texture.levels == description.levels);
+
+		// Formats without a CPU fallback are kept when supported and rejected when not.
+		description.format = VK_FORMAT_BC7_UNORM_BLOCK;
+		description.levels = { std::vector<uint8_t>(32, 1), std::vector<uint8_t>(16, 2) };
+		errors += EXPECT(load(makeKtx2(description)).format == VK_FORMAT_BC7_UNORM_BLOCK);
+		errors += EXPECT(rejects(makeKtx2(description), "can't sample", support));
+		description.format = VK_FORMAT_ASTC_4x4_SRGB_BLOCK;
+		errors += EXPECT(load(makeKtx2(description)).format == VK_FORMAT_ASTC_4x4_UNORM_BLOCK);
+		return errors;
+	}
+
+	int testBc1Decode() {
+		int errors = 0;
+		const TextureFormatSupport none;
+		Ktx2Description description;
+		description.format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		description.levels = { makeBc1Block(red565, blue565) };
+
+		// Descending endpoints: the two endpoints and their 2/3 and 1/3 blends.
+		TextureLevels texture = load(makeKtx2(description), none);
+		errors += EXPECT(texture.format == VK_FORMAT_R8G8B8A8_UNORM);
+		errors += EXPECT(texture.levels[0].size() == 4u * 4 * 4);
+		errors += EXPECT(pixelIs(texture, 0, 0, { 255, 0, 0, 255 }));
+		errors += EXPECT(pixelIs(texture, 1, 1, { 0, 0, 255, 255 }));
+		errors += EXPECT(pixelIs(texture, 2, 2, { 170, 0, 85, 255 }));
+		errors += EXPECT(pixelIs(texture, 3, 3, { 85, 0, 170, 255 }));
+
+		// Ascending endpoints: BC1 without alpha still has four opaque colours...
+		description.levels = { makeBc1Block(blue565, red565) };
+		texture = load(makeKtx2(description), none);
+		errors += EXPECT(pixelIs(texture, 2, 0, { 85, 0, 170, 255 }));
+		errors += EXPECT(pixelIs(texture, 3, 0, { 170, 0, 85, 255 }));
+
+		// ...while BC1 with alpha has the midpoint and transparent black.
+		description.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		texture = load(makeKtx2(description), none);
+		errors += EXPECT(pixelIs(texture, 0, 0, { 0, 0, 255, 255 }));
+		errors += EXPECT(pixelIs(texture, 2, 0, { 127, 0, 127, 255 }));
+		errors += EXPECT(pixelIs(texture, 3, 0, { 0, 0, 0, 0 }));
+
+		// A 6x2 texture covers two blocks, and only the texels inside it are written.
+		description.format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		description.width = 6;
+		description.height = 2;
+		description.levels = { makeBc1Block(red565, blue565) };
+		std::vector<uint8_t> second = makeBc1Block(blue565, blue565);
+		description.levels[0].insert(description.levels[0].end(), second.begin(), second.end());
+		texture = load(makeKtx2(description), none);
+		errors += EXPECT(texture.levels[0].size() == 6u * 2 * 4);
+		errors += EXPECT(pixelIs(texture, 3, 1, { 85, 0, 170, 255 }));
+		errors += EXPECT(pixelIs(texture, 4, 0, { 0, 0, 255, 255 }));
+		errors += EXPECT(pixelIs(texture, 5, 1, { 0, 0, 255, 255 }));
+		return errors;
+	}
+
+	int testBc2Bc3Decode() {
+		int errors = 0;
+		const TextureFormatSupport none;
+		std::vector<uint8_t> colors = makeBc1Block(red565, blue565);
+
+		// BC2: texel i's 4-bit alpha is i, scaled to 8 bits.
+		Ktx2Description description;
+		description.format = VK_FORMAT_BC2_UNORM_BLOCK;
+		std::vector<uint8_t> block;
+		for (uint8_t i = 0; i < 8; ++i) {
+			block.push_back(static_cast<uint8_t>((2 * i) | ((2 * i + 1) << 4)));
+		}
+		block.insert(block.end(), colors.begin(), colors.end());
+		description.levels = { block };
+		TextureLevels texture = load(makeKtx2(description), none);
+		bool alphasMatch = true;
+		for (uint32_t texel = 0; texel < 16; ++texel) {
+			alphasMatch = alphasMatch && texture.levels[0][texel * 4 + 3] == texel * 17;
+		}
+		errors += EXPECT(alphasMatch);
+		errors += EXPECT(pixelIs(texture, 2, 0, { 170, 0, 85, 34 }));
+
+		// BC3: texel i uses alpha index i % 8, with descending endpoints giving six interpolated values...
+		description.format = VK_FORMAT_BC3_SRGB_BLOCK;
+		uint64_t indices = 0;
+		for (uint64_t texel = 0; texel < 16; ++texel) {
+			indices |= (texel % 8) << (3 * texel);
+		}
+		block = { 255, 0 };
+		for (uint32_t i = 0; i < 6; ++i) {
+			block.push_back(static_cast<uint8_t>(indices >> (8 * i)));
+		}
+		block.insert(block.end(), colors.begin(), colors.end());
+		description.levels = { block };
+		texture = load(makeKtx2(description), none);
+		const uint8_t descending[] = { 255, 0, 218, 182, 145, 109, 72, 36 };
+		alphasMatch = true;
+		for (uint32_t texel = 0; texel < 16; ++texel) {
+			alphasMatch = alphasMatch && texture.levels[0][texel * 4 + 3] == descending[texel % 8];
+		}
+		errors += EXPECT(alphasMatch);
+		errors += EXPECT(pixelIs(texture, 1, 0, { 0, 0, 255, 0 }));
+
+		// ...and ascending endpoints giving four, then 0 and 255.
+		description.levels[0][0] = 0;
+		description.levels[0][1] = 255;
+		texture = load(makeKtx2(description), none);
+		const uint8_t ascending[] = { 0, 255, 51, 102, 153, 204, 0, 255 };
+		alphasMatch = true;
+		for (uint32_t texel = 0; texel < 16; ++texel) {
+			alphasMatch = alphasMatch && texture.levels[0][texel * 4 + 3] == ascending[texel % 8];
+		}
+		errors += EXPECT(alphasMatch);
+		return errors;
+	}
+
+	int testRejections() {
+		int errors = 0;
+		Ktx2Description valid;
+		valid.levels = { makeRgba(4, 4, 0) };
+
+		const uint8_t png[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		errors += EXPECT(rejects(std::vector<uint8_t>(png, png + sizeof(png)), "Not a KTX2 file"));
+		errors += EXPECT(rejects(std::vector<uint8_t>(ktx2Identifier, ktx2Identifier + sizeof(ktx2Identifier)), "Not a KTX2 file"));
+
+		// Basis Universal payloads and Zstd each say which library they'd need.
+		Ktx2Description basis = valid;
+		basis.format = VK_FORMAT_UNDEFINED;
+		basis.supercompression = 1;
+		errors += EXPECT(rejects(makeKtx2(basis), "BasisLZ"));
+		basis.supercompression = 0;
+		basis.dfd.assign(44, 0);
+		basis.dfd[12] = 166;
+		errors += EXPECT(rejects(makeKtx2(basis), "UASTC"));
+		basis.dfd[12] = 1;
+		errors += EXPECT(rejects(makeKtx2(basis), "no Vulkan format"));
+		Ktx2Description scheme = valid;
+		scheme.supercompression = 2;
+		errors += EXPECT(rejects(makeKtx2(scheme), "Zstd"));
+		scheme.supercompression = 7;
+		errors += EXPECT(rejects(makeKtx2(scheme), "Unknown supercompression scheme 7"));
+
+		Ktx2Description unsupported = valid;
+		unsupported.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		errors += EXPECT(rejects(makeKtx2(unsupported), "is not supported"));
+
+		// Cube maps, arrays and 3D textures.
+		Ktx2Description shape = valid;
+		shape.faceCount = 6;
+		errors += EXPECT(rejects(makeKtx2(shape), "single 2D"));
+		shape = valid;
+		shape.layerCount = 2;
+		errors += EXPECT(rejects(makeKtx2(shape), "single 2D"));
+		shape = valid;
+		shape.depth = 4;
+		errors += EXPECT(rejects(makeKtx2(shape), "single 2D"));
+
+		Ktx2Description levels = valid;
+		levels.levels = { makeRgba(4, 4, 0), makeRgba(2, 2, 0), makeRgba(1, 1, 0), makeRgba(1, 1, 0) };
+		errors += EXPECT(rejects(makeKtx2(levels), "More levels"));
+
+		// A level that doesn't fit in the file, one of the wrong size, and a zlib level claiming the wrong size.
+		std::vector<uint8_t> file = makeKtx2(valid);
+		errors += EXPECT(rejects(std::vector<uint8_t>(file.begin(), file.end() - 1), "runs past the end"));
+		Ktx2Description wrongSize = valid;
+		wrongSize.levels[0].push_back(0);
+		errors += EXPECT(rejects(makeKtx2(wrongSize), "wrong size"));
+		Ktx2Description zlib = valid;
+		zlib.supercompression = 3;
+		file = makeKtx2(zlib);
+		writeU64(file, 80 + 16, 60);
+		errors += EXPECT(rejects(file, "wrong size"));
+		return errors;
+	}
+}
+
+int testKtx2Texture() {
+	int errors = 0;
+	errors += testUncompressed();
+	errors += testBlocksKept();
+	errors += testBc1Decode();
+	errors += testBc2Bc3Decode();
+	errors += testRejections();
+	return errors;
+}
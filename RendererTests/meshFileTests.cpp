@@ -0,0 +1,200 @@
+#include "meshFile.h"
+#include "tests.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+	std::string getTestPath(const char* name) {
+		std::filesystem::path directory = std::filesystem::temp_directory_path() / "rendererTests";
+		std::filesystem::create_directories(directory);
+		return (directory / name).string();
+	}
+
+	std::vector<char> readBytes(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void writeBytes(const std::string& path, const std::vector<char>& bytes) {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+	// A size x size grid of quads in the xy plane, split into two submeshes by row.
+	MeshData makeGrid(uint32_t size) {
+		MeshData mesh;
+		for (uint32_t y = 0; y <= size; ++y) {
+			for (uint32_t x = 0; x <= size; ++x) {
+				MeshVertex vertex = { { static_cast<float>(x), static_cast<float>(y), 0.0f }, { 0.0f, 0.0f, 1.0f },
+					{ static_cast<float>(x) / size, static_cast<float>(y) / size } };
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t y = 0; y < size; ++y) {
+			for (uint32_t x = 0; x < size; ++x) {
+				uint32_t corner = y * (size + 1) + x;
+				uint32_t quad[] = { corner, corner + 1, corner + size + 1, corner + 1, corner + size + 2, corner + size + 1 };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		uint32_t half = size / 2 * size * 6;
+		mesh.submeshes.push_back({ 0, half, 0, 0, {} });
+		mesh.submeshes.push_back({ half, static_cast<uint32_t>(mesh.indices.size()) - half, 0, 0, {} });
+		return mesh;
+	}
+
+	int checkStreams(const MeshFile& file, const MeshData& mesh) {
+		int errors = 0;
+		const MeshFileHeader& header = file.getHeader();
+		errors += EXPECT(header.vertexCount == mesh.vertices.size());
+		errors += EXPECT(header.indexCount == mesh.indices.size());
+		errors += EXPECT(header.submeshCount == mesh.submeshes.size());
+		errors += EXPECT(header.meshletCount > 0);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(MeshStream::Count); ++i) {
+			errors += EXPECT(header.sections[i].offset % meshFileAlignment == 0);
+		}
+
+		// Stored exactly as given, so the bytes are what an upload copies.
+		errors += EXPECT(memcmp(file.getStreamData(MeshStream::Vertices), mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex)) == 0);
+		const uint8_t* indices = file.getStreamData(MeshStream::Indices);
+		bool indicesMatch = true;
+		for (size_t i = 0; i < mesh.indices.size(); ++i) {
+			uint32_t index = 0;
+			memcpy(&index, indices + i * header.indexSize, header.indexSize);
+			indicesMatch = indicesMatch && index == mesh.indices[i];
+		}
+		errors += EXPECT(indicesMatch);
+
+		// Every triangle lands in exactly one meshlet of its own submesh.
+		for (uint32_t i = 0; i < header.submeshCount; ++i) {
+			const MeshSubmesh& submesh = file.getSubmeshes()[i];
+			errors += EXPECT(submesh.firstIndex == mesh.submeshes[i].firstIndex);
+			errors += EXPECT(submesh.indexCount == mesh.submeshes[i].indexCount);
+			uint32_t triangles = 0;
+			for (uint32_t meshlet = submesh.firstMeshlet; meshlet < submesh.firstMeshlet + submesh.meshletCount; ++meshlet) {
+				errors += EXPECT(file.getMeshlets()[meshlet].vertexCount <= maxMeshletVertices);
+				errors += EXPECT(file.getMeshlets()[meshlet].triangleCount <= maxMeshletTriangles);
+				triangles += file.getMeshlets()[meshlet].triangleCount;
+			}
+			errors += EXPECT(triangles * 3 == submesh.indexCount);
+			errors += EXPECT(submesh.boundingSphere[3] > 0.0f);
+		}
+		return errors;
+	}
+
+	int testRoundTrip() {
+		int errors = 0;
+		std::string path = getTestPath("grid.mesh");
+		MeshData mesh = makeGrid(16);
+		writeMeshFile(path, mesh);
+
+		MeshFile file;
+		file.open(path);
+		errors += EXPECT(file.getHeader().indexSize == 2u);
+		errors += EXPECT(file.getHeader().fileSize == std::filesystem::file_size(path));
+		errors += EXPECT(file.getHeader().boundsMin[0] == 0.0f && file.getHeader().boundsMax[1] == 16.0f);
+		errors += checkStreams(file, mesh);
+		file.close();
+		std::filesystem::remove(path);
+		return errors;
+	}
+
+	// Past 65536 vertices the indices no longer fit in 16 bits.
+	int testWideIndices() {
+		int errors = 0;
+		std::string path = getTestPath("wide.mesh");
+		MeshData mesh;
+		mesh.vertices.resize(70000, MeshVertex{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f } });
+		mesh.vertices[69999].position[0] = 1.0f;
+		mesh.vertices[35000].position[1] = 1.0f;
+		mesh.indices = { 0, 69999, 35000, 35000, 69999, 65536 };
+		mesh.submeshes.push_back({ 0, 6, 0, 0, {} });
+		writeMeshFile(path, mesh);
+
+		MeshFile file;
+		file.open(path);
+		errors += EXPECT(file.getHeader().indexSize == 4u);
+		errors += checkStreams(file, mesh);
+		file.close();
+		std::filesystem::remove(path);
+		return errors;
+	}
+
+	int testRejection() {
+		int errors = 0;
+		std::string path = getTestPath("valid.mesh");
+		std::string damagedPath = getTestPath("damaged.mesh");
+		writeMeshFile(path, makeGrid(4));
+		std::vector<char> valid = readBytes(path);
+		MeshFile file;
+
+		// Truncated anywhere: inside the streams, inside the header, or to nothing.
+		for (size_t size : { valid.size() - 1, valid.size() - meshFileAlignment, sizeof(MeshFileHeader) - 1, static_cast<size_t>(0) }) {
+			writeBytes(damagedPath, std::vector<char>(valid.begin(), valid.begin() + size));
+			errors += EXPECT(throwsRuntimeError([&]() { file.open(damagedPath); }));
+		}
+
+		// Extra bytes are as wrong as missing ones.
+		std::vector<char> damaged = valid;
+		damaged.push_back(0);
+		writeBytes(damagedPath, damaged);
+		errors += EXPECT(throwsRuntimeError([&]() { file.open(damagedPath); }));
+
+		MeshFileHeader header;
+		memcpy(&header, valid.data(), sizeof(header));
+		auto openPatched = [&](const MeshFileHeader& patched) {
+			std::vector<char> bytes = valid;
+			memcpy(bytes.data(), &patched, sizeof(patched));
+			writeBytes(damagedPath, bytes);
+			return throwsRuntimeError([&]() { file.open(damagedPath); });
+		};
+		MeshFileHeader patched = header;
+		patched.magic = 0;
+		errors += EXPECT(openPatched(patched));
+		patched = header;
+		patched.version = meshFileVersion + 1;
+		errors += EXPECT(openPatched(patched));
+		patched = header;
+		patched.indexSize = 3;
+		errors += EXPECT(openPatched(patched));
+		patched = header;
+		patched.sections[static_cast<uint32_t>(MeshStream::Indices)].offset += 1;
+		errors += EXPECT(openPatched(patched));
+		patched = header;
+		patched.sections[static_cast<uint32_t>(MeshStream::MeshletTriangles)].size = header.fileSize;
+		errors += EXPECT(openPatched(patched));
+
+		// A submesh reaching past the index stream.
+		damaged = valid;
+		MeshSubmesh submesh;
+		size_t submeshOffset = static_cast<size_t>(header.sections[static_cast<uint32_t>(MeshStream::Submeshes)].offset);
+		memcpy(&submesh, damaged.data() + submeshOffset, sizeof(submesh));
+		submesh.indexCount = header.indexCount + 3;
+		memcpy(damaged.data() + submeshOffset, &submesh, sizeof(submesh));
+		writeBytes(damagedPath, damaged);
+		errors += EXPECT(throwsRuntimeError([&]() { file.open(damagedPath); }));
+
+		// A failed open leaves nothing half open, and the original is still fine.
+		errors += EXPECT(file.getHeader().magic == 0u);
+		errors += EXPECT(!throwsRuntimeError([&]() { file.open(path); }));
+		errors += EXPECT(throwsRuntimeError([&]() { file.open(getTestPath("missing.mesh")); }));
+		file.close();
+		std::filesystem::remove(path);
+		std::filesystem::remove(damagedPath);
+		return errors;
+	}
+}
+
+int testMeshFile() {
+	int errors = 0;
+	errors += testRoundTrip();
+	errors += testWideIndices();
+	errors += testRejection();
+	return errors;
+}
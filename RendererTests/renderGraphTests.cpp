@@ -0,0 +1,192 @@
+#include "renderGraph.h"
+#include "tests.h"
+
+#include <vector>
+
+namespace {
+
+	const RenderGraphImageDesc colorDesc{ VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 }, VK_IMAGE_ASPECT_COLOR_BIT };
+	const VkDeviceSize colorSize = 64 * 64 * 4;
+
+	VkMemoryRequirements memoryRequirements(const VkImageCreateInfo& createInfo) {
+		return { static_cast<VkDeviceSize>(createInfo.extent.width) * createInfo.extent.height * 4, 256, ~0u };
+	}
+
+	RenderGraphResource importTarget(RenderGraph& graph) {
+		return graph.importImage("target", VK_NULL_HANDLE, VK_NULL_HANDLE, colorDesc, {});
+	}
+
+	const RenderGraphBarrier* findBarrier(const std::vector<RenderGraphBarrier>& barriers, RenderGraphResource resource) {
+		for (const RenderGraphBarrier& barrier : barriers) {
+			if (barrier.resource == resource) {
+				return &barrier;
+			}
+		}
+		return nullptr;
+	}
+
+	const RenderGraphTransientPlan::Image* findImage(const RenderGraphTransientPlan& plan, RenderGraphResource resource) {
+		for (const RenderGraphTransientPlan::Image& image : plan.images) {
+			if (image.resource == resource) {
+				return &image;
+			}
+		}
+		return nullptr;
+	}
+
+	int testCulling() {
+		int errors = 0;
+		RenderGraph graph;
+		RenderGraphResource target = importTarget(graph);
+		RenderGraphResource scratch = graph.createImage("scratch", colorDesc);
+		RenderGraphResource unused = graph.createImage("unused", colorDesc);
+		graph.markOutput(target);
+
+		graph.addPass("dead", nullptr).write(unused, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("producer", nullptr).write(scratch, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("consumer", nullptr)
+			.read(scratch, RenderGraphAccess::SampledRead)
+			.write(target, RenderGraphAccess::ColorAttachmentWrite);
+		// Writes scratch after its last reader, and reading unused doesn't bring "dead" back.
+		graph.addPass("lateWrite", nullptr)
+			.read(unused, RenderGraphAccess::SampledRead)
+			.write(scratch, RenderGraphAccess::StorageWrite);
+		graph.addPass("pinned", nullptr).keepAlive();
+		graph.compile(memoryRequirements);
+
+		errors += EXPECT((graph.getCompiledPasses() == std::vector<uint32_t>{ 1, 2, 4 }));
+		// Transients only culled passes touch are never planned.
+		errors += EXPECT(graph.getTransientPlan().images.size() == 1);
+		errors += EXPECT(findImage(graph.getTransientPlan(), unused) == nullptr);
+		return errors;
+	}
+
+	int testBarriers() {
+		int errors = 0;
+		RenderGraph graph;
+		RenderGraphResource target = importTarget(graph);
+		RenderGraphResource scratch = graph.createImage("scratch", colorDesc);
+		graph.setFinalState(target, RenderGraphAccess::TransferRead);
+
+		graph.addPass("draw", nullptr).write(scratch, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("compose", nullptr)
+			.read(scratch, RenderGraphAccess::SampledRead)
+			.write(target, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("overlay", nullptr)
+			.read(scratch, RenderGraphAccess::SampledRead)
+			.write(target, RenderGraphAccess::ColorAttachmentWrite);
+		graph.compile(memoryRequirements);
+		errors += EXPECT(graph.getCompiledPasses().size() == 3);
+
+		// First use: a layout transition out of UNDEFINED with nothing to wait for.
+		const RenderGraphBarrier* first = findBarrier(graph.getPassBarriers(0), scratch);
+		errors += EXPECT(graph.getPassBarriers(0).size() == 1);
+		errors += EXPECT(first && first->before.layout == VK_IMAGE_LAYOUT_UNDEFINED);
+		errors += EXPECT(first && first->before.stages == VK_PIPELINE_STAGE_2_NONE);
+		errors += EXPECT(first && first->after.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+		// Read after write: waits for the attachment write and moves to a sampled layout.
+		const RenderGraphBarrier* read = findBarrier(graph.getPassBarriers(1), scratch);
+		errors += EXPECT(graph.getPassBarriers(1).size() == 2);
+		errors += EXPECT(read && read->before.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		errors += EXPECT(read && (read->before.access & VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT) != 0);
+		errors += EXPECT(read && read->after.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// The second read is already visible; the second write to target still orders after the first.
+		errors += EXPECT(findBarrier(graph.getPassBarriers(2), scratch) == nullptr);
+		const RenderGraphBarrier* rewrite = findBarrier(graph.getPassBarriers(2), target);
+		errors += EXPECT(rewrite && rewrite->before.stages == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+		errors += EXPECT(rewrite && rewrite->before.layout == rewrite->after.layout);
+
+		const RenderGraphBarrier* final = findBarrier(graph.getFinalBarriers(), target);
+		errors += EXPECT(graph.getFinalBarriers().size() == 1);
+		errors += EXPECT(final && final->after.layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		return errors;
+	}
+
+	// a lives for passes 0-1, c for 1-2 and b for 2-3, so only a and b can share memory.
+	void buildAliasingGraph(RenderGraph& graph, RenderGraphResource& a, RenderGraphResource& b, RenderGraphResource& c) {
+		RenderGraphResource target = importTarget(graph);
+		a = graph.createImage("a", colorDesc);
+		b = graph.createImage("b", colorDesc);
+		c = graph.createImage("c", colorDesc);
+		graph.markOutput(target);
+
+		graph.addPass("writeA", nullptr).write(a, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("aToC", nullptr)
+			.read(a, RenderGraphAccess::SampledRead)
+			.write(c, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("cToB", nullptr)
+			.read(c, RenderGraphAccess::SampledRead)
+			.write(b, RenderGraphAccess::ColorAttachmentWrite);
+		graph.addPass("bToTarget", nullptr)
+			.read(b, RenderGraphAccess::SampledRead)
+			.write(target, RenderGraphAccess::ColorAttachmentWrite);
+	}
+
+	int testTransientAliasing() {
+		int errors = 0;
+		RenderGraph graph;
+		RenderGraphResource a;
+		RenderGraphResource b;
+		RenderGraphResource c;
+		buildAliasingGraph(graph, a, b, c);
+		graph.compile(memoryRequirements);
+
+		const RenderGraphTransientPlan& plan = graph.getTransientPlan();
+		const RenderGraphTransientPlan::Image* imageA = findImage(plan, a);
+		const RenderGraphTransientPlan::Image* imageB = findImage(plan, b);
+		const RenderGraphTransientPlan::Image* imageC = findImage(plan, c);
+		errors += EXPECT(imageA && imageB && imageC);
+		if (!imageA || !imageB || !imageC) {
+			return errors;
+		}
+
+		errors += EXPECT(imageA->offset == imageB->offset);
+		errors += EXPECT(imageC->offset >= imageA->offset + colorSize || imageA->offset >= imageC->offset + colorSize);
+		errors += EXPECT(plan.memory.size == 2 * colorSize);
+		errors += EXPECT(imageC->firstPass == 1 && imageC->lastPass == 2);
+
+		// b's first use waits for a's last use of the same memory; c shares memory with nothing before it.
+		const RenderGraphBarrier* aliasB = findBarrier(graph.getPassBarriers(2), b);
+		errors += EXPECT(aliasB && (aliasB->before.stages & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT) != 0);
+		const RenderGraphBarrier* firstC = findBarrier(graph.getPassBarriers(1), c);
+		errors += EXPECT(firstC && firstC->before.stages == VK_PIPELINE_STAGE_2_NONE);
+
+		// An identical graph compiles to the same plan, so a frame slot keeps its images.
+		RenderGraph again;
+		buildAliasingGraph(again, a, b, c);
+		again.compile(memoryRequirements);
+		errors += EXPECT(again.getTransientPlan().hash == plan.hash);
+		return errors;
+	}
+
+	int testMisuse() {
+		int errors = 0;
+		RenderGraph graph;
+		RenderGraphResource target = importTarget(graph);
+		RenderGraphResource scratch = graph.createImage("scratch", colorDesc);
+
+		errors += EXPECT(throwsRuntimeError([&]() { graph.addPass("readAsWrite", nullptr).write(target, RenderGraphAccess::SampledRead); }));
+		errors += EXPECT(throwsRuntimeError([&]() { graph.setFinalState(scratch, RenderGraphAccess::TransferRead); }));
+
+		// One pass can't use an image in two layouts.
+		RenderGraph twoLayouts;
+		RenderGraphResource image = importTarget(twoLayouts);
+		twoLayouts.markOutput(image);
+		twoLayouts.addPass("both", nullptr)
+			.read(image, RenderGraphAccess::SampledRead)
+			.write(image, RenderGraphAccess::ColorAttachmentWrite);
+		errors += EXPECT(throwsRuntimeError([&]() { twoLayouts.compile(memoryRequirements); }));
+		return errors;
+	}
+}
+
+int testRenderGraph() {
+	int errors = 0;
+	errors += testCulling();
+	errors += testBarriers();
+	errors += testTransientAliasing();
+	errors += testMisuse();
+	return errors;
+}
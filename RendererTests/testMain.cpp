@@ -0,0 +1,46 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "tests.h"
+
+int main() {
+	struct Suite {
+		const char* name;
+		int (*run)();
+	};
+	const Suite suites[] = {
+		{ "BuddyAllocator", testBuddyAllocator },
+		{ "GpuMemoryAllocator", testGpuMemoryAllocator },
+		{ "JobSystem", testJobSystem },
+		{ "RenderGraph", testRenderGraph },
+		{ "DescriptorSlotAllocator", testDescriptorSlotAllocator },
+		{ "GpuCulling", testGpuCulling },
+		{ "MeshFile", testMeshFile },
+		{ "Json", testJson },
+		{ "GltfLoader", testGltfLoader },
+		{ "ImageDecoder", testImageDecoder },
+		{ "Ktx2Texture", testKtx2Texture },
+		{ "AssetCooker", testAssetCooker },
+	};
+
+	int failedSuites = 0;
+	for (const Suite& suite : suites) {
+		int errors = 0;
+		try {
+			errors = suite.run();
+		}
+		catch (const std::exception& e) {
+			std::cerr << suite.name << ": unexpected exception: " << e.what() << "\n";
+			errors = 1;
+		}
+		std::cout << (errors == 0 ? "[ OK ] " : "[FAIL] ") << suite.name;
+		if (errors != 0) {
+			std::cout << " (" << errors << " failed checks)";
+		}
+		std::cout << "\n";
+		failedSuites += errors != 0 ? 1 : 0;
+	}
+
+	std::cout << failedSuites << " of " << sizeof(suites) / sizeof(suites[0]) << " suites failed.\n";
+	return failedSuites == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
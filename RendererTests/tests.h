@@ -0,0 +1,43 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+
+/*
+	CPU Tests
+	- Each suite is a plain function returning how many of its checks failed, in the style of glm/test:
+	  errors += EXPECT(...). A failed check prints its expression and location and the suite carries on.
+	- Nothing here needs a GPU. Code that calls Vulkan runs against the fake driver in vulkanStubs.h.
+*/
+inline int expectTrue(bool condition, const char* expression, const char* file, int line) {
+	if (!condition) {
+		std::cerr << file << "(" << line << "): check failed: " << expression << "\n";
+	}
+	return condition ? 0 : 1;
+}
+
+#define EXPECT(condition) expectTrue((condition), #condition, __FILE__, __LINE__)
+
+template <typename Body>
+bool throwsRuntimeError(Body body) {
+	try {
+		body();
+	}
+	catch (const std::runtime_error&) {
+		return true;
+	}
+	return false;
+}
+
+int testBuddyAllocator();
+int testGpuMemoryAllocator();
+int testJobSystem();
+int testRenderGraph();
+int testDescriptorSlotAllocator();
+int testGpuCulling();
+int testMeshFile();
+int testJson();
+int testGltfLoader();
+int testImageDecoder();
+int testKtx2Texture();
+int testAssetCooker();
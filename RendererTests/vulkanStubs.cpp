@@ -0,0 +1,231 @@
+#include "vulkanStubs.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+	struct StubMemory {
+		VkDeviceSize size;
+		void* mapped = nullptr;
+	};
+
+	uint64_t nextHandle = 1;
+	std::unordered_map<uint64_t, VkMemoryRequirements> bufferRequirements;
+	std::unordered_map<uint64_t, StubMemory> deviceMemory;
+
+	// Non-dispatchable handles are pointers on 64-bit targets and uint64_t on 32-bit ones.
+	template <typename Handle>
+	Handle toHandle(uint64_t value) {
+		Handle handle{};
+		memcpy(&handle, &value, sizeof(handle));
+		return handle;
+	}
+
+	template <typename Handle>
+	uint64_t fromHandle(Handle handle) {
+		uint64_t value = 0;
+		memcpy(&value, &handle, sizeof(handle));
+		return value;
+	}
+}
+
+VkBuffer createStubBuffer(VkDeviceSize size, VkDeviceSize alignment) {
+	uint64_t handle = nextHandle++;
+	bufferRequirements[handle] = { size, alignment, ~0u };
+	return toHandle<VkBuffer>(handle);
+}
+
+uint32_t getStubDeviceMemoryCount() {
+	return static_cast<uint32_t>(deviceMemory.size());
+}
+
+DeviceCapabilityProfile createStubDeviceProfile() {
+	DeviceCapabilityProfile profile;
+	profile.properties.limits.maxMemoryAllocationCount = 4096;
+
+	VkPhysicalDeviceMemoryProperties& memory = profile.memoryProperties;
+	memory.memoryHeapCount = 2;
+	memory.memoryHeaps[0] = { 4ull * 1024 * 1024 * 1024, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+	memory.memoryHeaps[1] = { 256ull * 1024 * 1024, 0 };
+	memory.memoryTypeCount = 2;
+	memory.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+	memory.memoryTypes[1] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+	return profile;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks*, VkDeviceMemory* pMemory) {
+	uint64_t handle = nextHandle++;
+	deviceMemory[handle] = { pAllocateInfo->allocationSize };
+	*pMemory = toHandle<VkDeviceMemory>(handle);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*) {
+	auto it = deviceMemory.find(fromHandle(memory));
+	if (it != deviceMemory.end()) {
+		std::free(it->second.mapped);
+		deviceMemory.erase(it);
+	}
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** ppData) {
+	StubMemory& stub = deviceMemory.at(fromHandle(memory));
+	if (!stub.mapped) {
+		stub.mapped = std::calloc(1, static_cast<size_t>(stub.size));
+	}
+	*ppData = static_cast<char*>(stub.mapped) + offset;
+	return stub.mapped ? VK_SUCCESS : VK_ERROR_MEMORY_MAP_FAILED;
+}
+
+// Never asks for a dedicated allocation; callers zero-initialise the VkMemoryDedicatedRequirements they chain.
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(VkDevice, const VkBufferMemoryRequirementsInfo2* pInfo, VkMemoryRequirements2* pMemoryRequirements) {
+	pMemoryRequirements->memoryRequirements = bufferRequirements.at(fromHandle(pInfo->buffer));
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(VkDevice, const VkImageMemoryRequirementsInfo2*, VkMemoryRequirements2* pMemoryRequirements) {
+	pMemoryRequirements->memoryRequirements = { 64 * 1024, 64 * 1024, ~0u };
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties) {
+	pMemoryProperties->memoryProperties = createStubDeviceProfile().memoryProperties;
+}
+
+// Referenced by the render graph, frame scheduler and queue code linked into the tests. The tests only compile graphs,
+// so these just hand out handles and succeed.
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo*, const VkAllocationCallbacks*, VkImage* pImage) {
+	*pImage = toHandle<VkImage>(nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, VkImage, const VkAllocationCallbacks*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* pView) {
+	*pView = toHandle<VkImageView>(nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView, const VkAllocationCallbacks*) {
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceImageMemoryRequirements(VkDevice, const VkDeviceImageMemoryRequirements*, VkMemoryRequirements2* pMemoryRequirements) {
+	pMemoryRequirements->memoryRequirements = { 64 * 1024, 64 * 1024, ~0u };
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier2(VkCommandBuffer, const VkDependencyInfo*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*, VkCommandPool* pCommandPool) {
+	*pCommandPool = toHandle<VkCommandPool>(nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice, VkCommandPool, const VkAllocationCallbacks*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice, VkCommandPool, VkCommandPoolResetFlags) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers) {
+	// Dispatchable handles are pointers; the tests never dereference them.
+	for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i) {
+		pCommandBuffers[i] = toHandle<VkCommandBuffer>(nextHandle++);
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo*) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdExecuteCommands(VkCommandBuffer, uint32_t, const VkCommandBuffer*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo*, const VkAllocationCallbacks*, VkSemaphore* pSemaphore) {
+	*pSemaphore = toHandle<VkSemaphore>(nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore, const VkAllocationCallbacks*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice, VkSemaphore, uint64_t* pValue) {
+	*pValue = 0;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(VkDevice, const VkSemaphoreWaitInfo*, uint64_t) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, uint32_t, uint32_t, VkQueue* pQueue) {
+	*pQueue = toHandle<VkQueue>(nextHandle++);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, uint32_t, const VkSubmitInfo*, VkFence) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit2(VkQueue, uint32_t, const VkSubmitInfo2*, VkFence) {
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(VkQueue) {
+	return VK_SUCCESS;
+}
+
+// Referenced by the bindless descriptor code; the tests only exercise its slot allocator.
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures2(VkPhysicalDevice, VkPhysicalDeviceFeatures2*) {
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties2(VkPhysicalDevice, VkPhysicalDeviceProperties2*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*, VkDescriptorSetLayout* pSetLayout) {
+	*pSetLayout = toHandle<VkDescriptorSetLayout>(nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout, const VkAllocationCallbacks*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo*, const VkAllocationCallbacks*, VkDescriptorPool* pDescriptorPool) {
+	*pDescriptorPool = toHandle<VkDescriptorPool>(nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool, const VkAllocationCallbacks*) {
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo* pAllocateInfo, VkDescriptorSet* pDescriptorSets) {
+	for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i) {
+		pDescriptorSets[i] = toHandle<VkDescriptorSet>(nextHandle++);
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t, const VkCopyDescriptorSet*) {
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, uint32_t, const VkDescriptorSet*, uint32_t, const uint32_t*) {
+}
+
+// Referenced by the KTX2 code the glTF loader links; the tests never query formats.
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat, VkFormatProperties* pFormatProperties) {
+	*pFormatProperties = {};
+}
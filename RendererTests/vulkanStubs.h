@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+#include "deviceProfile.h"
+
+/*
+	Fake Driver
+	- Defines the Vulkan entry points the tested code calls, so the test project links without vulkan-1 and runs
+	  without a GPU. Handles are counters; memory is only backed by host memory once it is mapped.
+	- Buffers are created here with the requirements vkGetBufferMemoryRequirements2 should report for them.
+*/
+VkBuffer createStubBuffer(VkDeviceSize size, VkDeviceSize alignment);
+uint32_t getStubDeviceMemoryCount(); // vkAllocateMemory calls not yet matched by vkFreeMemory.
+
+// A profile with one 4 GiB device local heap and one 256 MiB host visible heap, each with a single memory type.
+DeviceCapabilityProfile createStubDeviceProfile();